@@ -0,0 +1,621 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// PathPlannerBatch - headless batch planning
+//
+// Plans a case, or every case of a cohort file, without Qt: the entry and
+// target points are read from text files, a trajectory is generated for
+// every entry and target pair, scored with the PathPlanner logic against
+// the label maps of the case, and the ranked trajectories are written to a
+// CSV file. The cases of a cohort are planned by child processes of this
+// executable, each one with its share of the cores.
+//
+// Point files hold one point per line, "name,R,A,S[,...]" (Slicer fiducial
+// lists) or "R A S"; lines starting with '#' are ignored. Cohort files hold
+// one case per line:
+//
+//   name entries targets critical [structure ...]
+//
+// "critical" is the label map used for the success probability, "-" for
+// none; the structures are the label maps the clearances are computed to.
+// Relative paths are relative to the cohort file.
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerLogic.h"
+#include "vtkSlicerPathPlannerRobustnessAnalyzer.h"
+#include "vtkSlicerPathPlannerTrajectoryScorer.h"
+
+// MRML includes
+#include <vtkMRMLAnnotationHierarchyNode.h>
+#include <vtkMRMLAnnotationRulerNode.h>
+#include <vtkMRMLPathPlannerTrajectoryNode.h>
+#include <vtkMRMLScalarVolumeNode.h>
+#include <vtkMRMLScene.h>
+#include <vtkMRMLVolumeArchetypeStorageNode.h>
+
+// VTK includes
+#include <vtkCollection.h>
+#include <vtkDoubleArray.h>
+#include <vtkMath.h>
+#include <vtkMultiThreader.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+#include <vtkStringArray.h>
+#include <vtksys/Process.h>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+//----------------------------------------------------------------------------
+struct Point
+{
+  std::string Name;
+  double Position[3];
+};
+
+//----------------------------------------------------------------------------
+struct Case
+{
+  std::string Name;
+  std::string EntriesFileName;
+  std::string TargetsFileName;
+  std::string CriticalFileName;
+  std::vector<std::string> StructureFileNames;
+};
+
+//----------------------------------------------------------------------------
+struct Options
+{
+  Options() : MaximumLength(0.0), NumberOfSamples(0), NumberOfJobs(1),
+              NumberOfThreads(0), CaseIndex(-1), Help(false) {}
+  Case SingleCase;
+  std::string OutputFileName;
+  std::string CasesFileName;
+  std::string OutputDirectory;
+  double MaximumLength;
+  int NumberOfSamples;
+  int NumberOfJobs;
+  int NumberOfThreads;
+  int CaseIndex;
+  bool Help;
+};
+
+//----------------------------------------------------------------------------
+void PrintUsage(const char* program)
+{
+  std::cerr
+    << "Usage: " << program << " [options] --entries FILE --targets FILE --output FILE\n"
+    << "       " << program << " [options] --cases FILE --output-dir DIRECTORY\n"
+    << "Options:\n"
+    << "  --critical FILE     label map of the success probability (single case)\n"
+    << "  --structure FILE    label map of a structure to avoid, repeatable (single case)\n"
+    << "  --max-length MM     skip the trajectories longer than MM\n"
+    << "  --samples N         Monte Carlo insertions per trajectory\n"
+    << "  --jobs N            cases planned in parallel (default 1)\n"
+    << "  --threads N         threads per case (default: cores / jobs)\n"
+    << "  -h, --help          print this help and exit\n";
+}
+
+//----------------------------------------------------------------------------
+bool ParseArguments(int argc, char* argv[], Options& options)
+{
+  for (int i = 1; i < argc; i++)
+    {
+    std::string argument = argv[i];
+    if (argument == "--help" || argument == "-h")
+      {
+      options.Help = true;
+      return true;
+      }
+    if (i + 1 >= argc)
+      {
+      std::cerr << "Missing value of " << argument << std::endl;
+      return false;
+      }
+    const char* value = argv[++i];
+    if (argument == "--entries")
+      {
+      options.SingleCase.EntriesFileName = value;
+      }
+    else if (argument == "--targets")
+      {
+      options.SingleCase.TargetsFileName = value;
+      }
+    else if (argument == "--critical")
+      {
+      options.SingleCase.CriticalFileName = value;
+      }
+    else if (argument == "--structure")
+      {
+      options.SingleCase.StructureFileNames.push_back(value);
+      }
+    else if (argument == "--output")
+      {
+      options.OutputFileName = value;
+      }
+    else if (argument == "--cases")
+      {
+      options.CasesFileName = value;
+      }
+    else if (argument == "--output-dir")
+      {
+      options.OutputDirectory = value;
+      }
+    else if (argument == "--max-length")
+      {
+      options.MaximumLength = atof(value);
+      }
+    else if (argument == "--samples")
+      {
+      options.NumberOfSamples = atoi(value);
+      }
+    else if (argument == "--jobs")
+      {
+      options.NumberOfJobs = atoi(value) > 0 ? atoi(value) : 1;
+      }
+    else if (argument == "--threads")
+      {
+      options.NumberOfThreads = atoi(value);
+      }
+    else if (argument == "--case-index")
+      {
+      // Used by the child processes
+      options.CaseIndex = atoi(value);
+      }
+    else
+      {
+      std::cerr << "Unknown option " << argument << std::endl;
+      return false;
+      }
+    }
+
+  if (!options.CasesFileName.empty())
+    {
+    return !options.OutputDirectory.empty();
+    }
+  return !options.SingleCase.EntriesFileName.empty() &&
+    !options.SingleCase.TargetsFileName.empty() && !options.OutputFileName.empty();
+}
+
+//----------------------------------------------------------------------------
+bool ReadPoints(const std::string& fileName, const char* defaultName,
+                std::vector<Point>& points)
+{
+  std::ifstream file(fileName.c_str());
+  if (!file)
+    {
+    std::cerr << "Cannot read " << fileName << std::endl;
+    return false;
+    }
+  std::string line;
+  while (std::getline(file, line))
+    {
+    if (line.empty() || line[0] == '#')
+      {
+      continue;
+      }
+    bool named = line.find(',') != std::string::npos;
+    for (size_t i = 0; i < line.size(); i++)
+      {
+      if (line[i] == ',')
+        {
+        line[i] = ' ';
+        }
+      }
+    std::istringstream fields(line);
+    Point point;
+    if (named)
+      {
+      fields >> point.Name;
+      }
+    fields >> point.Position[0] >> point.Position[1] >> point.Position[2];
+    if (fields.fail())
+      {
+      continue;
+      }
+    if (point.Name.empty())
+      {
+      std::ostringstream name;
+      name << defaultName << " " << points.size() + 1;
+      point.Name = name.str();
+      }
+    points.push_back(point);
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool ReadCases(const std::string& fileName, std::vector<Case>& cases)
+{
+  std::ifstream file(fileName.c_str());
+  if (!file)
+    {
+    std::cerr << "Cannot read " << fileName << std::endl;
+    return false;
+    }
+  std::string directory = vtksys::SystemTools::GetFilenamePath(
+    vtksys::SystemTools::CollapseFullPath(fileName.c_str()));
+  std::string line;
+  while (std::getline(file, line))
+    {
+    std::istringstream fields(line);
+    std::vector<std::string> values;
+    std::string value;
+    while (fields >> value)
+      {
+      values.push_back(value);
+      }
+    if (values.empty() || values[0][0] == '#')
+      {
+      continue;
+      }
+    if (values.size() < 4)
+      {
+      std::cerr << "Invalid case: " << line << std::endl;
+      return false;
+      }
+    for (size_t i = 1; i < values.size(); i++)
+      {
+      if (values[i] != "-")
+        {
+        values[i] = vtksys::SystemTools::CollapseFullPath(values[i].c_str(), directory.c_str());
+        }
+      }
+    Case newCase;
+    newCase.Name = values[0];
+    newCase.EntriesFileName = values[1];
+    newCase.TargetsFileName = values[2];
+    newCase.CriticalFileName = values[3] != "-" ? values[3] : "";
+    newCase.StructureFileNames.assign(values.begin() + 4, values.end());
+    cases.push_back(newCase);
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLScalarVolumeNode* ReadLabelMap(vtkMRMLScene* scene, const std::string& fileName)
+{
+  vtkNew<vtkMRMLScalarVolumeNode> volume;
+  volume->SetName(vtksys::SystemTools::GetFilenameWithoutExtension(fileName).c_str());
+  volume->SetLabelMap(1);
+  scene->AddNode(volume.GetPointer());
+
+  vtkNew<vtkMRMLVolumeArchetypeStorageNode> storage;
+  storage->SetFileName(fileName.c_str());
+  scene->AddNode(storage.GetPointer());
+  volume->SetAndObserveStorageNodeID(storage->GetID());
+  if (!storage->ReadData(volume.GetPointer()) || !volume->GetImageData())
+    {
+    std::cerr << "Cannot read " << fileName << std::endl;
+    return NULL;
+    }
+  return volume.GetPointer();
+}
+
+//----------------------------------------------------------------------------
+// Trajectory of every entry and target pair, as rulers of the trajectory
+// node in the same hierarchy layout as the module
+int GenerateTrajectories(vtkMRMLScene* scene, vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                         const std::vector<Point>& entries, const std::vector<Point>& targets,
+                         double maximumLength)
+{
+  int numberOfTrajectories = 0;
+  for (size_t t = 0; t < targets.size(); t++)
+    {
+    for (size_t e = 0; e < entries.size(); e++)
+      {
+      const double* entry = entries[e].Position;
+      const double* target = targets[t].Position;
+      if (maximumLength > 0.0 &&
+          vtkMath::Distance2BetweenPoints(entry, target) > maximumLength * maximumLength)
+        {
+        continue;
+        }
+      std::string name = entries[e].Name + "-" + targets[t].Name;
+
+      vtkNew<vtkMRMLAnnotationRulerNode> ruler;
+      ruler->SetName(name.c_str());
+      ruler->SetPosition1(entry[0], entry[1], entry[2]);
+      ruler->SetPosition2(target[0], target[1], target[2]);
+      scene->AddNode(ruler.GetPointer());
+
+      vtkNew<vtkMRMLAnnotationHierarchyNode> rulerHierarchy;
+      rulerHierarchy->SetHideFromEditors(1);
+      rulerHierarchy->AllowMultipleChildrenOff();
+      scene->AddNode(rulerHierarchy.GetPointer());
+      rulerHierarchy->SetParentNodeID(trajectoryNode->GetID());
+      rulerHierarchy->SetAssociatedNodeID(ruler->GetID());
+      ++numberOfTrajectories;
+      }
+    }
+  return numberOfTrajectories;
+}
+
+//----------------------------------------------------------------------------
+bool WriteRankedTrajectories(const std::string& fileName, vtkSlicerPathPlannerLogic* logic,
+                             vtkCollection* rankedRulers)
+{
+  std::ofstream file(fileName.c_str());
+  if (!file)
+    {
+    std::cerr << "Cannot write " << fileName << std::endl;
+    return false;
+    }
+
+  vtkSlicerPathPlannerTrajectoryScorer* scorer = logic->GetTrajectoryScorer();
+  std::vector<std::string> terms;
+  for (int n = 0; n < scorer->GetNumberOfTerms(); n++)
+    {
+    if (scorer->GetTermWeight(scorer->GetNthTermName(n)) != 0.0)
+      {
+      terms.push_back(scorer->GetNthTermName(n));
+      }
+    }
+
+  // Scores of the scorer, as ranked by ReplanTrajectories
+  std::map<std::string, double> scores;
+  vtkStringArray* ids = logic->GetTrajectoryIDArray();
+  vtkDoubleArray* scoreArray = logic->GetTrajectoryScoreArray();
+  for (vtkIdType i = 0; i < ids->GetNumberOfValues() && i < scoreArray->GetNumberOfTuples(); i++)
+    {
+    scores[ids->GetValue(i)] = scoreArray->GetValue(i);
+    }
+
+  file << "Rank,Name,EntryR,EntryA,EntryS,TargetR,TargetA,TargetS,Length,Score";
+  for (size_t n = 0; n < terms.size(); n++)
+    {
+    file << "," << terms[n];
+    }
+  file << "\n";
+  file.precision(10);
+
+  for (int i = 0; i < rankedRulers->GetNumberOfItems(); i++)
+    {
+    vtkMRMLAnnotationRulerNode* ruler =
+      vtkMRMLAnnotationRulerNode::SafeDownCast(rankedRulers->GetItemAsObject(i));
+    double* entry = ruler->GetPosition1();
+    double* target = ruler->GetPosition2();
+
+    std::ostringstream values;
+    values.precision(10);
+    for (size_t n = 0; n < terms.size(); n++)
+      {
+      const char* value = ruler->GetAttribute(terms[n].c_str());
+      values << "," << (value ? value : "");
+      }
+    std::map<std::string, double>::const_iterator score =
+      scores.find(ruler->GetID() ? ruler->GetID() : "");
+
+    file << i + 1 << "," << ruler->GetName() << ","
+         << entry[0] << "," << entry[1] << "," << entry[2] << ","
+         << target[0] << "," << target[1] << "," << target[2] << ","
+         << sqrt(vtkMath::Distance2BetweenPoints(entry, target)) << ","
+         << (score != scores.end() ? score->second : vtkMath::Nan()) << values.str() << "\n";
+    }
+  return file.good();
+}
+
+//----------------------------------------------------------------------------
+bool PlanCase(const Case& plannedCase, const Options& options, const std::string& outputFileName)
+{
+  std::vector<Point> entries;
+  std::vector<Point> targets;
+  if (!ReadPoints(plannedCase.EntriesFileName, "Entry", entries) ||
+      !ReadPoints(plannedCase.TargetsFileName, "Target", targets))
+    {
+    return false;
+    }
+
+  vtkNew<vtkMRMLScene> scene;
+  vtkNew<vtkSlicerPathPlannerLogic> logic;
+  logic->SetMRMLScene(scene.GetPointer());
+  if (options.NumberOfSamples > 0)
+    {
+    logic->GetRobustnessAnalyzer()->SetNumberOfSamples(options.NumberOfSamples);
+    }
+
+  vtkMRMLScalarVolumeNode* critical = NULL;
+  if (!plannedCase.CriticalFileName.empty())
+    {
+    critical = ReadLabelMap(scene.GetPointer(), plannedCase.CriticalFileName);
+    if (!critical)
+      {
+      return false;
+      }
+    }
+  vtkNew<vtkCollection> structures;
+  for (size_t i = 0; i < plannedCase.StructureFileNames.size(); i++)
+    {
+    vtkMRMLScalarVolumeNode* structure =
+      ReadLabelMap(scene.GetPointer(), plannedCase.StructureFileNames[i]);
+    if (!structure)
+      {
+      return false;
+      }
+    structures->AddItem(structure);
+    }
+
+  vtkNew<vtkMRMLPathPlannerTrajectoryNode> trajectoryNode;
+  trajectoryNode->SetName(plannedCase.Name.c_str());
+  scene->AddNode(trajectoryNode.GetPointer());
+  int numberOfTrajectories = GenerateTrajectories(scene.GetPointer(), trajectoryNode.GetPointer(),
+                                                  entries, targets, options.MaximumLength);
+
+  // Scores as in the module: probabilities, then clearances and ranking
+  logic->ComputeHitProbabilities(trajectoryNode.GetPointer());
+  logic->ComputeSuccessProbabilities(trajectoryNode.GetPointer(), critical);
+  vtkNew<vtkCollection> rankedRulers;
+  logic->ReplanTrajectories(trajectoryNode.GetPointer(), structures.GetPointer(),
+                            rankedRulers.GetPointer());
+
+  if (!WriteRankedTrajectories(outputFileName, logic.GetPointer(), rankedRulers.GetPointer()))
+    {
+    return false;
+    }
+  std::cout << plannedCase.Name << ": " << numberOfTrajectories << " trajectories ranked in "
+            << outputFileName << std::endl;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Plan the cases in child processes, "numberOfJobs" at a time. Return the
+// number of failed cases.
+int PlanCases(const char* program, const Options& options, int numberOfCases)
+{
+  int numberOfThreads = options.NumberOfThreads;
+  if (numberOfThreads <= 0)
+    {
+    numberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads() / options.NumberOfJobs;
+    numberOfThreads = numberOfThreads > 0 ? numberOfThreads : 1;
+    }
+  std::ostringstream threads;
+  threads << numberOfThreads;
+  std::ostringstream samples;
+  samples << options.NumberOfSamples;
+  std::ostringstream maximumLength;
+  maximumLength << options.MaximumLength;
+
+  std::vector<vtksysProcess*> running;
+  std::vector<int> runningCases;
+  int nextCase = 0;
+  int numberOfFailures = 0;
+  while (nextCase < numberOfCases || !running.empty())
+    {
+    while (nextCase < numberOfCases && static_cast<int>(running.size()) < options.NumberOfJobs)
+      {
+      std::ostringstream caseIndex;
+      caseIndex << nextCase;
+      std::vector<std::string> arguments;
+      arguments.push_back(program);
+      arguments.push_back("--cases");
+      arguments.push_back(options.CasesFileName);
+      arguments.push_back("--output-dir");
+      arguments.push_back(options.OutputDirectory);
+      arguments.push_back("--case-index");
+      arguments.push_back(caseIndex.str());
+      arguments.push_back("--threads");
+      arguments.push_back(threads.str());
+      arguments.push_back("--samples");
+      arguments.push_back(samples.str());
+      arguments.push_back("--max-length");
+      arguments.push_back(maximumLength.str());
+      std::vector<const char*> command;
+      for (size_t i = 0; i < arguments.size(); i++)
+        {
+        command.push_back(arguments[i].c_str());
+        }
+      command.push_back(NULL);
+
+      vtksysProcess* process = vtksysProcess_New();
+      vtksysProcess_SetCommand(process, &command[0]);
+      vtksysProcess_SetPipeShared(process, vtksysProcess_Pipe_STDOUT, 1);
+      vtksysProcess_SetPipeShared(process, vtksysProcess_Pipe_STDERR, 1);
+      vtksysProcess_Execute(process);
+      running.push_back(process);
+      runningCases.push_back(nextCase++);
+      }
+
+    // Reap the finished cases
+    for (size_t i = 0; i < running.size(); )
+      {
+      double timeout = 0.05;
+      if (!vtksysProcess_WaitForExit(running[i], &timeout))
+        {
+        ++i;
+        continue;
+        }
+      if (vtksysProcess_GetState(running[i]) != vtksysProcess_State_Exited ||
+          vtksysProcess_GetExitValue(running[i]) != 0)
+        {
+        std::cerr << "Case " << runningCases[i] + 1 << " failed" << std::endl;
+        ++numberOfFailures;
+        }
+      vtksysProcess_Delete(running[i]);
+      running.erase(running.begin() + i);
+      runningCases.erase(runningCases.begin() + i);
+      }
+    }
+  return numberOfFailures;
+}
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  Options options;
+  if (!ParseArguments(argc, argv, options))
+    {
+    PrintUsage(argv[0]);
+    return EXIT_FAILURE;
+    }
+  if (options.Help)
+    {
+    PrintUsage(argv[0]);
+    return EXIT_SUCCESS;
+    }
+  if (options.NumberOfThreads > 0)
+    {
+    vtkMultiThreader::SetGlobalMaximumNumberOfThreads(options.NumberOfThreads);
+    }
+
+  if (options.CasesFileName.empty())
+    {
+    return PlanCase(options.SingleCase, options, options.OutputFileName) ?
+      EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+  std::vector<Case> cases;
+  if (!ReadCases(options.CasesFileName, cases))
+    {
+    return EXIT_FAILURE;
+    }
+  vtksys::SystemTools::MakeDirectory(options.OutputDirectory.c_str());
+
+  // Child process: one case of the cohort
+  if (options.CaseIndex >= 0)
+    {
+    if (options.CaseIndex >= static_cast<int>(cases.size()))
+      {
+      return EXIT_FAILURE;
+      }
+    const Case& plannedCase = cases[options.CaseIndex];
+    return PlanCase(plannedCase, options,
+                    options.OutputDirectory + "/" + plannedCase.Name + ".csv") ?
+      EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+  int numberOfFailures = PlanCases(argv[0], options, static_cast<int>(cases.size()));
+  std::cout << cases.size() - numberOfFailures << " of " << cases.size()
+            << " cases planned" << std::endl;
+  return numberOfFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
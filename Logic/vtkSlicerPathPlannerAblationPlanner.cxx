@@ -0,0 +1,672 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerAblationPlanner.h"
+#include "vtkSlicerPathPlannerParallel.h"
+#include "vtkSlicerPathPlannerVolumeSampler.h"
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkIdList.h>
+#include <vtkMath.h>
+#include <vtkObjectFactory.h>
+#include <vtkPoints.h>
+
+// STD includes
+#include <cmath>
+
+namespace
+{
+//----------------------------------------------------------------------------
+int CountBits(vtkTypeUInt64 x)
+{
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  return static_cast<int>((x * 0x0101010101010101ULL) >> 56);
+}
+
+//----------------------------------------------------------------------------
+// Bounds of the non zero grid points, per thread
+struct TumorBoundsFunctor
+{
+  const vtkSlicerPathPlannerVolumeSampler* Tumor;
+  double Origin[3];
+  int Dimensions[3];
+  double Spacing;
+  double* ThreadBounds;
+
+  void operator()(vtkIdType begin, vtkIdType end, int threadId)
+  {
+    double* bounds = this->ThreadBounds + 6 * threadId;
+    for (vtkIdType k = begin; k < end; k++)
+      {
+      double point[3];
+      point[2] = this->Origin[2] + k * this->Spacing;
+      for (int j = 0; j < this->Dimensions[1]; j++)
+        {
+        point[1] = this->Origin[1] + j * this->Spacing;
+        for (int i = 0; i < this->Dimensions[0]; i++)
+          {
+          point[0] = this->Origin[0] + i * this->Spacing;
+          if (this->Tumor->GetValueNearest(point) == 0.0)
+            {
+            continue;
+            }
+          for (int axis = 0; axis < 3; axis++)
+            {
+            bounds[2 * axis] = point[axis] < bounds[2 * axis] ? point[axis] : bounds[2 * axis];
+            bounds[2 * axis + 1] = point[axis] > bounds[2 * axis + 1] ?
+              point[axis] : bounds[2 * axis + 1];
+            }
+          }
+        }
+      }
+  }
+};
+
+//----------------------------------------------------------------------------
+// Tumor flag of every grid point
+struct InsideFunctor
+{
+  const vtkSlicerPathPlannerVolumeSampler* Tumor;
+  double Origin[3];
+  int Dimensions[3];
+  double Spacing;
+  char* Inside;
+
+  void operator()(vtkIdType begin, vtkIdType end, int vtkNotUsed(threadId))
+  {
+    for (vtkIdType row = begin; row < end; row++)
+      {
+      double point[3];
+      point[1] = this->Origin[1] + (row % this->Dimensions[1]) * this->Spacing;
+      point[2] = this->Origin[2] + (row / this->Dimensions[1]) * this->Spacing;
+      char* inside = this->Inside + row * this->Dimensions[0];
+      for (int i = 0; i < this->Dimensions[0]; i++)
+        {
+        point[0] = this->Origin[0] + i * this->Spacing;
+        inside[i] = this->Tumor->GetValueNearest(point) != 0.0;
+        }
+      }
+  }
+};
+
+//----------------------------------------------------------------------------
+// Grid points within the margin of a tumor point. Each point gathers from
+// its neighbors so that threads never write to the same point.
+struct DilateFunctor
+{
+  int Dimensions[3];
+  const std::vector<int>* Offsets;
+  const char* Inside;
+  char* Target;
+
+  void operator()(vtkIdType begin, vtkIdType end, int vtkNotUsed(threadId))
+  {
+    const std::vector<int>& offsets = *this->Offsets;
+    for (vtkIdType row = begin; row < end; row++)
+      {
+      int j = static_cast<int>(row % this->Dimensions[1]);
+      int k = static_cast<int>(row / this->Dimensions[1]);
+      for (int i = 0; i < this->Dimensions[0]; i++)
+        {
+        char target = 0;
+        for (size_t n = 0; n + 2 < offsets.size() && !target; n += 3)
+          {
+          int ni = i + offsets[n];
+          int nj = j + offsets[n + 1];
+          int nk = k + offsets[n + 2];
+          if (ni < 0 || nj < 0 || nk < 0 || ni >= this->Dimensions[0] ||
+              nj >= this->Dimensions[1] || nk >= this->Dimensions[2])
+            {
+            continue;
+            }
+          target = this->Inside[(static_cast<vtkIdType>(nk) * this->Dimensions[1] + nj) *
+                                this->Dimensions[0] + ni];
+          }
+        this->Target[row * this->Dimensions[0] + i] = target;
+        }
+      }
+  }
+};
+
+//----------------------------------------------------------------------------
+// Coverage bitmap and risk of every candidate zone
+struct RasterizeFunctor
+{
+  const double* Candidates;
+  const vtkSlicerPathPlannerVolumeSampler* CriticalStructures;
+  double Origin[3];
+  int Dimensions[3];
+  double Spacing;
+  const int* TargetIndices;
+  int NumberOfWords;
+  double HalfLength;
+  double HalfDiameter;
+  double Offset;
+  vtkTypeUInt64* Bits;
+  double* Risks;
+  char* Feasible;
+
+  void operator()(vtkIdType begin, vtkIdType end, int vtkNotUsed(threadId))
+  {
+    for (vtkIdType c = begin; c < end; c++)
+      {
+      this->Rasterize(c);
+      }
+  }
+
+  void Rasterize(vtkIdType c)
+  {
+    const double* entry = this->Candidates + 6 * c;
+    const double* tip = entry + 3;
+    vtkTypeUInt64* bits = this->Bits + c * this->NumberOfWords;
+    this->Risks[c] = 0.0;
+    this->Feasible[c] = 0;
+
+    double axis[3] = { tip[0] - entry[0], tip[1] - entry[1], tip[2] - entry[2] };
+    if (vtkMath::Normalize(axis) <= 0.0 || this->HalfLength <= 0.0 ||
+        this->HalfDiameter <= 0.0)
+      {
+      return;
+      }
+    if (this->CriticalStructures &&
+        this->CriticalStructures->SegmentIntersectsNonZero(entry, tip))
+      {
+      return;
+      }
+    this->Feasible[c] = 1;
+
+    double center[3];
+    for (int i = 0; i < 3; i++)
+      {
+      center[i] = tip[i] - this->Offset * axis[i];
+      }
+    double extent = this->HalfLength > this->HalfDiameter ? this->HalfLength : this->HalfDiameter;
+    int first[3];
+    int last[3];
+    for (int i = 0; i < 3; i++)
+      {
+      first[i] = static_cast<int>(std::ceil((center[i] - extent - this->Origin[i]) / this->Spacing));
+      last[i] = static_cast<int>(std::floor((center[i] + extent - this->Origin[i]) / this->Spacing));
+      }
+
+    const double inverseLength2 = 1.0 / (this->HalfLength * this->HalfLength);
+    const double inverseDiameter2 = 1.0 / (this->HalfDiameter * this->HalfDiameter);
+    vtkIdType criticalPoints = 0;
+    int index[3];
+    for (index[2] = first[2]; index[2] <= last[2]; index[2]++)
+      {
+      for (index[1] = first[1]; index[1] <= last[1]; index[1]++)
+        {
+        for (index[0] = first[0]; index[0] <= last[0]; index[0]++)
+          {
+          double point[3];
+          double offset[3];
+          for (int i = 0; i < 3; i++)
+            {
+            point[i] = this->Origin[i] + index[i] * this->Spacing;
+            offset[i] = point[i] - center[i];
+            }
+          double along = vtkMath::Dot(offset, axis);
+          double radial2 = vtkMath::Dot(offset, offset) - along * along;
+          if (along * along * inverseLength2 + radial2 * inverseDiameter2 > 1.0)
+            {
+            continue;
+            }
+          if (index[0] >= 0 && index[1] >= 0 && index[2] >= 0 &&
+              index[0] < this->Dimensions[0] && index[1] < this->Dimensions[1] &&
+              index[2] < this->Dimensions[2])
+            {
+            int target = this->TargetIndices[
+              (static_cast<vtkIdType>(index[2]) * this->Dimensions[1] + index[1]) *
+              this->Dimensions[0] + index[0]];
+            if (target >= 0)
+              {
+              bits[target >> 6] |= static_cast<vtkTypeUInt64>(1) << (target & 63);
+              }
+            }
+          if (this->CriticalStructures &&
+              this->CriticalStructures->GetValueNearest(point) != 0.0)
+            {
+            ++criticalPoints;
+            }
+          }
+        }
+      }
+    this->Risks[c] = criticalPoints * this->Spacing * this->Spacing * this->Spacing;
+  }
+};
+
+//----------------------------------------------------------------------------
+// Newly covered points of every candidate
+struct GainFunctor
+{
+  const vtkTypeUInt64* Bits;
+  const vtkTypeUInt64* Covered;
+  int NumberOfWords;
+  const char* Available;
+  vtkIdType* NewlyCovered;
+
+  void operator()(vtkIdType begin, vtkIdType end, int vtkNotUsed(threadId))
+  {
+    for (vtkIdType c = begin; c < end; c++)
+      {
+      vtkIdType count = 0;
+      if (this->Available[c])
+        {
+        const vtkTypeUInt64* bits = this->Bits + c * this->NumberOfWords;
+        for (int w = 0; w < this->NumberOfWords; w++)
+          {
+          count += CountBits(bits[w] & ~this->Covered[w]);
+          }
+        }
+      this->NewlyCovered[c] = count;
+      }
+  }
+};
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerPathPlannerAblationPlanner);
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerAblationPlanner::vtkSlicerPathPlannerAblationPlanner()
+{
+  this->Tumor = NULL;
+  this->CriticalStructures = NULL;
+  this->Candidates = NULL;
+  this->Margin = 5.0;
+  this->GridSpacing = 2.0;
+  this->ZoneLength = 40.0;
+  this->ZoneDiameter = 30.0;
+  this->ZoneOffset = 5.0;
+  this->RiskWeight = 1.0;
+  this->RequiredCoverage = 0.99;
+  this->MaximumNumberOfProbes = 6;
+  this->TipSpacing = 5.0;
+  this->Coverage = 0.0;
+  this->Risk = 0.0;
+  this->NumberOfTargetPoints = 0;
+  this->GridOrigin[0] = this->GridOrigin[1] = this->GridOrigin[2] = 0.0;
+  this->GridDimensions[0] = this->GridDimensions[1] = this->GridDimensions[2] = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerAblationPlanner::~vtkSlicerPathPlannerAblationPlanner()
+{
+  this->SetTumor(NULL);
+  this->SetCriticalStructures(NULL);
+  this->SetCandidates(NULL);
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerAblationPlanner::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Tumor: " << this->Tumor << "\n";
+  os << indent << "CriticalStructures: " << this->CriticalStructures << "\n";
+  os << indent << "Candidates: " << this->Candidates << "\n";
+  os << indent << "Margin: " << this->Margin << "\n";
+  os << indent << "GridSpacing: " << this->GridSpacing << "\n";
+  os << indent << "ZoneLength: " << this->ZoneLength << "\n";
+  os << indent << "ZoneDiameter: " << this->ZoneDiameter << "\n";
+  os << indent << "ZoneOffset: " << this->ZoneOffset << "\n";
+  os << indent << "RiskWeight: " << this->RiskWeight << "\n";
+  os << indent << "RequiredCoverage: " << this->RequiredCoverage << "\n";
+  os << indent << "MaximumNumberOfProbes: " << this->MaximumNumberOfProbes << "\n";
+  os << indent << "TipSpacing: " << this->TipSpacing << "\n";
+  os << indent << "Coverage: " << this->Coverage << "\n";
+  os << indent << "Risk: " << this->Risk << "\n";
+  os << indent << "NumberOfTargetPoints: " << this->NumberOfTargetPoints << "\n";
+}
+
+//----------------------------------------------------------------------------
+vtkCxxSetObjectMacro(vtkSlicerPathPlannerAblationPlanner, Tumor,
+                     vtkSlicerPathPlannerVolumeSampler);
+vtkCxxSetObjectMacro(vtkSlicerPathPlannerAblationPlanner, CriticalStructures,
+                     vtkSlicerPathPlannerVolumeSampler);
+vtkCxxSetObjectMacro(vtkSlicerPathPlannerAblationPlanner, Candidates, vtkDoubleArray);
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerAblationPlanner::ComputeTumorBounds(double bounds[6])
+{
+  if (!this->Tumor || !this->Tumor->IsValid())
+    {
+    return 0;
+    }
+
+  double imageBounds[6];
+  this->Tumor->GetRASBounds(imageBounds);
+  TumorBoundsFunctor functor;
+  functor.Tumor = this->Tumor;
+  functor.Spacing = this->GridSpacing;
+  for (int axis = 0; axis < 3; axis++)
+    {
+    functor.Origin[axis] = imageBounds[2 * axis] + 0.5 * this->GridSpacing;
+    functor.Dimensions[axis] = static_cast<int>(
+      (imageBounds[2 * axis + 1] - imageBounds[2 * axis]) / this->GridSpacing);
+    functor.Dimensions[axis] = functor.Dimensions[axis] > 1 ? functor.Dimensions[axis] : 1;
+    }
+
+  int numberOfThreads = vtkSlicerPathPlannerNumberOfThreads();
+  std::vector<double> threadBounds(6 * numberOfThreads);
+  for (int t = 0; t < numberOfThreads; t++)
+    {
+    for (int axis = 0; axis < 3; axis++)
+      {
+      threadBounds[6 * t + 2 * axis] = VTK_DOUBLE_MAX;
+      threadBounds[6 * t + 2 * axis + 1] = -VTK_DOUBLE_MAX;
+      }
+    }
+  functor.ThreadBounds = &threadBounds[0];
+  vtkSlicerPathPlannerParallelFor(0, functor.Dimensions[2], 1, functor);
+
+  for (int axis = 0; axis < 3; axis++)
+    {
+    bounds[2 * axis] = VTK_DOUBLE_MAX;
+    bounds[2 * axis + 1] = -VTK_DOUBLE_MAX;
+    for (int t = 0; t < numberOfThreads; t++)
+      {
+      bounds[2 * axis] = threadBounds[6 * t + 2 * axis] < bounds[2 * axis] ?
+        threadBounds[6 * t + 2 * axis] : bounds[2 * axis];
+      bounds[2 * axis + 1] = threadBounds[6 * t + 2 * axis + 1] > bounds[2 * axis + 1] ?
+        threadBounds[6 * t + 2 * axis + 1] : bounds[2 * axis + 1];
+      }
+    }
+  return bounds[0] <= bounds[1];
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerAblationPlanner::BuildTargetGrid()
+{
+  this->TargetIndices.clear();
+  this->NumberOfTargetPoints = 0;
+  double bounds[6];
+  if (!this->ComputeTumorBounds(bounds))
+    {
+    return 0;
+    }
+
+  // Tumor bounds grown by the margin and one grid step
+  double spacing = this->GridSpacing;
+  for (int axis = 0; axis < 3; axis++)
+    {
+    this->GridOrigin[axis] = bounds[2 * axis] - this->Margin - spacing;
+    this->GridDimensions[axis] = static_cast<int>(std::ceil(
+      (bounds[2 * axis + 1] - bounds[2 * axis] + 2.0 * (this->Margin + spacing)) / spacing)) + 1;
+    }
+  vtkIdType numberOfPoints = static_cast<vtkIdType>(this->GridDimensions[0]) *
+    this->GridDimensions[1] * this->GridDimensions[2];
+  vtkIdType numberOfRows = static_cast<vtkIdType>(this->GridDimensions[1]) *
+    this->GridDimensions[2];
+
+  std::vector<char> inside(numberOfPoints);
+  InsideFunctor insideFunctor;
+  insideFunctor.Tumor = this->Tumor;
+  insideFunctor.Spacing = spacing;
+  for (int axis = 0; axis < 3; axis++)
+    {
+    insideFunctor.Origin[axis] = this->GridOrigin[axis];
+    insideFunctor.Dimensions[axis] = this->GridDimensions[axis];
+    }
+  insideFunctor.Inside = &inside[0];
+  vtkSlicerPathPlannerParallelFor(0, numberOfRows, 16, insideFunctor);
+
+  // Grid offsets within the margin
+  std::vector<int> offsets;
+  int range = static_cast<int>(std::floor(this->Margin / spacing));
+  for (int k = -range; k <= range; k++)
+    {
+    for (int j = -range; j <= range; j++)
+      {
+      for (int i = -range; i <= range; i++)
+        {
+        if ((i * i + j * j + k * k) * spacing * spacing <= this->Margin * this->Margin)
+          {
+          offsets.push_back(i);
+          offsets.push_back(j);
+          offsets.push_back(k);
+          }
+        }
+      }
+    }
+
+  std::vector<char> target(numberOfPoints);
+  DilateFunctor dilateFunctor;
+  for (int axis = 0; axis < 3; axis++)
+    {
+    dilateFunctor.Dimensions[axis] = this->GridDimensions[axis];
+    }
+  dilateFunctor.Offsets = &offsets;
+  dilateFunctor.Inside = &inside[0];
+  dilateFunctor.Target = &target[0];
+  vtkSlicerPathPlannerParallelFor(0, numberOfRows, 16, dilateFunctor);
+
+  this->TargetIndices.resize(numberOfPoints);
+  for (vtkIdType i = 0; i < numberOfPoints; i++)
+    {
+    this->TargetIndices[i] = target[i] ? static_cast<int>(this->NumberOfTargetPoints++) : -1;
+    }
+  return this->NumberOfTargetPoints > 0;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerAblationPlanner::GenerateCandidates(vtkPoints* entryPoints,
+                                                            vtkDoubleArray* candidates)
+{
+  if (!candidates)
+    {
+    return;
+    }
+  candidates->SetNumberOfComponents(6);
+  candidates->SetNumberOfTuples(0);
+  double bounds[6];
+  if (!entryPoints || !this->ComputeTumorBounds(bounds))
+    {
+    return;
+    }
+  const double tipSpacing = this->TipSpacing;
+
+  int dimensions[3];
+  for (int axis = 0; axis < 3; axis++)
+    {
+    dimensions[axis] = static_cast<int>((bounds[2 * axis + 1] - bounds[2 * axis]) / tipSpacing) + 1;
+    }
+  std::vector<double> tips;
+  double tip[3];
+  for (int k = 0; k < dimensions[2]; k++)
+    {
+    tip[2] = bounds[4] + k * tipSpacing;
+    for (int j = 0; j < dimensions[1]; j++)
+      {
+      tip[1] = bounds[2] + j * tipSpacing;
+      for (int i = 0; i < dimensions[0]; i++)
+        {
+        tip[0] = bounds[0] + i * tipSpacing;
+        if (this->Tumor->GetValueNearest(tip) != 0.0)
+          {
+          tips.insert(tips.end(), tip, tip + 3);
+          }
+        }
+      }
+    }
+
+  for (vtkIdType e = 0; e < entryPoints->GetNumberOfPoints(); e++)
+    {
+    double candidate[6];
+    entryPoints->GetPoint(e, candidate);
+    for (size_t t = 0; t < tips.size(); t += 3)
+      {
+      candidate[3] = tips[t];
+      candidate[4] = tips[t + 1];
+      candidate[5] = tips[t + 2];
+      candidates->InsertNextTuple(candidate);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerAblationPlanner::Plan()
+{
+  this->Selected.clear();
+  this->Coverage = 0.0;
+  this->Risk = 0.0;
+  if (!this->Candidates || this->Candidates->GetNumberOfComponents() != 6)
+    {
+    vtkErrorMacro(<< "Plan: no candidate trajectories");
+    return -1;
+    }
+  if (!this->BuildTargetGrid())
+    {
+    vtkErrorMacro(<< "Plan: empty tumor");
+    return -1;
+    }
+  vtkSlicerPathPlannerVolumeSampler* structures =
+    this->CriticalStructures && this->CriticalStructures->IsValid() ?
+    this->CriticalStructures : NULL;
+
+  vtkIdType numberOfCandidates = this->Candidates->GetNumberOfTuples();
+  int numberOfWords = static_cast<int>((this->NumberOfTargetPoints + 63) / 64);
+  std::vector<vtkTypeUInt64> bits(static_cast<size_t>(numberOfCandidates) * numberOfWords, 0);
+  std::vector<double> risks(numberOfCandidates);
+  std::vector<char> available(numberOfCandidates);
+  if (numberOfCandidates == 0)
+    {
+    return 0;
+    }
+
+  RasterizeFunctor rasterize;
+  rasterize.Candidates = this->Candidates->GetPointer(0);
+  rasterize.CriticalStructures = structures;
+  for (int axis = 0; axis < 3; axis++)
+    {
+    rasterize.Origin[axis] = this->GridOrigin[axis];
+    rasterize.Dimensions[axis] = this->GridDimensions[axis];
+    }
+  rasterize.Spacing = this->GridSpacing;
+  rasterize.TargetIndices = &this->TargetIndices[0];
+  rasterize.NumberOfWords = numberOfWords;
+  rasterize.HalfLength = 0.5 * this->ZoneLength;
+  rasterize.HalfDiameter = 0.5 * this->ZoneDiameter;
+  rasterize.Offset = this->ZoneOffset;
+  rasterize.Bits = &bits[0];
+  rasterize.Risks = &risks[0];
+  rasterize.Feasible = &available[0];
+  vtkSlicerPathPlannerParallelFor(0, numberOfCandidates, 8, rasterize);
+
+  // Greedy weighted set cover
+  const double pointVolume = this->GridSpacing * this->GridSpacing * this->GridSpacing;
+  const vtkIdType requiredPoints = static_cast<vtkIdType>(
+    std::ceil(this->RequiredCoverage * this->NumberOfTargetPoints - 1e-9));
+  std::vector<vtkTypeUInt64> covered(numberOfWords, 0);
+  std::vector<vtkIdType> newlyCovered(numberOfCandidates);
+  vtkIdType coveredPoints = 0;
+
+  GainFunctor gain;
+  gain.Bits = &bits[0];
+  gain.Covered = &covered[0];
+  gain.NumberOfWords = numberOfWords;
+  gain.Available = &available[0];
+  gain.NewlyCovered = &newlyCovered[0];
+
+  while (static_cast<int>(this->Selected.size()) < this->MaximumNumberOfProbes &&
+         coveredPoints < requiredPoints)
+    {
+    vtkSlicerPathPlannerParallelFor(0, numberOfCandidates, 64, gain);
+
+    vtkIdType best = -1;
+    double bestGain = 0.0;
+    for (vtkIdType c = 0; c < numberOfCandidates; c++)
+      {
+      double candidateGain = newlyCovered[c] * pointVolume - this->RiskWeight * risks[c];
+      if (newlyCovered[c] > 0 && candidateGain > bestGain)
+        {
+        best = c;
+        bestGain = candidateGain;
+        }
+      }
+    if (best < 0)
+      {
+      break;
+      }
+
+    this->Selected.push_back(best);
+    available[best] = 0;
+    coveredPoints += newlyCovered[best];
+    const vtkTypeUInt64* bestBits = &bits[best * numberOfWords];
+    for (int w = 0; w < numberOfWords; w++)
+      {
+      covered[w] |= bestBits[w];
+      }
+    }
+
+  // Remove the probes whose zone is covered by the others
+  for (size_t n = 0; n < this->Selected.size() && this->Selected.size() > 1; )
+    {
+    vtkIdType others = 0;
+    for (int w = 0; w < numberOfWords; w++)
+      {
+      vtkTypeUInt64 word = 0;
+      for (size_t m = 0; m < this->Selected.size(); m++)
+        {
+        if (m != n)
+          {
+          word |= bits[this->Selected[m] * numberOfWords + w];
+          }
+        }
+      others += CountBits(word);
+      }
+    if (others == coveredPoints)
+      {
+      this->Selected.erase(this->Selected.begin() + n);
+      }
+    else
+      {
+      ++n;
+      }
+    }
+
+  for (size_t n = 0; n < this->Selected.size(); n++)
+    {
+    this->Risk += risks[this->Selected[n]];
+    }
+  this->Coverage = static_cast<double>(coveredPoints) / this->NumberOfTargetPoints;
+  return static_cast<int>(this->Selected.size());
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerAblationPlanner::GetSelectedCandidates(vtkIdList* candidates)
+{
+  if (!candidates)
+    {
+    return;
+    }
+  candidates->SetNumberOfIds(static_cast<vtkIdType>(this->Selected.size()));
+  for (size_t n = 0; n < this->Selected.size(); n++)
+    {
+    candidates->SetId(static_cast<vtkIdType>(n), this->Selected[n]);
+    }
+}
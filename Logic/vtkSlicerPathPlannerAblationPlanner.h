@@ -0,0 +1,172 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// .NAME vtkSlicerPathPlannerAblationPlanner - multi-probe ablation coverage
+// .SECTION Description
+// Selects, among candidate trajectories, the probes whose ablation zones
+// cover the tumor plus Margin with the fewest probes and the least risk.
+// The ablation zone of a probe is an ellipsoid of revolution along the
+// needle axis (ZoneLength x ZoneDiameter) centered ZoneOffset mm before
+// the tip.
+//
+// The tumor plus margin is sampled on a grid of GridSpacing mm and every
+// candidate zone is rasterized in parallel into a bitmap over these
+// points. The selection is a greedy weighted set cover: each step adds
+// the probe with the largest newly covered volume minus RiskWeight times
+// the volume of critical structures inside its zone, the gains being
+// evaluated in parallel, until RequiredCoverage or MaximumNumberOfProbes
+// is reached. Probes made redundant by later ones are then removed.
+// Candidates whose path crosses the critical structures are discarded.
+
+#ifndef __vtkSlicerPathPlannerAblationPlanner_h
+#define __vtkSlicerPathPlannerAblationPlanner_h
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerPathPlannerModuleLogicExport.h"
+
+class vtkDoubleArray;
+class vtkIdList;
+class vtkPoints;
+class vtkSlicerPathPlannerVolumeSampler;
+
+/// \ingroup Slicer_QtModules_PathPlanner
+class VTK_SLICER_PATHPLANNER_MODULE_LOGIC_EXPORT vtkSlicerPathPlannerAblationPlanner :
+  public vtkObject
+{
+public:
+  static vtkSlicerPathPlannerAblationPlanner *New();
+  vtkTypeMacro(vtkSlicerPathPlannerAblationPlanner, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Tumor label map, non zero inside.
+  void SetTumor(vtkSlicerPathPlannerVolumeSampler* tumor);
+  vtkGetObjectMacro(Tumor, vtkSlicerPathPlannerVolumeSampler);
+
+  /// Critical structures label map, non zero inside. May be NULL.
+  void SetCriticalStructures(vtkSlicerPathPlannerVolumeSampler* structures);
+  vtkGetObjectMacro(CriticalStructures, vtkSlicerPathPlannerVolumeSampler);
+
+  /// Safety margin around the tumor (mm). Default is 5.
+  vtkSetClampMacro(Margin, double, 0.0, VTK_DOUBLE_MAX);
+  vtkGetMacro(Margin, double);
+
+  /// Coverage sampling step (mm). Default is 2.
+  vtkSetClampMacro(GridSpacing, double, 0.1, 100.0);
+  vtkGetMacro(GridSpacing, double);
+
+  /// Ablation zone: length along the needle and diameter (mm), and
+  /// distance from the tip back to the zone center. Defaults are 40, 30
+  /// and 5.
+  vtkSetClampMacro(ZoneLength, double, 0.0, VTK_DOUBLE_MAX);
+  vtkGetMacro(ZoneLength, double);
+  vtkSetClampMacro(ZoneDiameter, double, 0.0, VTK_DOUBLE_MAX);
+  vtkGetMacro(ZoneDiameter, double);
+  vtkSetMacro(ZoneOffset, double);
+  vtkGetMacro(ZoneOffset, double);
+
+  /// Cost of 1 mm^3 of critical structure inside a zone, relative to 1 mm^3
+  /// of newly covered tumor. Default is 1.
+  vtkSetClampMacro(RiskWeight, double, 0.0, VTK_DOUBLE_MAX);
+  vtkGetMacro(RiskWeight, double);
+
+  /// Stop once this fraction of the tumor plus margin is covered. Default
+  /// is 0.99.
+  vtkSetClampMacro(RequiredCoverage, double, 0.0, 1.0);
+  vtkGetMacro(RequiredCoverage, double);
+
+  /// Default is 6.
+  vtkSetClampMacro(MaximumNumberOfProbes, int, 1, 1000);
+  vtkGetMacro(MaximumNumberOfProbes, int);
+
+  /// Candidate trajectories, 6 components: entry RAS, tip RAS.
+  void SetCandidates(vtkDoubleArray* candidates);
+  vtkGetObjectMacro(Candidates, vtkDoubleArray);
+
+  /// Fill "candidates" with the trajectories from every entry point to
+  /// every point of a grid of TipSpacing mm inside the tumor.
+  void GenerateCandidates(vtkPoints* entryPoints, vtkDoubleArray* candidates);
+
+  /// Spacing of the generated tip positions (mm). Default is 5.
+  vtkSetClampMacro(TipSpacing, double, 0.1, 100.0);
+  vtkGetMacro(TipSpacing, double);
+
+  /// Select the probes. Return the number of selected probes, -1 on error.
+  int Plan();
+
+  /// Indices of the selected candidates, in order of selection.
+  void GetSelectedCandidates(vtkIdList* candidates);
+
+  /// Results of the last Plan: covered fraction of the tumor plus margin,
+  /// volume (mm^3) of critical structures inside the selected zones and
+  /// number of sampled target points.
+  vtkGetMacro(Coverage, double);
+  vtkGetMacro(Risk, double);
+  vtkGetMacro(NumberOfTargetPoints, vtkIdType);
+
+protected:
+  vtkSlicerPathPlannerAblationPlanner();
+  virtual ~vtkSlicerPathPlannerAblationPlanner();
+
+  /// Bounds of the tumor sampled every GridSpacing mm. Return 0 if empty.
+  int ComputeTumorBounds(double bounds[6]);
+
+  /// Sample the tumor plus margin into TargetIndices.
+  int BuildTargetGrid();
+
+  vtkSlicerPathPlannerVolumeSampler* Tumor;
+  vtkSlicerPathPlannerVolumeSampler* CriticalStructures;
+  vtkDoubleArray* Candidates;
+  double Margin;
+  double GridSpacing;
+  double ZoneLength;
+  double ZoneDiameter;
+  double ZoneOffset;
+  double RiskWeight;
+  double RequiredCoverage;
+  int MaximumNumberOfProbes;
+  double TipSpacing;
+
+  double Coverage;
+  double Risk;
+  vtkIdType NumberOfTargetPoints;
+
+  //BTX
+  // Target grid: index of each grid point among the target points, -1
+  // outside of the tumor plus margin
+  double GridOrigin[3];
+  int GridDimensions[3];
+  std::vector<int> TargetIndices;
+  std::vector<vtkIdType> Selected;
+  //ETX
+
+private:
+  vtkSlicerPathPlannerAblationPlanner(const vtkSlicerPathPlannerAblationPlanner&); // Not implemented
+  void operator=(const vtkSlicerPathPlannerAblationPlanner&);               // Not implemented
+};
+
+#endif
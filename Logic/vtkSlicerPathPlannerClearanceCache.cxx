@@ -0,0 +1,302 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerClearanceCache.h"
+#include "vtkSlicerPathPlannerDistanceMapCache.h"
+#include "vtkSlicerPathPlannerParallel.h"
+#include "vtkSlicerPathPlannerVolumeSampler.h"
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+namespace
+{
+//----------------------------------------------------------------------------
+// Clearances of the trajectory x structure pairs missing from the cache,
+// structures varying fastest
+struct MissingClearanceFunctor
+{
+  const double* Segments;
+  int NumberOfStructures;
+  const vtkSlicerPathPlannerVolumeSampler* const* DistanceMaps;
+  const vtkIdType* MissingPairs;
+  double SampleStep;
+  double* Clearances;
+
+  void operator()(vtkIdType begin, vtkIdType end, int vtkNotUsed(threadId))
+  {
+    for (vtkIdType m = begin; m < end; m++)
+      {
+      vtkIdType pair = this->MissingPairs[m];
+      const vtkSlicerPathPlannerVolumeSampler* distances =
+        this->DistanceMaps[pair % this->NumberOfStructures];
+      const double* segment = this->Segments + 6 * (pair / this->NumberOfStructures);
+      this->Clearances[pair] = distances ?
+        distances->GetMinimumAlongSegment(segment, segment + 3, this->SampleStep) :
+        VTK_DOUBLE_MAX;
+      }
+  }
+};
+}
+
+//----------------------------------------------------------------------------
+bool vtkSlicerPathPlannerClearanceCache::Segment::operator<(const Segment& other) const
+{
+  return std::lexicographical_compare(this->Points, this->Points + 6,
+                                      other.Points, other.Points + 6);
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerPathPlannerClearanceCache);
+
+//----------------------------------------------------------------------------
+vtkCxxSetObjectMacro(vtkSlicerPathPlannerClearanceCache, DistanceMapCache,
+                     vtkSlicerPathPlannerDistanceMapCache);
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerClearanceCache::vtkSlicerPathPlannerClearanceCache()
+{
+  this->DistanceMapCache = vtkSlicerPathPlannerDistanceMapCache::New();
+  this->SampleStep = 1.0;
+  this->SafetyMargin = 5.0;
+  this->NumberOfComputedClearances = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerClearanceCache::~vtkSlicerPathPlannerClearanceCache()
+{
+  this->SetDistanceMapCache(NULL);
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerClearanceCache::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  for (std::map<std::string, Structure>::iterator it = this->Structures.begin();
+       it != this->Structures.end(); ++it)
+    {
+    os << indent << "Structure " << it->first << ": "
+       << it->second.Clearances.size() << " clearances\n";
+    }
+  os << indent << "DistanceMapCache: " << this->DistanceMapCache << "\n";
+  os << indent << "SampleStep: " << this->SampleStep << "\n";
+  os << indent << "SafetyMargin: " << this->SafetyMargin << "\n";
+  os << indent << "NumberOfComputedClearances: " << this->NumberOfComputedClearances << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerClearanceCache::SetStructure(const char* name,
+                                                      vtkSlicerPathPlannerVolumeSampler* structures)
+{
+  if (!name)
+    {
+    return;
+    }
+  this->Structures[name].Labels = structures;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerClearanceCache::RemoveStructure(const char* name)
+{
+  if (name && this->Structures.erase(name))
+    {
+    this->Modified();
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerClearanceCache::RemoveAllStructures()
+{
+  this->Structures.clear();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerClearanceCache::GetNumberOfStructures()
+{
+  return static_cast<int>(this->Structures.size());
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerClearanceCache::GetNthStructureName(int n)
+{
+  if (n < 0 || n >= static_cast<int>(this->Structures.size()))
+    {
+    return NULL;
+    }
+  std::map<std::string, Structure>::iterator it = this->Structures.begin();
+  std::advance(it, n);
+  return it->first.c_str();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerClearanceCache::SetSampleStep(double step)
+{
+  step = step > 0.01 ? step : 0.01;
+  if (step == this->SampleStep)
+    {
+    return;
+    }
+  this->SampleStep = step;
+  for (std::map<std::string, Structure>::iterator it = this->Structures.begin();
+       it != this->Structures.end(); ++it)
+    {
+    it->second.Clearances.clear();
+    }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerClearanceCache::Evaluate(vtkDoubleArray* segments,
+                                                  vtkDoubleArray* clearances,
+                                                  vtkDoubleArray* risks,
+                                                  vtkDoubleArray* structureClearances)
+{
+  if (!segments || !clearances || !risks || segments->GetNumberOfComponents() != 6)
+    {
+    vtkErrorMacro(<< "Evaluate: invalid input arrays");
+    return;
+    }
+  if (!this->DistanceMapCache)
+    {
+    vtkErrorMacro(<< "Evaluate: no distance map cache");
+    return;
+    }
+
+  vtkIdType numberOfTrajectories = segments->GetNumberOfTuples();
+  int numberOfStructures = static_cast<int>(this->Structures.size());
+  const double* segment = numberOfTrajectories > 0 ? segments->GetPointer(0) : NULL;
+  clearances->SetNumberOfComponents(1);
+  clearances->SetNumberOfTuples(numberOfTrajectories);
+  risks->SetNumberOfComponents(1);
+  risks->SetNumberOfTuples(numberOfTrajectories);
+  this->NumberOfComputedClearances = 0;
+
+  // Distance maps are fetched before the threads start, recomputing those
+  // of the modified label maps. A new map invalidates its clearances.
+  std::vector<Structure*> structures;
+  std::vector<const vtkSlicerPathPlannerVolumeSampler*> distanceMaps(numberOfStructures + 1, NULL);
+  for (std::map<std::string, Structure>::iterator it = this->Structures.begin();
+       it != this->Structures.end(); ++it)
+    {
+    Structure& structure = it->second;
+    vtkSlicerPathPlannerVolumeSampler* distanceMap =
+      this->DistanceMapCache->GetDistanceMap(structure.Labels);
+    unsigned long distanceMapTime = distanceMap ? distanceMap->GetMTime() : 0;
+    if (distanceMap != structure.DistanceMap || distanceMapTime != structure.DistanceMapTime)
+      {
+      structure.Clearances.clear();
+      structure.DistanceMap = distanceMap;
+      structure.DistanceMapTime = distanceMapTime;
+      }
+    distanceMaps[structures.size()] = distanceMap;
+    structures.push_back(&structure);
+    }
+
+  // Reuse the clearances of the segments that did not move
+  std::vector<double> pairClearances(
+    static_cast<size_t>(numberOfTrajectories) * numberOfStructures + 1);
+  std::vector<vtkIdType> missingPairs;
+  for (vtkIdType t = 0; t < numberOfTrajectories; t++)
+    {
+    Segment key;
+    std::copy(segment + 6 * t, segment + 6 * t + 6, key.Points);
+    for (int s = 0; s < numberOfStructures; s++)
+      {
+      vtkIdType pair = t * numberOfStructures + s;
+      std::map<Segment, double>::iterator found = structures[s]->Clearances.find(key);
+      if (found != structures[s]->Clearances.end())
+        {
+        pairClearances[pair] = found->second;
+        }
+      else
+        {
+        missingPairs.push_back(pair);
+        }
+      }
+    }
+
+  this->NumberOfComputedClearances = static_cast<vtkIdType>(missingPairs.size());
+  if (!missingPairs.empty())
+    {
+    MissingClearanceFunctor functor;
+    functor.Segments = segment;
+    functor.NumberOfStructures = numberOfStructures;
+    functor.DistanceMaps = &distanceMaps[0];
+    functor.MissingPairs = &missingPairs[0];
+    functor.SampleStep = this->SampleStep;
+    functor.Clearances = &pairClearances[0];
+    vtkSlicerPathPlannerParallelFor(0, this->NumberOfComputedClearances, 16, functor);
+    }
+
+  // Keep the clearances of the current segments only
+  for (int s = 0; s < numberOfStructures; s++)
+    {
+    std::map<Segment, double> current;
+    for (vtkIdType t = 0; t < numberOfTrajectories; t++)
+      {
+      Segment key;
+      std::copy(segment + 6 * t, segment + 6 * t + 6, key.Points);
+      current[key] = pairClearances[t * numberOfStructures + s];
+      }
+    structures[s]->Clearances.swap(current);
+    }
+
+  if (structureClearances)
+    {
+    structureClearances->SetNumberOfComponents(numberOfStructures > 0 ? numberOfStructures : 1);
+    structureClearances->SetNumberOfTuples(numberOfStructures > 0 ? numberOfTrajectories : 0);
+    if (numberOfStructures > 0 && numberOfTrajectories > 0)
+      {
+      std::copy(pairClearances.begin(), pairClearances.end() - 1,
+                structureClearances->GetPointer(0));
+      }
+    }
+
+  for (vtkIdType t = 0; t < numberOfTrajectories; t++)
+    {
+    double clearance = VTK_DOUBLE_MAX;
+    for (int s = 0; s < numberOfStructures; s++)
+      {
+      clearance = std::min(clearance, pairClearances[t * numberOfStructures + s]);
+      }
+    double risk = 0.0;
+    if (clearance <= 0.0)
+      {
+      risk = 1.0;
+      }
+    else if (clearance < this->SafetyMargin)
+      {
+      risk = 1.0 - clearance / this->SafetyMargin;
+      }
+    clearances->SetValue(t, clearance);
+    risks->SetValue(t, risk);
+    }
+}
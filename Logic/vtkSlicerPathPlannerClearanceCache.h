@@ -0,0 +1,129 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// .NAME vtkSlicerPathPlannerClearanceCache - incremental clearance to critical structures
+// .SECTION Description
+// Each critical structure is a label map identified by name. The
+// clearance of a trajectory to a structure is the smallest distance to it
+// sampled every SampleStep mm along the segment, read from the distance
+// map of the structure in a DistanceMapCache.
+//
+// Clearances are kept per structure and per segment between evaluations.
+// When a new intra-procedural image is segmented, only the structures
+// whose label map changed get a new distance map, and only their
+// clearances, plus those of the trajectories that moved, are computed
+// again. The others are reused as they are.
+
+#ifndef __vtkSlicerPathPlannerClearanceCache_h
+#define __vtkSlicerPathPlannerClearanceCache_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <map>
+#include <string>
+
+#include "vtkSlicerPathPlannerModuleLogicExport.h"
+
+class vtkDoubleArray;
+class vtkSlicerPathPlannerDistanceMapCache;
+class vtkSlicerPathPlannerVolumeSampler;
+
+/// \ingroup Slicer_QtModules_PathPlanner
+class VTK_SLICER_PATHPLANNER_MODULE_LOGIC_EXPORT vtkSlicerPathPlannerClearanceCache :
+  public vtkObject
+{
+public:
+  static vtkSlicerPathPlannerClearanceCache *New();
+  vtkTypeMacro(vtkSlicerPathPlannerClearanceCache, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Add a structure or replace its label map. Replacing a label map by a
+  /// sampler of the same unmodified image keeps the clearances.
+  void SetStructure(const char* name, vtkSlicerPathPlannerVolumeSampler* structures);
+  void RemoveStructure(const char* name);
+  void RemoveAllStructures();
+  int GetNumberOfStructures();
+  const char* GetNthStructureName(int n);
+
+  /// Cache the distance maps are taken from. A cache is created by the
+  /// constructor; share it to reuse maps across evaluators.
+  void SetDistanceMapCache(vtkSlicerPathPlannerDistanceMapCache* cache);
+  vtkGetObjectMacro(DistanceMapCache, vtkSlicerPathPlannerDistanceMapCache);
+
+  /// Distance between clearance samples (mm). Changing it drops the
+  /// cached clearances. Default is 1.
+  virtual void SetSampleStep(double step);
+  vtkGetMacro(SampleStep, double);
+
+  /// Clearance above which the risk is 0 (mm). The risk grows linearly to
+  /// 1 when the clearance drops to 0. Default is 5.
+  vtkSetClampMacro(SafetyMargin, double, 0.0, VTK_DOUBLE_MAX);
+  vtkGetMacro(SafetyMargin, double);
+
+  /// Clearance of every trajectory of "segments" (6 components: entry
+  /// RAS, target RAS) to the closest structure, and the matching risk.
+  /// "structureClearances" (may be NULL) receives one component per
+  /// structure, in the order of GetNthStructureName. Clearances of
+  /// segments that are not in "segments" are forgotten.
+  void Evaluate(vtkDoubleArray* segments, vtkDoubleArray* clearances, vtkDoubleArray* risks,
+                vtkDoubleArray* structureClearances = NULL);
+
+  /// Number of trajectory x structure clearances computed, rather than
+  /// reused, by the last evaluation.
+  vtkGetMacro(NumberOfComputedClearances, vtkIdType);
+
+protected:
+  vtkSlicerPathPlannerClearanceCache();
+  virtual ~vtkSlicerPathPlannerClearanceCache();
+
+  //BTX
+  struct Segment
+  {
+    double Points[6];
+    bool operator<(const Segment& other) const;
+  };
+  struct Structure
+  {
+    Structure() : DistanceMap(NULL), DistanceMapTime(0) {}
+    vtkSmartPointer<vtkSlicerPathPlannerVolumeSampler> Labels;
+    // Distance map the clearances were computed on
+    const vtkSlicerPathPlannerVolumeSampler* DistanceMap;
+    unsigned long DistanceMapTime;
+    std::map<Segment, double> Clearances;
+  };
+  std::map<std::string, Structure> Structures;
+  //ETX
+
+  vtkSlicerPathPlannerDistanceMapCache* DistanceMapCache;
+  double SampleStep;
+  double SafetyMargin;
+  vtkIdType NumberOfComputedClearances;
+
+private:
+  vtkSlicerPathPlannerClearanceCache(const vtkSlicerPathPlannerClearanceCache&); // Not implemented
+  void operator=(const vtkSlicerPathPlannerClearanceCache&);               // Not implemented
+};
+
+#endif
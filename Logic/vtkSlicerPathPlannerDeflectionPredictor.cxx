@@ -0,0 +1,266 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerDeflectionPredictor.h"
+#include "vtkSlicerPathPlannerParallel.h"
+#include "vtkSlicerPathPlannerVolumeSampler.h"
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkMath.h>
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <cmath>
+
+namespace
+{
+//----------------------------------------------------------------------------
+struct DeflectionFunctor
+{
+  const double* Segments;
+  const double* BevelAngles;
+  double Curvature;
+  double StiffnessScale;
+  const vtkSlicerPathPlannerVolumeSampler* Stiffness;
+  const std::map<int, double>* LabelStiffness;
+  int NumberOfPathPoints;
+  double StepLength;
+  double* Paths;
+  double* TipSegments;
+
+  double GetCurvature(const double position[3]) const
+  {
+    if (!this->Stiffness)
+      {
+      return this->Curvature;
+      }
+    double stiffness = 1.0;
+    if (this->LabelStiffness->empty())
+      {
+      stiffness = this->StiffnessScale * this->Stiffness->GetValueLinear(position);
+      }
+    else
+      {
+      int label = static_cast<int>(this->Stiffness->GetValueNearest(position));
+      std::map<int, double>::const_iterator it = this->LabelStiffness->find(label);
+      if (it != this->LabelStiffness->end())
+        {
+        stiffness = it->second;
+        }
+      }
+    return stiffness > 0.0 ? this->Curvature * stiffness : 0.0;
+  }
+
+  void operator()(vtkIdType begin, vtkIdType end, int vtkNotUsed(threadId))
+  {
+    for (vtkIdType i = begin; i < end; i++)
+      {
+      const double* entry = this->Segments + 6 * i;
+      const double* target = entry + 3;
+      double* path = this->Paths + 3 * this->NumberOfPathPoints * i;
+
+      // Tip frame: tangent and bevel direction
+      double tangent[3] = { target[0] - entry[0], target[1] - entry[1], target[2] - entry[2] };
+      double depth = vtkMath::Normalize(tangent);
+      if (depth <= 0.0)
+        {
+        // The entry is the target: nothing is inserted, the path and the
+        // tip segment are the entry point and the deviation is 0
+        for (int point = 0; point < this->NumberOfPathPoints; point++)
+          {
+          path[3 * point] = entry[0];
+          path[3 * point + 1] = entry[1];
+          path[3 * point + 2] = entry[2];
+          }
+        if (this->TipSegments)
+          {
+          double* tipSegment = this->TipSegments + 6 * i;
+          for (int c = 0; c < 3; c++)
+            {
+            tipSegment[c] = tipSegment[c + 3] = entry[c];
+            }
+          }
+        continue;
+        }
+      double lateral1[3];
+      double lateral2[3];
+      vtkMath::Perpendiculars(tangent, lateral1, lateral2, 0.0);
+      double roll = this->BevelAngles ?
+        vtkMath::RadiansFromDegrees(this->BevelAngles[i]) : 0.0;
+      double bevel[3];
+      for (int c = 0; c < 3; c++)
+        {
+        bevel[c] = std::cos(roll) * lateral1[c] + std::sin(roll) * lateral2[c];
+        }
+
+      double position[3] = { entry[0], entry[1], entry[2] };
+      path[0] = position[0];
+      path[1] = position[1];
+      path[2] = position[2];
+
+      double interval = depth / (this->NumberOfPathPoints - 1);
+      int numberOfSteps = static_cast<int>(std::ceil(interval / this->StepLength));
+      numberOfSteps = numberOfSteps > 0 ? numberOfSteps : 1;
+      double step = interval / numberOfSteps;
+      for (int point = 1; point < this->NumberOfPathPoints; point++)
+        {
+        for (int n = 0; n < numberOfSteps; n++)
+          {
+          // Exact arc of constant curvature in the (tangent, bevel) plane
+          double curvature = this->GetCurvature(position);
+          double angle = curvature * step;
+          double along = step;
+          double across = 0.0;
+          if (angle > 1e-9)
+            {
+            along = std::sin(angle) / curvature;
+            across = (1.0 - std::cos(angle)) / curvature;
+            }
+          double cosine = std::cos(angle);
+          double sine = std::sin(angle);
+          for (int c = 0; c < 3; c++)
+            {
+            position[c] += along * tangent[c] + across * bevel[c];
+            double t = tangent[c];
+            tangent[c] = cosine * t + sine * bevel[c];
+            bevel[c] = cosine * bevel[c] - sine * t;
+            }
+          }
+        path[3 * point] = position[0];
+        path[3 * point + 1] = position[1];
+        path[3 * point + 2] = position[2];
+        }
+
+      if (this->TipSegments)
+        {
+        double* tipSegment = this->TipSegments + 6 * i;
+        for (int c = 0; c < 3; c++)
+          {
+          tipSegment[c] = position[c] - depth * tangent[c];
+          tipSegment[c + 3] = position[c];
+          }
+        }
+      }
+  }
+};
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerPathPlannerDeflectionPredictor);
+
+//----------------------------------------------------------------------------
+vtkCxxSetObjectMacro(vtkSlicerPathPlannerDeflectionPredictor, Stiffness,
+                     vtkSlicerPathPlannerVolumeSampler);
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerDeflectionPredictor::vtkSlicerPathPlannerDeflectionPredictor()
+{
+  this->Curvature = 0.004;
+  this->StiffnessScale = 1.0;
+  this->Stiffness = NULL;
+  this->NumberOfPathPoints = 21;
+  this->StepLength = 1.0;
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerDeflectionPredictor::~vtkSlicerPathPlannerDeflectionPredictor()
+{
+  this->SetStiffness(NULL);
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerDeflectionPredictor::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Curvature: " << this->Curvature << "\n";
+  os << indent << "StiffnessScale: " << this->StiffnessScale << "\n";
+  os << indent << "Stiffness: " << this->Stiffness << "\n";
+  os << indent << "NumberOfLabelStiffnesses: " << this->LabelStiffness.size() << "\n";
+  os << indent << "NumberOfPathPoints: " << this->NumberOfPathPoints << "\n";
+  os << indent << "StepLength: " << this->StepLength << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerDeflectionPredictor::SetLabelStiffness(int label, double stiffness)
+{
+  this->LabelStiffness[label] = stiffness;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerDeflectionPredictor::RemoveAllLabelStiffnesses()
+{
+  if (!this->LabelStiffness.empty())
+    {
+    this->LabelStiffness.clear();
+    this->Modified();
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerDeflectionPredictor::Predict(vtkDoubleArray* segments,
+                                                      vtkDoubleArray* bevelAngles,
+                                                      vtkDoubleArray* paths,
+                                                      vtkDoubleArray* tipSegments)
+{
+  if (!segments || !paths || segments->GetNumberOfComponents() != 6 ||
+      (bevelAngles && bevelAngles->GetNumberOfTuples() != segments->GetNumberOfTuples()))
+    {
+    vtkErrorMacro(<< "Predict: invalid input arrays");
+    return;
+    }
+  if (this->StepLength <= 0.0)
+    {
+    vtkErrorMacro(<< "Predict: StepLength must be positive");
+    return;
+    }
+
+  vtkIdType numberOfTrajectories = segments->GetNumberOfTuples();
+  paths->SetNumberOfComponents(3);
+  paths->SetNumberOfTuples(numberOfTrajectories * this->NumberOfPathPoints);
+  if (tipSegments)
+    {
+    tipSegments->SetNumberOfComponents(6);
+    tipSegments->SetNumberOfTuples(numberOfTrajectories);
+    }
+  if (numberOfTrajectories == 0)
+    {
+    return;
+    }
+
+  DeflectionFunctor functor;
+  functor.Segments = segments->GetPointer(0);
+  functor.BevelAngles = bevelAngles ? bevelAngles->GetPointer(0) : NULL;
+  functor.Curvature = this->Curvature;
+  functor.StiffnessScale = this->StiffnessScale;
+  functor.Stiffness = (this->Stiffness && this->Stiffness->IsValid()) ? this->Stiffness : NULL;
+  functor.LabelStiffness = &this->LabelStiffness;
+  functor.NumberOfPathPoints = this->NumberOfPathPoints;
+  functor.StepLength = this->StepLength;
+  functor.Paths = paths->GetPointer(0);
+  functor.TipSegments = tipSegments ? tipSegments->GetPointer(0) : NULL;
+
+  vtkSlicerPathPlannerParallelFor(0, numberOfTrajectories, 16, functor);
+}
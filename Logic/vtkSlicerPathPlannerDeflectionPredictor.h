@@ -0,0 +1,116 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// .NAME vtkSlicerPathPlannerDeflectionPredictor - bevel-tip needle path prediction
+// .SECTION Description
+// Predicts the path of a bevel-tip needle inserted along each planned
+// trajectory with the kinematic model of Webster et al. (IJRR 2006): the
+// asymmetric tip makes the needle follow an arc whose curvature points
+// toward the bevel. The curvature is Curvature times the local tissue
+// stiffness, read from an image (value times StiffnessScale) or from a
+// label map through a label to stiffness table. Without stiffness volume
+// the stiffness is 1 everywhere. Each step advances exactly along an arc of
+// constant curvature, so the step length only controls how often the
+// stiffness is sampled. Trajectories are predicted in parallel.
+
+#ifndef __vtkSlicerPathPlannerDeflectionPredictor_h
+#define __vtkSlicerPathPlannerDeflectionPredictor_h
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <map>
+
+#include "vtkSlicerPathPlannerModuleLogicExport.h"
+
+class vtkDoubleArray;
+class vtkSlicerPathPlannerVolumeSampler;
+
+/// \ingroup Slicer_QtModules_PathPlanner
+class VTK_SLICER_PATHPLANNER_MODULE_LOGIC_EXPORT vtkSlicerPathPlannerDeflectionPredictor :
+  public vtkObject
+{
+public:
+  static vtkSlicerPathPlannerDeflectionPredictor *New();
+  vtkTypeMacro(vtkSlicerPathPlannerDeflectionPredictor, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Curvature (1/mm) of the needle path in tissue of stiffness 1.
+  /// Default is 0.004 (radius of 25 cm).
+  vtkSetMacro(Curvature, double);
+  vtkGetMacro(Curvature, double);
+
+  /// Factor applied to the stiffness image values. Default is 1.
+  vtkSetMacro(StiffnessScale, double);
+  vtkGetMacro(StiffnessScale, double);
+
+  /// Image or label map of the tissue stiffness. May be NULL.
+  void SetStiffness(vtkSlicerPathPlannerVolumeSampler* sampler);
+  vtkGetObjectMacro(Stiffness, vtkSlicerPathPlannerVolumeSampler);
+
+  /// When at least one label is set, the Stiffness volume is a label map
+  /// and labels missing from the table have a stiffness of 1.
+  void SetLabelStiffness(int label, double stiffness);
+  void RemoveAllLabelStiffnesses();
+
+  /// Number of points of each predicted path, entry and tip included.
+  /// Default is 21.
+  vtkSetClampMacro(NumberOfPathPoints, int, 2, VTK_INT_MAX);
+  vtkGetMacro(NumberOfPathPoints, int);
+
+  /// Integration step length (mm). Default is 1.
+  vtkSetMacro(StepLength, double);
+  vtkGetMacro(StepLength, double);
+
+  /// Predict the path of every trajectory of "segments" (6 components:
+  /// entry RAS, target RAS), the needle being inserted along the planned
+  /// direction up to the planned depth. "bevelAngles" (may be NULL) holds
+  /// the roll of the bevel in degrees around the insertion axis, 0 being
+  /// the first vector returned by vtkMath::Perpendiculars. "paths" receives
+  /// NumberOfPathPoints 3-component points per trajectory. "tipSegments",
+  /// if not NULL, receives the straight segment of the planned length
+  /// ending at the predicted tip and tangent to the path there.
+  void Predict(vtkDoubleArray* segments, vtkDoubleArray* bevelAngles,
+               vtkDoubleArray* paths, vtkDoubleArray* tipSegments);
+
+protected:
+  vtkSlicerPathPlannerDeflectionPredictor();
+  virtual ~vtkSlicerPathPlannerDeflectionPredictor();
+
+  double Curvature;
+  double StiffnessScale;
+  vtkSlicerPathPlannerVolumeSampler* Stiffness;
+  int NumberOfPathPoints;
+  double StepLength;
+
+  //BTX
+  std::map<int, double> LabelStiffness;
+  //ETX
+
+private:
+  vtkSlicerPathPlannerDeflectionPredictor(const vtkSlicerPathPlannerDeflectionPredictor&); // Not implemented
+  void operator=(const vtkSlicerPathPlannerDeflectionPredictor&);               // Not implemented
+};
+
+#endif
@@ -0,0 +1,507 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerDeviationMonitor.h"
+#include "vtkSlicerPathPlannerTrackingLog.h"
+
+// VTK includes
+#include <vtkClientSocket.h>
+#include <vtkCriticalSection.h>
+#include <vtkDoubleArray.h>
+#include <vtkMath.h>
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+#include <vtkTimerLog.h>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+//----------------------------------------------------------------------------
+// Return 1 until TerminateThread is called on the thread
+int IsThreadActive(vtkMultiThreader::ThreadInfo* info)
+{
+  info->ActiveFlagLock->Lock();
+  int active = *info->ActiveFlag;
+  info->ActiveFlagLock->Unlock();
+  return active;
+}
+
+// Longest wait of the reader thread before checking if it should stop (ms)
+const unsigned long PollInterval = 50;
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerPathPlannerDeviationMonitor);
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerDeviationMonitor::vtkSlicerPathPlannerDeviationMonitor()
+{
+  this->Buffer.resize(1024);
+  this->BufferHead = 0;
+  this->BufferCount = 0;
+  for (int i = 0; i < 3; i++)
+    {
+    this->Entry[i] = this->Target[i] = 0.0;
+    this->LastTip[i] = this->LastDirection[i] = 0.0;
+    }
+  this->NumberOfReceivedPoses = 0;
+  this->NumberOfDroppedDeviations = 0;
+  this->ReaderRunning = 0;
+  this->Socket = NULL;
+  this->ReplayRate = 1.0;
+  this->LatencyNext = 0;
+  this->BufferLock = vtkSimpleCriticalSection::New();
+  this->Recorder = NULL;
+  this->Threader = vtkMultiThreader::New();
+  this->ReaderThreadID = -1;
+  this->LatencyWindow = 1000;
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerDeviationMonitor::~vtkSlicerPathPlannerDeviationMonitor()
+{
+  this->Stop();
+  this->SetRecorder(NULL);
+  this->Threader->Delete();
+  this->BufferLock->Delete();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerDeviationMonitor::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Entry: " << this->Entry[0] << " " << this->Entry[1] << " "
+     << this->Entry[2] << "\n";
+  os << indent << "Target: " << this->Target[0] << " " << this->Target[1] << " "
+     << this->Target[2] << "\n";
+  os << indent << "BufferSize: " << this->Buffer.size() << "\n";
+  os << indent << "Running: " << this->IsRunning() << "\n";
+  os << indent << "NumberOfReceivedPoses: " << this->GetNumberOfReceivedPoses() << "\n";
+  os << indent << "NumberOfDroppedDeviations: " << this->GetNumberOfDroppedDeviations() << "\n";
+  os << indent << "LatencyWindow: " << this->LatencyWindow << "\n";
+  os << indent << "Recorder: " << this->Recorder << "\n";
+}
+
+//----------------------------------------------------------------------------
+vtkCxxSetObjectMacro(vtkSlicerPathPlannerDeviationMonitor, Recorder,
+                     vtkSlicerPathPlannerTrackingLog);
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerDeviationMonitor::SetTrajectory(const double entry[3],
+                                                         const double target[3])
+{
+  this->BufferLock->Lock();
+  for (int i = 0; i < 3; i++)
+    {
+    this->Entry[i] = entry[i];
+    this->Target[i] = target[i];
+    }
+  this->BufferLock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerDeviationMonitor
+::ComputeDeviation(const double entry[3], const double target[3],
+                   const double tip[3], const double direction[3],
+                   double deviation[3])
+{
+  double axis[3] = { target[0] - entry[0], target[1] - entry[1], target[2] - entry[2] };
+  if (vtkMath::Normalize(axis) <= 0.0)
+    {
+    deviation[0] = std::sqrt(vtkMath::Distance2BetweenPoints(tip, target));
+    deviation[1] = 0.0;
+    deviation[2] = 0.0;
+    return;
+    }
+
+  double toTip[3] = { tip[0] - entry[0], tip[1] - entry[1], tip[2] - entry[2] };
+  double along = vtkMath::Dot(toTip, axis);
+  double lateral[3] = { toTip[0] - along * axis[0], toTip[1] - along * axis[1],
+                        toTip[2] - along * axis[2] };
+  deviation[0] = vtkMath::Norm(lateral);
+
+  double needle[3] = { direction[0], direction[1], direction[2] };
+  if (vtkMath::Normalize(needle) > 0.0)
+    {
+    double cosine = vtkMath::Dot(needle, axis);
+    cosine = cosine < 1.0 ? (cosine > -1.0 ? cosine : -1.0) : 1.0;
+    deviation[1] = vtkMath::DegreesFromRadians(std::acos(cosine));
+    }
+  else
+    {
+    deviation[1] = 0.0;
+    }
+
+  double toTarget[3] = { target[0] - tip[0], target[1] - tip[1], target[2] - tip[2] };
+  deviation[2] = vtkMath::Dot(toTarget, axis);
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerDeviationMonitor::PushPose(double time, const double tip[3],
+                                                    const double direction[3])
+{
+  if (this->Recorder)
+    {
+    this->Recorder->RecordPose(time, tip, direction);
+    }
+
+  Deviation deviation;
+  deviation.ArrivalTime = vtkTimerLog::GetUniversalTime();
+  deviation.Values[TimeComponent] = time;
+  deviation.Values[LatencyComponent] = 0.0;
+
+  this->BufferLock->Lock();
+  ComputeDeviation(this->Entry, this->Target, tip, direction,
+                   deviation.Values + LateralComponent);
+  size_t size = this->Buffer.size();
+  if (this->BufferCount == size)
+    {
+    // Drop the oldest deviation rather than delaying the newest
+    this->BufferHead = (this->BufferHead + 1) % size;
+    --this->BufferCount;
+    ++this->NumberOfDroppedDeviations;
+    }
+  this->Buffer[(this->BufferHead + this->BufferCount) % size] = deviation;
+  ++this->BufferCount;
+  for (int i = 0; i < 3; i++)
+    {
+    this->LastTip[i] = tip[i];
+    this->LastDirection[i] = direction[i];
+    }
+  ++this->NumberOfReceivedPoses;
+  this->BufferLock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerDeviationMonitor::SetBufferSize(int size)
+{
+  size = size > 1 ? size : 1;
+  this->BufferLock->Lock();
+  this->Buffer.assign(size, Deviation());
+  this->BufferHead = 0;
+  this->BufferCount = 0;
+  this->BufferLock->Unlock();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerDeviationMonitor::GetBufferSize()
+{
+  this->BufferLock->Lock();
+  int size = static_cast<int>(this->Buffer.size());
+  this->BufferLock->Unlock();
+  return size;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerDeviationMonitor::GetLastPose(double tip[3], double direction[3])
+{
+  this->BufferLock->Lock();
+  for (int i = 0; i < 3; i++)
+    {
+    tip[i] = this->LastTip[i];
+    direction[i] = this->LastDirection[i];
+    }
+  int received = this->NumberOfReceivedPoses > 0;
+  this->BufferLock->Unlock();
+  return received;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerDeviationMonitor::PopDeviations(vtkDoubleArray* deviations)
+{
+  if (!deviations)
+    {
+    return 0;
+    }
+
+  // Copy out under the lock, process outside
+  std::vector<Deviation> popped;
+  this->BufferLock->Lock();
+  size_t size = this->Buffer.size();
+  popped.reserve(this->BufferCount);
+  for (size_t i = 0; i < this->BufferCount; i++)
+    {
+    popped.push_back(this->Buffer[(this->BufferHead + i) % size]);
+    }
+  this->BufferHead = (this->BufferHead + this->BufferCount) % size;
+  this->BufferCount = 0;
+  this->BufferLock->Unlock();
+
+  double now = vtkTimerLog::GetUniversalTime();
+  int numberOfDeviations = static_cast<int>(popped.size());
+  deviations->SetNumberOfComponents(NumberOfComponents);
+  deviations->SetNumberOfTuples(numberOfDeviations);
+  size_t window = static_cast<size_t>(this->LatencyWindow);
+  if (this->Latencies.size() > window)
+    {
+    this->Latencies.clear();
+    this->LatencyNext = 0;
+    }
+  for (int i = 0; i < numberOfDeviations; i++)
+    {
+    double latency = now - popped[i].ArrivalTime;
+    popped[i].Values[LatencyComponent] = latency;
+    std::copy(popped[i].Values, popped[i].Values + NumberOfComponents,
+              deviations->GetPointer(NumberOfComponents * i));
+    if (this->Latencies.size() < window)
+      {
+      this->Latencies.push_back(latency);
+      }
+    else
+      {
+      this->Latencies[this->LatencyNext] = latency;
+      }
+    this->LatencyNext = (this->LatencyNext + 1) % window;
+    }
+  return numberOfDeviations;
+}
+
+//----------------------------------------------------------------------------
+double vtkSlicerPathPlannerDeviationMonitor::GetLatencyPercentile(double percent)
+{
+  if (this->Latencies.empty())
+    {
+    return -1.0;
+    }
+  percent = percent > 0.0 ? (percent < 100.0 ? percent : 100.0) : 0.0;
+  std::vector<double> latencies(this->Latencies);
+  size_t rank = static_cast<size_t>(
+    std::floor(percent / 100.0 * (latencies.size() - 1) + 0.5));
+  std::nth_element(latencies.begin(), latencies.begin() + rank, latencies.end());
+  return latencies[rank];
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkSlicerPathPlannerDeviationMonitor::GetNumberOfReceivedPoses()
+{
+  this->BufferLock->Lock();
+  vtkIdType count = this->NumberOfReceivedPoses;
+  this->BufferLock->Unlock();
+  return count;
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkSlicerPathPlannerDeviationMonitor::GetNumberOfDroppedDeviations()
+{
+  this->BufferLock->Lock();
+  vtkIdType count = this->NumberOfDroppedDeviations;
+  this->BufferLock->Unlock();
+  return count;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerDeviationMonitor::ConnectToServer(const char* hostName, int port)
+{
+  this->Stop();
+  if (!hostName)
+    {
+    return 0;
+    }
+  vtkClientSocket* socket = vtkClientSocket::New();
+  if (socket->ConnectToServer(hostName, port) != 0)
+    {
+    vtkErrorMacro(<< "ConnectToServer: cannot connect to " << hostName << ":" << port);
+    socket->Delete();
+    return 0;
+    }
+  this->Socket = socket;
+  return this->StartReader();
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerDeviationMonitor::ReplayFile(const char* fileName, double rate)
+{
+  this->Stop();
+  if (!fileName || !vtksys::SystemTools::FileExists(fileName, true))
+    {
+    vtkErrorMacro(<< "ReplayFile: cannot open " << (fileName ? fileName : "(null)"));
+    return 0;
+    }
+  this->FileName = fileName;
+  this->ReplayRate = rate > 0.0 ? rate : 0.0;
+  return this->StartReader();
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerDeviationMonitor::StartReader()
+{
+  this->BufferLock->Lock();
+  this->BufferHead = 0;
+  this->BufferCount = 0;
+  this->NumberOfReceivedPoses = 0;
+  this->NumberOfDroppedDeviations = 0;
+  this->ReaderRunning = 1;
+  this->BufferLock->Unlock();
+  this->Latencies.clear();
+  this->LatencyNext = 0;
+
+  this->ReaderThreadID = this->Threader->SpawnThread(
+    &vtkSlicerPathPlannerDeviationMonitor::ReaderThread, this);
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerDeviationMonitor::Stop()
+{
+  if (this->ReaderThreadID >= 0)
+    {
+    // Joins the reader, which checks its active flag every PollInterval
+    this->Threader->TerminateThread(this->ReaderThreadID);
+    this->ReaderThreadID = -1;
+    }
+  if (this->Socket)
+    {
+    this->Socket->CloseSocket();
+    this->Socket->Delete();
+    this->Socket = NULL;
+    }
+  this->FileName.clear();
+  this->BufferLock->Lock();
+  this->ReaderRunning = 0;
+  this->BufferLock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerDeviationMonitor::IsRunning()
+{
+  this->BufferLock->Lock();
+  int running = this->ReaderRunning;
+  this->BufferLock->Unlock();
+  return running;
+}
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkSlicerPathPlannerDeviationMonitor::ReaderThread(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  vtkSlicerPathPlannerDeviationMonitor* self =
+    static_cast<vtkSlicerPathPlannerDeviationMonitor*>(info->UserData);
+  if (self->Socket)
+    {
+    self->ReadSocket(info);
+    }
+  else
+    {
+    self->ReadFile(info);
+    }
+  self->BufferLock->Lock();
+  self->ReaderRunning = 0;
+  self->BufferLock->Unlock();
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerDeviationMonitor::ReadSocket(vtkMultiThreader::ThreadInfo* info)
+{
+  std::string pending;
+  char buffer[4096];
+  int socketDescriptor = this->Socket->GetSocketDescriptor();
+  while (IsThreadActive(info))
+    {
+    int selected = -1;
+    int status = vtkSocket::SelectSockets(&socketDescriptor, 1, PollInterval, &selected);
+    if (status == 0)
+      {
+      continue;
+      }
+    int received = status > 0 ? this->Socket->Receive(buffer, sizeof(buffer), 0) : 0;
+    if (received <= 0)
+      {
+      // Closed by the server
+      return;
+      }
+    pending.append(buffer, received);
+    size_t lineStart = 0;
+    size_t lineEnd;
+    while ((lineEnd = pending.find('\n', lineStart)) != std::string::npos)
+      {
+      this->ParsePose(pending.substr(lineStart, lineEnd - lineStart));
+      lineStart = lineEnd + 1;
+      }
+    pending.erase(0, lineStart);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerDeviationMonitor::ReadFile(vtkMultiThreader::ThreadInfo* info)
+{
+  std::ifstream file(this->FileName.c_str());
+  std::string line;
+  double startTime = vtkTimerLog::GetUniversalTime();
+  double firstPoseTime = 0.0;
+  bool first = true;
+  while (IsThreadActive(info) && std::getline(file, line))
+    {
+    std::stringstream stream(line);
+    double poseTime;
+    if (line.empty() || line[0] == '#' || !(stream >> poseTime))
+      {
+      continue;
+      }
+    if (first)
+      {
+      firstPoseTime = poseTime;
+      first = false;
+      }
+
+    // Wait until the pose is due, a few milliseconds at a time
+    if (this->ReplayRate > 0.0)
+      {
+      double due = startTime + (poseTime - firstPoseTime) / this->ReplayRate;
+      double wait;
+      while ((wait = due - vtkTimerLog::GetUniversalTime()) > 0.0 && IsThreadActive(info))
+        {
+        double milliseconds = std::min(1000.0 * wait, static_cast<double>(PollInterval));
+        vtksys::SystemTools::Delay(static_cast<unsigned int>(std::ceil(milliseconds)));
+        }
+      }
+    this->ParsePose(line);
+    }
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerDeviationMonitor::ParsePose(const std::string& line)
+{
+  if (line.empty() || line[0] == '#')
+    {
+    return 0;
+    }
+  std::stringstream stream(line);
+  double time;
+  double tip[3];
+  double direction[3];
+  if (!(stream >> time >> tip[0] >> tip[1] >> tip[2]
+        >> direction[0] >> direction[1] >> direction[2]))
+    {
+    return 0;
+    }
+  this->PushPose(time, tip, direction);
+  return 1;
+}
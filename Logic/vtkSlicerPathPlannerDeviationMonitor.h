@@ -0,0 +1,186 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// .NAME vtkSlicerPathPlannerDeviationMonitor - live deviation of a tracked needle
+// .SECTION Description
+// Consumes needle tip poses (time, tip RAS, needle direction) at tracker
+// rates and computes, for each of them, the deviation from the planned
+// trajectory: lateral distance of the tip to the trajectory line, angle
+// between the needle and the trajectory, and remaining depth to the
+// target along the trajectory.
+//
+// Poses are read on a background thread from a local socket or from a
+// recorded file, one pose per text line: "time x y z dx dy dz". Lines
+// starting with '#' are ignored. Deviations are queued in a bounded ring
+// buffer which the UI drains with PopDeviations without ever waiting for
+// the reader; when the consumer falls behind, the oldest deviations are
+// dropped so that the latency stays bounded. The latency of a deviation
+// is the time between the reception of its pose and its delivery by
+// PopDeviations; percentiles over the last deliveries are available.
+
+#ifndef __vtkSlicerPathPlannerDeviationMonitor_h
+#define __vtkSlicerPathPlannerDeviationMonitor_h
+
+// VTK includes
+#include <vtkMultiThreader.h>
+#include <vtkObject.h>
+
+// STD includes
+#include <string>
+#include <vector>
+
+#include "vtkSlicerPathPlannerModuleLogicExport.h"
+
+class vtkClientSocket;
+class vtkDoubleArray;
+class vtkSimpleCriticalSection;
+class vtkSlicerPathPlannerTrackingLog;
+
+/// \ingroup Slicer_QtModules_PathPlanner
+class VTK_SLICER_PATHPLANNER_MODULE_LOGIC_EXPORT vtkSlicerPathPlannerDeviationMonitor :
+  public vtkObject
+{
+public:
+  static vtkSlicerPathPlannerDeviationMonitor *New();
+  vtkTypeMacro(vtkSlicerPathPlannerDeviationMonitor, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Components of the deviations returned by PopDeviations
+  enum
+    {
+    TimeComponent = 0,    ///< pose time (s), as sent by the tracker
+    LateralComponent,     ///< distance from the tip to the trajectory line (mm)
+    AngularComponent,     ///< angle between the needle and the trajectory (degrees)
+    DepthComponent,       ///< distance left to the target along the trajectory (mm)
+    LatencyComponent,     ///< reception to delivery (s)
+    NumberOfComponents
+    };
+
+  /// Planned trajectory the poses are compared to. Can be changed while
+  /// the monitor is running.
+  void SetTrajectory(const double entry[3], const double target[3]);
+
+  /// Start reading poses from a server (e.g. a tracker bridge) on another
+  /// thread. Return 0 if the connection failed.
+  int ConnectToServer(const char* hostName, int port);
+
+  /// Start replaying a recorded pose file on another thread, paced by the
+  /// pose times divided by "rate" (0 replays as fast as possible).
+  /// Return 0 if the file cannot be opened.
+  int ReplayFile(const char* fileName, double rate = 1.0);
+
+  /// Stop the reader thread and close the source.
+  void Stop();
+
+  /// Return 1 while the reader thread is receiving poses.
+  int IsRunning();
+
+  /// Log receiving the poses, e.g. to replay the session later. Set it
+  /// while the monitor is stopped.
+  void SetRecorder(vtkSlicerPathPlannerTrackingLog* recorder);
+  vtkGetObjectMacro(Recorder, vtkSlicerPathPlannerTrackingLog);
+
+  /// Compute the deviation of a pose and queue it. Called by the reader
+  /// thread; other sources may call it from any single thread.
+  void PushPose(double time, const double tip[3], const double direction[3]);
+
+  /// Capacity of the ring buffer. Changing it clears the buffer. Default
+  /// is 1024, i.e. 2 s at 500 Hz.
+  void SetBufferSize(int size);
+  int GetBufferSize();
+
+  /// Most recent pose received. Return 0 if none was received since the
+  /// last start.
+  int GetLastPose(double tip[3], double direction[3]);
+
+  /// Move the queued deviations, oldest first, to "deviations"
+  /// (NumberOfComponents components). Never blocks on the reader. Return
+  /// the number of deviations. Call it from one thread only.
+  int PopDeviations(vtkDoubleArray* deviations);
+
+  /// Latency percentile (s), "percent" in [0, 100], over the last
+  /// LatencyWindow delivered deviations. -1 if none was delivered.
+  double GetLatencyPercentile(double percent);
+  vtkSetClampMacro(LatencyWindow, int, 1, VTK_INT_MAX);
+  vtkGetMacro(LatencyWindow, int);
+
+  /// Number of poses received and of deviations dropped because the
+  /// buffer was full, since the last start.
+  vtkIdType GetNumberOfReceivedPoses();
+  vtkIdType GetNumberOfDroppedDeviations();
+
+  /// Deviation of a single pose (lateral mm, angular degrees, depth mm).
+  static void ComputeDeviation(const double entry[3], const double target[3],
+                               const double tip[3], const double direction[3],
+                               double deviation[3]);
+
+protected:
+  vtkSlicerPathPlannerDeviationMonitor();
+  virtual ~vtkSlicerPathPlannerDeviationMonitor();
+
+  int StartReader();
+  static VTK_THREAD_RETURN_TYPE ReaderThread(void* arg);
+  void ReadSocket(vtkMultiThreader::ThreadInfo* info);
+  void ReadFile(vtkMultiThreader::ThreadInfo* info);
+  int ParsePose(const std::string& line);
+
+  //BTX
+  struct Deviation
+  {
+    double Values[NumberOfComponents];
+    double ArrivalTime;
+  };
+
+  // Ring buffer shared with the reader thread, guarded by BufferLock
+  std::vector<Deviation> Buffer;
+  size_t BufferHead;
+  size_t BufferCount;
+  double Entry[3];
+  double Target[3];
+  double LastTip[3];
+  double LastDirection[3];
+  vtkIdType NumberOfReceivedPoses;
+  vtkIdType NumberOfDroppedDeviations;
+  int ReaderRunning;
+
+  // Source, owned by the reader thread while it runs
+  vtkClientSocket* Socket;
+  std::string FileName;
+  double ReplayRate;
+
+  // Consumer side only
+  std::vector<double> Latencies;
+  size_t LatencyNext;
+  //ETX
+
+  vtkSimpleCriticalSection* BufferLock;
+  vtkSlicerPathPlannerTrackingLog* Recorder;
+  vtkMultiThreader* Threader;
+  int ReaderThreadID;
+  int LatencyWindow;
+
+private:
+  vtkSlicerPathPlannerDeviationMonitor(const vtkSlicerPathPlannerDeviationMonitor&); // Not implemented
+  void operator=(const vtkSlicerPathPlannerDeviationMonitor&);               // Not implemented
+};
+
+#endif
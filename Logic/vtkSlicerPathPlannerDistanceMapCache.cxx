@@ -0,0 +1,318 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerDistanceMapCache.h"
+#include "vtkSlicerPathPlannerParallel.h"
+#include "vtkSlicerPathPlannerVolumeSampler.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+// Squared distance of the voxels without structure in reach
+const double Far = 1e30;
+
+//----------------------------------------------------------------------------
+// Label map to 0 (structure) or Far, one slice per index
+struct InitializeFunctor
+{
+  const vtkSlicerPathPlannerVolumeSampler* Structures;
+  int Dimensions[3];
+  float* Distances;
+
+  void operator()(vtkIdType begin, vtkIdType end, int vtkNotUsed(threadId))
+  {
+    for (vtkIdType k = begin; k < end; k++)
+      {
+      float* slice = this->Distances + k * this->Dimensions[0] * this->Dimensions[1];
+      for (int j = 0; j < this->Dimensions[1]; j++)
+        {
+        for (int i = 0; i < this->Dimensions[0]; i++)
+          {
+          slice[j * this->Dimensions[0] + i] = this->Structures->GetVoxelValue(
+            i, j, static_cast<int>(k)) != 0.0 ? 0.0f : static_cast<float>(Far);
+          }
+        }
+      }
+  }
+};
+
+//----------------------------------------------------------------------------
+// 1D squared distance transform along one axis, one image line per index
+struct DistancePassFunctor
+{
+  int Axis;
+  int Dimensions[3];
+  double Spacing;
+  float* Distances;
+
+  void operator()(vtkIdType begin, vtkIdType end, int vtkNotUsed(threadId))
+  {
+    const int n = this->Dimensions[this->Axis];
+    const int u = this->Axis == 0 ? 1 : 0;
+    const int v = this->Axis == 2 ? 1 : 2;
+    const vtkIdType strides[3] = { 1, this->Dimensions[0],
+      static_cast<vtkIdType>(this->Dimensions[0]) * this->Dimensions[1] };
+
+    std::vector<double> f(n);
+    std::vector<int> parabolas(n);
+    std::vector<double> bounds(n + 1);
+    for (vtkIdType line = begin; line < end; line++)
+      {
+      float* data = this->Distances +
+        (line % this->Dimensions[u]) * strides[u] + (line / this->Dimensions[u]) * strides[v];
+      const vtkIdType stride = strides[this->Axis];
+      for (int q = 0; q < n; q++)
+        {
+        f[q] = data[q * stride];
+        }
+
+      // Lower envelope of the parabolas rooted at the finite samples
+      int k = -1;
+      for (int q = 0; q < n; q++)
+        {
+        if (f[q] >= Far)
+          {
+          continue;
+          }
+        const double position = q * this->Spacing;
+        double intersection = -Far;
+        while (k >= 0)
+          {
+          const double other = parabolas[k] * this->Spacing;
+          intersection = ((f[q] + position * position) -
+                          (f[parabolas[k]] + other * other)) / (2.0 * (position - other));
+          if (intersection > bounds[k])
+            {
+            break;
+            }
+          k--;
+          }
+        k++;
+        parabolas[k] = q;
+        bounds[k] = k == 0 ? -Far : intersection;
+        bounds[k + 1] = Far;
+        }
+      if (k < 0)
+        {
+        continue;
+        }
+
+      k = 0;
+      for (int q = 0; q < n; q++)
+        {
+        const double position = q * this->Spacing;
+        while (bounds[k + 1] < position)
+          {
+          k++;
+          }
+        const double offset = position - parabolas[k] * this->Spacing;
+        data[q * stride] = static_cast<float>(offset * offset + f[parabolas[k]]);
+        }
+      }
+  }
+};
+
+//----------------------------------------------------------------------------
+// Squared distances to distances
+struct SquareRootFunctor
+{
+  float* Distances;
+
+  void operator()(vtkIdType begin, vtkIdType end, int vtkNotUsed(threadId))
+  {
+    for (vtkIdType i = begin; i < end; i++)
+      {
+      this->Distances[i] = this->Distances[i] >= static_cast<float>(Far) ?
+        VTK_FLOAT_MAX : std::sqrt(this->Distances[i]);
+      }
+  }
+};
+}
+
+//----------------------------------------------------------------------------
+bool vtkSlicerPathPlannerDistanceMapCache::Key::operator<(const Key& other) const
+{
+  if (this->Labels != other.Labels)
+    {
+    return this->Labels < other.Labels;
+    }
+  return std::lexicographical_compare(this->RASToIJK, this->RASToIJK + 12,
+                                      other.RASToIJK, other.RASToIJK + 12);
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerPathPlannerDistanceMapCache);
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerDistanceMapCache::vtkSlicerPathPlannerDistanceMapCache()
+{
+  this->NumberOfComputedMaps = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerDistanceMapCache::~vtkSlicerPathPlannerDistanceMapCache()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerDistanceMapCache::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfDistanceMaps: " << this->Entries.size() << "\n";
+  os << indent << "NumberOfComputedMaps: " << this->NumberOfComputedMaps << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerDistanceMapCache
+::ComputeDistanceMap(vtkSlicerPathPlannerVolumeSampler* structures, vtkImageData* distances)
+{
+  if (!structures || !distances || !structures->IsValid())
+    {
+    return;
+    }
+
+  int dimensions[3];
+  double spacing[3];
+  structures->GetDimensions(dimensions);
+  structures->GetSpacing(spacing);
+  distances->SetDimensions(dimensions);
+  distances->SetScalarTypeToFloat();
+  distances->SetNumberOfScalarComponents(1);
+  distances->AllocateScalars();
+  float* data = static_cast<float*>(distances->GetScalarPointer());
+
+  InitializeFunctor initialize;
+  initialize.Structures = structures;
+  initialize.Distances = data;
+  for (int i = 0; i < 3; i++)
+    {
+    initialize.Dimensions[i] = dimensions[i];
+    }
+  vtkSlicerPathPlannerParallelFor(0, dimensions[2], 1, initialize);
+
+  for (int axis = 0; axis < 3; axis++)
+    {
+    DistancePassFunctor pass;
+    pass.Axis = axis;
+    pass.Spacing = spacing[axis];
+    pass.Distances = data;
+    for (int i = 0; i < 3; i++)
+      {
+      pass.Dimensions[i] = dimensions[i];
+      }
+    vtkIdType numberOfLines = static_cast<vtkIdType>(dimensions[0]) * dimensions[1] *
+      dimensions[2] / dimensions[axis];
+    vtkSlicerPathPlannerParallelFor(0, numberOfLines, 64, pass);
+    }
+
+  SquareRootFunctor squareRoot;
+  squareRoot.Distances = data;
+  vtkSlicerPathPlannerParallelFor(
+    0, static_cast<vtkIdType>(dimensions[0]) * dimensions[1] * dimensions[2], 4096, squareRoot);
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerVolumeSampler* vtkSlicerPathPlannerDistanceMapCache
+::GetDistanceMap(vtkSlicerPathPlannerVolumeSampler* structures)
+{
+  if (!structures || !structures->IsValid())
+    {
+    return NULL;
+    }
+
+  vtkImageData* labels = structures->GetImageData();
+  vtkNew<vtkMatrix4x4> rasToIJK;
+  structures->GetRASToIJKMatrix(rasToIJK.GetPointer());
+  Key key;
+  key.Labels = labels;
+  for (int i = 0; i < 12; i++)
+    {
+    key.RASToIJK[i] = rasToIJK->GetElement(i / 4, i % 4);
+    }
+
+  std::map<Key, Entry>::iterator it = this->Entries.find(key);
+  if (it != this->Entries.end() &&
+      labels->GetMTime() <= it->second.BuildTime.GetMTime())
+    {
+    return it->second.Distances;
+    }
+
+  Entry& entry = this->Entries[key];
+  entry.Labels = labels;
+  vtkNew<vtkImageData> distances;
+  this->ComputeDistanceMap(structures, distances.GetPointer());
+  entry.Distances = vtkSmartPointer<vtkSlicerPathPlannerVolumeSampler>::New();
+  entry.Distances->SetImageData(distances.GetPointer(), rasToIJK.GetPointer());
+  entry.Distances->SetOutsideValue(VTK_FLOAT_MAX);
+  entry.BuildTime.Modified();
+  this->NumberOfComputedMaps++;
+  return entry.Distances;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerDistanceMapCache::GetNumberOfDistanceMaps()
+{
+  return static_cast<int>(this->Entries.size());
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerDistanceMapCache::RemoveAllDistanceMaps()
+{
+  this->Entries.clear();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerDistanceMapCache::PruneDistanceMaps()
+{
+  // An image may have one entry per geometry
+  std::map<vtkImageData*, int> cacheReferences;
+  std::map<Key, Entry>::iterator it;
+  for (it = this->Entries.begin(); it != this->Entries.end(); ++it)
+    {
+    cacheReferences[it->first.Labels]++;
+    }
+
+  it = this->Entries.begin();
+  while (it != this->Entries.end())
+    {
+    if (it->second.Labels->GetReferenceCount() == cacheReferences[it->first.Labels])
+      {
+      this->Entries.erase(it++);
+      }
+    else
+      {
+      ++it;
+      }
+    }
+}
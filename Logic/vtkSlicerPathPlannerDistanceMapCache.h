@@ -0,0 +1,111 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// .NAME vtkSlicerPathPlannerDistanceMapCache - shared distance maps of label maps
+// .SECTION Description
+// Euclidean distance (mm) from every voxel center to the closest non zero
+// voxel of a label map, computed with the exact separable squared distance
+// transform of Felzenszwalb and Huttenlocher: one 1D lower envelope pass
+// per axis, each pass running in parallel over the image lines. Voxels
+// inside the structures are at distance 0.
+//
+// Maps are cached by label image and geometry (RAS to IJK matrix): every
+// sampler built on the same image and geometry shares one map, which is
+// recomputed only when the image is modified. Several respiratory phases sharing a label map and
+// differing only by their transform therefore cost one map.
+
+#ifndef __vtkSlicerPathPlannerDistanceMapCache_h
+#define __vtkSlicerPathPlannerDistanceMapCache_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimeStamp.h>
+
+// STD includes
+#include <map>
+
+#include "vtkSlicerPathPlannerModuleLogicExport.h"
+
+class vtkImageData;
+class vtkSlicerPathPlannerVolumeSampler;
+
+/// \ingroup Slicer_QtModules_PathPlanner
+class VTK_SLICER_PATHPLANNER_MODULE_LOGIC_EXPORT vtkSlicerPathPlannerDistanceMapCache :
+  public vtkObject
+{
+public:
+  static vtkSlicerPathPlannerDistanceMapCache *New();
+  vtkTypeMacro(vtkSlicerPathPlannerDistanceMapCache, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Sampler of the distance map of the label map sampled by "structures",
+  /// with the same geometry. Points outside the image are reported at
+  /// VTK_FLOAT_MAX. The sampler is owned by the cache. Return NULL if
+  /// "structures" is not valid.
+  vtkSlicerPathPlannerVolumeSampler* GetDistanceMap(vtkSlicerPathPlannerVolumeSampler* structures);
+
+  /// Compute the distance map (float, mm) of a label map.
+  static void ComputeDistanceMap(vtkSlicerPathPlannerVolumeSampler* structures,
+                                 vtkImageData* distances);
+
+  int GetNumberOfDistanceMaps();
+  void RemoveAllDistanceMaps();
+
+  /// Remove the maps of the label images referenced by the cache only.
+  void PruneDistanceMaps();
+
+  /// Number of maps computed since the last call to
+  /// ResetNumberOfComputedMaps.
+  vtkGetMacro(NumberOfComputedMaps, int);
+  void ResetNumberOfComputedMaps() { this->NumberOfComputedMaps = 0; }
+
+protected:
+  vtkSlicerPathPlannerDistanceMapCache();
+  virtual ~vtkSlicerPathPlannerDistanceMapCache();
+
+  //BTX
+  struct Key
+  {
+    vtkImageData* Labels;
+    double RASToIJK[12];
+    bool operator<(const Key& other) const;
+  };
+  struct Entry
+  {
+    // Keeps the label image alive so that its address stays a valid key
+    vtkSmartPointer<vtkImageData> Labels;
+    vtkTimeStamp BuildTime;
+    vtkSmartPointer<vtkSlicerPathPlannerVolumeSampler> Distances;
+  };
+  std::map<Key, Entry> Entries;
+  //ETX
+
+  int NumberOfComputedMaps;
+
+private:
+  vtkSlicerPathPlannerDistanceMapCache(const vtkSlicerPathPlannerDistanceMapCache&); // Not implemented
+  void operator=(const vtkSlicerPathPlannerDistanceMapCache&);               // Not implemented
+};
+
+#endif
@@ -0,0 +1,267 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerHitProbability.h"
+#include "vtkSlicerPathPlannerParallel.h"
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkMath.h>
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <cmath>
+
+namespace
+{
+// Positive nodes and weights of the 20 point Gauss-Legendre rule on [-1, 1]
+const int NumberOfGaussNodes = 10;
+const double GaussNodes[NumberOfGaussNodes][2] = {
+  { 0.0765265211334973, 0.1527533871307260 },
+  { 0.2277858511416451, 0.1491729864726038 },
+  { 0.3737060887154195, 0.1420961093183822 },
+  { 0.5108670019508271, 0.1316886384491765 },
+  { 0.6360536807265150, 0.1181945319615183 },
+  { 0.7463319064601508, 0.1019301198172405 },
+  { 0.8391169718222189, 0.0832767415767047 },
+  { 0.9122344282513259, 0.0626720483341090 },
+  { 0.9639719272779138, 0.0406014298003870 },
+  { 0.9931285991850949, 0.0176140071391523 } };
+
+// Gaussians further than this many standard deviations are ignored
+const double CutOff = 8.0;
+
+//----------------------------------------------------------------------------
+// Complementary error function, fractional error below 1.2e-7
+// (Numerical Recipes erfcc). std::erfc is not available before C++11.
+double ComplementaryErrorFunction(double x)
+{
+  double z = std::fabs(x);
+  double t = 1.0 / (1.0 + 0.5 * z);
+  double result = t * std::exp(-z * z - 1.26551223 + t * (1.00002368 +
+    t * (0.37409196 + t * (0.09678418 + t * (-0.18628806 + t * (0.27886807 +
+    t * (-1.13520398 + t * (1.48851587 + t * (-0.82215223 + t * 0.17087277)))))))));
+  return x >= 0.0 ? result : 2.0 - result;
+}
+
+//----------------------------------------------------------------------------
+// Probability that N(mean, sigma^2) falls in [-halfWidth, halfWidth]
+double IntervalProbability(double mean, double sigma, double halfWidth)
+{
+  if (sigma <= 1e-12)
+    {
+    return std::fabs(mean) <= halfWidth ? 1.0 : 0.0;
+    }
+  const double scale = 1.0 / (sigma * std::sqrt(2.0));
+  return 0.5 * (ComplementaryErrorFunction((-halfWidth - mean) * scale) -
+                ComplementaryErrorFunction((halfWidth - mean) * scale));
+}
+
+//----------------------------------------------------------------------------
+// Probability that (X1, X2), X1 ~ N(mean1, sigma1^2) and X2 ~ N(mean2,
+// sigma2^2) independent, falls in the disk of given radius. sigma1 should
+// be the smallest deviation: the outer integral is clipped to its support.
+double DiskProbability(double mean1, double sigma1, double mean2, double sigma2,
+                       double radius)
+{
+  if (sigma1 <= 1e-9 * radius)
+    {
+    if (std::fabs(mean1) > radius)
+      {
+      return 0.0;
+      }
+    return IntervalProbability(mean2, sigma2,
+                               std::sqrt(radius * radius - mean1 * mean1));
+    }
+
+  double lower = mean1 - CutOff * sigma1;
+  double upper = mean1 + CutOff * sigma1;
+  lower = lower > -radius ? lower : -radius;
+  upper = upper < radius ? upper : radius;
+  if (lower >= upper)
+    {
+    return 0.0;
+    }
+
+  // x = radius * sin(t) removes the square root singularity at the rim
+  double tLower = std::asin(lower / radius);
+  double tUpper = std::asin(upper / radius);
+  double tCenter = 0.5 * (tUpper + tLower);
+  double tHalfWidth = 0.5 * (tUpper - tLower);
+  double normalization = 1.0 / (sigma1 * std::sqrt(2.0 * vtkMath::Pi()));
+
+  double sum = 0.0;
+  for (int n = 0; n < NumberOfGaussNodes; n++)
+    {
+    for (int side = -1; side <= 1; side += 2)
+      {
+      double t = tCenter + side * tHalfWidth * GaussNodes[n][0];
+      double x = radius * std::sin(t);
+      double halfChord = radius * std::cos(t);
+      double u = (x - mean1) / sigma1;
+      double density = normalization * std::exp(-0.5 * u * u);
+      sum += GaussNodes[n][1] * density *
+        IntervalProbability(mean2, sigma2, halfChord) * halfChord;
+      }
+    }
+  double probability = sum * tHalfWidth;
+  return probability < 1.0 ? probability : 1.0;
+}
+
+//----------------------------------------------------------------------------
+struct HitProbabilityFunctor
+{
+  const double* Segments;
+  const double* Means;
+  const double* Covariances;
+  double Radius;
+  double* Probabilities;
+
+  void operator()(vtkIdType begin, vtkIdType end, int vtkNotUsed(threadId))
+  {
+    for (vtkIdType i = begin; i < end; i++)
+      {
+      const double* segment = this->Segments + 6 * i;
+      const double* mean = this->Means ? this->Means + 3 * i : segment + 3;
+      this->Probabilities[i] = vtkSlicerPathPlannerHitProbability::ComputeHitProbability(
+        segment, segment + 3, mean, this->Covariances + 9 * i, this->Radius);
+      }
+  }
+};
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerPathPlannerHitProbability);
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerHitProbability::vtkSlicerPathPlannerHitProbability()
+{
+  this->Radius = 5.0;
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerHitProbability::~vtkSlicerPathPlannerHitProbability()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerHitProbability::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Radius: " << this->Radius << "\n";
+}
+
+//----------------------------------------------------------------------------
+double vtkSlicerPathPlannerHitProbability
+::ComputeHitProbability(const double entry[3], const double target[3],
+                        const double mean[3], const double covariance[9],
+                        double radius)
+{
+  double axis[3] = { target[0] - entry[0], target[1] - entry[1], target[2] - entry[2] };
+  if (vtkMath::Normalize(axis) <= 0.0 || radius <= 0.0)
+    {
+    return 0.0;
+    }
+
+  double lateral1[3];
+  double lateral2[3];
+  vtkMath::Perpendiculars(axis, lateral1, lateral2, 0.0);
+
+  // Offset of the target mean from the line
+  double offset[3] = { mean[0] - entry[0], mean[1] - entry[1], mean[2] - entry[2] };
+  double offset1 = vtkMath::Dot(offset, lateral1);
+  double offset2 = vtkMath::Dot(offset, lateral2);
+
+  // Covariance projected on the plane orthogonal to the trajectory
+  double covariance1[3];
+  double covariance2[3];
+  for (int i = 0; i < 3; i++)
+    {
+    covariance1[i] = covariance[3 * i] * lateral1[0] +
+      covariance[3 * i + 1] * lateral1[1] + covariance[3 * i + 2] * lateral1[2];
+    covariance2[i] = covariance[3 * i] * lateral2[0] +
+      covariance[3 * i + 1] * lateral2[1] + covariance[3 * i + 2] * lateral2[2];
+    }
+  double a = vtkMath::Dot(lateral1, covariance1);
+  double b = vtkMath::Dot(lateral1, covariance2);
+  double c = vtkMath::Dot(lateral2, covariance2);
+
+  // Principal axes of the 2x2 covariance
+  double halfTrace = 0.5 * (a + c);
+  double halfGap = std::sqrt(0.25 * (a - c) * (a - c) + b * b);
+  double largeVariance = halfTrace + halfGap;
+  double smallVariance = halfTrace - halfGap;
+  double angle = 0.5 * std::atan2(2.0 * b, a - c);
+  double cosine = std::cos(angle);
+  double sine = std::sin(angle);
+  double largeMean = cosine * offset1 + sine * offset2;
+  double smallMean = -sine * offset1 + cosine * offset2;
+  double largeSigma = std::sqrt(largeVariance > 0.0 ? largeVariance : 0.0);
+  double smallSigma = std::sqrt(smallVariance > 0.0 ? smallVariance : 0.0);
+
+  // Closed form for a centered isotropic distribution
+  if (largeSigma - smallSigma <= 1e-6 * largeSigma &&
+      largeMean * largeMean + smallMean * smallMean <= 1e-12 * radius * radius &&
+      largeSigma > 0.0)
+    {
+    return 1.0 - std::exp(-0.5 * radius * radius / (largeVariance));
+    }
+
+  return DiskProbability(smallMean, smallSigma, largeMean, largeSigma, radius);
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerHitProbability::Evaluate(vtkDoubleArray* segments,
+                                                  vtkDoubleArray* means,
+                                                  vtkDoubleArray* covariances,
+                                                  vtkDoubleArray* probabilities)
+{
+  if (!segments || !covariances || !probabilities ||
+      segments->GetNumberOfComponents() != 6 ||
+      covariances->GetNumberOfComponents() != 9 ||
+      covariances->GetNumberOfTuples() != segments->GetNumberOfTuples() ||
+      (means && (means->GetNumberOfComponents() != 3 ||
+                 means->GetNumberOfTuples() != segments->GetNumberOfTuples())))
+    {
+    vtkErrorMacro(<< "Evaluate: invalid input arrays");
+    return;
+    }
+
+  vtkIdType numberOfTrajectories = segments->GetNumberOfTuples();
+  probabilities->SetNumberOfComponents(1);
+  probabilities->SetNumberOfTuples(numberOfTrajectories);
+  if (numberOfTrajectories == 0)
+    {
+    return;
+    }
+
+  HitProbabilityFunctor functor;
+  functor.Segments = segments->GetPointer(0);
+  functor.Means = means ? means->GetPointer(0) : NULL;
+  functor.Covariances = covariances->GetPointer(0);
+  functor.Radius = this->Radius;
+  functor.Probabilities = probabilities->GetPointer(0);
+
+  // A few hundred evaluations per chunk amortize the thread start up
+  vtkSlicerPathPlannerParallelFor(0, numberOfTrajectories, 512, functor);
+}
@@ -0,0 +1,84 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// .NAME vtkSlicerPathPlannerHitProbability - hit probability of uncertain targets
+// .SECTION Description
+// The target position is a normal distribution (mean, 3x3 covariance). The
+// probability that a straight trajectory passes within Radius of the target
+// is the probability mass of the target, projected on the plane orthogonal
+// to the trajectory, inside a disk of that radius. In the principal axes of
+// the projected covariance the two coordinates are independent, so the
+// probability reduces to a 1D integral of a Gaussian times a difference of
+// normal cumulative distributions, evaluated with a 20 point Gauss-Legendre
+// rule. A centered isotropic distribution uses the closed form
+// 1 - exp(-R^2 / 2 sigma^2). This is cheap enough to be computed for every
+// candidate trajectory.
+
+#ifndef __vtkSlicerPathPlannerHitProbability_h
+#define __vtkSlicerPathPlannerHitProbability_h
+
+// VTK includes
+#include <vtkObject.h>
+
+#include "vtkSlicerPathPlannerModuleLogicExport.h"
+
+class vtkDoubleArray;
+
+/// \ingroup Slicer_QtModules_PathPlanner
+class VTK_SLICER_PATHPLANNER_MODULE_LOGIC_EXPORT vtkSlicerPathPlannerHitProbability :
+  public vtkObject
+{
+public:
+  static vtkSlicerPathPlannerHitProbability *New();
+  vtkTypeMacro(vtkSlicerPathPlannerHitProbability, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Ablation or biopsy radius (mm). Default is 5.
+  vtkSetMacro(Radius, double);
+  vtkGetMacro(Radius, double);
+
+  /// Probability that the line going through entry and target passes within
+  /// radius of a target distributed as N(mean, covariance). covariance is
+  /// the row-major 3x3 matrix.
+  static double ComputeHitProbability(const double entry[3], const double target[3],
+                                      const double mean[3], const double covariance[9],
+                                      double radius);
+
+  /// Evaluate every trajectory of "segments" (6 components: entry RAS,
+  /// target RAS). "means" (3 components) and "covariances" (9 components)
+  /// hold one target distribution per trajectory; when "means" is NULL the
+  /// planned target is used.
+  void Evaluate(vtkDoubleArray* segments, vtkDoubleArray* means,
+                vtkDoubleArray* covariances, vtkDoubleArray* probabilities);
+
+protected:
+  vtkSlicerPathPlannerHitProbability();
+  virtual ~vtkSlicerPathPlannerHitProbability();
+
+  double Radius;
+
+private:
+  vtkSlicerPathPlannerHitProbability(const vtkSlicerPathPlannerHitProbability&); // Not implemented
+  void operator=(const vtkSlicerPathPlannerHitProbability&);               // Not implemented
+};
+
+#endif
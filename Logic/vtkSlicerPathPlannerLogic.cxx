@@ -21,16 +21,248 @@
 ==============================================================================*/
 
 // PathPlanner Logic includes
+#include "vtkSlicerPathPlannerAblationPlanner.h"
+#include "vtkSlicerPathPlannerClearanceCache.h"
+#include "vtkSlicerPathPlannerDeflectionPredictor.h"
+#include "vtkSlicerPathPlannerDeviationMonitor.h"
+#include "vtkSlicerPathPlannerDistanceMapCache.h"
+#include "vtkSlicerPathPlannerHitProbability.h"
 #include "vtkSlicerPathPlannerLogic.h"
+#include "vtkSlicerPathPlannerPhaseEvaluator.h"
+#include "vtkSlicerPathPlannerPlanHistory.h"
+#include "vtkSlicerPathPlannerPlanJournal.h"
+#include "vtkSlicerPathPlannerPlanSnapshot.h"
+#include "vtkSlicerPathPlannerPlanSnapshotStore.h"
+#include "vtkSlicerPathPlannerPlanSync.h"
+#include "vtkSlicerPathPlannerRobotKinematics.h"
+#include "vtkSlicerPathPlannerRobustnessAnalyzer.h"
+#include "vtkSlicerPathPlannerSeedDose.h"
+#include "vtkSlicerPathPlannerSegmentIndex.h"
+#include "vtkSlicerPathPlannerSharedEntryPlanner.h"
+#include "vtkSlicerPathPlannerSteerablePlanner.h"
+#include "vtkSlicerPathPlannerTemplateReachability.h"
+#include "vtkSlicerPathPlannerTrackingLog.h"
+#include "vtkSlicerPathPlannerTrajectoryScorer.h"
+#include "vtkSlicerPathPlannerTrajectoryWarper.h"
+#include "vtkSlicerPathPlannerVolumeSampler.h"
+#include "vtkSlicerPathPlannerWorkspace.h"
 
 // MRML includes
+#include "vtkMRMLAnnotationFiducialNode.h"
+#include "vtkMRMLAnnotationHierarchyNode.h"
+#include "vtkMRMLAnnotationRulerNode.h"
 #include "vtkMRMLPathPlannerTrajectoryNode.h"
+#include "vtkMRMLScalarVolumeNode.h"
+#include "vtkMRMLScene.h"
+#include "vtkMRMLTransformNode.h"
 
 // VTK includes
+#include <vtkCallbackCommand.h>
+#include <vtkCollection.h>
+#include <vtkDoubleArray.h>
+#include <vtkGeneralTransform.h>
+#include <vtkIdList.h>
+#include <vtkIdTypeArray.h>
+#include <vtkImageData.h>
+#include <vtkIntArray.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
 #include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkSmartPointer.h>
+#include <vtkStringArray.h>
 
 // STD includes
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+//----------------------------------------------------------------------------
+// Store "numberOfValues" numbers in a node attribute, separated by spaces.
+// The attribute is left untouched if it already holds these values.
+void SetAttributeValues(vtkMRMLNode* node, const char* name,
+                        const double* values, int numberOfValues)
+{
+  std::stringstream valuesString;
+  valuesString.precision(9);
+  for (int i = 0; i < numberOfValues; i++)
+    {
+    valuesString << (i ? " " : "") << values[i];
+    }
+  const char* previous = node->GetAttribute(name);
+  if (!previous || valuesString.str() != previous)
+    {
+    node->SetAttribute(name, valuesString.str().c_str());
+    }
+}
+
+//----------------------------------------------------------------------------
+// Read the numbers stored by SetAttributeValues. Return 0 and zeros if the
+// attribute is missing or does not hold enough numbers.
+int GetAttributeValues(vtkMRMLNode* node, const char* name,
+                       double* values, int numberOfValues)
+{
+  const char* valuesString = node ? node->GetAttribute(name) : NULL;
+  std::stringstream valuesStream(valuesString ? valuesString : "");
+  int i = 0;
+  while (i < numberOfValues && valuesStream >> values[i])
+    {
+    ++i;
+    }
+  if (i == numberOfValues)
+    {
+    return 1;
+    }
+  for (i = 0; i < numberOfValues; i++)
+    {
+    values[i] = 0.0;
+    }
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+// All the numbers stored by SetAttributeValues, whatever their count
+void GetAttributeVector(vtkMRMLNode* node, const char* name, std::vector<double>& values)
+{
+  values.clear();
+  const char* valuesString = node ? node->GetAttribute(name) : NULL;
+  std::stringstream valuesStream(valuesString ? valuesString : "");
+  double value;
+  while (valuesStream >> value)
+    {
+    values.push_back(value);
+    }
+}
+
+//----------------------------------------------------------------------------
+// Identify the stiffness volume and its content (node, voxel or parent
+// transform changes), "none" without volume
+std::string GetStiffnessKey(vtkMRMLScalarVolumeNode* stiffness)
+{
+  if (!stiffness || !stiffness->GetID())
+    {
+    return "none";
+    }
+  unsigned long mtime = stiffness->GetMTime();
+  if (stiffness->GetImageData() && stiffness->GetImageData()->GetMTime() > mtime)
+    {
+    mtime = stiffness->GetImageData()->GetMTime();
+    }
+  for (vtkMRMLTransformNode* transformNode = stiffness->GetParentTransformNode();
+       transformNode; transformNode = transformNode->GetParentTransformNode())
+    {
+    if (transformNode->GetMTime() > mtime)
+      {
+      mtime = transformNode->GetMTime();
+      }
+    }
+  std::stringstream key;
+  key << stiffness->GetID() << " " << mtime;
+  return key.str();
+}
+
+//----------------------------------------------------------------------------
+// True if the ruler has a prediction made with the current content of its
+// stiffness volume
+bool HasCurrentPrediction(vtkMRMLNode* ruler)
+{
+  const char* key = ruler ? ruler->GetAttribute(
+    vtkSlicerPathPlannerLogic::GetPredictionStiffnessAttributeName()) : NULL;
+  if (!key)
+    {
+    return false;
+    }
+  std::string stiffnessID;
+  std::stringstream keyStream(key);
+  keyStream >> stiffnessID;
+  vtkMRMLScalarVolumeNode* stiffness = stiffnessID != "none" && ruler->GetScene() ?
+    vtkMRMLScalarVolumeNode::SafeDownCast(ruler->GetScene()->GetNodeByID(stiffnessID.c_str())) :
+    NULL;
+  if (stiffnessID != "none" && !stiffness)
+    {
+    return false;
+    }
+  return GetStiffnessKey(stiffness) == key;
+}
+
+//----------------------------------------------------------------------------
+// True if both rulers come from the same entry or the same target fiducial
+bool SharesFiducial(vtkMRMLNode* first, vtkMRMLNode* second)
+{
+  const char* names[2] = { vtkSlicerPathPlannerLogic::GetEntryPointIDAttributeName(),
+                           vtkSlicerPathPlannerLogic::GetTargetPointIDAttributeName() };
+  for (int i = 0; i < 2; i++)
+    {
+    const char* firstID = first->GetAttribute(names[i]);
+    const char* secondID = second->GetAttribute(names[i]);
+    if (firstID && secondID && strcmp(firstID, secondID) == 0)
+      {
+      return true;
+      }
+    }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+// True if the sampler holds the current image and world geometry of the
+// volume. The parent transforms may change without modifying the volume node
+bool IsSamplerCurrent(vtkSlicerPathPlannerVolumeSampler* sampler, vtkMRMLVolumeNode* volumeNode)
+{
+  vtkImageData* image = volumeNode ? volumeNode->GetImageData() : NULL;
+  if (image != sampler->GetImageData())
+    {
+    return false;
+    }
+  if (!image)
+    {
+    return true;
+    }
+  if (volumeNode->GetMTime() > sampler->GetMTime() || image->GetMTime() > sampler->GetMTime())
+    {
+    return false;
+    }
+  vtkNew<vtkMatrix4x4> worldToIJK;
+  vtkSlicerPathPlannerLogic::GetWorldToIJKMatrix(volumeNode, worldToIJK.GetPointer());
+  vtkNew<vtkMatrix4x4> samplerWorldToIJK;
+  sampler->GetRASToIJKMatrix(samplerWorldToIJK.GetPointer());
+  for (int i = 0; i < 4; i++)
+    {
+    for (int j = 0; j < 4; j++)
+      {
+      if (samplerWorldToIJK->GetElement(i, j) != worldToIJK->GetElement(i, j))
+        {
+        return false;
+        }
+      }
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Positions of the fiducials of a hierarchy, in order
+void GetFiducialPositions(vtkMRMLAnnotationHierarchyNode* list, vtkPoints* points)
+{
+  for (int i = 0; list && i < list->GetNumberOfChildrenNodes(); i++)
+    {
+    vtkMRMLAnnotationFiducialNode* fiducial =
+      vtkMRMLAnnotationFiducialNode::SafeDownCast(list->GetNthChildNode(i)->GetAssociatedNode());
+    if (fiducial)
+      {
+      double position[3];
+      vtkSlicerPathPlannerLogic::GetFiducialWorldCoordinates(fiducial, position);
+      points->InsertNextPoint(position);
+      }
+    }
+}
+}
 
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkSlicerPathPlannerLogic);
@@ -38,17 +270,1329 @@ vtkStandardNewMacro(vtkSlicerPathPlannerLogic);
 //----------------------------------------------------------------------------
 vtkSlicerPathPlannerLogic::vtkSlicerPathPlannerLogic()
 {
+  this->RobustnessAnalyzer = vtkSlicerPathPlannerRobustnessAnalyzer::New();
+  this->HitProbability = vtkSlicerPathPlannerHitProbability::New();
+  this->TrajectoryScorer = vtkSlicerPathPlannerTrajectoryScorer::New();
+  this->TrajectoryScorer->SetTermWeight(this->GetHitProbabilityAttributeName(), 1.0);
+  this->TrajectoryScorer->SetTermWeight(this->GetSuccessProbabilityAttributeName(), 1.0);
+  this->TrajectoryScorer->SetTermWeight(this->GetPredictedDeviationAttributeName(), 0.0);
+  this->TrajectorySegmentArray = vtkDoubleArray::New();
+  this->TrajectorySegmentArray->SetNumberOfComponents(6);
+  this->TrajectoryIDArray = vtkStringArray::New();
+  this->TrajectoryScoreArray = vtkDoubleArray::New();
+  this->DeflectionPredictor = vtkSlicerPathPlannerDeflectionPredictor::New();
+  this->UsePredictedPaths = 0;
+  this->SteerablePlanner = vtkSlicerPathPlannerSteerablePlanner::New();
+  this->TemplateReachability = vtkSlicerPathPlannerTemplateReachability::New();
+  this->TemplateCriticalStructures = vtkSlicerPathPlannerVolumeSampler::New();
+  this->TemplateReachability->SetCriticalStructures(this->TemplateCriticalStructures);
+  this->RobotWorkspace = vtkSlicerPathPlannerWorkspace::New();
+  this->TrajectoryScorer->SetTermWeight(this->GetRobotIKReachableAttributeName(), 0.0);
+  this->TrajectoryIndex = vtkSlicerPathPlannerSegmentIndex::New();
+  this->NextTrajectoryIndexID = 0;
+  this->TrajectoryIndexModified = 1;
+  this->TrajectoryIndexCallback = vtkCallbackCommand::New();
+  this->TrajectoryIndexCallback->SetClientData(this);
+  this->TrajectoryIndexCallback->SetCallback(
+    &vtkSlicerPathPlannerLogic::TrajectoryIndexModifiedCallback);
+  this->AblationPlanner = vtkSlicerPathPlannerAblationPlanner::New();
+  this->SharedEntryPlanner = vtkSlicerPathPlannerSharedEntryPlanner::New();
+  this->SeedDose = vtkSlicerPathPlannerSeedDose::New();
+  this->SeedDoseTarget = vtkSlicerPathPlannerVolumeSampler::New();
+  this->SeedDose->SetTarget(this->SeedDoseTarget);
+  this->DistanceMapCache = vtkSlicerPathPlannerDistanceMapCache::New();
+  this->PhaseEvaluator = vtkSlicerPathPlannerPhaseEvaluator::New();
+  this->PhaseEvaluator->SetDistanceMapCache(this->DistanceMapCache);
+  this->TrajectoryScorer->SetTermWeight(this->GetWorstCaseRiskAttributeName(), 0.0);
+  this->TrajectoryWarper = vtkSlicerPathPlannerTrajectoryWarper::New();
+  this->ClearanceCache = vtkSlicerPathPlannerClearanceCache::New();
+  this->ClearanceCache->SetDistanceMapCache(this->DistanceMapCache);
+  this->DeviationMonitor = vtkSlicerPathPlannerDeviationMonitor::New();
+  this->TrackingLog = vtkSlicerPathPlannerTrackingLog::New();
+  this->TrackingLog->SetMonitor(this->DeviationMonitor);
+  this->PlanSync = vtkSlicerPathPlannerPlanSync::New();
+  this->PlanJournal = vtkSlicerPathPlannerPlanJournal::New();
+  this->PlanHistory = vtkSlicerPathPlannerPlanHistory::New();
+  this->PlanSnapshotStore = vtkSlicerPathPlannerPlanSnapshotStore::New();
+  this->TrajectoryScorer->SetTermWeight(this->GetClearanceRiskAttributeName(), -1.0);
 }
 
 //----------------------------------------------------------------------------
 vtkSlicerPathPlannerLogic::~vtkSlicerPathPlannerLogic()
 {
+  this->RobustnessAnalyzer->Delete();
+  this->HitProbability->Delete();
+  this->TrajectoryScorer->Delete();
+  this->TrajectorySegmentArray->Delete();
+  this->TrajectoryIDArray->Delete();
+  this->TrajectoryScoreArray->Delete();
+  this->DeflectionPredictor->Delete();
+  this->SteerablePlanner->Delete();
+  this->TemplateReachability->Delete();
+  this->TemplateCriticalStructures->Delete();
+  this->RobotWorkspace->Delete();
+  this->RemoveTrajectoryIndexObservers();
+  this->TrajectoryIndexCallback->Delete();
+  this->TrajectoryIndex->Delete();
+  this->AblationPlanner->Delete();
+  this->SharedEntryPlanner->Delete();
+  this->SeedDose->Delete();
+  this->SeedDoseTarget->Delete();
+  this->PhaseEvaluator->Delete();
+  this->DistanceMapCache->Delete();
+  this->TrajectoryWarper->Delete();
+  this->ClearanceCache->Delete();
+  this->DeviationMonitor->SetRecorder(NULL);
+  this->DeviationMonitor->Delete();
+  this->TrackingLog->Delete();
+  this->PlanSync->Delete();
+  this->PlanJournal->Delete();
+  this->PlanHistory->Delete();
+  this->PlanSnapshotStore->Delete();
 }
 
 //----------------------------------------------------------------------------
 void vtkSlicerPathPlannerLogic::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "RobustnessAnalyzer:\n";
+  this->RobustnessAnalyzer->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "HitProbability:\n";
+  this->HitProbability->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "TrajectoryScorer:\n";
+  this->TrajectoryScorer->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "NumberOfTrajectories: "
+     << this->TrajectorySegmentArray->GetNumberOfTuples() << "\n";
+  os << indent << "DeflectionPredictor:\n";
+  this->DeflectionPredictor->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "UsePredictedPaths: " << this->UsePredictedPaths << "\n";
+  os << indent << "SteerablePlanner:\n";
+  this->SteerablePlanner->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "TemplateReachability:\n";
+  this->TemplateReachability->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "RobotWorkspace:\n";
+  this->RobotWorkspace->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "TrajectoryIndex:\n";
+  this->TrajectoryIndex->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "AblationPlanner:\n";
+  this->AblationPlanner->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "SharedEntryPlanner:\n";
+  this->SharedEntryPlanner->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "SeedDose:\n";
+  this->SeedDose->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "PhaseEvaluator:\n";
+  this->PhaseEvaluator->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "DistanceMapCache:\n";
+  this->DistanceMapCache->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "TrajectoryWarper:\n";
+  this->TrajectoryWarper->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "ClearanceCache:\n";
+  this->ClearanceCache->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "DeviationMonitor:\n";
+  this->DeviationMonitor->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "TrackingLog:\n";
+  this->TrackingLog->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "PlanSync:\n";
+  this->PlanSync->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "PlanJournal:\n";
+  this->PlanJournal->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "PlanHistory:\n";
+  this->PlanHistory->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "PlanSnapshotStore:\n";
+  this->PlanSnapshotStore->PrintSelf(os, indent.GetNextIndent());
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerLogic::GetSuccessProbabilityAttributeName()
+{
+  return "PathPlanner.SuccessProbability";
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerLogic::GetEntryPointIDAttributeName()
+{
+  return "PathPlanner.EntryPointID";
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerLogic::GetTargetPointIDAttributeName()
+{
+  return "PathPlanner.TargetPointID";
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerLogic::GetTargetCovarianceAttributeName()
+{
+  return "PathPlanner.TargetCovariance";
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerLogic::GetHitProbabilityAttributeName()
+{
+  return "PathPlanner.HitProbability";
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerLogic::GetBevelAngleAttributeName()
+{
+  return "PathPlanner.BevelAngle";
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerLogic::GetPredictedTipSegmentAttributeName()
+{
+  return "PathPlanner.PredictedTipSegment";
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerLogic::GetPredictedDeviationAttributeName()
+{
+  return "PathPlanner.PredictedDeviation";
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerLogic::GetPredictedPathAttributeName()
+{
+  return "PathPlanner.PredictedPath";
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerLogic::GetPredictionStiffnessAttributeName()
+{
+  return "PathPlanner.PredictionStiffness";
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerLogic::GetRobotWorkspaceReachableAttributeName()
+{
+  return "PathPlanner.RobotWorkspaceReachable";
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerLogic::GetRobotIKReachableAttributeName()
+{
+  return "PathPlanner.RobotIKReachable";
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerLogic::GetRobotJointsAttributeName()
+{
+  return "PathPlanner.RobotJoints";
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerLogic::GetWorstCaseClearanceAttributeName()
+{
+  return "PathPlanner.WorstCaseClearance";
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerLogic::GetWorstCaseRiskAttributeName()
+{
+  return "PathPlanner.WorstCaseRisk";
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerLogic::GetWorstCasePhaseAttributeName()
+{
+  return "PathPlanner.WorstCasePhase";
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerLogic::GetClearanceAttributeName()
+{
+  return "PathPlanner.Clearance";
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerLogic::GetClearanceRiskAttributeName()
+{
+  return "PathPlanner.ClearanceRisk";
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLAnnotationFiducialNode* vtkSlicerPathPlannerLogic
+::GetTargetPoint(vtkMRMLAnnotationRulerNode* ruler)
+{
+  if (!ruler || !ruler->GetScene())
+    {
+    return NULL;
+    }
+  const char* targetID = ruler->GetAttribute(GetTargetPointIDAttributeName());
+  if (!targetID)
+    {
+    return NULL;
+    }
+  return vtkMRMLAnnotationFiducialNode::SafeDownCast(ruler->GetScene()->GetNodeByID(targetID));
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerLogic
+::GetFiducialWorldCoordinates(vtkMRMLAnnotationFiducialNode* fiducial, double world[3])
+{
+  world[0] = world[1] = world[2] = 0.0;
+  if (!fiducial)
+    {
+    return;
+    }
+  double local[3] = { 0.0, 0.0, 0.0 };
+  fiducial->GetFiducialCoordinates(local);
+
+  vtkMRMLTransformNode* transformNode = fiducial->GetParentTransformNode();
+  if (!transformNode)
+    {
+    world[0] = local[0];
+    world[1] = local[1];
+    world[2] = local[2];
+    return;
+    }
+
+  // The general transform handles grid and B-spline transforms as well
+  vtkNew<vtkGeneralTransform> localToWorld;
+  transformNode->GetTransformToWorld(localToWorld.GetPointer());
+  localToWorld->TransformPoint(local, world);
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerLogic
+::SetFiducialWorldCoordinates(vtkMRMLAnnotationFiducialNode* fiducial, const double world[3])
+{
+  if (!fiducial)
+    {
+    return;
+    }
+  double local[3] = { world[0], world[1], world[2] };
+  vtkMRMLTransformNode* transformNode = fiducial->GetParentTransformNode();
+  if (transformNode)
+    {
+    vtkNew<vtkGeneralTransform> localToWorld;
+    transformNode->GetTransformToWorld(localToWorld.GetPointer());
+    localToWorld->GetInverse()->TransformPoint(world, local);
+    }
+  fiducial->SetFiducialCoordinates(local);
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerLogic
+::GetRulerWorldCoordinates(vtkMRMLAnnotationRulerNode* ruler, double entry[3], double target[3])
+{
+  double* entryPosition = ruler ? ruler->GetPosition1() : NULL;
+  double* targetPosition = ruler ? ruler->GetPosition2() : NULL;
+  if (!entryPosition || !targetPosition)
+    {
+    entry[0] = entry[1] = entry[2] = 0.0;
+    target[0] = target[1] = target[2] = 0.0;
+    return 0;
+    }
+  vtkMRMLTransformNode* transformNode = ruler->GetParentTransformNode();
+  if (!transformNode)
+    {
+    for (int i = 0; i < 3; i++)
+      {
+      entry[i] = entryPosition[i];
+      target[i] = targetPosition[i];
+      }
+    return 1;
+    }
+
+  vtkNew<vtkGeneralTransform> localToWorld;
+  transformNode->GetTransformToWorld(localToWorld.GetPointer());
+  localToWorld->TransformPoint(entryPosition, entry);
+  localToWorld->TransformPoint(targetPosition, target);
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerLogic
+::GetWorldToIJKMatrix(vtkMRMLVolumeNode* volumeNode, vtkMatrix4x4* worldToIJK)
+{
+  if (!volumeNode || !worldToIJK)
+    {
+    return 0;
+    }
+  volumeNode->GetRASToIJKMatrix(worldToIJK);
+
+  vtkMRMLTransformNode* transformNode = volumeNode->GetParentTransformNode();
+  if (!transformNode)
+    {
+    return 1;
+    }
+  if (!transformNode->IsTransformToWorldLinear())
+    {
+    return 0;
+    }
+  vtkNew<vtkMatrix4x4> rasToWorld;
+  transformNode->GetMatrixTransformToWorld(rasToWorld.GetPointer());
+  vtkNew<vtkMatrix4x4> worldToRAS;
+  vtkMatrix4x4::Invert(rasToWorld.GetPointer(), worldToRAS.GetPointer());
+  vtkNew<vtkMatrix4x4> rasToIJK;
+  rasToIJK->DeepCopy(worldToIJK);
+  vtkMatrix4x4::Multiply4x4(rasToIJK.GetPointer(), worldToRAS.GetPointer(), worldToIJK);
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerLogic
+::SetTargetCovariance(vtkMRMLAnnotationFiducialNode* target, const double covariance[9])
+{
+  if (!target)
+    {
+    return;
+    }
+  if (!covariance)
+    {
+    target->RemoveAttribute(GetTargetCovarianceAttributeName());
+    return;
+    }
+
+  SetAttributeValues(target, GetTargetCovarianceAttributeName(), covariance, 9);
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerLogic
+::GetTargetCovariance(vtkMRMLAnnotationFiducialNode* target, double covariance[9])
+{
+  return GetAttributeValues(target, GetTargetCovarianceAttributeName(), covariance, 9);
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerLogic
+::GetTrajectorySegments(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                        vtkDoubleArray* segments,
+                        vtkCollection* rulers)
+{
+  if (!segments)
+    {
+    return;
+    }
+
+  segments->SetNumberOfComponents(6);
+  segments->SetNumberOfTuples(0);
+  if (rulers)
+    {
+    rulers->RemoveAllItems();
+    }
+
+  if (!trajectoryNode)
+    {
+    return;
+    }
+
+  // Convention: Position1 -> Entry Point
+  //             Position2 -> Target Point
+  for (int i = 0; i < trajectoryNode->GetNumberOfChildrenNodes(); i++)
+    {
+    vtkMRMLAnnotationRulerNode* ruler =
+      vtkMRMLAnnotationRulerNode::SafeDownCast(trajectoryNode->GetNthChildNode(i)->GetAssociatedNode());
+    if (!ruler)
+      {
+      continue;
+      }
+
+    double* entryPosition = ruler->GetPosition1();
+    double* targetPosition = ruler->GetPosition2();
+    if (!entryPosition || !targetPosition)
+      {
+      continue;
+      }
+
+    double segment[6] = {
+      entryPosition[0], entryPosition[1], entryPosition[2],
+      targetPosition[0], targetPosition[1], targetPosition[2] };
+    segments->InsertNextTuple(segment);
+    if (rulers)
+      {
+      rulers->AddItem(ruler);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerLogic
+::ComputeSuccessProbabilities(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                              vtkMRMLScalarVolumeNode* criticalStructures)
+{
+  if (!trajectoryNode)
+    {
+    return;
+    }
+
+  // The workers only read the snapshot, not the scene
+  vtkNew<vtkCollection> volumeNodes;
+  if (criticalStructures)
+    {
+    volumeNodes->AddItem(criticalStructures);
+    }
+  vtkNew<vtkCollection> rulers;
+  vtkSlicerPathPlannerPlanSnapshot* snapshot =
+    this->AcquirePlanSnapshot(trajectoryNode, volumeNodes.GetPointer(), rulers.GetPointer());
+  vtkDoubleArray* segments = snapshot->GetSegments();
+
+  this->RobustnessAnalyzer->SetCriticalStructures(
+    criticalStructures ? snapshot->GetVolume(criticalStructures->GetID()) : NULL);
+
+  // Nominal shafts along the predicted needle paths
+  vtkNew<vtkDoubleArray> predictedPaths;
+  if (this->UsePredictedPaths &&
+      this->GetPredictedPaths(rulers.GetPointer(), segments, predictedPaths.GetPointer()))
+    {
+    this->RobustnessAnalyzer->SetPredictedPaths(predictedPaths.GetPointer());
+    }
+
+  // Samples follow the ruler, not its rank among the evaluated rulers
+  vtkNew<vtkStringArray> rulerIDs;
+  for (int i = 0; i < rulers->GetNumberOfItems(); i++)
+    {
+    const char* rulerID = vtkMRMLNode::SafeDownCast(rulers->GetItemAsObject(i))->GetID();
+    rulerIDs->InsertNextValue(rulerID ? rulerID : "");
+    }
+  this->RobustnessAnalyzer->SetTrajectoryKeys(rulerIDs.GetPointer());
+
+  vtkNew<vtkDoubleArray> successProbabilities;
+  this->RobustnessAnalyzer->Evaluate(segments, NULL, NULL,
+                                     successProbabilities.GetPointer());
+  this->RobustnessAnalyzer->SetCriticalStructures(NULL);
+  this->RobustnessAnalyzer->SetPredictedPaths(NULL);
+  this->RobustnessAnalyzer->SetTrajectoryKeys(NULL);
+  this->PlanSnapshotStore->Release(snapshot);
+
+  for (int i = 0; i < rulers->GetNumberOfItems(); i++)
+    {
+    vtkMRMLAnnotationRulerNode* ruler =
+      vtkMRMLAnnotationRulerNode::SafeDownCast(rulers->GetItemAsObject(i));
+    std::stringstream probability;
+    probability << successProbabilities->GetValue(i);
+    ruler->SetAttribute(this->GetSuccessProbabilityAttributeName(),
+                        probability.str().c_str());
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerLogic
+::ComputeHitProbabilities(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode)
+{
+  if (!trajectoryNode)
+    {
+    return;
+    }
+
+  vtkNew<vtkCollection> rulers;
+  vtkSlicerPathPlannerPlanSnapshot* snapshot =
+    this->AcquirePlanSnapshot(trajectoryNode, NULL, rulers.GetPointer());
+  vtkDoubleArray* segments = snapshot->GetSegments();
+
+  // Target distribution: fiducial position and covariance
+  vtkIdType numberOfTrajectories = segments->GetNumberOfTuples();
+  vtkNew<vtkDoubleArray> means;
+  means->SetNumberOfComponents(3);
+  means->SetNumberOfTuples(numberOfTrajectories);
+  vtkNew<vtkDoubleArray> covariances;
+  covariances->SetNumberOfComponents(9);
+  covariances->SetNumberOfTuples(numberOfTrajectories);
+  for (vtkIdType i = 0; i < numberOfTrajectories; i++)
+    {
+    vtkMRMLAnnotationFiducialNode* target = this->GetTargetPoint(
+      vtkMRMLAnnotationRulerNode::SafeDownCast(rulers->GetItemAsObject(i)));
+    double mean[3] = { segments->GetComponent(i, 3), segments->GetComponent(i, 4),
+                       segments->GetComponent(i, 5) };
+    if (target)
+      {
+      this->GetFiducialWorldCoordinates(target, mean);
+      }
+    double covariance[9];
+    this->GetTargetCovariance(target, covariance);
+    means->SetTuple(i, mean);
+    covariances->SetTuple(i, covariance);
+    }
+
+  // Lines tangent to the predicted paths at the tip
+  vtkNew<vtkDoubleArray> tipSegments;
+  vtkDoubleArray* evaluatedSegments = segments;
+  if (this->UsePredictedPaths &&
+      this->GetPredictedTipSegments(rulers.GetPointer(), segments,
+                                    tipSegments.GetPointer()))
+    {
+    evaluatedSegments = tipSegments.GetPointer();
+    }
+
+  vtkNew<vtkDoubleArray> probabilities;
+  this->HitProbability->Evaluate(evaluatedSegments, means.GetPointer(),
+                                 covariances.GetPointer(), probabilities.GetPointer());
+  this->PlanSnapshotStore->Release(snapshot);
+
+  for (int i = 0; i < rulers->GetNumberOfItems(); i++)
+    {
+    vtkMRMLAnnotationRulerNode* ruler =
+      vtkMRMLAnnotationRulerNode::SafeDownCast(rulers->GetItemAsObject(i));
+    std::stringstream probability;
+    probability << probabilities->GetValue(i);
+    ruler->SetAttribute(this->GetHitProbabilityAttributeName(), probability.str().c_str());
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerLogic
+::PredictNeedlePaths(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                     vtkMRMLScalarVolumeNode* stiffness,
+                     vtkDoubleArray* paths)
+{
+  if (!trajectoryNode)
+    {
+    return;
+    }
+
+  vtkNew<vtkDoubleArray> segments;
+  vtkNew<vtkCollection> rulers;
+  this->GetTrajectorySegments(trajectoryNode, segments.GetPointer(), rulers.GetPointer());
+
+  vtkIdType numberOfTrajectories = segments->GetNumberOfTuples();
+  vtkNew<vtkDoubleArray> bevelAngles;
+  bevelAngles->SetNumberOfTuples(numberOfTrajectories);
+  for (vtkIdType i = 0; i < numberOfTrajectories; i++)
+    {
+    double bevelAngle;
+    GetAttributeValues(vtkMRMLNode::SafeDownCast(rulers->GetItemAsObject(i)),
+                       this->GetBevelAngleAttributeName(), &bevelAngle, 1);
+    bevelAngles->SetValue(i, bevelAngle);
+    }
+
+  vtkNew<vtkSlicerPathPlannerVolumeSampler> stiffnessSampler;
+  stiffnessSampler->SetVolumeNode(stiffness);
+  this->DeflectionPredictor->SetStiffness(stiffnessSampler.GetPointer());
+
+  vtkNew<vtkDoubleArray> predictedPaths;
+  vtkDoubleArray* pathPoints = paths ? paths : predictedPaths.GetPointer();
+  vtkNew<vtkDoubleArray> tipSegments;
+  this->DeflectionPredictor->Predict(segments.GetPointer(), bevelAngles.GetPointer(),
+                                     pathPoints, tipSegments.GetPointer());
+  this->DeflectionPredictor->SetStiffness(NULL);
+
+  int numberOfPathPoints = this->DeflectionPredictor->GetNumberOfPathPoints();
+  std::string stiffnessKey = GetStiffnessKey(stiffness);
+  for (vtkIdType i = 0; i < tipSegments->GetNumberOfTuples(); i++)
+    {
+    vtkMRMLAnnotationRulerNode* ruler =
+      vtkMRMLAnnotationRulerNode::SafeDownCast(rulers->GetItemAsObject(i));
+    double* tipSegment = tipSegments->GetPointer(6 * i);
+    SetAttributeValues(ruler, this->GetPredictedTipSegmentAttributeName(), tipSegment, 6);
+    SetAttributeValues(ruler, this->GetPredictedPathAttributeName(),
+                       pathPoints->GetPointer(3 * numberOfPathPoints * i),
+                       3 * numberOfPathPoints);
+    double deviation = std::sqrt(vtkMath::Distance2BetweenPoints(
+      tipSegment + 3, segments->GetPointer(6 * i + 3)));
+    SetAttributeValues(ruler, this->GetPredictedDeviationAttributeName(), &deviation, 1);
+    ruler->SetAttribute(this->GetPredictionStiffnessAttributeName(), stiffnessKey.c_str());
+    }
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerLogic
+::GetPredictedTipSegments(vtkCollection* rulers, vtkDoubleArray* segments,
+                          vtkDoubleArray* tipSegments)
+{
+  tipSegments->DeepCopy(segments);
+  int predicted = 0;
+  for (int i = 0; i < rulers->GetNumberOfItems(); i++)
+    {
+    vtkMRMLNode* ruler = vtkMRMLNode::SafeDownCast(rulers->GetItemAsObject(i));
+    double tipSegment[6];
+    if (HasCurrentPrediction(ruler) &&
+        GetAttributeValues(ruler, GetPredictedTipSegmentAttributeName(), tipSegment, 6))
+      {
+      tipSegments->SetTuple(i, tipSegment);
+      predicted = 1;
+      }
+    }
+  return predicted;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerLogic
+::GetPredictedPaths(vtkCollection* rulers, vtkDoubleArray* segments, vtkDoubleArray* paths)
+{
+  vtkIdType numberOfTrajectories = segments->GetNumberOfTuples();
+  std::vector<std::vector<double> > rulerPaths(numberOfTrajectories);
+  int numberOfPathPoints = 2;
+  int predicted = 0;
+  for (vtkIdType i = 0; i < numberOfTrajectories && i < rulers->GetNumberOfItems(); i++)
+    {
+    vtkMRMLNode* ruler = vtkMRMLNode::SafeDownCast(rulers->GetItemAsObject(i));
+    if (!HasCurrentPrediction(ruler))
+      {
+      continue;
+      }
+    GetAttributeVector(ruler, GetPredictedPathAttributeName(), rulerPaths[i]);
+    int numberOfPoints = static_cast<int>(rulerPaths[i].size() / 3);
+    if (numberOfPoints < 2 || rulerPaths[i].size() % 3 != 0)
+      {
+      rulerPaths[i].clear();
+      continue;
+      }
+    numberOfPathPoints = std::max(numberOfPathPoints, numberOfPoints);
+    predicted = 1;
+    }
+
+  // Same number of points for all: the paths are resampled, the rulers
+  // without prediction are straight
+  paths->SetNumberOfComponents(3 * numberOfPathPoints);
+  paths->SetNumberOfTuples(numberOfTrajectories);
+  for (vtkIdType i = 0; i < numberOfTrajectories; i++)
+    {
+    std::vector<double>& path = rulerPaths[i];
+    if (path.empty())
+      {
+      path.assign(segments->GetPointer(6 * i), segments->GetPointer(6 * i) + 6);
+      }
+    int last = static_cast<int>(path.size() / 3) - 1;
+    double* output = paths->GetPointer(3 * numberOfPathPoints * i);
+    for (int point = 0; point < numberOfPathPoints; point++)
+      {
+      double position = static_cast<double>(point) * last / (numberOfPathPoints - 1);
+      int index = std::min(static_cast<int>(position), last - 1);
+      double t = position - index;
+      for (int j = 0; j < 3; j++)
+        {
+        output[3 * point + j] =
+          (1.0 - t) * path[3 * index + j] + t * path[3 * (index + 1) + j];
+        }
+      }
+    }
+  return predicted;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerLogic
+::PlanSteerablePath(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                    vtkMRMLAnnotationFiducialNode* entryPoint,
+                    vtkMRMLAnnotationFiducialNode* targetPoint,
+                    vtkMRMLScalarVolumeNode* obstacles)
+{
+  if (!trajectoryNode || !entryPoint || !targetPoint)
+    {
+    return -1;
+    }
+
+  double entryPosition[3];
+  double targetPosition[3];
+  this->GetFiducialWorldCoordinates(entryPoint, entryPosition);
+  this->GetFiducialWorldCoordinates(targetPoint, targetPosition);
+
+  vtkNew<vtkSlicerPathPlannerVolumeSampler> obstaclesSampler;
+  obstaclesSampler->SetVolumeNode(obstacles);
+  this->SteerablePlanner->SetObstacles(obstaclesSampler.GetPointer());
+
+  vtkNew<vtkPoints> path;
+  int found = this->SteerablePlanner->Plan(entryPosition, NULL, targetPosition,
+                                           path.GetPointer());
+  this->SteerablePlanner->SetObstacles(NULL);
+  if (!found)
+    {
+    vtkWarningMacro(<< "PlanSteerablePath: no path found from "
+                    << entryPoint->GetName() << " to " << targetPoint->GetName());
+    return -1;
+    }
+
+  std::stringstream pathName;
+  pathName << (entryPoint->GetName() ? entryPoint->GetName() : "")
+           << "-" << (targetPoint->GetName() ? targetPoint->GetName() : "");
+  return trajectoryNode->AddCurvedPath(pathName.str().c_str(), path.GetPointer());
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerLogic
+::UpdateTemplateReachability(vtkMRMLAnnotationHierarchyNode* targetList,
+                             vtkMRMLScalarVolumeNode* criticalStructures)
+{
+  // Reload the structures only when they changed, as it dirties every row
+  if (!IsSamplerCurrent(this->TemplateCriticalStructures, criticalStructures))
+    {
+    this->TemplateCriticalStructures->SetVolumeNode(criticalStructures);
+    }
+
+  // Targets keyed by fiducial ID: unchanged fiducials keep their row
+  std::set<std::string> targetIDs;
+  for (int i = 0; targetList && i < targetList->GetNumberOfChildrenNodes(); i++)
+    {
+    vtkMRMLAnnotationFiducialNode* target =
+      vtkMRMLAnnotationFiducialNode::SafeDownCast(targetList->GetNthChildNode(i)->GetAssociatedNode());
+    if (target && target->GetID())
+      {
+      double position[3];
+      this->GetFiducialWorldCoordinates(target, position);
+      this->TemplateReachability->SetTarget(target->GetID(), position);
+      targetIDs.insert(target->GetID());
+      }
+    }
+  for (int i = this->TemplateReachability->GetNumberOfTargets() - 1; i >= 0; i--)
+    {
+    const char* targetID = this->TemplateReachability->GetNthTargetID(i);
+    if (targetIDs.find(targetID) == targetIDs.end())
+      {
+      this->TemplateReachability->RemoveTarget(targetID);
+      }
+    }
+  this->TemplateReachability->Update();
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerLogic
+::GetTemplateHolesReachingTarget(vtkMRMLAnnotationFiducialNode* target,
+                                 vtkIdList* holes, vtkDoubleArray* depths)
+{
+  if (!target || !target->GetID())
+    {
+    return -1;
+    }
+  double position[3];
+  this->GetFiducialWorldCoordinates(target, position);
+  this->TemplateReachability->SetTarget(target->GetID(), position);
+  return this->TemplateReachability->GetReachableHoles(target->GetID(), holes, depths);
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerLogic
+::ComputeRobotReachability(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode)
+{
+  if (!trajectoryNode || !this->RobotWorkspace->Update())
+    {
+    return 0;
+    }
+
+  vtkNew<vtkDoubleArray> segments;
+  vtkNew<vtkCollection> rulers;
+  this->GetTrajectorySegments(trajectoryNode, segments.GetPointer(), rulers.GetPointer());
+
+  vtkNew<vtkIntArray> reachable;
+  this->RobotWorkspace->EvaluateFeasibility(segments.GetPointer(), reachable.GetPointer());
+
+  for (int i = 0; i < rulers->GetNumberOfItems(); i++)
+    {
+    vtkMRMLAnnotationRulerNode* ruler =
+      vtkMRMLAnnotationRulerNode::SafeDownCast(rulers->GetItemAsObject(i));
+    ruler->SetAttribute(this->GetRobotWorkspaceReachableAttributeName(),
+                        reachable->GetValue(i) ? "1" : "0");
+    }
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerLogic
+::SolveRobotInverseKinematics(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode)
+{
+  if (!trajectoryNode)
+    {
+    return;
+    }
+
+  vtkNew<vtkDoubleArray> segments;
+  vtkNew<vtkCollection> rulers;
+  this->GetTrajectorySegments(trajectoryNode, segments.GetPointer(), rulers.GetPointer());
+
+  vtkNew<vtkDoubleArray> joints;
+  vtkNew<vtkIntArray> violations;
+  vtkNew<vtkIntArray> collisions;
+  this->RobotWorkspace->GetKinematics()->SolveInverseKinematics(
+    segments.GetPointer(), joints.GetPointer(), violations.GetPointer(),
+    collisions.GetPointer());
+
+  for (int i = 0; i < rulers->GetNumberOfItems(); i++)
+    {
+    vtkMRMLAnnotationRulerNode* ruler =
+      vtkMRMLAnnotationRulerNode::SafeDownCast(rulers->GetItemAsObject(i));
+    SetAttributeValues(ruler, this->GetRobotJointsAttributeName(),
+                       joints->GetPointer(5 * i), 5);
+    bool reachable = violations->GetValue(i) == 0 && collisions->GetValue(i) == 0;
+    ruler->SetAttribute(this->GetRobotIKReachableAttributeName(), reachable ? "1" : "0");
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerLogic
+::UpdateTrajectoryIndex(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode)
+{
+  std::string nodeID = trajectoryNode && trajectoryNode->GetID() ? trajectoryNode->GetID() : "";
+  if (nodeID == this->TrajectoryIndexNodeID && !this->TrajectoryIndexModified)
+    {
+    return;
+    }
+  if (nodeID != this->TrajectoryIndexNodeID)
+    {
+    this->TrajectoryIndex->RemoveAllSegments();
+    this->TrajectoryIndexIDs.clear();
+    this->TrajectoryIndexNodeID = nodeID;
+    }
+  this->TrajectoryIndexRulers.clear();
+  this->TrajectoryIndexModified = 0;
+
+  // Observe the nodes the index is built from: the trajectory node for
+  // its children, the child hierarchy nodes for their associated node and
+  // the rulers for their positions.
+  this->RemoveTrajectoryIndexObservers();
+  for (int i = 0; trajectoryNode && i < trajectoryNode->GetNumberOfChildrenNodes(); i++)
+    {
+    vtkMRMLNode* nodes[3] = { i == 0 ? trajectoryNode : NULL,
+                              trajectoryNode->GetNthChildNode(i),
+                              trajectoryNode->GetNthChildNode(i)->GetAssociatedNode() };
+    for (int j = 0; j < 3; j++)
+      {
+      if (nodes[j])
+        {
+        ObservedIndexNode observed;
+        observed.Node = nodes[j];
+        observed.Tag = nodes[j]->AddObserver(vtkCommand::ModifiedEvent,
+                                             this->TrajectoryIndexCallback);
+        this->TrajectoryIndexObservers.push_back(observed);
+        }
+      }
+    }
+
+  vtkNew<vtkDoubleArray> segments;
+  vtkNew<vtkCollection> rulerCollection;
+  this->GetTrajectorySegments(trajectoryNode, segments.GetPointer(), rulerCollection.GetPointer());
+
+  // Unchanged segments are left alone by SetSegment
+  std::map<std::string, vtkIdType> previousIDs;
+  previousIDs.swap(this->TrajectoryIndexIDs);
+  for (int i = 0; i < rulerCollection->GetNumberOfItems(); i++)
+    {
+    vtkMRMLAnnotationRulerNode* ruler =
+      vtkMRMLAnnotationRulerNode::SafeDownCast(rulerCollection->GetItemAsObject(i));
+    if (!ruler->GetID())
+      {
+      continue;
+      }
+    vtkIdType id;
+    std::map<std::string, vtkIdType>::iterator previous = previousIDs.find(ruler->GetID());
+    if (previous != previousIDs.end())
+      {
+      id = previous->second;
+      previousIDs.erase(previous);
+      }
+    else
+      {
+      id = this->NextTrajectoryIndexID++;
+      }
+    this->TrajectoryIndexIDs[ruler->GetID()] = id;
+    const double* segment = segments->GetPointer(6 * i);
+    this->TrajectoryIndex->SetSegment(id, segment, segment + 3);
+    this->TrajectoryIndexRulers[id] = ruler;
+    }
+
+  // Rulers removed from the node
+  for (std::map<std::string, vtkIdType>::iterator it = previousIDs.begin();
+       it != previousIDs.end(); ++it)
+    {
+    this->TrajectoryIndex->RemoveSegment(it->second);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerLogic::RemoveTrajectoryIndexObservers()
+{
+  for (std::vector<ObservedIndexNode>::iterator it = this->TrajectoryIndexObservers.begin();
+       it != this->TrajectoryIndexObservers.end(); ++it)
+    {
+    it->Node->RemoveObserver(it->Tag);
+    }
+  this->TrajectoryIndexObservers.clear();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerLogic::TrajectoryIndexModifiedCallback(vtkObject* vtkNotUsed(caller),
+                                                                unsigned long vtkNotUsed(eid),
+                                                                void* clientData,
+                                                                void* vtkNotUsed(callData))
+{
+  vtkSlicerPathPlannerLogic* self = reinterpret_cast<vtkSlicerPathPlannerLogic*>(clientData);
+  self->TrajectoryIndexModified = 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerLogic
+::PlanAblation(vtkMRMLAnnotationHierarchyNode* entryList,
+               vtkMRMLScalarVolumeNode* tumor,
+               vtkMRMLScalarVolumeNode* criticalStructures,
+               vtkDoubleArray* probes)
+{
+  if (!probes)
+    {
+    return -1;
+    }
+  probes->SetNumberOfComponents(6);
+  probes->SetNumberOfTuples(0);
+
+  vtkNew<vtkPoints> entryPoints;
+  GetFiducialPositions(entryList, entryPoints.GetPointer());
+
+  vtkNew<vtkSlicerPathPlannerVolumeSampler> tumorSampler;
+  tumorSampler->SetVolumeNode(tumor);
+  vtkNew<vtkSlicerPathPlannerVolumeSampler> structures;
+  structures->SetVolumeNode(criticalStructures);
+  this->AblationPlanner->SetTumor(tumorSampler.GetPointer());
+  this->AblationPlanner->SetCriticalStructures(structures.GetPointer());
+
+  vtkNew<vtkDoubleArray> candidates;
+  this->AblationPlanner->GenerateCandidates(entryPoints.GetPointer(), candidates.GetPointer());
+  this->AblationPlanner->SetCandidates(candidates.GetPointer());
+  int numberOfProbes = this->AblationPlanner->Plan();
+
+  vtkNew<vtkIdList> selected;
+  this->AblationPlanner->GetSelectedCandidates(selected.GetPointer());
+  for (vtkIdType i = 0; i < selected->GetNumberOfIds(); i++)
+    {
+    probes->InsertNextTuple(candidates->GetPointer(6 * selected->GetId(i)));
+    }
+
+  this->AblationPlanner->SetTumor(NULL);
+  this->AblationPlanner->SetCriticalStructures(NULL);
+  this->AblationPlanner->SetCandidates(NULL);
+  return numberOfProbes;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerLogic
+::PlanSharedEntries(vtkMRMLAnnotationHierarchyNode* targetList,
+                    vtkMRMLAnnotationHierarchyNode* entryList,
+                    vtkMRMLScalarVolumeNode* obstacles,
+                    vtkIdList* targetEntries)
+{
+  if (!targetEntries)
+    {
+    return -1;
+    }
+  targetEntries->Reset();
+
+  vtkNew<vtkPoints> targetPoints;
+  GetFiducialPositions(targetList, targetPoints.GetPointer());
+  vtkNew<vtkPoints> entryPoints;
+  GetFiducialPositions(entryList, entryPoints.GetPointer());
+
+  vtkNew<vtkSlicerPathPlannerVolumeSampler> obstacleSampler;
+  obstacleSampler->SetVolumeNode(obstacles);
+  this->SharedEntryPlanner->SetTargets(targetPoints.GetPointer());
+  this->SharedEntryPlanner->SetEntries(entryPoints.GetPointer());
+  this->SharedEntryPlanner->SetObstacles(obstacleSampler.GetPointer());
+  int numberOfEntries = this->SharedEntryPlanner->Plan();
+  this->SharedEntryPlanner->GetTargetEntries(targetEntries);
+
+  this->SharedEntryPlanner->SetTargets(NULL);
+  this->SharedEntryPlanner->SetEntries(NULL);
+  this->SharedEntryPlanner->SetObstacles(NULL);
+  return numberOfEntries;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerLogic
+::ComputeSeedDose(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                  vtkMRMLScalarVolumeNode* implantTarget, double metrics[3])
+{
+  metrics[0] = metrics[1] = metrics[2] = 0.0;
+
+  // Reload the target only when it changed, as it recomputes the whole grid
+  if (!IsSamplerCurrent(this->SeedDoseTarget, implantTarget))
+    {
+    this->SeedDoseTarget->SetVolumeNode(implantTarget);
+    }
+  if (!this->SeedDoseTarget->IsValid())
+    {
+    return 0;
+    }
+
+  // Needles keyed by ruler ID: unchanged rulers keep their seeds
+  vtkNew<vtkDoubleArray> segments;
+  vtkNew<vtkCollection> rulers;
+  this->GetTrajectorySegments(trajectoryNode, segments.GetPointer(), rulers.GetPointer());
+  std::set<std::string> rulerIDs;
+  for (int i = 0; i < rulers->GetNumberOfItems(); i++)
+    {
+    vtkMRMLAnnotationRulerNode* ruler =
+      vtkMRMLAnnotationRulerNode::SafeDownCast(rulers->GetItemAsObject(i));
+    if (ruler->GetID())
+      {
+      const double* segment = segments->GetPointer(6 * i);
+      this->SeedDose->SetNeedle(ruler->GetID(), segment, segment + 3);
+      rulerIDs.insert(ruler->GetID());
+      }
+    }
+  for (int i = this->SeedDose->GetNumberOfNeedles() - 1; i >= 0; i--)
+    {
+    const char* needleID = this->SeedDose->GetNthNeedleID(i);
+    if (rulerIDs.find(needleID) == rulerIDs.end())
+      {
+      this->SeedDose->RemoveNeedle(needleID);
+      }
+    }
+  this->SeedDose->Update();
+
+  double prescription = this->SeedDose->GetPrescriptionDose();
+  metrics[0] = this->SeedDose->GetDoseToVolume(0.9);
+  metrics[1] = this->SeedDose->GetVolumeReceivingDose(prescription);
+  metrics[2] = this->SeedDose->GetVolumeReceivingDose(1.5 * prescription);
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerLogic
+::ComputeWorstCaseClearances(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                             vtkCollection* phaseVolumes,
+                             vtkCollection* phaseTransforms)
+{
+  int numberOfVolumes = phaseVolumes ? phaseVolumes->GetNumberOfItems() : 0;
+  int numberOfTransforms = phaseTransforms ? phaseTransforms->GetNumberOfItems() : 0;
+  if (!trajectoryNode || numberOfVolumes == 0 ||
+      (numberOfVolumes > 1 && numberOfTransforms > 1 && numberOfVolumes != numberOfTransforms))
+    {
+    return 0;
+    }
+
+  // One sampler per volume: phases sharing a volume share its distance map.
+  // The samplers are in the volume local RAS, the volume parent transforms
+  // going into the phase matrices, so that moving a volume keeps its map.
+  int numberOfPhases = numberOfVolumes > numberOfTransforms ? numberOfVolumes : numberOfTransforms;
+  std::vector<vtkSmartPointer<vtkSlicerPathPlannerVolumeSampler> > samplers(numberOfVolumes);
+  for (int i = 0; i < numberOfVolumes; i++)
+    {
+    samplers[i] = vtkSmartPointer<vtkSlicerPathPlannerVolumeSampler>::New();
+    vtkMRMLScalarVolumeNode* volumeNode =
+      vtkMRMLScalarVolumeNode::SafeDownCast(phaseVolumes->GetItemAsObject(i));
+    if (volumeNode && volumeNode->GetImageData())
+      {
+      vtkNew<vtkMatrix4x4> rasToIJK;
+      volumeNode->GetRASToIJKMatrix(rasToIJK.GetPointer());
+      samplers[i]->SetImageData(volumeNode->GetImageData(), rasToIJK.GetPointer());
+      }
+    }
+  this->PhaseEvaluator->RemoveAllPhases();
+  for (int i = 0; i < numberOfPhases; i++)
+    {
+    // World planning position -> world phase position (phase transform)
+    // -> phase volume RAS (inverse of the volume parent transforms)
+    vtkMRMLTransformNode* transformNode = i < numberOfTransforms ?
+      vtkMRMLTransformNode::SafeDownCast(phaseTransforms->GetItemAsObject(i)) : NULL;
+    vtkNew<vtkMatrix4x4> planningToWorldPhase;
+    if (transformNode && !transformNode->IsTransformToWorldLinear())
+      {
+      vtkWarningMacro(<< "ComputeWorstCaseClearances: phase " << i
+                      << " transform is not linear, ignored");
+      }
+    else if (transformNode)
+      {
+      transformNode->GetMatrixTransformToWorld(planningToWorldPhase.GetPointer());
+      }
+    int volume = i < numberOfVolumes ? i : 0;
+    vtkMRMLScalarVolumeNode* volumeNode =
+      vtkMRMLScalarVolumeNode::SafeDownCast(phaseVolumes->GetItemAsObject(volume));
+    vtkMRMLTransformNode* volumeTransformNode =
+      volumeNode ? volumeNode->GetParentTransformNode() : NULL;
+    vtkNew<vtkMatrix4x4> volumeToWorld;
+    if (volumeTransformNode && !volumeTransformNode->IsTransformToWorldLinear())
+      {
+      vtkWarningMacro(<< "ComputeWorstCaseClearances: phase volume " << volume
+                      << " transform is not linear, ignored");
+      }
+    else if (volumeTransformNode)
+      {
+      volumeTransformNode->GetMatrixTransformToWorld(volumeToWorld.GetPointer());
+      }
+    vtkNew<vtkMatrix4x4> worldToVolume;
+    vtkMatrix4x4::Invert(volumeToWorld.GetPointer(), worldToVolume.GetPointer());
+    vtkNew<vtkMatrix4x4> planningToPhase;
+    vtkMatrix4x4::Multiply4x4(worldToVolume.GetPointer(), planningToWorldPhase.GetPointer(),
+                              planningToPhase.GetPointer());
+    this->PhaseEvaluator->AddPhase(samplers[volume], planningToPhase.GetPointer());
+    }
+
+  // Trajectories in world coordinates
+  vtkNew<vtkDoubleArray> segments;
+  vtkNew<vtkCollection> rulers;
+  this->GetTrajectorySegments(trajectoryNode, segments.GetPointer(), rulers.GetPointer());
+  for (int i = 0; i < rulers->GetNumberOfItems(); i++)
+    {
+    double* segment = segments->GetPointer(6 * i);
+    this->GetRulerWorldCoordinates(
+      vtkMRMLAnnotationRulerNode::SafeDownCast(rulers->GetItemAsObject(i)),
+      segment, segment + 3);
+    }
+  vtkNew<vtkDoubleArray> clearances;
+  vtkNew<vtkDoubleArray> risks;
+  vtkNew<vtkIntArray> worstPhases;
+  this->PhaseEvaluator->Evaluate(segments.GetPointer(), clearances.GetPointer(),
+                                 risks.GetPointer(), worstPhases.GetPointer());
+  this->PhaseEvaluator->RemoveAllPhases();
+  samplers.clear();
+  this->DistanceMapCache->PruneDistanceMaps();
+
+  for (int i = 0; i < rulers->GetNumberOfItems(); i++)
+    {
+    vtkMRMLAnnotationRulerNode* ruler =
+      vtkMRMLAnnotationRulerNode::SafeDownCast(rulers->GetItemAsObject(i));
+    std::stringstream clearance;
+    clearance << clearances->GetValue(i);
+    ruler->SetAttribute(this->GetWorstCaseClearanceAttributeName(), clearance.str().c_str());
+    std::stringstream risk;
+    risk << risks->GetValue(i);
+    ruler->SetAttribute(this->GetWorstCaseRiskAttributeName(), risk.str().c_str());
+    std::stringstream phase;
+    phase << worstPhases->GetValue(i);
+    ruler->SetAttribute(this->GetWorstCasePhaseAttributeName(), phase.str().c_str());
+    }
+  return numberOfPhases;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerLogic
+::FindTrajectoryConflicts(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                          double distance, vtkCollection* pairs)
+{
+  if (!pairs)
+    {
+    return;
+    }
+  pairs->RemoveAllItems();
+
+  this->UpdateTrajectoryIndex(trajectoryNode);
+  std::map<vtkIdType, vtkMRMLAnnotationRulerNode*>& rulers = this->TrajectoryIndexRulers;
+
+  vtkNew<vtkIdList> ids;
+  this->TrajectoryIndex->FindConflicts(distance, ids.GetPointer());
+  for (vtkIdType i = 0; i + 1 < ids->GetNumberOfIds(); i += 2)
+    {
+    vtkMRMLAnnotationRulerNode* first = rulers[ids->GetId(i)];
+    vtkMRMLAnnotationRulerNode* second = rulers[ids->GetId(i + 1)];
+    if (!SharesFiducial(first, second))
+      {
+      pairs->AddItem(first);
+      pairs->AddItem(second);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerLogic
+::FindConflictingTrajectories(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                              vtkMRMLAnnotationRulerNode* ruler, double distance,
+                              vtkCollection* conflicting)
+{
+  if (!conflicting)
+    {
+    return;
+    }
+  conflicting->RemoveAllItems();
+  if (!ruler || !ruler->GetID())
+    {
+    return;
+    }
+
+  this->UpdateTrajectoryIndex(trajectoryNode);
+  std::map<vtkIdType, vtkMRMLAnnotationRulerNode*>& rulers = this->TrajectoryIndexRulers;
+  std::map<std::string, vtkIdType>::iterator it = this->TrajectoryIndexIDs.find(ruler->GetID());
+  if (it == this->TrajectoryIndexIDs.end())
+    {
+    return;
+    }
+
+  vtkNew<vtkIdList> ids;
+  this->TrajectoryIndex->FindConflicts(it->second, distance, ids.GetPointer());
+  for (vtkIdType i = 0; i < ids->GetNumberOfIds(); i++)
+    {
+    vtkMRMLAnnotationRulerNode* other = rulers[ids->GetId(i)];
+    if (!SharesFiducial(ruler, other))
+      {
+      conflicting->AddItem(other);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLAnnotationRulerNode* vtkSlicerPathPlannerLogic
+::FindClosestTrajectory(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                        const double tip[3], const double direction[3],
+                        double maximumAngle, double* distance)
+{
+  if (distance)
+    {
+    *distance = VTK_DOUBLE_MAX;
+    }
+  if (!tip)
+    {
+    return NULL;
+    }
+
+  this->UpdateTrajectoryIndex(trajectoryNode);
+  vtkIdType id = this->TrajectoryIndex->FindClosestSegment(tip, direction, maximumAngle,
+                                                           distance);
+  std::map<vtkIdType, vtkMRMLAnnotationRulerNode*>::iterator it =
+    this->TrajectoryIndexRulers.find(id);
+  return it != this->TrajectoryIndexRulers.end() ? it->second : NULL;
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkSlicerPathPlannerLogic
+::UpdateTrajectoryArrays(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                         vtkCollection* rulers)
+{
+  vtkNew<vtkCollection> trajectoryRulers;
+  if (!rulers)
+    {
+    rulers = trajectoryRulers.GetPointer();
+    }
+  this->GetTrajectorySegments(trajectoryNode, this->TrajectorySegmentArray, rulers);
+  vtkIdType numberOfRulers = rulers->GetNumberOfItems();
+  this->TrajectoryIDArray->SetNumberOfValues(numberOfRulers);
+  for (vtkIdType i = 0; i < numberOfRulers; i++)
+    {
+    const char* id = vtkMRMLNode::SafeDownCast(rulers->GetItemAsObject(i))->GetID();
+    this->TrajectoryIDArray->SetValue(i, id ? id : "");
+    }
+
+  // Refresh the terms from the ruler attributes, in place
+  for (int n = 0; n < this->TrajectoryScorer->GetNumberOfTerms(); n++)
+    {
+    const char* termName = this->TrajectoryScorer->GetNthTermName(n);
+    vtkDoubleArray* values = this->TrajectoryScorer->GetTermValues(termName);
+    if (!values)
+      {
+      vtkNew<vtkDoubleArray> newValues;
+      this->TrajectoryScorer->SetTermValues(termName, newValues.GetPointer());
+      values = newValues.GetPointer();
+      }
+    values->SetNumberOfComponents(1);
+    values->SetNumberOfTuples(numberOfRulers);
+    for (vtkIdType i = 0; i < numberOfRulers; i++)
+      {
+      const char* value = vtkMRMLNode::SafeDownCast(rulers->GetItemAsObject(i))->GetAttribute(termName);
+      values->SetValue(i, value ? atof(value) : 0.0);
+      }
+    values->Modified();
+    }
+
+  this->TrajectoryScorer->ComputeScores(numberOfRulers, this->TrajectoryScoreArray);
+  this->TrajectoryScoreArray->Modified();
+  this->TrajectorySegmentArray->Modified();
+  this->TrajectoryIDArray->Modified();
+  return numberOfRulers;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerLogic
+::RankTrajectories(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                   vtkCollection* rankedRulers)
+{
+  if (!rankedRulers)
+    {
+    return;
+    }
+  rankedRulers->RemoveAllItems();
+
+  vtkNew<vtkCollection> rulers;
+  this->UpdateTrajectoryArrays(trajectoryNode, rulers.GetPointer());
+
+  vtkNew<vtkIdList> order;
+  vtkSlicerPathPlannerTrajectoryScorer::SelectBest(this->TrajectoryScoreArray, 0, order.GetPointer());
+  for (vtkIdType i = 0; i < order->GetNumberOfIds(); i++)
+    {
+    rankedRulers->AddItem(rulers->GetItemAsObject(order->GetId(i)));
+    }
 }
 
 //---------------------------------------------------------------------------
@@ -59,6 +1603,10 @@ void vtkSlicerPathPlannerLogic::SetMRMLSceneInternal(vtkMRMLScene * newScene)
   events->InsertNextValue(vtkMRMLScene::NodeRemovedEvent);
   events->InsertNextValue(vtkMRMLScene::EndBatchProcessEvent);
   this->SetAndObserveMRMLSceneEventsInternal(newScene, events.GetPointer());
+  this->TrackingLog->SetScene(newScene);
+  this->RemoveTrajectoryIndexObservers();
+  this->TrajectoryIndexRulers.clear();
+  this->TrajectoryIndexModified = 1;
 }
 
 //-----------------------------------------------------------------------------
@@ -80,13 +1628,252 @@ void vtkSlicerPathPlannerLogic::UpdateFromMRMLScene()
 
 //---------------------------------------------------------------------------
 void vtkSlicerPathPlannerLogic
-::OnMRMLSceneNodeAdded(vtkMRMLNode* vtkNotUsed(node))
+::OnMRMLSceneNodeAdded(vtkMRMLNode* node)
 {
+  // A new hierarchy node may put a ruler under the indexed trajectory node
+  if (vtkMRMLAnnotationHierarchyNode::SafeDownCast(node) ||
+      vtkMRMLAnnotationRulerNode::SafeDownCast(node))
+    {
+    this->TrajectoryIndexModified = 1;
+    }
 }
 
 //---------------------------------------------------------------------------
 void vtkSlicerPathPlannerLogic
-::OnMRMLSceneNodeRemoved(vtkMRMLNode* vtkNotUsed(node))
+::OnMRMLSceneNodeRemoved(vtkMRMLNode* node)
 {
+  // The observed node may be deleted once removed, stop observing it now
+  // (the index observes again when it is resynchronized)
+  if (vtkMRMLAnnotationHierarchyNode::SafeDownCast(node) ||
+      vtkMRMLAnnotationRulerNode::SafeDownCast(node))
+    {
+    this->RemoveTrajectoryIndexObservers();
+    this->TrajectoryIndexRulers.clear();
+    this->TrajectoryIndexModified = 1;
+    }
 }
 
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerLogic
+::WarpTrajectories(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                   vtkMRMLTransformNode* deformation)
+{
+  if (!trajectoryNode || !deformation)
+    {
+    return -1;
+    }
+
+  // Results of a previous registration are replaced
+  const std::string suffix(" (warped)");
+  int wasModifying = trajectoryNode->StartModify();
+  for (int i = trajectoryNode->GetNumberOfCurvedPaths() - 1; i >= 0; i--)
+    {
+    std::string name(trajectoryNode->GetNthCurvedPathName(i) ?
+                     trajectoryNode->GetNthCurvedPathName(i) : "");
+    if (name.size() >= suffix.size() &&
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)
+      {
+      trajectoryNode->RemoveNthCurvedPath(i);
+      }
+    }
+
+  vtkNew<vtkDoubleArray> segments;
+  vtkNew<vtkCollection> rulers;
+  this->GetTrajectorySegments(trajectoryNode, segments.GetPointer(), rulers.GetPointer());
+
+  // Vertices of all the curved paths, warped in one batch
+  int numberOfCurvedPaths = trajectoryNode->GetNumberOfCurvedPaths();
+  std::vector<vtkIdType> curvedOffsets(1, 0);
+  vtkNew<vtkDoubleArray> curvedPoints;
+  curvedPoints->SetNumberOfComponents(3);
+  vtkNew<vtkPoints> path;
+  for (int i = 0; i < numberOfCurvedPaths; i++)
+    {
+    trajectoryNode->GetNthCurvedPathPoints(i, path.GetPointer());
+    for (vtkIdType j = 0; j < path->GetNumberOfPoints(); j++)
+      {
+      curvedPoints->InsertNextTuple(path->GetPoint(j));
+      }
+    curvedOffsets.push_back(curvedPoints->GetNumberOfTuples());
+    }
+
+  vtkNew<vtkGeneralTransform> deformationToWorld;
+  deformation->GetTransformToWorld(deformationToWorld.GetPointer());
+  this->TrajectoryWarper->SetTransform(deformationToWorld.GetPointer());
+  vtkNew<vtkDoubleArray> points;
+  vtkNew<vtkIdTypeArray> offsets;
+  int warped = this->TrajectoryWarper->WarpTrajectories(segments.GetPointer(),
+                                                        points.GetPointer(),
+                                                        offsets.GetPointer()) &&
+    this->TrajectoryWarper->WarpPoints(curvedPoints.GetPointer());
+  this->TrajectoryWarper->SetTransform(NULL);
+  if (!warped)
+    {
+    trajectoryNode->EndModify(wasModifying);
+    return -1;
+    }
+
+  int numberOfRulers = rulers->GetNumberOfItems();
+  for (int i = 0; i < numberOfRulers + numberOfCurvedPaths; i++)
+    {
+    std::string name;
+    vtkDoubleArray* warpedPoints = points.GetPointer();
+    vtkIdType begin;
+    vtkIdType end;
+    if (i < numberOfRulers)
+      {
+      vtkMRMLNode* ruler = vtkMRMLNode::SafeDownCast(rulers->GetItemAsObject(i));
+      name = ruler->GetName() ? ruler->GetName() : "";
+      begin = offsets->GetValue(i);
+      end = offsets->GetValue(i + 1);
+      }
+    else
+      {
+      const char* curvedName = trajectoryNode->GetNthCurvedPathName(i - numberOfRulers);
+      name = curvedName ? curvedName : "";
+      warpedPoints = curvedPoints.GetPointer();
+      begin = curvedOffsets[i - numberOfRulers];
+      end = curvedOffsets[i - numberOfRulers + 1];
+      }
+    path->SetNumberOfPoints(end - begin);
+    for (vtkIdType j = begin; j < end; j++)
+      {
+      path->SetPoint(j - begin, warpedPoints->GetPointer(3 * j));
+      }
+    trajectoryNode->AddCurvedPath((name + suffix).c_str(), path.GetPointer());
+    }
+  trajectoryNode->EndModify(wasModifying);
+
+  return numberOfRulers + numberOfCurvedPaths;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerLogic
+::ReplanTrajectories(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                     vtkCollection* structureVolumes,
+                     vtkCollection* rankedRulers)
+{
+  if (!trajectoryNode)
+    {
+    return 0;
+    }
+
+  // The workers only read the snapshot, not the scene
+  vtkNew<vtkCollection> rulers;
+  vtkSlicerPathPlannerPlanSnapshot* snapshot =
+    this->AcquirePlanSnapshot(trajectoryNode, structureVolumes, rulers.GetPointer());
+
+  // The distance maps and the clearances are attached to the label images
+  // of the snapshot, which are only copied again if they changed
+  std::set<std::string> structureIDs;
+  int numberOfVolumes = structureVolumes ? structureVolumes->GetNumberOfItems() : 0;
+  for (int i = 0; i < numberOfVolumes; i++)
+    {
+    vtkMRMLScalarVolumeNode* volume =
+      vtkMRMLScalarVolumeNode::SafeDownCast(structureVolumes->GetItemAsObject(i));
+    vtkSlicerPathPlannerVolumeSampler* sampler =
+      volume ? snapshot->GetVolume(volume->GetID()) : NULL;
+    if (!sampler)
+      {
+      continue;
+      }
+    this->ClearanceCache->SetStructure(volume->GetID(), sampler);
+    structureIDs.insert(volume->GetID());
+    }
+  for (int n = this->ClearanceCache->GetNumberOfStructures() - 1; n >= 0; n--)
+    {
+    const char* name = this->ClearanceCache->GetNthStructureName(n);
+    if (!structureIDs.count(name))
+      {
+      this->ClearanceCache->RemoveStructure(name);
+      }
+    }
+
+  vtkNew<vtkDoubleArray> clearances;
+  vtkNew<vtkDoubleArray> risks;
+  this->ClearanceCache->Evaluate(snapshot->GetSegments(), clearances.GetPointer(),
+                                 risks.GetPointer());
+  this->DistanceMapCache->PruneDistanceMaps();
+  this->PlanSnapshotStore->Release(snapshot);
+
+  for (int i = 0; i < rulers->GetNumberOfItems(); i++)
+    {
+    vtkMRMLNode* ruler = vtkMRMLNode::SafeDownCast(rulers->GetItemAsObject(i));
+    if (this->ClearanceCache->GetNumberOfStructures() == 0)
+      {
+      ruler->RemoveAttribute(this->GetClearanceAttributeName());
+      ruler->RemoveAttribute(this->GetClearanceRiskAttributeName());
+      continue;
+      }
+    SetAttributeValues(ruler, this->GetClearanceAttributeName(),
+                       clearances->GetPointer(i), 1);
+    SetAttributeValues(ruler, this->GetClearanceRiskAttributeName(),
+                       risks->GetPointer(i), 1);
+    }
+
+  if (rankedRulers)
+    {
+    this->RankTrajectories(trajectoryNode, rankedRulers);
+    }
+  return this->ClearanceCache->GetNumberOfStructures();
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerPlanSnapshot* vtkSlicerPathPlannerLogic
+::PublishPlanSnapshot(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                      vtkMRMLAnnotationHierarchyNode* entryList,
+                      vtkMRMLAnnotationHierarchyNode* targetList,
+                      vtkCollection* volumeNodes)
+{
+  vtkNew<vtkSlicerPathPlannerPlanSnapshot> snapshot;
+  snapshot->Capture(this->PlanSnapshotStore->GetCurrent(), trajectoryNode,
+                    entryList, targetList, volumeNodes);
+  this->PlanSnapshotStore->Publish(snapshot.GetPointer());
+  return snapshot.GetPointer();
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerPlanSnapshot* vtkSlicerPathPlannerLogic
+::AcquirePlanSnapshot(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                      vtkCollection* volumeNodes,
+                      vtkCollection* rulers)
+{
+  // Points and volumes of the previous snapshot, if still in the scene
+  vtkSlicerPathPlannerPlanSnapshot* current = this->PlanSnapshotStore->GetCurrent();
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  vtkMRMLAnnotationHierarchyNode* entryList = NULL;
+  vtkMRMLAnnotationHierarchyNode* targetList = NULL;
+  vtkNew<vtkCollection> capturedVolumes;
+  if (current && scene)
+    {
+    if (*current->GetEntryListID())
+      {
+      entryList = vtkMRMLAnnotationHierarchyNode::SafeDownCast(
+        scene->GetNodeByID(current->GetEntryListID()));
+      }
+    if (*current->GetTargetListID())
+      {
+      targetList = vtkMRMLAnnotationHierarchyNode::SafeDownCast(
+        scene->GetNodeByID(current->GetTargetListID()));
+      }
+    for (int i = 0; i < current->GetNumberOfVolumes(); i++)
+      {
+      vtkMRMLNode* volumeNode = scene->GetNodeByID(current->GetNthVolumeID(i));
+      if (volumeNode && !(volumeNodes && volumeNodes->IsItemPresent(volumeNode)))
+        {
+        capturedVolumes->AddItem(volumeNode);
+        }
+      }
+    }
+  for (int i = 0; volumeNodes && i < volumeNodes->GetNumberOfItems(); i++)
+    {
+    capturedVolumes->AddItem(volumeNodes->GetItemAsObject(i));
+    }
+
+  this->PublishPlanSnapshot(trajectoryNode, entryList, targetList, capturedVolumes.GetPointer());
+
+  // Same traversal as the capture, hence the same order
+  vtkNew<vtkDoubleArray> segments;
+  this->GetTrajectorySegments(trajectoryNode, segments.GetPointer(), rulers);
+  return this->PlanSnapshotStore->Acquire();
+}
@@ -36,9 +36,50 @@
 
 // STD includes
 #include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
 
 #include "vtkSlicerPathPlannerModuleLogicExport.h"
 
+class vtkCallbackCommand;
+class vtkCollection;
+class vtkDoubleArray;
+class vtkIdList;
+class vtkMRMLAnnotationHierarchyNode;
+class vtkMRMLAnnotationFiducialNode;
+class vtkMRMLAnnotationRulerNode;
+class vtkMRMLNode;
+class vtkMRMLPathPlannerTrajectoryNode;
+class vtkMRMLScalarVolumeNode;
+class vtkMRMLTransformNode;
+class vtkMRMLVolumeNode;
+class vtkMatrix4x4;
+class vtkSlicerPathPlannerAblationPlanner;
+class vtkSlicerPathPlannerClearanceCache;
+class vtkSlicerPathPlannerDeviationMonitor;
+class vtkSlicerPathPlannerDeflectionPredictor;
+class vtkSlicerPathPlannerDistanceMapCache;
+class vtkSlicerPathPlannerHitProbability;
+class vtkSlicerPathPlannerPhaseEvaluator;
+class vtkSlicerPathPlannerPlanHistory;
+class vtkSlicerPathPlannerPlanJournal;
+class vtkSlicerPathPlannerPlanSnapshot;
+class vtkSlicerPathPlannerPlanSnapshotStore;
+class vtkSlicerPathPlannerPlanSync;
+class vtkSlicerPathPlannerRobustnessAnalyzer;
+class vtkSlicerPathPlannerSeedDose;
+class vtkSlicerPathPlannerSegmentIndex;
+class vtkSlicerPathPlannerSharedEntryPlanner;
+class vtkSlicerPathPlannerSteerablePlanner;
+class vtkSlicerPathPlannerTemplateReachability;
+class vtkSlicerPathPlannerTrackingLog;
+class vtkSlicerPathPlannerVolumeSampler;
+class vtkSlicerPathPlannerTrajectoryScorer;
+class vtkSlicerPathPlannerTrajectoryWarper;
+class vtkSlicerPathPlannerWorkspace;
+class vtkStringArray;
+
 
 /// \ingroup Slicer_QtModules_ExtensionTemplate
 class VTK_SLICER_PATHPLANNER_MODULE_LOGIC_EXPORT vtkSlicerPathPlannerLogic :
@@ -50,6 +91,325 @@ public:
   vtkTypeMacro(vtkSlicerPathPlannerLogic, vtkSlicerModuleLogic);
   void PrintSelf(ostream& os, vtkIndent indent);
 
+  /// Fill "segments" with one 6-component tuple (entry RAS, target RAS) per
+  /// ruler of the trajectory node and, if not NULL, "rulers" with the
+  /// matching vtkMRMLAnnotationRulerNode in the same order.
+  static void GetTrajectorySegments(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                                    vtkDoubleArray* segments,
+                                    vtkCollection* rulers);
+
+  /// Monte Carlo analysis of every trajectory of the node against the
+  /// critical structures label map (may be NULL). The success probability
+  /// is stored in the SuccessProbabilityAttributeName attribute of each
+  /// ruler. Parameters are set on the RobustnessAnalyzer.
+  void ComputeSuccessProbabilities(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                                   vtkMRMLScalarVolumeNode* criticalStructures);
+  vtkGetObjectMacro(RobustnessAnalyzer, vtkSlicerPathPlannerRobustnessAnalyzer);
+
+  /// Ruler attribute holding the probability of success, in [0, 1]
+  static const char* GetSuccessProbabilityAttributeName();
+
+  /// Ruler attributes holding the IDs of the entry and target fiducials
+  /// the trajectory was created from.
+  static const char* GetEntryPointIDAttributeName();
+  static const char* GetTargetPointIDAttributeName();
+
+  /// Target fiducial of a ruler, NULL if unknown.
+  static vtkMRMLAnnotationFiducialNode* GetTargetPoint(vtkMRMLAnnotationRulerNode* ruler);
+
+  /// Position of a fiducial in world (RAS) coordinates, i.e. its local
+  /// coordinates mapped through the linear or nonlinear transforms of its
+  /// parent chain.
+  static void GetFiducialWorldCoordinates(vtkMRMLAnnotationFiducialNode* fiducial,
+                                          double world[3]);
+
+  /// Move a fiducial to a world (RAS) position, i.e. set its local
+  /// coordinates through the inverse transforms of its parent chain.
+  static void SetFiducialWorldCoordinates(vtkMRMLAnnotationFiducialNode* fiducial,
+                                          const double world[3]);
+
+  /// Entry (Position1) and target (Position2) of a ruler in world
+  /// coordinates, through the transforms of its parent chain. Return 0 if
+  /// the ruler has no positions.
+  static int GetRulerWorldCoordinates(vtkMRMLAnnotationRulerNode* ruler,
+                                      double entry[3], double target[3]);
+
+  /// Matrix from world (RAS) coordinates to the IJK indices of a volume,
+  /// through the transforms of its parent chain. Return 0 if a parent
+  /// transform is not linear; "worldToIJK" is then the volume's own RAS
+  /// to IJK matrix.
+  static int GetWorldToIJKMatrix(vtkMRMLVolumeNode* volumeNode, vtkMatrix4x4* worldToIJK);
+
+  /// Positional covariance (mm^2, row-major 3x3 matrix) of a target
+  /// fiducial, kept in its TargetCovarianceAttributeName attribute.
+  /// GetTargetCovariance returns 0 and a null matrix if none is set.
+  static void SetTargetCovariance(vtkMRMLAnnotationFiducialNode* target,
+                                  const double covariance[9]);
+  static int GetTargetCovariance(vtkMRMLAnnotationFiducialNode* target,
+                                 double covariance[9]);
+  static const char* GetTargetCovarianceAttributeName();
+
+  /// Probability that each trajectory passes within HitProbability radius
+  /// of its uncertain target, stored in the HitProbabilityAttributeName
+  /// attribute of each ruler. Targets without covariance are exact.
+  void ComputeHitProbabilities(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode);
+  vtkGetObjectMacro(HitProbability, vtkSlicerPathPlannerHitProbability);
+
+  /// Ruler attribute holding the hit probability, in [0, 1]
+  static const char* GetHitProbabilityAttributeName();
+
+  /// Sort the rulers of the trajectory node by decreasing score. Scores are
+  /// computed by the TrajectoryScorer, each term taking its values from the
+  /// ruler attribute of the same name (0 when missing). The hit and success
+  /// probabilities are registered with a weight of 1.
+  void RankTrajectories(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                        vtkCollection* rankedRulers);
+  vtkGetObjectMacro(TrajectoryScorer, vtkSlicerPathPlannerTrajectoryScorer);
+
+  /// Refresh the trajectory arrays from the rulers of the node, in the
+  /// order of GetTrajectorySegments, and the scorer terms and scores as
+  /// RankTrajectories does, without sorting. "rulers", if not NULL,
+  /// receives the matching rulers. Return the number of trajectories.
+  vtkIdType UpdateTrajectoryArrays(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                                   vtkCollection* rulers = NULL);
+
+  /// Trajectory arrays, also refreshed by RankTrajectories: segments (6 components: entry RAS, target RAS),
+  /// ruler IDs and scores. Like the term values of the TrajectoryScorer,
+  /// they are filled in place and only reallocated when the number of
+  /// trajectories grows, so that Python can view them as NumPy arrays
+  /// (vtk.util.numpy_support.vtk_to_numpy) without copy. Views taken
+  /// before the number of trajectories grew must be taken again.
+  vtkGetObjectMacro(TrajectorySegmentArray, vtkDoubleArray);
+  vtkGetObjectMacro(TrajectoryIDArray, vtkStringArray);
+  vtkGetObjectMacro(TrajectoryScoreArray, vtkDoubleArray);
+
+  /// Predict the path of a bevel-tip needle inserted along every trajectory
+  /// of the node, the tissue stiffness being read from "stiffness" (may be
+  /// NULL). The bevel roll (degrees) is read from the BevelAngleAttributeName
+  /// attribute of each ruler (0 if missing). The straight segment tangent to
+  /// the path at the predicted tip and the tip to target distance are
+  /// stored in the PredictedTipSegmentAttributeName and
+  /// PredictedDeviationAttributeName attributes. "paths", if not NULL,
+  /// receives the predicted polylines (see vtkSlicerPathPlannerDeflectionPredictor).
+  void PredictNeedlePaths(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                          vtkMRMLScalarVolumeNode* stiffness,
+                          vtkDoubleArray* paths);
+  vtkGetObjectMacro(DeflectionPredictor, vtkSlicerPathPlannerDeflectionPredictor);
+
+  static const char* GetBevelAngleAttributeName();
+  static const char* GetPredictedTipSegmentAttributeName();
+  static const char* GetPredictedDeviationAttributeName();
+
+  /// Ruler attribute holding the points of the predicted path
+  static const char* GetPredictedPathAttributeName();
+
+  /// Ruler attribute identifying the stiffness volume, and its
+  /// modification time, a prediction was made with. Predictions made
+  /// before the volume changed are ignored.
+  static const char* GetPredictionStiffnessAttributeName();
+
+  /// When on, hit and success probabilities are computed for the predicted
+  /// needle paths of the rulers that have one instead of the straight
+  /// rulers: hits with the line tangent to the path at the predicted tip,
+  /// critical structures along the predicted path. Default is off.
+  vtkSetMacro(UsePredictedPaths, int);
+  vtkGetMacro(UsePredictedPaths, int);
+  vtkBooleanMacro(UsePredictedPaths, int);
+
+  /// Plan a curvature-constrained path from the entry to the target
+  /// fiducial around the non zero voxels of "obstacles" (may be NULL) with
+  /// the SteerablePlanner, and store it as a curved path of the trajectory
+  /// node. Return the index of the new curved path, -1 if no path was found.
+  int PlanSteerablePath(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                        vtkMRMLAnnotationFiducialNode* entryPoint,
+                        vtkMRMLAnnotationFiducialNode* targetPoint,
+                        vtkMRMLScalarVolumeNode* obstacles);
+  vtkGetObjectMacro(SteerablePlanner, vtkSlicerPathPlannerSteerablePlanner);
+
+  /// Synchronize the template lookup table with the fiducials of the
+  /// target list and the critical structures (may be NULL), then rebuild
+  /// the rows of the targets that moved. The template and its pose are set
+  /// on TemplateReachability->GetTemplate().
+  void UpdateTemplateReachability(vtkMRMLAnnotationHierarchyNode* targetList,
+                                  vtkMRMLScalarVolumeNode* criticalStructures);
+  vtkGetObjectMacro(TemplateReachability, vtkSlicerPathPlannerTemplateReachability);
+
+  /// Template holes reaching the target without crossing the critical
+  /// structures, best first, and the matching insertion depths (may be
+  /// NULL). The target is added to the table, or its row rebuilt if it
+  /// moved, first. Return the number of holes, -1 if the target is NULL or
+  /// has no ID.
+  int GetTemplateHolesReachingTarget(vtkMRMLAnnotationFiducialNode* target,
+                                     vtkIdList* holes, vtkDoubleArray* depths);
+
+  /// Check every trajectory of the node against the precomputed workspace
+  /// of the needle guide robot and store 1 (reachable) or 0 in the
+  /// RobotWorkspaceReachableAttributeName attribute of each ruler. The robot, its
+  /// pose and the cache directory are set on RobotWorkspace, which is
+  /// loaded or computed when its parameters changed. Return 0 on failure.
+  int ComputeRobotReachability(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode);
+  vtkGetObjectMacro(RobotWorkspace, vtkSlicerPathPlannerWorkspace);
+
+  /// Exact robot check of every trajectory of the node, solved in one
+  /// batch by RobotWorkspace->GetKinematics(). The joint values are stored
+  /// in the RobotJointsAttributeName attribute of each ruler and the
+  /// RobotIKReachableAttributeName attribute is set to 1 only if all joints
+  /// are within their limits and the needle clears the scanner bore.
+  void SolveRobotInverseKinematics(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode);
+
+  /// Ruler attributes holding the robot reachability, 0 or 1: the binned
+  /// workspace lookup of ComputeRobotReachability, which is approximate,
+  /// and the exact check of SolveRobotInverseKinematics. The trajectory
+  /// scorer term (weight 0 by default) is the exact one.
+  static const char* GetRobotWorkspaceReachableAttributeName();
+  static const char* GetRobotIKReachableAttributeName();
+
+  /// Ruler attribute holding the X, Y, Pitch, Yaw and Depth joint values
+  static const char* GetRobotJointsAttributeName();
+
+  /// Pairs of trajectories of the node passing closer than "distance"
+  /// (mm), added to "pairs" as consecutive rulers. Trajectories sharing
+  /// their entry or target fiducial are alternatives, not simultaneous
+  /// needles, and are not reported. The segments are kept in
+  /// TrajectoryIndex, which is only resynchronized with the scene after a
+  /// ruler, a hierarchy or the trajectory node changed.
+  void FindTrajectoryConflicts(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                               double distance, vtkCollection* pairs);
+
+  /// Trajectories of the node passing closer than "distance" (mm) to
+  /// "ruler", e.g. after one of its fiducials moved.
+  void FindConflictingTrajectories(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                                   vtkMRMLAnnotationRulerNode* ruler, double distance,
+                                   vtkCollection* conflicting);
+  vtkGetObjectMacro(TrajectoryIndex, vtkSlicerPathPlannerSegmentIndex);
+
+  /// Trajectory of the node closest to a tracked needle tip, i.e. the one
+  /// being followed, among those within "maximumAngle" degrees of the
+  /// needle direction (any trajectory if "direction" is NULL). "distance"
+  /// receives the distance from the tip when not NULL. Return NULL if no
+  /// trajectory qualifies.
+  vtkMRMLAnnotationRulerNode* FindClosestTrajectory(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                                                    const double tip[3], const double direction[3],
+                                                    double maximumAngle, double* distance = NULL);
+
+  /// Select the probes, going from the fiducials of "entryList" to the
+  /// tumor, whose ablation zones cover the tumor plus margin with the
+  /// fewest probes and the least risk to the critical structures (may be
+  /// NULL). "probes" receives one 6-component tuple (entry RAS, tip RAS)
+  /// per selected probe. Zone model and stopping criteria are set on the
+  /// AblationPlanner. Return the number of probes, -1 on error.
+  int PlanAblation(vtkMRMLAnnotationHierarchyNode* entryList,
+                   vtkMRMLScalarVolumeNode* tumor,
+                   vtkMRMLScalarVolumeNode* criticalStructures,
+                   vtkDoubleArray* probes);
+  vtkGetObjectMacro(AblationPlanner, vtkSlicerPathPlannerAblationPlanner);
+
+  /// Select the fewest fiducials of "entryList" from which every fiducial
+  /// of "targetList" can be reached without crossing the non zero voxels
+  /// of "obstacles" (may be NULL). "targetEntries" receives, for every
+  /// target, the index of its entry among the fiducials of "entryList", or
+  /// -1 when it cannot be reached. Angulation and depth limits are set on
+  /// the SharedEntryPlanner. Return the number of entries, -1 on error.
+  int PlanSharedEntries(vtkMRMLAnnotationHierarchyNode* targetList,
+                        vtkMRMLAnnotationHierarchyNode* entryList,
+                        vtkMRMLScalarVolumeNode* obstacles,
+                        vtkIdList* targetEntries);
+  vtkGetObjectMacro(SharedEntryPlanner, vtkSlicerPathPlannerSharedEntryPlanner);
+
+  /// LDR seed dose of the trajectories of the node, the seeds being loaded
+  /// where the needles cross "implantTarget". Only the needles that moved
+  /// since the last call are recomputed. "metrics" receives D90 (Gy) and
+  /// the fractions of the target receiving 100 % and 150 % of the
+  /// SeedDose prescription. Return 0 if there is no target.
+  int ComputeSeedDose(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                      vtkMRMLScalarVolumeNode* implantTarget, double metrics[3]);
+  vtkGetObjectMacro(SeedDose, vtkSlicerPathPlannerSeedDose);
+
+  /// Worst case of every trajectory of the node over the respiratory
+  /// phases. Phase i uses the i-th volume of "phaseVolumes" (or the only
+  /// one) as critical structures and the i-th transform node of
+  /// "phaseTransforms" (or none) to map the planning space to the phase,
+  /// both in world coordinates: the parent transforms of the rulers and of
+  /// the phase volumes are taken into account.
+  /// The smallest clearance (mm), the matching risk and the phase index
+  /// are stored in the WorstCase attributes of each ruler. Distance maps
+  /// are kept in DistanceMapCache between calls. Return the number of
+  /// phases.
+  int ComputeWorstCaseClearances(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                                 vtkCollection* phaseVolumes,
+                                 vtkCollection* phaseTransforms);
+  vtkGetObjectMacro(PhaseEvaluator, vtkSlicerPathPlannerPhaseEvaluator);
+  vtkGetObjectMacro(DistanceMapCache, vtkSlicerPathPlannerDistanceMapCache);
+
+  /// Ruler attributes holding the worst case clearance (mm), risk in
+  /// [0, 1] and phase index
+  static const char* GetWorstCaseClearanceAttributeName();
+  static const char* GetWorstCaseRiskAttributeName();
+  static const char* GetWorstCasePhaseAttributeName();
+
+  /// Warp every trajectory of trajectoryNode through "deformation" to
+  /// world, e.g. the deformable registration of an intra-procedural image
+  /// to the planning image. Rulers are sampled every TrajectoryWarper
+  /// SampleStep mm and the vertices of curved paths are warped as they
+  /// are. Each trajectory gets a curved path named "<name> (warped)",
+  /// replacing the previous one. Return the number of warped trajectories,
+  /// -1 on error.
+  int WarpTrajectories(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                       vtkMRMLTransformNode* deformation);
+  vtkGetObjectMacro(TrajectoryWarper, vtkSlicerPathPlannerTrajectoryWarper);
+
+  /// Re-evaluate every trajectory of the node against the critical
+  /// structures, one label map volume per structure (e.g. segmented from a
+  /// new intra-procedural image), then rank them as RankTrajectories does.
+  /// Structures are identified by volume node ID across calls: distance
+  /// maps and clearances are only recomputed for the structures whose
+  /// label map changed and for the trajectories that moved. The smallest
+  /// clearance and its risk are stored in the Clearance attributes of
+  /// each ruler; the risk is a scorer term of weight -1. Return the number
+  /// of structures.
+  int ReplanTrajectories(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                         vtkCollection* structureVolumes,
+                         vtkCollection* rankedRulers);
+  vtkGetObjectMacro(ClearanceCache, vtkSlicerPathPlannerClearanceCache);
+
+  /// Ruler attributes holding the clearance to the closest structure (mm)
+  /// and its risk in [0, 1]
+  static const char* GetClearanceAttributeName();
+  static const char* GetClearanceRiskAttributeName();
+
+  /// Deviation of a tracked needle from the planned trajectory, computed
+  /// from a live pose stream. The monitor is stopped with the logic.
+  vtkGetObjectMacro(DeviationMonitor, vtkSlicerPathPlannerDeviationMonitor);
+
+  /// Records tracking sessions (poses and fiducial moves) and replays them
+  /// against the DeviationMonitor and the scene.
+  vtkGetObjectMacro(TrackingLog, vtkSlicerPathPlannerTrackingLog);
+
+  /// Sends the changes of the plan to another workstation, or applies the
+  /// changes received from it.
+  vtkGetObjectMacro(PlanSync, vtkSlicerPathPlannerPlanSync);
+
+  /// Saves the edits of the plan in the background for crash recovery.
+  /// The journal is closed with the logic.
+  vtkGetObjectMacro(PlanJournal, vtkSlicerPathPlannerPlanJournal);
+
+  /// Undo and redo of the edits of the plan.
+  vtkGetObjectMacro(PlanHistory, vtkSlicerPathPlannerPlanHistory);
+
+  /// Capture the plan (trajectories, entry and target points, and the
+  /// volumes of "volumeNodes", which may be NULL) and publish it in the
+  /// PlanSnapshotStore, where background workers can read it while the
+  /// scene is edited. Unchanged parts are shared with the previous
+  /// snapshot. Return the published snapshot. Main thread only. The
+  /// parallel evaluations (ComputeSuccessProbabilities,
+  /// ComputeHitProbabilities and ReplanTrajectories) publish the current
+  /// trajectories the same way and only read the snapshot.
+  vtkSlicerPathPlannerPlanSnapshot* PublishPlanSnapshot(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                                                        vtkMRMLAnnotationHierarchyNode* entryList,
+                                                        vtkMRMLAnnotationHierarchyNode* targetList,
+                                                        vtkCollection* volumeNodes);
+  vtkGetObjectMacro(PlanSnapshotStore, vtkSlicerPathPlannerPlanSnapshotStore);
+
 protected:
   vtkSlicerPathPlannerLogic();
   virtual ~vtkSlicerPathPlannerLogic();
@@ -60,6 +420,87 @@ protected:
   virtual void UpdateFromMRMLScene();
   virtual void OnMRMLSceneNodeAdded(vtkMRMLNode* node);
   virtual void OnMRMLSceneNodeRemoved(vtkMRMLNode* node);
+
+  /// Predicted tip segments of the rulers, or the rulers themselves when
+  /// not predicted or predicted before their stiffness volume changed.
+  /// Return 0 if no ruler has a prediction.
+  static int GetPredictedTipSegments(vtkCollection* rulers, vtkDoubleArray* segments,
+                                     vtkDoubleArray* tipSegments);
+
+  /// Same for the predicted paths: one tuple of 3-component points per
+  /// ruler, resampled to the largest number of points.
+  static int GetPredictedPaths(vtkCollection* rulers, vtkDoubleArray* segments,
+                               vtkDoubleArray* paths);
+
+  /// Publish the current trajectories of the node and the volumes of
+  /// "volumeNodes" (may be NULL), keeping the points and volumes of the
+  /// previous snapshot, and acquire the new snapshot. "rulers" receives
+  /// the rulers in the order of its segments. Release the snapshot with
+  /// PlanSnapshotStore once the workers are done.
+  vtkSlicerPathPlannerPlanSnapshot* AcquirePlanSnapshot(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                                                        vtkCollection* volumeNodes,
+                                                        vtkCollection* rulers);
+
+  /// Synchronize TrajectoryIndex and TrajectoryIndexRulers with the
+  /// rulers of the node if it is not the indexed one or if
+  /// TrajectoryIndexModified is set. Otherwise the scene is not walked.
+  void UpdateTrajectoryIndex(vtkMRMLPathPlannerTrajectoryNode* trajectoryNode);
+
+  /// Stop observing the nodes of the indexed trajectory node
+  void RemoveTrajectoryIndexObservers();
+
+  /// Set TrajectoryIndexModified when an observed node is modified
+  static void TrajectoryIndexModifiedCallback(vtkObject* caller, unsigned long eid,
+                                              void* clientData, void* callData);
+
+  vtkSlicerPathPlannerRobustnessAnalyzer* RobustnessAnalyzer;
+  vtkSlicerPathPlannerHitProbability* HitProbability;
+  vtkSlicerPathPlannerTrajectoryScorer* TrajectoryScorer;
+  vtkDoubleArray* TrajectorySegmentArray;
+  vtkStringArray* TrajectoryIDArray;
+  vtkDoubleArray* TrajectoryScoreArray;
+  vtkSlicerPathPlannerDeflectionPredictor* DeflectionPredictor;
+  vtkSlicerPathPlannerSteerablePlanner* SteerablePlanner;
+  vtkSlicerPathPlannerTemplateReachability* TemplateReachability;
+  vtkSlicerPathPlannerVolumeSampler* TemplateCriticalStructures;
+  vtkSlicerPathPlannerWorkspace* RobotWorkspace;
+  vtkSlicerPathPlannerSegmentIndex* TrajectoryIndex;
+  vtkSlicerPathPlannerAblationPlanner* AblationPlanner;
+  vtkSlicerPathPlannerSharedEntryPlanner* SharedEntryPlanner;
+  vtkSlicerPathPlannerSeedDose* SeedDose;
+  vtkSlicerPathPlannerVolumeSampler* SeedDoseTarget;
+  vtkSlicerPathPlannerDistanceMapCache* DistanceMapCache;
+  vtkSlicerPathPlannerPhaseEvaluator* PhaseEvaluator;
+  vtkSlicerPathPlannerTrajectoryWarper* TrajectoryWarper;
+  vtkSlicerPathPlannerClearanceCache* ClearanceCache;
+  vtkSlicerPathPlannerDeviationMonitor* DeviationMonitor;
+  vtkSlicerPathPlannerTrackingLog* TrackingLog;
+  vtkSlicerPathPlannerPlanSync* PlanSync;
+  vtkSlicerPathPlannerPlanJournal* PlanJournal;
+  vtkSlicerPathPlannerPlanHistory* PlanHistory;
+  vtkSlicerPathPlannerPlanSnapshotStore* PlanSnapshotStore;
+
+  //BTX
+  // Segment ids of the indexed rulers, by ruler ID, and the rulers by
+  // segment id
+  std::string TrajectoryIndexNodeID;
+  std::map<std::string, vtkIdType> TrajectoryIndexIDs;
+  std::map<vtkIdType, vtkMRMLAnnotationRulerNode*> TrajectoryIndexRulers;
+  vtkIdType NextTrajectoryIndexID;
+  int TrajectoryIndexModified;
+
+  // Trajectory, hierarchy and ruler nodes whose modifications invalidate
+  // the index
+  struct ObservedIndexNode
+    {
+    vtkMRMLNode* Node;
+    unsigned long Tag;
+    };
+  std::vector<ObservedIndexNode> TrajectoryIndexObservers;
+  vtkCallbackCommand* TrajectoryIndexCallback;
+  //ETX
+  int UsePredictedPaths;
+
 private:
 
   vtkSlicerPathPlannerLogic(const vtkSlicerPathPlannerLogic&); // Not implemented
@@ -0,0 +1,123 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// .NAME vtkSlicerPathPlannerParallel - parallel loop helper for the planner kernels
+// .SECTION Description
+// vtkSlicerPathPlannerParallelFor splits [begin, end) in chunks of "grain"
+// items and runs them on the threads of a vtkMultiThreader. The functor is
+// called as functor(chunkBegin, chunkEnd, threadId) where threadId is lower
+// than vtkSlicerPathPlannerNumberOfThreads(), so per-thread scratch buffers
+// can be indexed by it. Chunks are dealt round-robin: which thread runs a
+// chunk never depends on timing.
+
+#ifndef __vtkSlicerPathPlannerParallel_h
+#define __vtkSlicerPathPlannerParallel_h
+
+// VTK includes
+#include <vtkMultiThreader.h>
+#include <vtkNew.h>
+
+//BTX
+//----------------------------------------------------------------------------
+inline int vtkSlicerPathPlannerNumberOfThreads()
+{
+  int numberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+  return numberOfThreads > 0 ? numberOfThreads : 1;
+}
+
+//----------------------------------------------------------------------------
+template <class TFunctor>
+struct vtkSlicerPathPlannerParallelForData
+{
+  TFunctor* Functor;
+  vtkIdType Begin;
+  vtkIdType End;
+  vtkIdType Grain;
+};
+
+//----------------------------------------------------------------------------
+template <class TFunctor>
+VTK_THREAD_RETURN_TYPE vtkSlicerPathPlannerParallelForExecute(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* info =
+    static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  vtkSlicerPathPlannerParallelForData<TFunctor>* data =
+    static_cast<vtkSlicerPathPlannerParallelForData<TFunctor>*>(info->UserData);
+
+  vtkIdType stride = data->Grain * info->NumberOfThreads;
+  for (vtkIdType chunkBegin = data->Begin + info->ThreadID * data->Grain;
+       chunkBegin < data->End; chunkBegin += stride)
+    {
+    vtkIdType chunkEnd = chunkBegin + data->Grain;
+    if (chunkEnd > data->End)
+      {
+      chunkEnd = data->End;
+      }
+    (*data->Functor)(chunkBegin, chunkEnd, info->ThreadID);
+    }
+
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+template <class TFunctor>
+void vtkSlicerPathPlannerParallelFor(vtkIdType begin, vtkIdType end,
+                                     vtkIdType grain, TFunctor& functor)
+{
+  if (end <= begin)
+    {
+    return;
+    }
+
+  int numberOfThreads = vtkSlicerPathPlannerNumberOfThreads();
+  if (grain <= 0)
+    {
+    // Default: about 8 chunks per thread to even out the load
+    grain = (end - begin) / (8 * numberOfThreads);
+    grain = grain > 0 ? grain : 1;
+    }
+
+  vtkIdType numberOfChunks = (end - begin + grain - 1) / grain;
+  if (numberOfThreads == 1 || numberOfChunks == 1)
+    {
+    functor(begin, end, 0);
+    return;
+    }
+  if (numberOfChunks < numberOfThreads)
+    {
+    numberOfThreads = static_cast<int>(numberOfChunks);
+    }
+
+  vtkSlicerPathPlannerParallelForData<TFunctor> data;
+  data.Functor = &functor;
+  data.Begin = begin;
+  data.End = end;
+  data.Grain = grain;
+
+  vtkNew<vtkMultiThreader> threader;
+  threader->SetNumberOfThreads(numberOfThreads);
+  threader->SetSingleMethod(vtkSlicerPathPlannerParallelForExecute<TFunctor>, &data);
+  threader->SingleMethodExecute();
+}
+//ETX
+
+#endif
@@ -0,0 +1,241 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerDistanceMapCache.h"
+#include "vtkSlicerPathPlannerParallel.h"
+#include "vtkSlicerPathPlannerPhaseEvaluator.h"
+#include "vtkSlicerPathPlannerVolumeSampler.h"
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkIntArray.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <algorithm>
+
+namespace
+{
+//----------------------------------------------------------------------------
+// Clearance of every trajectory x phase pair, phases varying fastest
+struct ClearanceFunctor
+{
+  const double* Segments;
+  int NumberOfPhases;
+  const vtkSlicerPathPlannerVolumeSampler* const* DistanceMaps;
+  // Row-major 3x4 planning to phase matrices
+  const double* Transforms;
+  double SampleStep;
+  double* Clearances;
+
+  void operator()(vtkIdType begin, vtkIdType end, int vtkNotUsed(threadId))
+  {
+    for (vtkIdType pair = begin; pair < end; pair++)
+      {
+      vtkIdType trajectory = pair / this->NumberOfPhases;
+      int phase = static_cast<int>(pair % this->NumberOfPhases);
+      const vtkSlicerPathPlannerVolumeSampler* distances = this->DistanceMaps[phase];
+      if (!distances)
+        {
+        this->Clearances[pair] = VTK_DOUBLE_MAX;
+        continue;
+        }
+      const double* transform = this->Transforms + 12 * phase;
+      const double* segment = this->Segments + 6 * trajectory;
+      double points[6];
+      for (int p = 0; p < 2; p++)
+        {
+        for (int i = 0; i < 3; i++)
+          {
+          points[3 * p + i] = transform[4 * i] * segment[3 * p] +
+            transform[4 * i + 1] * segment[3 * p + 1] +
+            transform[4 * i + 2] * segment[3 * p + 2] + transform[4 * i + 3];
+          }
+        }
+      this->Clearances[pair] = distances->GetMinimumAlongSegment(points, points + 3,
+                                                                 this->SampleStep);
+      }
+  }
+};
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerPathPlannerPhaseEvaluator);
+
+//----------------------------------------------------------------------------
+vtkCxxSetObjectMacro(vtkSlicerPathPlannerPhaseEvaluator, DistanceMapCache,
+                     vtkSlicerPathPlannerDistanceMapCache);
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerPhaseEvaluator::vtkSlicerPathPlannerPhaseEvaluator()
+{
+  this->DistanceMapCache = vtkSlicerPathPlannerDistanceMapCache::New();
+  this->SampleStep = 1.0;
+  this->SafetyMargin = 5.0;
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerPhaseEvaluator::~vtkSlicerPathPlannerPhaseEvaluator()
+{
+  this->SetDistanceMapCache(NULL);
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerPhaseEvaluator::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfPhases: " << this->Phases.size() << "\n";
+  os << indent << "DistanceMapCache: " << this->DistanceMapCache << "\n";
+  os << indent << "SampleStep: " << this->SampleStep << "\n";
+  os << indent << "SafetyMargin: " << this->SafetyMargin << "\n";
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPhaseEvaluator::AddPhase(vtkSlicerPathPlannerVolumeSampler* structures,
+                                                 vtkMatrix4x4* planningToPhase)
+{
+  Phase phase;
+  phase.Structures = structures;
+  for (int i = 0; i < 3; i++)
+    {
+    for (int j = 0; j < 4; j++)
+      {
+      phase.PlanningToPhase[i][j] = planningToPhase ?
+        planningToPhase->GetElement(i, j) : (i == j ? 1.0 : 0.0);
+      }
+    }
+  this->Phases.push_back(phase);
+  this->Modified();
+  return static_cast<int>(this->Phases.size()) - 1;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerPhaseEvaluator::RemoveAllPhases()
+{
+  this->Phases.clear();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPhaseEvaluator::GetNumberOfPhases()
+{
+  return static_cast<int>(this->Phases.size());
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerPhaseEvaluator::Evaluate(vtkDoubleArray* segments,
+                                                  vtkDoubleArray* clearances,
+                                                  vtkDoubleArray* risks,
+                                                  vtkIntArray* worstPhases,
+                                                  vtkDoubleArray* phaseClearances)
+{
+  if (!segments || !clearances || !risks || segments->GetNumberOfComponents() != 6)
+    {
+    vtkErrorMacro(<< "Evaluate: invalid input arrays");
+    return;
+    }
+  if (!this->DistanceMapCache)
+    {
+    vtkErrorMacro(<< "Evaluate: no distance map cache");
+    return;
+    }
+
+  vtkIdType numberOfTrajectories = segments->GetNumberOfTuples();
+  int numberOfPhases = static_cast<int>(this->Phases.size());
+  clearances->SetNumberOfComponents(1);
+  clearances->SetNumberOfTuples(numberOfTrajectories);
+  risks->SetNumberOfComponents(1);
+  risks->SetNumberOfTuples(numberOfTrajectories);
+  if (worstPhases)
+    {
+    worstPhases->SetNumberOfComponents(1);
+    worstPhases->SetNumberOfTuples(numberOfTrajectories);
+    }
+
+  // Distance maps are fetched before the threads start: the cache is not
+  // thread safe, the samplers are
+  std::vector<const vtkSlicerPathPlannerVolumeSampler*> distanceMaps(numberOfPhases + 1, NULL);
+  std::vector<double> transforms(12 * numberOfPhases + 1);
+  for (int p = 0; p < numberOfPhases; p++)
+    {
+    distanceMaps[p] = this->DistanceMapCache->GetDistanceMap(this->Phases[p].Structures);
+    const double* matrix = &this->Phases[p].PlanningToPhase[0][0];
+    std::copy(matrix, matrix + 12, transforms.begin() + 12 * p);
+    }
+
+  std::vector<double> pairClearances(
+    static_cast<size_t>(numberOfTrajectories) * numberOfPhases + 1);
+  if (numberOfTrajectories > 0 && numberOfPhases > 0)
+    {
+    ClearanceFunctor functor;
+    functor.Segments = segments->GetPointer(0);
+    functor.NumberOfPhases = numberOfPhases;
+    functor.DistanceMaps = &distanceMaps[0];
+    functor.Transforms = &transforms[0];
+    functor.SampleStep = this->SampleStep;
+    functor.Clearances = &pairClearances[0];
+    vtkSlicerPathPlannerParallelFor(0, numberOfTrajectories * numberOfPhases, 16, functor);
+    }
+
+  if (phaseClearances)
+    {
+    phaseClearances->SetNumberOfComponents(numberOfPhases > 0 ? numberOfPhases : 1);
+    phaseClearances->SetNumberOfTuples(numberOfPhases > 0 ? numberOfTrajectories : 0);
+    if (numberOfPhases > 0)
+      {
+      std::copy(pairClearances.begin(), pairClearances.end() - 1,
+                phaseClearances->GetPointer(0));
+      }
+    }
+
+  for (vtkIdType t = 0; t < numberOfTrajectories; t++)
+    {
+    double clearance = VTK_DOUBLE_MAX;
+    int worstPhase = -1;
+    for (int p = 0; p < numberOfPhases; p++)
+      {
+      if (pairClearances[t * numberOfPhases + p] < clearance)
+        {
+        clearance = pairClearances[t * numberOfPhases + p];
+        worstPhase = p;
+        }
+      }
+    double risk = 0.0;
+    if (clearance <= 0.0)
+      {
+      risk = 1.0;
+      }
+    else if (clearance < this->SafetyMargin)
+      {
+      risk = 1.0 - clearance / this->SafetyMargin;
+      }
+    clearances->SetValue(t, clearance);
+    risks->SetValue(t, risk);
+    if (worstPhases)
+      {
+      worstPhases->SetValue(t, worstPhase);
+      }
+    }
+}
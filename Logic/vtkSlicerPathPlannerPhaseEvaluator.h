@@ -0,0 +1,116 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// .NAME vtkSlicerPathPlannerPhaseEvaluator - worst case clearance over respiratory phases
+// .SECTION Description
+// A phase is a label map of the critical structures and an optional
+// linear transform mapping the planning RAS space to the phase RAS space.
+// Phases may have their own label maps (phase volumes), share one label
+// map with different transforms (phase transforms), or both.
+//
+// The clearance of a trajectory in a phase is the smallest distance to
+// the structures sampled every SampleStep mm along the transformed
+// segment. Distance maps come from a DistanceMapCache, so each label map
+// is processed once whatever the number of phases and evaluations, and
+// adding a phase costs one map plus its share of the evaluation. All the
+// trajectory x phase pairs are evaluated in parallel, then reduced to
+// the worst phase of every trajectory.
+
+#ifndef __vtkSlicerPathPlannerPhaseEvaluator_h
+#define __vtkSlicerPathPlannerPhaseEvaluator_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerPathPlannerModuleLogicExport.h"
+
+class vtkDoubleArray;
+class vtkIntArray;
+class vtkMatrix4x4;
+class vtkSlicerPathPlannerDistanceMapCache;
+class vtkSlicerPathPlannerVolumeSampler;
+
+/// \ingroup Slicer_QtModules_PathPlanner
+class VTK_SLICER_PATHPLANNER_MODULE_LOGIC_EXPORT vtkSlicerPathPlannerPhaseEvaluator :
+  public vtkObject
+{
+public:
+  static vtkSlicerPathPlannerPhaseEvaluator *New();
+  vtkTypeMacro(vtkSlicerPathPlannerPhaseEvaluator, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Add a phase. "planningToPhase" may be NULL for the identity. The
+  /// matrix is copied. Return the index of the phase.
+  int AddPhase(vtkSlicerPathPlannerVolumeSampler* structures, vtkMatrix4x4* planningToPhase);
+  void RemoveAllPhases();
+  int GetNumberOfPhases();
+
+  /// Cache the distance maps are taken from. A cache is created by the
+  /// constructor; share it to reuse maps across evaluators.
+  void SetDistanceMapCache(vtkSlicerPathPlannerDistanceMapCache* cache);
+  vtkGetObjectMacro(DistanceMapCache, vtkSlicerPathPlannerDistanceMapCache);
+
+  /// Distance between clearance samples (mm). Default is 1.
+  vtkSetClampMacro(SampleStep, double, 0.01, VTK_DOUBLE_MAX);
+  vtkGetMacro(SampleStep, double);
+
+  /// Clearance above which the risk is 0 (mm). The risk grows linearly to
+  /// 1 when the clearance drops to 0. Default is 5.
+  vtkSetClampMacro(SafetyMargin, double, 0.0, VTK_DOUBLE_MAX);
+  vtkGetMacro(SafetyMargin, double);
+
+  /// Evaluate every trajectory of "segments" (6 components: entry RAS,
+  /// target RAS) in every phase. "clearances" and "risks" receive the
+  /// worst case of every trajectory and "worstPhases" (may be NULL) the
+  /// phase it occurs in. "phaseClearances" (may be NULL) receives one
+  /// component per phase.
+  void Evaluate(vtkDoubleArray* segments, vtkDoubleArray* clearances, vtkDoubleArray* risks,
+                vtkIntArray* worstPhases, vtkDoubleArray* phaseClearances = NULL);
+
+protected:
+  vtkSlicerPathPlannerPhaseEvaluator();
+  virtual ~vtkSlicerPathPlannerPhaseEvaluator();
+
+  //BTX
+  struct Phase
+  {
+    vtkSmartPointer<vtkSlicerPathPlannerVolumeSampler> Structures;
+    double PlanningToPhase[3][4];
+  };
+  std::vector<Phase> Phases;
+  //ETX
+
+  vtkSlicerPathPlannerDistanceMapCache* DistanceMapCache;
+  double SampleStep;
+  double SafetyMargin;
+
+private:
+  vtkSlicerPathPlannerPhaseEvaluator(const vtkSlicerPathPlannerPhaseEvaluator&); // Not implemented
+  void operator=(const vtkSlicerPathPlannerPhaseEvaluator&);               // Not implemented
+};
+
+#endif
@@ -0,0 +1,229 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerPlanDescription.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+
+//----------------------------------------------------------------------------
+bool vtkSlicerPathPlannerPlanDescription::Item::operator==(const Item& other) const
+{
+  return this->Type == other.Type && this->Name == other.Name &&
+    this->Position[0] == other.Position[0] && this->Position[1] == other.Position[1] &&
+    this->Position[2] == other.Position[2] && this->EntryID == other.EntryID &&
+    this->TargetID == other.TargetID;
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerPathPlannerPlanDescription);
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerPlanDescription::vtkSlicerPathPlannerPlanDescription()
+{
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerPlanDescription::~vtkSlicerPathPlannerPlanDescription()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerPlanDescription::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfItems: " << this->Items.size() << "\n";
+  os << indent << "NumberOfChanges: " << this->Changes.size() << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerPlanDescription::BeginUpdate()
+{
+  // Items are kept to avoid reallocating them at every update
+  for (ItemMap::iterator it = this->Items.begin(); it != this->Items.end(); ++it)
+    {
+    it->second.Updated = false;
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerPlanDescription::SetFiducial(const char* id, int type, const char* name,
+                                               const double position[3])
+{
+  if (!id || (type != EntryFiducial && type != TargetFiducial))
+    {
+    return;
+    }
+  Item& item = this->Items[id];
+  item.Type = type;
+  item.Updated = true;
+  item.Name = name ? name : "";
+  item.Position[0] = position[0];
+  item.Position[1] = position[1];
+  item.Position[2] = position[2];
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerPlanDescription::SetTrajectory(const char* id, const char* name,
+                                                 const char* entryID, const char* targetID)
+{
+  if (!id)
+    {
+    return;
+    }
+  Item& item = this->Items[id];
+  item.Type = Trajectory;
+  item.Updated = true;
+  item.Name = name ? name : "";
+  item.Position[0] = item.Position[1] = item.Position[2] = 0.0;
+  item.EntryID = entryID ? entryID : "";
+  item.TargetID = targetID ? targetID : "";
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPlanDescription::EndUpdate()
+{
+  return this->Diff(NULL, NULL);
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPlanDescription::GetNumberOfItems()
+{
+  return static_cast<int>(this->Items.size());
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPlanDescription::Diff(ItemMap* changed, std::vector<std::string>* removed)
+{
+  // Both maps are sorted by ID: a single merge pass, which also drops the
+  // items not set since BeginUpdate
+  int numberOfChanges = 0;
+  ItemMap::iterator it = this->Items.begin();
+  ItemMap::iterator sent = this->ReferenceItems.begin();
+  while (it != this->Items.end() || sent != this->ReferenceItems.end())
+    {
+    if (it != this->Items.end() && !it->second.Updated)
+      {
+      this->Items.erase(it++);
+      continue;
+      }
+    int order = it == this->Items.end() ? 1 :
+      sent == this->ReferenceItems.end() ? -1 : it->first.compare(sent->first);
+    if (order > 0)
+      {
+      if (removed)
+        {
+        removed->push_back(sent->first);
+        }
+      ++numberOfChanges;
+      ++sent;
+      continue;
+      }
+    if (order < 0 || !(it->second == sent->second))
+      {
+      if (changed)
+        {
+        changed->insert(changed->end(), *it);
+        }
+      ++numberOfChanges;
+      }
+    if (order == 0)
+      {
+      ++sent;
+      }
+    ++it;
+    }
+  return numberOfChanges;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPlanDescription::GetNumberOfChanges()
+{
+  return static_cast<int>(this->Changes.size());
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerPlanDescription::GetNthChangeID(int n)
+{
+  if (n < 0 || n >= static_cast<int>(this->Changes.size()))
+    {
+    return NULL;
+    }
+  return this->Changes[n].ID.c_str();
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPlanDescription::GetNthChangeType(int n)
+{
+  if (n < 0 || n >= static_cast<int>(this->Changes.size()))
+    {
+    return Removed;
+    }
+  return this->Changes[n].Value.Type;
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerPlanDescription::GetNthChangeName(int n)
+{
+  if (n < 0 || n >= static_cast<int>(this->Changes.size()))
+    {
+    return NULL;
+    }
+  return this->Changes[n].Value.Name.c_str();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerPlanDescription::GetNthChangePosition(int n, double position[3])
+{
+  for (int i = 0; i < 3; i++)
+    {
+    position[i] = n >= 0 && n < static_cast<int>(this->Changes.size()) ?
+      this->Changes[n].Value.Position[i] : 0.0;
+    }
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerPlanDescription::GetNthChangeEntryID(int n)
+{
+  if (n < 0 || n >= static_cast<int>(this->Changes.size()))
+    {
+    return NULL;
+    }
+  return this->Changes[n].Value.EntryID.c_str();
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerPlanDescription::GetNthChangeTargetID(int n)
+{
+  if (n < 0 || n >= static_cast<int>(this->Changes.size()))
+    {
+    return NULL;
+    }
+  return this->Changes[n].Value.TargetID.c_str();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerPlanDescription::ClearChanges()
+{
+  this->Changes.clear();
+}
@@ -0,0 +1,126 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// .NAME vtkSlicerPathPlannerPlanDescription - items of a plan and their changes
+// .SECTION Description
+// Plan (entry and target fiducials, trajectories) described between
+// BeginUpdate and EndUpdate, compared to a reference copy of the plan, and
+// list of the changes to apply to a scene. Common part of
+// vtkSlicerPathPlannerPlanSync, whose reference is the plan as of the
+// last message sent, and vtkSlicerPathPlannerPlanHistory, whose reference
+// is the plan as of the last undo step.
+
+#ifndef __vtkSlicerPathPlannerPlanDescription_h
+#define __vtkSlicerPathPlannerPlanDescription_h
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <map>
+#include <string>
+#include <vector>
+
+#include "vtkSlicerPathPlannerModuleLogicExport.h"
+
+/// \ingroup Slicer_QtModules_PathPlanner
+class VTK_SLICER_PATHPLANNER_MODULE_LOGIC_EXPORT vtkSlicerPathPlannerPlanDescription :
+  public vtkObject
+{
+public:
+  static vtkSlicerPathPlannerPlanDescription *New();
+  vtkTypeMacro(vtkSlicerPathPlannerPlanDescription, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Item types. Removed is only used by the changes.
+  enum
+    {
+    Removed = 0,
+    EntryFiducial,
+    TargetFiducial,
+    Trajectory
+    };
+
+  /// Describe the whole plan. Items not set since BeginUpdate are removed
+  /// by EndUpdate, which returns the number of items changed since the
+  /// reference.
+  void BeginUpdate();
+  void SetFiducial(const char* id, int type, const char* name, const double position[3]);
+  void SetTrajectory(const char* id, const char* name, const char* entryID,
+                     const char* targetID);
+  int EndUpdate();
+
+  /// Number of items of the plan described by the last update.
+  int GetNumberOfItems();
+
+  /// Changes to apply to the scene, oldest first, until ClearChanges.
+  /// Removed items only have an ID and a type.
+  int GetNumberOfChanges();
+  const char* GetNthChangeID(int n);
+  int GetNthChangeType(int n);
+  const char* GetNthChangeName(int n);
+  void GetNthChangePosition(int n, double position[3]);
+  const char* GetNthChangeEntryID(int n);
+  const char* GetNthChangeTargetID(int n);
+  void ClearChanges();
+
+protected:
+  vtkSlicerPathPlannerPlanDescription();
+  virtual ~vtkSlicerPathPlannerPlanDescription();
+
+  //BTX
+  struct Item
+  {
+    int Type;
+    std::string Name;
+    double Position[3];
+    std::string EntryID;
+    std::string TargetID;
+    // Set since BeginUpdate, not compared
+    bool Updated;
+    bool operator==(const Item& other) const;
+  };
+  typedef std::map<std::string, Item> ItemMap;
+
+  struct Change
+  {
+    std::string ID;
+    Item Value;
+  };
+
+  /// Drop the items not set since BeginUpdate and compare the plan to
+  /// ReferenceItems. "changed" (may be NULL) receives the items added or
+  /// modified, "removed" (may be NULL) the IDs of the items removed.
+  /// Return the number of items changed.
+  int Diff(ItemMap* changed, std::vector<std::string>* removed);
+
+  ItemMap Items;
+  ItemMap ReferenceItems;
+  std::vector<Change> Changes;
+  //ETX
+
+private:
+  vtkSlicerPathPlannerPlanDescription(const vtkSlicerPathPlannerPlanDescription&); // Not implemented
+  void operator=(const vtkSlicerPathPlannerPlanDescription&);                      // Not implemented
+};
+
+#endif
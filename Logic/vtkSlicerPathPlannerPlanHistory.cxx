@@ -0,0 +1,204 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerPlanHistory.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerPathPlannerPlanHistory);
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerPlanHistory::vtkSlicerPathPlannerPlanHistory()
+{
+  this->MaximumNumberOfSteps = 100;
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerPlanHistory::~vtkSlicerPathPlannerPlanHistory()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerPlanHistory::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "MaximumNumberOfSteps: " << this->MaximumNumberOfSteps << "\n";
+  os << indent << "NumberOfUndoSteps: " << this->UndoSteps.size() << "\n";
+  os << indent << "NumberOfRedoSteps: " << this->RedoSteps.size() << "\n";
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPlanHistory::Record()
+{
+  // ReferenceItems holds the plan as of the last step
+  ItemMap changed;
+  std::vector<std::string> removed;
+  int numberOfItems = this->Diff(&changed, &removed);
+  if (numberOfItems == 0)
+    {
+    return 0;
+    }
+
+  Step step;
+  step.reserve(numberOfItems);
+  for (ItemMap::iterator it = changed.begin(); it != changed.end(); ++it)
+    {
+    Edit edit;
+    edit.ID = it->first;
+    ItemMap::iterator previous = this->ReferenceItems.find(it->first);
+    edit.HasBefore = previous != this->ReferenceItems.end();
+    if (edit.HasBefore)
+      {
+      edit.Before = previous->second;
+      previous->second = it->second;
+      }
+    else
+      {
+      this->ReferenceItems.insert(*it);
+      }
+    edit.HasAfter = true;
+    edit.After = it->second;
+    step.push_back(edit);
+    }
+  for (std::vector<std::string>::iterator it = removed.begin(); it != removed.end(); ++it)
+    {
+    ItemMap::iterator previous = this->ReferenceItems.find(*it);
+    Edit edit;
+    edit.ID = *it;
+    edit.HasBefore = true;
+    edit.HasAfter = false;
+    edit.Before = previous->second;
+    step.push_back(edit);
+    this->ReferenceItems.erase(previous);
+    }
+
+  this->UndoSteps.push_back(step);
+  while (static_cast<int>(this->UndoSteps.size()) > this->MaximumNumberOfSteps)
+    {
+    this->UndoSteps.pop_front();
+    }
+  this->RedoSteps.clear();
+  this->Modified();
+  return numberOfItems;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPlanHistory::Undo()
+{
+  if (this->UndoSteps.empty())
+    {
+    return 0;
+    }
+  int numberOfChanges = this->Apply(this->UndoSteps.back(), true);
+  this->RedoSteps.push_back(Step());
+  this->RedoSteps.back().swap(this->UndoSteps.back());
+  this->UndoSteps.pop_back();
+  this->Modified();
+  return numberOfChanges;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPlanHistory::Redo()
+{
+  if (this->RedoSteps.empty())
+    {
+    return 0;
+    }
+  int numberOfChanges = this->Apply(this->RedoSteps.back(), false);
+  this->UndoSteps.push_back(Step());
+  this->UndoSteps.back().swap(this->RedoSteps.back());
+  this->RedoSteps.pop_back();
+  this->Modified();
+  return numberOfChanges;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPlanHistory::Apply(const Step& step, bool undo)
+{
+  // Fiducials before the trajectories using them, removals last and in the
+  // opposite order, as for a received message
+  int numberOfChanges = 0;
+  for (int type = EntryFiducial; type <= Trajectory; type++)
+    {
+    for (Step::const_iterator it = step.begin(); it != step.end(); ++it)
+      {
+      bool has = undo ? it->HasBefore : it->HasAfter;
+      const Item& value = undo ? it->Before : it->After;
+      if (!has || value.Type != type)
+        {
+        continue;
+        }
+      Change change;
+      change.ID = it->ID;
+      change.Value = value;
+      change.Value.Updated = true;
+      this->Changes.push_back(change);
+      this->Items[it->ID] = change.Value;
+      this->ReferenceItems[it->ID] = change.Value;
+      ++numberOfChanges;
+      }
+    }
+  for (int type = Trajectory; type >= EntryFiducial; type--)
+    {
+    for (Step::const_iterator it = step.begin(); it != step.end(); ++it)
+      {
+      bool has = undo ? it->HasBefore : it->HasAfter;
+      const Item& value = undo ? it->After : it->Before;
+      if (has || value.Type != type)
+        {
+        continue;
+        }
+      Change change;
+      change.ID = it->ID;
+      change.Value = value;
+      change.Value.Type = Removed;
+      this->Changes.push_back(change);
+      this->Items.erase(it->ID);
+      this->ReferenceItems.erase(it->ID);
+      ++numberOfChanges;
+      }
+    }
+  return numberOfChanges;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPlanHistory::GetNumberOfUndoSteps()
+{
+  return static_cast<int>(this->UndoSteps.size());
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPlanHistory::GetNumberOfRedoSteps()
+{
+  return static_cast<int>(this->RedoSteps.size());
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerPlanHistory::ClearSteps()
+{
+  this->UndoSteps.clear();
+  this->RedoSteps.clear();
+  this->Modified();
+}
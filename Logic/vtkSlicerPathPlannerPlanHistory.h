@@ -0,0 +1,108 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// .NAME vtkSlicerPathPlannerPlanHistory - undo and redo of plan edits
+// .SECTION Description
+// Describe the plan (see vtkSlicerPathPlannerPlanDescription) at the end
+// of an edit operation, then Record the edits as one step. A step only
+// holds the items it added, modified or removed (their value before and
+// after), while the current plan is kept once, so that the memory of a
+// step and the time of Undo and Redo are proportional to the edit rather
+// than to the plan: clearing a hierarchy costs one copy of the removed
+// items, moving a fiducial one item. Record compares the described plan
+// to the current one in a single pass.
+//
+// Undo and Redo list the changes to apply to the scene (see
+// GetNumberOfChanges), with the node IDs of the scene as item IDs.
+// Removed nodes should be restored with their former ID so that the
+// following steps still refer to them.
+
+#ifndef __vtkSlicerPathPlannerPlanHistory_h
+#define __vtkSlicerPathPlannerPlanHistory_h
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerPlanDescription.h"
+
+// STD includes
+#include <deque>
+
+#include "vtkSlicerPathPlannerModuleLogicExport.h"
+
+/// \ingroup Slicer_QtModules_PathPlanner
+class VTK_SLICER_PATHPLANNER_MODULE_LOGIC_EXPORT vtkSlicerPathPlannerPlanHistory :
+  public vtkSlicerPathPlannerPlanDescription
+{
+public:
+  static vtkSlicerPathPlannerPlanHistory *New();
+  vtkTypeMacro(vtkSlicerPathPlannerPlanHistory, vtkSlicerPathPlannerPlanDescription);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Record the edits described since the last step as a new step, and
+  /// forget the steps undone. Return the number of items edited, 0 if
+  /// there is nothing to record.
+  int Record();
+
+  /// Revert the last step, or apply again the last step undone. Pending
+  /// edits must be recorded first. Return the number of changes listed,
+  /// 0 if there is no step.
+  int Undo();
+  int Redo();
+
+  int GetNumberOfUndoSteps();
+  int GetNumberOfRedoSteps();
+
+  /// Oldest steps are forgotten beyond this number. Default is 100.
+  vtkSetClampMacro(MaximumNumberOfSteps, int, 1, VTK_INT_MAX);
+  vtkGetMacro(MaximumNumberOfSteps, int);
+
+  /// Forget all the steps, keeping the current plan.
+  void ClearSteps();
+
+protected:
+  vtkSlicerPathPlannerPlanHistory();
+  virtual ~vtkSlicerPathPlannerPlanHistory();
+
+  //BTX
+  struct Edit
+  {
+    std::string ID;
+    bool HasBefore;
+    bool HasAfter;
+    Item Before;
+    Item After;
+  };
+  typedef std::vector<Edit> Step;
+
+  int Apply(const Step& step, bool undo);
+
+  std::deque<Step> UndoSteps;
+  std::vector<Step> RedoSteps;
+  //ETX
+
+  int MaximumNumberOfSteps;
+
+private:
+  vtkSlicerPathPlannerPlanHistory(const vtkSlicerPathPlannerPlanHistory&); // Not implemented
+  void operator=(const vtkSlicerPathPlannerPlanHistory&);               // Not implemented
+};
+
+#endif
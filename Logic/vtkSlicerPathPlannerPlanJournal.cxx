@@ -0,0 +1,326 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerPlanJournal.h"
+#include "vtkSlicerPathPlannerPlanSync.h"
+
+// VTK includes
+#include <vtkByteSwap.h>
+#include <vtkConditionVariable.h>
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+#include <vtkUnsignedCharArray.h>
+
+// STD includes
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+const char Magic[8] = { 'P', 'P', 'J', 'O', 'U', 'R', 'N', 'L' };
+const vtkTypeUInt32 Version = 1;
+
+//----------------------------------------------------------------------------
+void WriteHeader(std::ofstream& stream)
+{
+  vtkTypeUInt32 version = Version;
+  vtkByteSwap::SwapLE(&version);
+  stream.write(Magic, sizeof(Magic));
+  stream.write(reinterpret_cast<const char*>(&version), sizeof(version));
+}
+
+//----------------------------------------------------------------------------
+void WriteMessage(std::ofstream& stream, const std::string& message)
+{
+  vtkTypeUInt32 length = static_cast<vtkTypeUInt32>(message.size());
+  vtkByteSwap::SwapLE(&length);
+  stream.write(reinterpret_cast<const char*>(&length), sizeof(length));
+  stream.write(message.data(), message.size());
+}
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerPathPlannerPlanJournal);
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerPlanJournal::vtkSlicerPathPlannerPlanJournal()
+{
+  this->NumberOfWrittenMessages = 0;
+  this->Closing = 0;
+  this->Plan = vtkSlicerPathPlannerPlanSync::New();
+  this->Threader = vtkMultiThreader::New();
+  this->QueueLock = vtkMutexLock::New();
+  this->QueueCondition = vtkConditionVariable::New();
+  this->WriterThreadID = -1;
+  this->CompactionInterval = 256;
+  this->NumberOfMessagesSinceCompaction = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerPlanJournal::~vtkSlicerPathPlannerPlanJournal()
+{
+  this->Close();
+  this->Plan->Delete();
+  this->Threader->Delete();
+  this->QueueLock->Delete();
+  this->QueueCondition->Delete();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerPlanJournal::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "FileName: " << this->FileName << "\n";
+  os << indent << "Open: " << this->IsOpen() << "\n";
+  os << indent << "CompactionInterval: " << this->CompactionInterval << "\n";
+  os << indent << "NumberOfWrittenMessages: " << this->GetNumberOfWrittenMessages() << "\n";
+  os << indent << "NumberOfQueuedMessages: " << this->GetNumberOfQueuedMessages() << "\n";
+  os << indent << "Plan:\n";
+  this->Plan->PrintSelf(os, indent.GetNextIndent());
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPlanJournal::Open(const char* fileName)
+{
+  this->Close();
+  if (!fileName)
+    {
+    return 0;
+    }
+  this->Stream.open(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!this->Stream.is_open())
+    {
+    vtkErrorMacro(<< "Open: cannot create " << fileName);
+    return 0;
+    }
+  WriteHeader(this->Stream);
+  this->Stream.flush();
+  this->FileName = fileName;
+
+  // The first message holds the plan described so far
+  vtkUnsignedCharArray* encoded = vtkUnsignedCharArray::New();
+  this->Plan->EncodeFull(encoded);
+  this->Queue.resize(1);
+  this->Queue[0].Full = false;
+  this->Queue[0].Data.assign(reinterpret_cast<const char*>(encoded->GetPointer(0)),
+                             encoded->GetNumberOfTuples());
+  encoded->Delete();
+  this->NumberOfMessagesSinceCompaction = 0;
+  this->NumberOfWrittenMessages = 0;
+  this->Closing = 0;
+  this->WriterThreadID = this->Threader->SpawnThread(
+    &vtkSlicerPathPlannerPlanJournal::WriterThread, this);
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerPlanJournal::Close()
+{
+  if (this->WriterThreadID < 0)
+    {
+    return;
+    }
+
+  // The writer empties the queue before leaving
+  this->QueueLock->Lock();
+  this->Closing = 1;
+  this->QueueLock->Unlock();
+  this->QueueCondition->Broadcast();
+  this->Threader->TerminateThread(this->WriterThreadID);
+  this->WriterThreadID = -1;
+
+  this->Stream.close();
+  this->FileName.clear();
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPlanJournal::IsOpen()
+{
+  return this->WriterThreadID >= 0 ? 1 : 0;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPlanJournal::Save()
+{
+  if (this->WriterThreadID < 0)
+    {
+    return 0;
+    }
+
+  vtkUnsignedCharArray* encoded = vtkUnsignedCharArray::New();
+  int numberOfItems = this->Plan->EncodeDelta(encoded);
+  Message message;
+  message.Full = false;
+  if (numberOfItems > 0 &&
+      ++this->NumberOfMessagesSinceCompaction >= this->CompactionInterval)
+    {
+    // Same sequence number as the delta, which it replaces
+    this->Plan->EncodeFull(encoded);
+    this->NumberOfMessagesSinceCompaction = 0;
+    message.Full = true;
+    }
+  if (numberOfItems > 0)
+    {
+    message.Data.assign(reinterpret_cast<const char*>(encoded->GetPointer(0)),
+                        encoded->GetNumberOfTuples());
+    }
+  encoded->Delete();
+  if (numberOfItems == 0)
+    {
+    return 0;
+    }
+
+  // Only the swap is done under the lock
+  this->QueueLock->Lock();
+  this->Queue.push_back(Message());
+  this->Queue.back().Full = message.Full;
+  this->Queue.back().Data.swap(message.Data);
+  this->QueueLock->Unlock();
+  this->QueueCondition->Signal();
+  return numberOfItems;
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkSlicerPathPlannerPlanJournal::GetNumberOfWrittenMessages()
+{
+  this->QueueLock->Lock();
+  vtkIdType numberOfMessages = this->NumberOfWrittenMessages;
+  this->QueueLock->Unlock();
+  return numberOfMessages;
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkSlicerPathPlannerPlanJournal::GetNumberOfQueuedMessages()
+{
+  this->QueueLock->Lock();
+  vtkIdType numberOfMessages = static_cast<vtkIdType>(this->Queue.size());
+  this->QueueLock->Unlock();
+  return numberOfMessages;
+}
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkSlicerPathPlannerPlanJournal::WriterThread(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  vtkSlicerPathPlannerPlanJournal* self =
+    static_cast<vtkSlicerPathPlannerPlanJournal*>(info->UserData);
+  self->WriteMessages();
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerPlanJournal::WriteMessages()
+{
+  std::vector<Message> batch;
+  this->QueueLock->Lock();
+  for (;;)
+    {
+    while (this->Queue.empty() && !this->Closing)
+      {
+      this->QueueCondition->Wait(this->QueueLock);
+      }
+    if (this->Queue.empty())
+      {
+      break;
+      }
+    batch.swap(this->Queue);
+    this->QueueLock->Unlock();
+
+    for (std::vector<Message>::iterator it = batch.begin(); it != batch.end(); ++it)
+      {
+      if (it->Full)
+        {
+        this->Compact(it->Data);
+        }
+      else
+        {
+        WriteMessage(this->Stream, it->Data);
+        }
+      }
+    this->Stream.flush();
+    vtkIdType numberOfMessages = static_cast<vtkIdType>(batch.size());
+    batch.clear();
+
+    this->QueueLock->Lock();
+    this->NumberOfWrittenMessages += numberOfMessages;
+    }
+  this->QueueLock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerPlanJournal::Compact(const std::string& message)
+{
+  // Replace the journal by the whole plan. The rename is atomic on POSIX,
+  // elsewhere a crash in between leaves the complete temporary file.
+  std::string temporaryFileName = this->FileName + ".tmp";
+  std::ofstream compacted(temporaryFileName.c_str(),
+                          std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!compacted.is_open())
+    {
+    WriteMessage(this->Stream, message);
+    return;
+    }
+  WriteHeader(compacted);
+  WriteMessage(compacted, message);
+  compacted.close();
+
+  this->Stream.close();
+  if (std::rename(temporaryFileName.c_str(), this->FileName.c_str()) != 0)
+    {
+    std::remove(this->FileName.c_str());
+    std::rename(temporaryFileName.c_str(), this->FileName.c_str());
+    }
+  this->Stream.open(this->FileName.c_str(), std::ios::out | std::ios::binary | std::ios::app);
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPlanJournal::Recover(const char* fileName,
+                                             vtkSlicerPathPlannerPlanSync* plan)
+{
+  std::ifstream stream(fileName ? fileName : "", std::ios::in | std::ios::binary);
+  char magic[sizeof(Magic)];
+  vtkTypeUInt32 version = 0;
+  stream.read(magic, sizeof(magic));
+  stream.read(reinterpret_cast<char*>(&version), sizeof(version));
+  vtkByteSwap::SwapLE(&version);
+  if (!plan || !stream || memcmp(magic, Magic, sizeof(Magic)) != 0 || version != Version)
+    {
+    return -1;
+    }
+
+  int numberOfMessages = 0;
+  std::vector<unsigned char> message;
+  vtkTypeUInt32 length;
+  while (stream.read(reinterpret_cast<char*>(&length), sizeof(length)))
+    {
+    vtkByteSwap::SwapLE(&length);
+    message.resize(length > 0 ? length : 1);
+    if (!stream.read(reinterpret_cast<char*>(&message[0]), length) ||
+        plan->Decode(&message[0], length) != 1)
+      {
+      break;
+      }
+    ++numberOfMessages;
+    }
+  return numberOfMessages;
+}
@@ -0,0 +1,137 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// .NAME vtkSlicerPathPlannerPlanJournal - append-only journal of plan edits
+// .SECTION Description
+// Saves the plan (entry and target fiducials, trajectories) continuously
+// during a procedure, without the stall of a scene save, so that it can be
+// recovered after a crash.
+//
+// The plan is described to the Plan object, as for a
+// vtkSlicerPathPlannerPlanSync sender, and Save encodes the edits since
+// the last call as one delta message. Messages are appended to the file
+// by a background thread: the calling thread only queues them, and never
+// waits for the disk. Every CompactionInterval messages the whole plan is
+// queued instead, and the writer replaces the file with it, so the
+// journal stays about the size of the plan.
+//
+// The file starts with the "PPJOURNL" magic and a version number,
+// followed by length prefixed messages in the vtkSlicerPathPlannerPlanSync
+// format. The writer flushes after each batch; a crash while writing only
+// loses the last, truncated message.
+
+#ifndef __vtkSlicerPathPlannerPlanJournal_h
+#define __vtkSlicerPathPlannerPlanJournal_h
+
+// VTK includes
+#include <vtkMultiThreader.h>
+#include <vtkObject.h>
+
+// STD includes
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "vtkSlicerPathPlannerModuleLogicExport.h"
+
+class vtkConditionVariable;
+class vtkMutexLock;
+class vtkSlicerPathPlannerPlanSync;
+
+/// \ingroup Slicer_QtModules_PathPlanner
+class VTK_SLICER_PATHPLANNER_MODULE_LOGIC_EXPORT vtkSlicerPathPlannerPlanJournal :
+  public vtkObject
+{
+public:
+  static vtkSlicerPathPlannerPlanJournal *New();
+  vtkTypeMacro(vtkSlicerPathPlannerPlanJournal, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Create the journal, replacing any existing file, write the plan
+  /// described so far and start the writer. Recover the previous journal
+  /// first. Return 0 if the file cannot be created.
+  int Open(const char* fileName);
+
+  /// Write the queued messages and stop the writer.
+  void Close();
+  int IsOpen();
+
+  /// Current plan, described between BeginUpdate and EndUpdate.
+  vtkGetObjectMacro(Plan, vtkSlicerPathPlannerPlanSync);
+
+  /// Queue the edits of the plan since the last call. Return the number of
+  /// items journaled.
+  int Save();
+
+  /// Number of messages between two compactions. Default is 256.
+  vtkSetClampMacro(CompactionInterval, int, 1, VTK_INT_MAX);
+  vtkGetMacro(CompactionInterval, int);
+
+  /// Messages written to the file since Open, and not written yet.
+  vtkIdType GetNumberOfWrittenMessages();
+  vtkIdType GetNumberOfQueuedMessages();
+
+  /// Read a journal into "plan", whose changes then list the recovered
+  /// items as for a vtkSlicerPathPlannerPlanSync receiver. A truncated
+  /// last message is ignored. Return the number of messages read, -1 if
+  /// the file is not a journal.
+  static int Recover(const char* fileName, vtkSlicerPathPlannerPlanSync* plan);
+
+protected:
+  vtkSlicerPathPlannerPlanJournal();
+  virtual ~vtkSlicerPathPlannerPlanJournal();
+
+  static VTK_THREAD_RETURN_TYPE WriterThread(void* arg);
+  void WriteMessages();
+  void Compact(const std::string& message);
+
+  //BTX
+  struct Message
+  {
+    bool Full;
+    std::string Data;
+  };
+
+  // Guarded by QueueLock
+  std::vector<Message> Queue;
+  vtkIdType NumberOfWrittenMessages;
+  int Closing;
+
+  // Writer thread only once started
+  std::ofstream Stream;
+  std::string FileName;
+  //ETX
+
+  vtkSlicerPathPlannerPlanSync* Plan;
+  vtkMultiThreader* Threader;
+  vtkMutexLock* QueueLock;
+  vtkConditionVariable* QueueCondition;
+  int WriterThreadID;
+  int CompactionInterval;
+  int NumberOfMessagesSinceCompaction;
+
+private:
+  vtkSlicerPathPlannerPlanJournal(const vtkSlicerPathPlannerPlanJournal&); // Not implemented
+  void operator=(const vtkSlicerPathPlannerPlanJournal&);               // Not implemented
+};
+
+#endif
@@ -0,0 +1,325 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerLogic.h"
+#include "vtkSlicerPathPlannerPlanSnapshot.h"
+#include "vtkSlicerPathPlannerVolumeSampler.h"
+
+// MRML includes
+#include <vtkMRMLAnnotationFiducialNode.h>
+#include <vtkMRMLAnnotationHierarchyNode.h>
+#include <vtkMRMLAnnotationRulerNode.h>
+#include <vtkMRMLPathPlannerTrajectoryNode.h>
+#include <vtkMRMLVolumeNode.h>
+
+// VTK includes
+#include <vtkCollection.h>
+#include <vtkDoubleArray.h>
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <cstring>
+
+namespace
+{
+//----------------------------------------------------------------------------
+// The parent transforms may change without modifying the volume node
+bool SameMatrix(vtkSlicerPathPlannerVolumeSampler* sampler, vtkMatrix4x4* worldToIJK)
+{
+  vtkNew<vtkMatrix4x4> samplerWorldToIJK;
+  sampler->GetRASToIJKMatrix(samplerWorldToIJK.GetPointer());
+  for (int i = 0; i < 4; i++)
+    {
+    for (int j = 0; j < 4; j++)
+      {
+      if (samplerWorldToIJK->GetElement(i, j) != worldToIJK->GetElement(i, j))
+        {
+        return false;
+        }
+      }
+    }
+  return true;
+}
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerPathPlannerPlanSnapshot);
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerPlanSnapshot::vtkSlicerPathPlannerPlanSnapshot()
+{
+  this->Version = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerPlanSnapshot::~vtkSlicerPathPlannerPlanSnapshot()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerPlanSnapshot::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Version: " << this->Version << "\n";
+  os << indent << "NumberOfTrajectories: " << this->GetNumberOfTrajectories() << "\n";
+  os << indent << "NumberOfEntryPoints: " << this->GetNumberOfEntryPoints() << "\n";
+  os << indent << "NumberOfTargetPoints: " << this->GetNumberOfTargetPoints() << "\n";
+  for (std::vector<Volume>::iterator it = this->Volumes.begin(); it != this->Volumes.end(); ++it)
+    {
+    os << indent << "Volume " << it->ID << "\n";
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerPlanSnapshot
+::ShareIfEqual(PointSet* previous, PointSet& points)
+{
+  if (!previous || !previous->Points || previous->IDs != points.IDs)
+    {
+    return;
+    }
+  vtkDoubleArray* previousPoints = previous->Points;
+  vtkIdType size = points.Points->GetNumberOfTuples() * points.Points->GetNumberOfComponents();
+  if (previousPoints->GetNumberOfTuples() != points.Points->GetNumberOfTuples() ||
+      previousPoints->GetNumberOfComponents() != points.Points->GetNumberOfComponents() ||
+      (size > 0 && memcmp(previousPoints->GetPointer(0), points.Points->GetPointer(0),
+                          size * sizeof(double)) != 0))
+    {
+    return;
+    }
+  points.Points = previousPoints;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerPlanSnapshot
+::CapturePoints(vtkMRMLAnnotationHierarchyNode* list, PointSet* previous, PointSet& points)
+{
+  points.Points = vtkSmartPointer<vtkDoubleArray>::New();
+  points.Points->SetNumberOfComponents(3);
+  points.IDs.clear();
+  for (int i = 0; list && i < list->GetNumberOfChildrenNodes(); i++)
+    {
+    vtkMRMLAnnotationFiducialNode* fiducial =
+      vtkMRMLAnnotationFiducialNode::SafeDownCast(list->GetNthChildNode(i)->GetAssociatedNode());
+    if (!fiducial || !fiducial->GetID())
+      {
+      continue;
+      }
+    double world[3];
+    vtkSlicerPathPlannerLogic::GetFiducialWorldCoordinates(fiducial, world);
+    points.Points->InsertNextTuple(world);
+    points.IDs.push_back(fiducial->GetID());
+    }
+  ShareIfEqual(previous, points);
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerPlanSnapshot::Capture(vtkSlicerPathPlannerPlanSnapshot* previous,
+                                               vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+                                               vtkMRMLAnnotationHierarchyNode* entryList,
+                                               vtkMRMLAnnotationHierarchyNode* targetList,
+                                               vtkCollection* volumeNodes)
+{
+  this->Version = previous ? previous->Version + 1 : 1;
+  this->TrajectoryNodeID = trajectoryNode && trajectoryNode->GetID() ? trajectoryNode->GetID() : "";
+  this->EntryListID = entryList && entryList->GetID() ? entryList->GetID() : "";
+  this->TargetListID = targetList && targetList->GetID() ? targetList->GetID() : "";
+
+  // Trajectories
+  vtkNew<vtkCollection> rulers;
+  this->Trajectories.Points = vtkSmartPointer<vtkDoubleArray>::New();
+  vtkSlicerPathPlannerLogic::GetTrajectorySegments(trajectoryNode, this->Trajectories.Points,
+                                                   rulers.GetPointer());
+  this->Trajectories.IDs.clear();
+  for (int i = 0; i < rulers->GetNumberOfItems(); i++)
+    {
+    vtkMRMLAnnotationRulerNode* ruler =
+      vtkMRMLAnnotationRulerNode::SafeDownCast(rulers->GetItemAsObject(i));
+    this->Trajectories.IDs.push_back(ruler->GetID() ? ruler->GetID() : "");
+    double* segment = this->Trajectories.Points->GetPointer(6 * i);
+    vtkSlicerPathPlannerLogic::GetRulerWorldCoordinates(ruler, segment, segment + 3);
+    }
+  ShareIfEqual(previous ? &previous->Trajectories : NULL, this->Trajectories);
+
+  // Entry and target points
+  CapturePoints(entryList, previous ? &previous->EntryPoints : NULL, this->EntryPoints);
+  CapturePoints(targetList, previous ? &previous->TargetPoints : NULL, this->TargetPoints);
+
+  // Volumes, copied only when modified since the previous capture
+  this->Volumes.clear();
+  for (int i = 0; volumeNodes && i < volumeNodes->GetNumberOfItems(); i++)
+    {
+    vtkMRMLVolumeNode* volumeNode = vtkMRMLVolumeNode::SafeDownCast(volumeNodes->GetItemAsObject(i));
+    if (!volumeNode || !volumeNode->GetID() || !volumeNode->GetImageData())
+      {
+      continue;
+      }
+    vtkNew<vtkMatrix4x4> worldToIJK;
+    if (!vtkSlicerPathPlannerLogic::GetWorldToIJKMatrix(volumeNode, worldToIJK.GetPointer()))
+      {
+      vtkWarningMacro(<< "Capture: volume " << volumeNode->GetID()
+                      << " is under a non linear transform, not captured");
+      continue;
+      }
+    Volume volume;
+    volume.ID = volumeNode->GetID();
+    volume.NodeMTime = volumeNode->GetMTime();
+    volume.ImageMTime = volumeNode->GetImageData()->GetMTime();
+    for (size_t j = 0; previous && j < previous->Volumes.size(); j++)
+      {
+      const Volume& previousVolume = previous->Volumes[j];
+      if (previousVolume.ID == volume.ID && previousVolume.NodeMTime == volume.NodeMTime &&
+          previousVolume.ImageMTime == volume.ImageMTime &&
+          SameMatrix(previousVolume.Sampler, worldToIJK.GetPointer()))
+        {
+        volume.Sampler = previousVolume.Sampler;
+        break;
+        }
+      }
+    if (!volume.Sampler)
+      {
+      vtkNew<vtkImageData> image;
+      image->DeepCopy(volumeNode->GetImageData());
+      volume.Sampler = vtkSmartPointer<vtkSlicerPathPlannerVolumeSampler>::New();
+      volume.Sampler->SetImageData(image.GetPointer(), worldToIJK.GetPointer());
+      }
+    this->Volumes.push_back(volume);
+    }
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerPlanSnapshot::GetTrajectoryNodeID()
+{
+  return this->TrajectoryNodeID.c_str();
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerPlanSnapshot::GetEntryListID()
+{
+  return this->EntryListID.c_str();
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerPlanSnapshot::GetTargetListID()
+{
+  return this->TargetListID.c_str();
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkSlicerPathPlannerPlanSnapshot::GetNumberOfTrajectories()
+{
+  return static_cast<vtkIdType>(this->Trajectories.IDs.size());
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerPlanSnapshot::GetTrajectoryID(vtkIdType i)
+{
+  if (i < 0 || i >= this->GetNumberOfTrajectories())
+    {
+    return NULL;
+    }
+  return this->Trajectories.IDs[i].c_str();
+}
+
+//----------------------------------------------------------------------------
+vtkDoubleArray* vtkSlicerPathPlannerPlanSnapshot::GetSegments()
+{
+  return this->Trajectories.Points;
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkSlicerPathPlannerPlanSnapshot::GetNumberOfEntryPoints()
+{
+  return static_cast<vtkIdType>(this->EntryPoints.IDs.size());
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerPlanSnapshot::GetEntryPointID(vtkIdType i)
+{
+  if (i < 0 || i >= this->GetNumberOfEntryPoints())
+    {
+    return NULL;
+    }
+  return this->EntryPoints.IDs[i].c_str();
+}
+
+//----------------------------------------------------------------------------
+vtkDoubleArray* vtkSlicerPathPlannerPlanSnapshot::GetEntryPoints()
+{
+  return this->EntryPoints.Points;
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkSlicerPathPlannerPlanSnapshot::GetNumberOfTargetPoints()
+{
+  return static_cast<vtkIdType>(this->TargetPoints.IDs.size());
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerPlanSnapshot::GetTargetPointID(vtkIdType i)
+{
+  if (i < 0 || i >= this->GetNumberOfTargetPoints())
+    {
+    return NULL;
+    }
+  return this->TargetPoints.IDs[i].c_str();
+}
+
+//----------------------------------------------------------------------------
+vtkDoubleArray* vtkSlicerPathPlannerPlanSnapshot::GetTargetPoints()
+{
+  return this->TargetPoints.Points;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPlanSnapshot::GetNumberOfVolumes()
+{
+  return static_cast<int>(this->Volumes.size());
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerPlanSnapshot::GetNthVolumeID(int n)
+{
+  if (n < 0 || n >= this->GetNumberOfVolumes())
+    {
+    return NULL;
+    }
+  return this->Volumes[n].ID.c_str();
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerVolumeSampler* vtkSlicerPathPlannerPlanSnapshot::GetVolume(const char* nodeID)
+{
+  for (std::vector<Volume>::iterator it = this->Volumes.begin();
+       nodeID && it != this->Volumes.end(); ++it)
+    {
+    if (it->ID == nodeID)
+      {
+      return it->Sampler;
+      }
+    }
+  return NULL;
+}
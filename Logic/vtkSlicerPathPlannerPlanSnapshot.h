@@ -0,0 +1,145 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// .NAME vtkSlicerPathPlannerPlanSnapshot - immutable copy of the plan
+// .SECTION Description
+// Copy of the state of the plan that worker threads can read without
+// locking while the scene is edited: the trajectory segments, the entry
+// and target points, and samplers of the referenced volumes. Everything
+// is in world coordinates: the parent transforms of the rulers and
+// fiducials are applied, and the volume samplers map world RAS to IJK.
+// Volumes under a non linear transform are not captured. A snapshot is filled once by Capture and never
+// modified afterwards; publish it with a vtkSlicerPathPlannerPlanSnapshotStore.
+//
+// Capturing is copy-on-write: the parts that did not change since the
+// previous snapshot are shared with it rather than copied. Volumes are
+// copied when first captured and then each time their image or geometry
+// is modified, so that in-place edits of a label map never show up in a
+// published snapshot.
+//
+// Workers must not modify the arrays of a snapshot, nor take or release
+// references to them: VTK 5 reference counts are not thread safe.
+
+#ifndef __vtkSlicerPathPlannerPlanSnapshot_h
+#define __vtkSlicerPathPlannerPlanSnapshot_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <string>
+#include <vector>
+
+#include "vtkSlicerPathPlannerModuleLogicExport.h"
+
+class vtkCollection;
+class vtkDoubleArray;
+class vtkMRMLAnnotationHierarchyNode;
+class vtkMRMLPathPlannerTrajectoryNode;
+class vtkSlicerPathPlannerVolumeSampler;
+
+/// \ingroup Slicer_QtModules_PathPlanner
+class VTK_SLICER_PATHPLANNER_MODULE_LOGIC_EXPORT vtkSlicerPathPlannerPlanSnapshot :
+  public vtkObject
+{
+public:
+  static vtkSlicerPathPlannerPlanSnapshot *New();
+  vtkTypeMacro(vtkSlicerPathPlannerPlanSnapshot, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Fill the snapshot from the scene, in the thread that edits it. Parts
+  /// equal to those of "previous" (optional) are shared with it. Any node
+  /// can be NULL; "volumeNodes" holds vtkMRMLVolumeNode.
+  void Capture(vtkSlicerPathPlannerPlanSnapshot* previous,
+               vtkMRMLPathPlannerTrajectoryNode* trajectoryNode,
+               vtkMRMLAnnotationHierarchyNode* entryList,
+               vtkMRMLAnnotationHierarchyNode* targetList,
+               vtkCollection* volumeNodes);
+
+  /// Incremented at each capture.
+  vtkGetMacro(Version, unsigned long);
+
+  /// IDs of the nodes the snapshot was captured from, empty if none.
+  const char* GetTrajectoryNodeID();
+  const char* GetEntryListID();
+  const char* GetTargetListID();
+
+  /// Trajectories, in the order of vtkSlicerPathPlannerLogic::GetTrajectorySegments.
+  /// Segments have 6 components: entry and target world RAS.
+  vtkIdType GetNumberOfTrajectories();
+  const char* GetTrajectoryID(vtkIdType i);
+  vtkDoubleArray* GetSegments();
+
+  /// World coordinates (3 components) of the entry and target points.
+  vtkIdType GetNumberOfEntryPoints();
+  const char* GetEntryPointID(vtkIdType i);
+  vtkDoubleArray* GetEntryPoints();
+  vtkIdType GetNumberOfTargetPoints();
+  const char* GetTargetPointID(vtkIdType i);
+  vtkDoubleArray* GetTargetPoints();
+
+  /// Sampler of a captured volume, sampled at world RAS positions. NULL
+  /// if it was not captured.
+  int GetNumberOfVolumes();
+  const char* GetNthVolumeID(int n);
+  vtkSlicerPathPlannerVolumeSampler* GetVolume(const char* nodeID);
+
+protected:
+  vtkSlicerPathPlannerPlanSnapshot();
+  virtual ~vtkSlicerPathPlannerPlanSnapshot();
+
+  //BTX
+  struct PointSet
+  {
+    vtkSmartPointer<vtkDoubleArray> Points;
+    std::vector<std::string> IDs;
+  };
+  static void CapturePoints(vtkMRMLAnnotationHierarchyNode* list, PointSet* previous,
+                            PointSet& points);
+  static void ShareIfEqual(PointSet* previous, PointSet& points);
+
+  struct Volume
+  {
+    std::string ID;
+    unsigned long NodeMTime;
+    unsigned long ImageMTime;
+    vtkSmartPointer<vtkSlicerPathPlannerVolumeSampler> Sampler;
+  };
+
+  std::string TrajectoryNodeID;
+  std::string EntryListID;
+  std::string TargetListID;
+  PointSet Trajectories;
+  PointSet EntryPoints;
+  PointSet TargetPoints;
+  std::vector<Volume> Volumes;
+  //ETX
+
+  unsigned long Version;
+
+private:
+  vtkSlicerPathPlannerPlanSnapshot(const vtkSlicerPathPlannerPlanSnapshot&); // Not implemented
+  void operator=(const vtkSlicerPathPlannerPlanSnapshot&);               // Not implemented
+};
+
+#endif
@@ -0,0 +1,154 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerPlanSnapshot.h"
+#include "vtkSlicerPathPlannerPlanSnapshotStore.h"
+
+// VTK includes
+#include <vtkCriticalSection.h>
+#include <vtkObjectFactory.h>
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerPathPlannerPlanSnapshotStore);
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerPlanSnapshotStore::vtkSlicerPathPlannerPlanSnapshotStore()
+{
+  this->Lock = vtkSimpleCriticalSection::New();
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerPlanSnapshotStore::~vtkSlicerPathPlannerPlanSnapshotStore()
+{
+  // Workers must have released their snapshots
+  for (size_t i = 0; i < this->Entries.size(); i++)
+    {
+    if (this->Entries[i].Readers > 0)
+      {
+      vtkErrorMacro(<< "Snapshot " << this->Entries[i].Snapshot->GetVersion()
+                    << " is still read by " << this->Entries[i].Readers << " workers");
+      }
+    this->Entries[i].Snapshot->UnRegister(this);
+    }
+  this->Lock->Delete();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerPlanSnapshotStore::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  this->Lock->Lock();
+  for (size_t i = 0; i < this->Entries.size(); i++)
+    {
+    os << indent << "Snapshot " << this->Entries[i].Snapshot->GetVersion() << ": "
+       << this->Entries[i].Readers << " readers\n";
+    }
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerPlanSnapshotStore::Publish(vtkSlicerPathPlannerPlanSnapshot* snapshot)
+{
+  if (!snapshot)
+    {
+    return;
+    }
+  snapshot->Register(this);
+  Entry entry;
+  entry.Snapshot = snapshot;
+  entry.Readers = 0;
+
+  // Retired snapshots are deleted outside of the lock
+  std::vector<vtkSlicerPathPlannerPlanSnapshot*> retired;
+  this->Lock->Lock();
+  this->Entries.push_back(entry);
+  size_t kept = 0;
+  for (size_t i = 0; i + 1 < this->Entries.size(); i++)
+    {
+    if (this->Entries[i].Readers > 0)
+      {
+      this->Entries[kept++] = this->Entries[i];
+      }
+    else
+      {
+      retired.push_back(this->Entries[i].Snapshot);
+      }
+    }
+  this->Entries[kept++] = entry;
+  this->Entries.resize(kept);
+  this->Lock->Unlock();
+
+  for (size_t i = 0; i < retired.size(); i++)
+    {
+    retired[i]->UnRegister(this);
+    }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerPlanSnapshot* vtkSlicerPathPlannerPlanSnapshotStore::GetCurrent()
+{
+  return this->Entries.empty() ? NULL : this->Entries.back().Snapshot;
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerPlanSnapshot* vtkSlicerPathPlannerPlanSnapshotStore::Acquire()
+{
+  vtkSlicerPathPlannerPlanSnapshot* snapshot = NULL;
+  this->Lock->Lock();
+  if (!this->Entries.empty())
+    {
+    this->Entries.back().Readers++;
+    snapshot = this->Entries.back().Snapshot;
+    }
+  this->Lock->Unlock();
+  return snapshot;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerPlanSnapshotStore::Release(vtkSlicerPathPlannerPlanSnapshot* snapshot)
+{
+  if (!snapshot)
+    {
+    return;
+    }
+  this->Lock->Lock();
+  for (size_t i = 0; i < this->Entries.size(); i++)
+    {
+    if (this->Entries[i].Snapshot == snapshot && this->Entries[i].Readers > 0)
+      {
+      this->Entries[i].Readers--;
+      break;
+      }
+    }
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPlanSnapshotStore::GetNumberOfSnapshots()
+{
+  this->Lock->Lock();
+  int numberOfSnapshots = static_cast<int>(this->Entries.size());
+  this->Lock->Unlock();
+  return numberOfSnapshots;
+}
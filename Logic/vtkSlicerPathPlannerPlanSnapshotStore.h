@@ -0,0 +1,98 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// .NAME vtkSlicerPathPlannerPlanSnapshotStore - publishes plan snapshots
+// .SECTION Description
+// Holds the current vtkSlicerPathPlannerPlanSnapshot and the older ones
+// still read by workers. The thread editing the scene captures a new
+// snapshot and publishes it; any thread can acquire the current snapshot,
+// read it without locking, and release it when done. Publishing swaps the
+// current snapshot in a short critical section, so a worker sees either
+// the previous version or the new one, never a partial edit, and is never
+// blocked by a capture.
+//
+// VTK 5 reference counts are not atomic, so the store counts readers itself:
+// Acquire and Release do not touch the reference count of the snapshot,
+// and retired snapshots are deleted by Publish, in the main thread, once
+// their last reader has released them.
+
+#ifndef __vtkSlicerPathPlannerPlanSnapshotStore_h
+#define __vtkSlicerPathPlannerPlanSnapshotStore_h
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerPathPlannerModuleLogicExport.h"
+
+class vtkSimpleCriticalSection;
+class vtkSlicerPathPlannerPlanSnapshot;
+
+/// \ingroup Slicer_QtModules_PathPlanner
+class VTK_SLICER_PATHPLANNER_MODULE_LOGIC_EXPORT vtkSlicerPathPlannerPlanSnapshotStore :
+  public vtkObject
+{
+public:
+  static vtkSlicerPathPlannerPlanSnapshotStore *New();
+  vtkTypeMacro(vtkSlicerPathPlannerPlanSnapshotStore, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Make "snapshot" the current one. It must not be modified afterwards.
+  /// Also deletes the retired snapshots without readers. Main thread only.
+  void Publish(vtkSlicerPathPlannerPlanSnapshot* snapshot);
+
+  /// Current snapshot, NULL if none was published. Main thread only: a
+  /// later Publish may delete it.
+  vtkSlicerPathPlannerPlanSnapshot* GetCurrent();
+
+  /// Current snapshot, kept alive until released. Thread safe. Return
+  /// NULL if none was published.
+  vtkSlicerPathPlannerPlanSnapshot* Acquire();
+  void Release(vtkSlicerPathPlannerPlanSnapshot* snapshot);
+
+  /// Number of snapshots kept: the current one and the retired ones that
+  /// still have readers.
+  int GetNumberOfSnapshots();
+
+protected:
+  vtkSlicerPathPlannerPlanSnapshotStore();
+  virtual ~vtkSlicerPathPlannerPlanSnapshotStore();
+
+  //BTX
+  struct Entry
+  {
+    vtkSlicerPathPlannerPlanSnapshot* Snapshot;
+    int Readers;
+  };
+  // Current snapshot last
+  std::vector<Entry> Entries;
+  //ETX
+  vtkSimpleCriticalSection* Lock;
+
+private:
+  vtkSlicerPathPlannerPlanSnapshotStore(const vtkSlicerPathPlannerPlanSnapshotStore&); // Not implemented
+  void operator=(const vtkSlicerPathPlannerPlanSnapshotStore&);               // Not implemented
+};
+
+#endif
@@ -0,0 +1,598 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerPlanSync.h"
+
+// VTK includes
+#include <vtkByteSwap.h>
+#include <vtkClientSocket.h>
+#include <vtkObjectFactory.h>
+#include <vtkServerSocket.h>
+#include <vtkUnsignedCharArray.h>
+
+// STD includes
+#include <cstring>
+
+namespace
+{
+const char Magic[4] = { 'P', 'P', 'S', 'Y' };
+
+// Message kinds
+const unsigned char DeltaMessage = 1;
+const unsigned char FullMessage = 2;
+const unsigned char FullRequestMessage = 3;
+
+// Magic, kind, sequence, number of items
+const size_t HeaderSize = 4 + 1 + 4 + 4;
+
+//----------------------------------------------------------------------------
+void WriteUInt32(std::string& buffer, vtkTypeUInt32 value)
+{
+  vtkByteSwap::SwapLE(&value);
+  buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+//----------------------------------------------------------------------------
+void WriteString(std::string& buffer, const std::string& value)
+{
+  vtkTypeUInt16 length = static_cast<vtkTypeUInt16>(
+    value.size() < VTK_UNSIGNED_SHORT_MAX ? value.size() : VTK_UNSIGNED_SHORT_MAX);
+  vtkTypeUInt16 storedLength = length;
+  vtkByteSwap::SwapLE(&storedLength);
+  buffer.append(reinterpret_cast<const char*>(&storedLength), sizeof(storedLength));
+  buffer.append(value, 0, length);
+}
+
+//----------------------------------------------------------------------------
+void WriteDoubles(std::string& buffer, const double* values, int numberOfValues)
+{
+  for (int i = 0; i < numberOfValues; i++)
+    {
+    double value = values[i];
+    vtkByteSwap::SwapLE(&value);
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+}
+
+//----------------------------------------------------------------------------
+// Bounds checked reader of a message
+struct MessageReader
+{
+  const unsigned char* Data;
+  size_t Size;
+  size_t Offset;
+  bool Valid;
+
+  bool Read(void* value, size_t size)
+  {
+    if (!this->Valid || this->Offset + size > this->Size)
+      {
+      this->Valid = false;
+      return false;
+      }
+    memcpy(value, this->Data + this->Offset, size);
+    this->Offset += size;
+    return true;
+  }
+  unsigned char ReadUInt8()
+  {
+    unsigned char value = 0;
+    this->Read(&value, 1);
+    return value;
+  }
+  vtkTypeUInt32 ReadUInt32()
+  {
+    vtkTypeUInt32 value = 0;
+    this->Read(&value, sizeof(value));
+    vtkByteSwap::SwapLE(&value);
+    return value;
+  }
+  std::string ReadString()
+  {
+    vtkTypeUInt16 length = 0;
+    this->Read(&length, sizeof(length));
+    vtkByteSwap::SwapLE(&length);
+    if (!this->Valid || this->Offset + length > this->Size)
+      {
+      this->Valid = false;
+      return std::string();
+      }
+    std::string value(reinterpret_cast<const char*>(this->Data + this->Offset), length);
+    this->Offset += length;
+    return value;
+  }
+  void ReadDoubles(double* values, int numberOfValues)
+  {
+    for (int i = 0; i < numberOfValues; i++)
+      {
+      values[i] = 0.0;
+      this->Read(values + i, sizeof(double));
+      vtkByteSwap::SwapLE(values + i);
+      }
+  }
+};
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerPathPlannerPlanSync);
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerPlanSync::vtkSlicerPathPlannerPlanSync()
+{
+  this->Server = NULL;
+  this->Socket = NULL;
+  this->Sequence = 0;
+  this->LastMessageSize = 0;
+  this->FullCopyPending = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerPlanSync::~vtkSlicerPathPlannerPlanSync()
+{
+  this->Disconnect();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerPlanSync::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfRemoteItems: " << this->RemoteItems.size() << "\n";
+  os << indent << "Listening: " << (this->Server ? 1 : 0) << "\n";
+  os << indent << "Connected: " << (this->Socket ? 1 : 0) << "\n";
+  os << indent << "Sequence: " << this->Sequence << "\n";
+  os << indent << "LastMessageSize: " << this->LastMessageSize << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerPlanSync::Encode(unsigned char kind, const ItemMap& items,
+                                          const std::vector<std::string>& removed,
+                                          vtkUnsignedCharArray* message)
+{
+  std::string buffer;
+  buffer.append(Magic, sizeof(Magic));
+  buffer += static_cast<char>(kind);
+  WriteUInt32(buffer, this->Sequence);
+  WriteUInt32(buffer, static_cast<vtkTypeUInt32>(items.size() + removed.size()));
+  for (ItemMap::const_iterator it = items.begin(); it != items.end(); ++it)
+    {
+    buffer += static_cast<char>(it->second.Type);
+    WriteString(buffer, it->first);
+    WriteString(buffer, it->second.Name);
+    if (it->second.Type == Trajectory)
+      {
+      WriteString(buffer, it->second.EntryID);
+      WriteString(buffer, it->second.TargetID);
+      }
+    else
+      {
+      WriteDoubles(buffer, it->second.Position, 3);
+      }
+    }
+  for (std::vector<std::string>::const_iterator it = removed.begin(); it != removed.end(); ++it)
+    {
+    buffer += static_cast<char>(Removed);
+    WriteString(buffer, *it);
+    }
+
+  message->SetNumberOfComponents(1);
+  message->SetNumberOfTuples(static_cast<vtkIdType>(buffer.size()));
+  memcpy(message->GetPointer(0), buffer.data(), buffer.size());
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPlanSync::EncodeDelta(vtkUnsignedCharArray* message)
+{
+  if (!message)
+    {
+    return 0;
+    }
+
+  ItemMap changed;
+  std::vector<std::string> removed;
+  int numberOfItems = this->Diff(&changed, &removed);
+  if (numberOfItems == 0)
+    {
+    message->SetNumberOfComponents(1);
+    message->SetNumberOfTuples(0);
+    return 0;
+    }
+  ++this->Sequence;
+  this->Encode(DeltaMessage, changed, removed, message);
+
+  // Only the changes are copied
+  for (ItemMap::iterator it = changed.begin(); it != changed.end(); ++it)
+    {
+    this->ReferenceItems[it->first] = it->second;
+    }
+  for (std::vector<std::string>::iterator it = removed.begin(); it != removed.end(); ++it)
+    {
+    this->ReferenceItems.erase(*it);
+    }
+  return numberOfItems;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerPlanSync::EncodeFull(vtkUnsignedCharArray* message)
+{
+  if (!message)
+    {
+    return;
+    }
+  this->Diff(NULL, NULL);
+  this->Encode(FullMessage, this->Items, std::vector<std::string>(), message);
+  this->ReferenceItems = this->Items;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPlanSync::Decode(const unsigned char* data, vtkIdType size)
+{
+  MessageReader reader;
+  reader.Data = data;
+  reader.Size = data && size > 0 ? static_cast<size_t>(size) : 0;
+  reader.Offset = 0;
+  reader.Valid = true;
+
+  char magic[sizeof(Magic)];
+  reader.Read(magic, sizeof(magic));
+  unsigned char kind = reader.ReadUInt8();
+  unsigned int sequence = reader.ReadUInt32();
+  vtkTypeUInt32 numberOfItems = reader.ReadUInt32();
+  if (!reader.Valid || memcmp(magic, Magic, sizeof(Magic)) != 0 ||
+      (kind != DeltaMessage && kind != FullMessage))
+    {
+    return -1;
+    }
+  if (kind == DeltaMessage && sequence != this->Sequence + 1)
+    {
+    return 0;
+    }
+
+  // Decode everything before touching the remote plan
+  ItemMap items;
+  std::vector<std::string> removed;
+  for (vtkTypeUInt32 i = 0; i < numberOfItems && reader.Valid; i++)
+    {
+    Item item;
+    item.Updated = true;
+    item.Type = reader.ReadUInt8();
+    std::string id = reader.ReadString();
+    if (item.Type == Removed)
+      {
+      removed.push_back(id);
+      continue;
+      }
+    item.Name = reader.ReadString();
+    item.Position[0] = item.Position[1] = item.Position[2] = 0.0;
+    if (item.Type == Trajectory)
+      {
+      item.EntryID = reader.ReadString();
+      item.TargetID = reader.ReadString();
+      }
+    else if (item.Type == EntryFiducial || item.Type == TargetFiducial)
+      {
+      reader.ReadDoubles(item.Position, 3);
+      }
+    else
+      {
+      reader.Valid = false;
+      }
+    items[id] = item;
+    }
+  if (!reader.Valid)
+    {
+    return -1;
+    }
+
+  // A full copy removes what it does not contain
+  if (kind == FullMessage)
+    {
+    for (ItemMap::iterator it = this->RemoteItems.begin(); it != this->RemoteItems.end(); ++it)
+      {
+      if (items.find(it->first) == items.end())
+        {
+        removed.push_back(it->first);
+        }
+      }
+    }
+
+  // Fiducials before the trajectories using them, removals last and in the
+  // opposite order
+  for (int type = EntryFiducial; type <= Trajectory; type++)
+    {
+    for (ItemMap::iterator it = items.begin(); it != items.end(); ++it)
+      {
+      ItemMap::iterator remote = this->RemoteItems.find(it->first);
+      if (it->second.Type != type ||
+          (remote != this->RemoteItems.end() && remote->second == it->second))
+        {
+        continue;
+        }
+      this->RemoteItems[it->first] = it->second;
+      Change change;
+      change.ID = it->first;
+      change.Value = it->second;
+      this->Changes.push_back(change);
+      }
+    }
+  for (int type = Trajectory; type >= EntryFiducial; type--)
+    {
+    for (std::vector<std::string>::iterator it = removed.begin(); it != removed.end(); ++it)
+      {
+      ItemMap::iterator remote = this->RemoteItems.find(*it);
+      if (remote == this->RemoteItems.end() || remote->second.Type != type)
+        {
+        continue;
+        }
+      Change change;
+      change.ID = *it;
+      change.Value = remote->second;
+      change.Value.Type = Removed;
+      this->Changes.push_back(change);
+      this->RemoteItems.erase(remote);
+      }
+    }
+
+  this->Sequence = sequence;
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerPlanSync::SetLocalNodeID(const char* remoteID, const char* localID)
+{
+  if (!remoteID)
+    {
+    return;
+    }
+  if (localID)
+    {
+    this->LocalNodeIDs[remoteID] = localID;
+    }
+  else
+    {
+    this->LocalNodeIDs.erase(remoteID);
+    }
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerPlanSync::GetLocalNodeID(const char* remoteID)
+{
+  std::map<std::string, std::string>::iterator it =
+    remoteID ? this->LocalNodeIDs.find(remoteID) : this->LocalNodeIDs.end();
+  return it != this->LocalNodeIDs.end() ? it->second.c_str() : NULL;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPlanSync::Listen(int port)
+{
+  this->Disconnect();
+  vtkServerSocket* server = vtkServerSocket::New();
+  if (server->CreateServer(port) != 0)
+    {
+    vtkErrorMacro(<< "Listen: cannot listen on port " << port);
+    server->Delete();
+    return 0;
+    }
+  this->Server = server;
+  this->Sequence = 0;
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPlanSync::Connect(const char* hostName, int port)
+{
+  this->Disconnect();
+  if (!hostName)
+    {
+    return 0;
+    }
+  vtkClientSocket* socket = vtkClientSocket::New();
+  if (socket->ConnectToServer(hostName, port) != 0)
+    {
+    vtkErrorMacro(<< "Connect: cannot connect to " << hostName << ":" << port);
+    socket->Delete();
+    return 0;
+    }
+  this->Socket = socket;
+
+  // The receiver may still hold the plan of a previous connection: start
+  // with a full copy, which removes the items it does not contain
+  this->ReferenceItems.clear();
+  this->Sequence = 0;
+  this->FullCopyPending = 1;
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerPlanSync::Disconnect()
+{
+  if (this->Socket)
+    {
+    this->Socket->CloseSocket();
+    this->Socket->Delete();
+    this->Socket = NULL;
+    }
+  if (this->Server)
+    {
+    this->Server->CloseSocket();
+    this->Server->Delete();
+    this->Server = NULL;
+    }
+  this->Pending.clear();
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPlanSync::IsConnected()
+{
+  return this->Socket && this->Socket->GetConnected() ? 1 : 0;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPlanSync::SendMessage(vtkUnsignedCharArray* message)
+{
+  // Length prefixed
+  std::string frame;
+  WriteUInt32(frame, static_cast<vtkTypeUInt32>(message->GetNumberOfTuples()));
+  frame.append(reinterpret_cast<const char*>(message->GetPointer(0)),
+               message->GetNumberOfTuples());
+  this->LastMessageSize = static_cast<vtkIdType>(frame.size());
+  if (!this->Socket->Send(frame.data(), static_cast<int>(frame.size())))
+    {
+    vtkWarningMacro(<< "SendMessage: connection lost");
+    this->Socket->Delete();
+    this->Socket = NULL;
+    return 0;
+    }
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPlanSync::SendDelta()
+{
+  if (!this->Socket)
+    {
+    return -1;
+    }
+  vtkUnsignedCharArray* message = vtkUnsignedCharArray::New();
+  int numberOfItems = 0;
+  if (this->FullCopyPending)
+    {
+    this->EncodeFull(message);
+    numberOfItems = this->GetNumberOfItems();
+    if (this->SendMessage(message))
+      {
+      this->FullCopyPending = 0;
+      }
+    else
+      {
+      numberOfItems = -1;
+      }
+    }
+  else
+    {
+    numberOfItems = this->EncodeDelta(message);
+    if (numberOfItems > 0 && !this->SendMessage(message))
+      {
+      numberOfItems = -1;
+      }
+    }
+  message->Delete();
+  return numberOfItems;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPlanSync::ReceiveMessages()
+{
+  // Read until a whole message is available, waiting at most 1 ms for
+  // each read. A zero timeout would block.
+  char buffer[65536];
+  int socketDescriptor = this->Socket->GetSocketDescriptor();
+  int selected = -1;
+  while (vtkSocket::SelectSockets(&socketDescriptor, 1, 1, &selected) > 0)
+    {
+    int received = this->Socket->Receive(buffer, sizeof(buffer), 0);
+    if (received <= 0)
+      {
+      this->Socket->Delete();
+      this->Socket = NULL;
+      break;
+      }
+    this->Pending.append(buffer, received);
+    vtkTypeUInt32 length = 0;
+    if (this->Pending.size() >= 4)
+      {
+      memcpy(&length, this->Pending.data(), sizeof(length));
+      vtkByteSwap::SwapLE(&length);
+      if (this->Pending.size() - 4 >= length)
+        {
+        break;
+        }
+      }
+    }
+
+  int numberOfChanges = static_cast<int>(this->Changes.size());
+  bool requestFullCopy = false;
+  size_t offset = 0;
+  while (this->Pending.size() - offset >= 4)
+    {
+    vtkTypeUInt32 length;
+    memcpy(&length, this->Pending.data() + offset, sizeof(length));
+    vtkByteSwap::SwapLE(&length);
+    if (this->Pending.size() - offset - 4 < length)
+      {
+      break;
+      }
+    const unsigned char* message =
+      reinterpret_cast<const unsigned char*>(this->Pending.data() + offset + 4);
+    offset += 4 + length;
+
+    if (length >= HeaderSize && memcmp(message, Magic, sizeof(Magic)) == 0 &&
+        message[sizeof(Magic)] == FullRequestMessage)
+      {
+      // Sender side
+      vtkUnsignedCharArray* full = vtkUnsignedCharArray::New();
+      this->EncodeFull(full);
+      if (this->Socket)
+        {
+        this->SendMessage(full);
+        }
+      full->Delete();
+      continue;
+      }
+    int status = this->Decode(message, length);
+    if (status == 0)
+      {
+      requestFullCopy = true;
+      }
+    else if (status < 0)
+      {
+      vtkWarningMacro(<< "ReceiveMessages: invalid message ignored");
+      }
+    }
+  this->Pending.erase(0, offset);
+
+  if (requestFullCopy && this->Socket)
+    {
+    vtkUnsignedCharArray* request = vtkUnsignedCharArray::New();
+    this->Encode(FullRequestMessage, ItemMap(), std::vector<std::string>(), request);
+    this->SendMessage(request);
+    request->Delete();
+    }
+  return static_cast<int>(this->Changes.size()) - numberOfChanges;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerPlanSync::Poll()
+{
+  // One sender at a time, accepted once the previous one is gone
+  if (this->Server && !this->Socket)
+    {
+    this->Socket = this->Server->WaitForConnection(1);
+    this->Pending.clear();
+    this->Sequence = 0;
+    }
+  if (!this->Socket)
+    {
+    return 0;
+    }
+  return this->ReceiveMessages();
+}
@@ -0,0 +1,135 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// .NAME vtkSlicerPathPlannerPlanSync - keep a plan in sync between workstations
+// .SECTION Description
+// Sends the changes of a plan (entry and target fiducials, trajectories)
+// from a planning workstation to another one, e.g. in the OR, instead of
+// transferring whole scenes.
+//
+// The sender describes its current plan between BeginUpdate and
+// EndUpdate (see vtkSlicerPathPlannerPlanDescription); items are
+// identified by the node IDs of the sender. Only the
+// items added, modified or removed since the last message are encoded, in
+// a compact little endian binary message numbered by a sequence number.
+// The receiver decodes the messages into its copy of the plan and lists
+// the changes to apply to its scene. A message that does not follow the
+// last one applied (lost or reordered) is ignored and a full copy of the
+// plan is requested instead.
+//
+// Messages are sent over a socket: the receiver listens, the sender
+// connects. Poll waits at most a few milliseconds and is meant to be
+// called from a timer on both sides. Encode and Decode can be used
+// without socket, e.g. to test a loopback.
+
+#ifndef __vtkSlicerPathPlannerPlanSync_h
+#define __vtkSlicerPathPlannerPlanSync_h
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerPlanDescription.h"
+
+#include "vtkSlicerPathPlannerModuleLogicExport.h"
+
+class vtkClientSocket;
+class vtkServerSocket;
+class vtkUnsignedCharArray;
+
+/// \ingroup Slicer_QtModules_PathPlanner
+class VTK_SLICER_PATHPLANNER_MODULE_LOGIC_EXPORT vtkSlicerPathPlannerPlanSync :
+  public vtkSlicerPathPlannerPlanDescription
+{
+public:
+  static vtkSlicerPathPlannerPlanSync *New();
+  vtkTypeMacro(vtkSlicerPathPlannerPlanSync, vtkSlicerPathPlannerPlanDescription);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Encode the changes since the last message, and make them the new
+  /// reference. Return the number of items in the message, 0 when there
+  /// is nothing to send ("message" is then empty).
+  int EncodeDelta(vtkUnsignedCharArray* message);
+
+  /// Encode the whole plan, e.g. for a receiver that lost track.
+  void EncodeFull(vtkUnsignedCharArray* message);
+
+  /// Receiver: apply a message to the copy of the remote plan and list its
+  /// changes (see GetNumberOfChanges). Return 1 if applied, 0 if out of sequence (ignored, a full
+  /// copy is needed), -1 if invalid.
+  int Decode(const unsigned char* data, vtkIdType size);
+
+  /// Local node created for a remote item, NULL if none.
+  void SetLocalNodeID(const char* remoteID, const char* localID);
+  const char* GetLocalNodeID(const char* remoteID);
+
+  /// Receiver side: accept a sender on "port". Return 0 on failure.
+  int Listen(int port);
+
+  /// Sender side: connect to a receiver. The next SendDelta sends a full
+  /// copy of the plan. Return 0 on failure.
+  int Connect(const char* hostName, int port);
+
+  /// Close the sockets.
+  void Disconnect();
+  int IsConnected();
+
+  /// Sender: send the changes of the plan, if any, or the whole plan for
+  /// the first message after Connect. Return the number of items sent, -1
+  /// if not connected.
+  int SendDelta();
+
+  /// Accept a pending sender, receive the pending messages (receiver) and
+  /// answer full copy requests (sender). Waits 1 ms when there is nothing
+  /// to read. Return the number of changes received.
+  int Poll();
+
+  /// Sequence number of the last message sent or applied
+  vtkGetMacro(Sequence, unsigned int);
+
+  /// Number of bytes of the last message sent
+  vtkGetMacro(LastMessageSize, vtkIdType);
+
+protected:
+  vtkSlicerPathPlannerPlanSync();
+  virtual ~vtkSlicerPathPlannerPlanSync();
+
+  //BTX
+  void Encode(unsigned char kind, const ItemMap& items, const std::vector<std::string>& removed,
+              vtkUnsignedCharArray* message);
+  int SendMessage(vtkUnsignedCharArray* message);
+  int ReceiveMessages();
+
+  ItemMap RemoteItems;
+  std::map<std::string, std::string> LocalNodeIDs;
+  std::string Pending;
+  //ETX
+
+  vtkServerSocket* Server;
+  vtkClientSocket* Socket;
+  unsigned int Sequence;
+  vtkIdType LastMessageSize;
+  int FullCopyPending;
+
+private:
+  vtkSlicerPathPlannerPlanSync(const vtkSlicerPathPlannerPlanSync&); // Not implemented
+  void operator=(const vtkSlicerPathPlannerPlanSync&);               // Not implemented
+};
+
+#endif
@@ -0,0 +1,116 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// .NAME vtkSlicerPathPlannerRandom - small random generator for worker threads
+// .SECTION Description
+// xorshift128+ generator seeded through splitmix64. Unlike vtkMath::Random()
+// it has no global state, so each worker owns its own stream: seeding with
+// (seed, stream) gives independent, reproducible sequences whatever the
+// number of threads.
+
+#ifndef __vtkSlicerPathPlannerRandom_h
+#define __vtkSlicerPathPlannerRandom_h
+
+// VTK includes
+#include <vtkType.h>
+
+// STD includes
+#include <cmath>
+
+//BTX
+class vtkSlicerPathPlannerRandom
+{
+public:
+  vtkSlicerPathPlannerRandom(vtkTypeUInt64 seed = 0, vtkTypeUInt64 stream = 0)
+  {
+    this->Seed(seed, stream);
+  }
+
+  void Seed(vtkTypeUInt64 seed, vtkTypeUInt64 stream = 0)
+  {
+    vtkTypeUInt64 state = seed ^ (stream * 0x9E3779B97F4A7C15ULL);
+    this->State[0] = SplitMix64(state);
+    this->State[1] = SplitMix64(state);
+    this->HasSpareGaussian = false;
+    this->SpareGaussian = 0.0;
+  }
+
+  vtkTypeUInt64 NextInteger()
+  {
+    vtkTypeUInt64 s1 = this->State[0];
+    const vtkTypeUInt64 s0 = this->State[1];
+    this->State[0] = s0;
+    s1 ^= s1 << 23;
+    this->State[1] = s1 ^ s0 ^ (s1 >> 17) ^ (s0 >> 26);
+    return this->State[1] + s0;
+  }
+
+  /// Uniform value in [0, 1)
+  double NextUniform()
+  {
+    return static_cast<double>(this->NextInteger() >> 11) * (1.0 / 9007199254740992.0);
+  }
+
+  /// Uniform value in [minimum, maximum)
+  double NextUniform(double minimum, double maximum)
+  {
+    return minimum + (maximum - minimum) * this->NextUniform();
+  }
+
+  /// Standard normal value (Marsaglia polar method)
+  double NextGaussian()
+  {
+    if (this->HasSpareGaussian)
+      {
+      this->HasSpareGaussian = false;
+      return this->SpareGaussian;
+      }
+    double u, v, s;
+    do
+      {
+      u = 2.0 * this->NextUniform() - 1.0;
+      v = 2.0 * this->NextUniform() - 1.0;
+      s = u * u + v * v;
+      }
+    while (s >= 1.0 || s == 0.0);
+    s = std::sqrt(-2.0 * std::log(s) / s);
+    this->SpareGaussian = v * s;
+    this->HasSpareGaussian = true;
+    return u * s;
+  }
+
+private:
+  static vtkTypeUInt64 SplitMix64(vtkTypeUInt64& state)
+  {
+    vtkTypeUInt64 z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+  vtkTypeUInt64 State[2];
+  bool HasSpareGaussian;
+  double SpareGaussian;
+};
+//ETX
+
+#endif
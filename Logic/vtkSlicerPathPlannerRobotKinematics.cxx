@@ -0,0 +1,467 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerParallel.h"
+#include "vtkSlicerPathPlannerRobotKinematics.h"
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkIntArray.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <cmath>
+#include <sstream>
+
+namespace
+{
+// Trajectories are processed in blocks stored as separate coordinate
+// arrays, so that the arithmetic loops have no branches and unit stride
+const int BlockSize = 64;
+
+//----------------------------------------------------------------------------
+struct InverseKinematicsFunctor
+{
+  const double* Segments;
+  double* Joints;
+  int* Violations;
+  int* Collisions;
+  double Rotation[3][3];
+  double Translation[3];
+  double Ranges[vtkSlicerPathPlannerRobotKinematics::NumberOfJoints][2];
+  double BoreRadius2;
+  double BoreCenter[3];
+  double BoreAxis[3];
+  double NeedleLength;
+
+  void operator()(vtkIdType begin, vtkIdType end, int vtkNotUsed(threadId))
+  {
+    for (vtkIdType blockBegin = begin; blockBegin < end; blockBegin += BlockSize)
+      {
+      int count = static_cast<int>(end - blockBegin < BlockSize ? end - blockBegin : BlockSize);
+      this->SolveBlock(blockBegin, count);
+      }
+  }
+
+  void SolveBlock(vtkIdType first, int count)
+  {
+    double tx[BlockSize], ty[BlockSize], tz[BlockSize];
+    double dx[BlockSize], dy[BlockSize], dz[BlockSize];
+    double joints[vtkSlicerPathPlannerRobotKinematics::NumberOfJoints][BlockSize];
+    int violations[BlockSize];
+    int collisions[BlockSize];
+    const double* segments = this->Segments + 6 * first;
+    int i;
+
+    // RAS to robot (rigid: transposed rotation)
+    for (i = 0; i < count; i++)
+      {
+      const double* s = segments + 6 * i;
+      double x = s[3] - this->Translation[0];
+      double y = s[4] - this->Translation[1];
+      double z = s[5] - this->Translation[2];
+      tx[i] = this->Rotation[0][0] * x + this->Rotation[1][0] * y + this->Rotation[2][0] * z;
+      ty[i] = this->Rotation[0][1] * x + this->Rotation[1][1] * y + this->Rotation[2][1] * z;
+      tz[i] = this->Rotation[0][2] * x + this->Rotation[1][2] * y + this->Rotation[2][2] * z;
+      x = s[3] - s[0];
+      y = s[4] - s[1];
+      z = s[5] - s[2];
+      dx[i] = this->Rotation[0][0] * x + this->Rotation[1][0] * y + this->Rotation[2][0] * z;
+      dy[i] = this->Rotation[0][1] * x + this->Rotation[1][1] * y + this->Rotation[2][1] * z;
+      dz[i] = this->Rotation[0][2] * x + this->Rotation[1][2] * y + this->Rotation[2][2] * z;
+      }
+
+    // Unit direction; degenerate directions are flagged and made harmless
+    for (i = 0; i < count; i++)
+      {
+      double norm2 = dx[i] * dx[i] + dy[i] * dy[i] + dz[i] * dz[i];
+      double inverse = 1.0 / std::sqrt(norm2 > 1e-300 ? norm2 : 1e-300);
+      dx[i] *= inverse;
+      dy[i] *= inverse;
+      dz[i] *= inverse;
+      violations[i] = (dz[i] > 1e-9) ? 0 : vtkSlicerPathPlannerRobotKinematics::InvalidDirection;
+      dz[i] = dz[i] > 1e-9 ? dz[i] : 1e-9;
+      }
+
+    // Guide point on z = 0 and depth
+    for (i = 0; i < count; i++)
+      {
+      double depth = tz[i] / dz[i];
+      joints[vtkSlicerPathPlannerRobotKinematics::X][i] = tx[i] - depth * dx[i];
+      joints[vtkSlicerPathPlannerRobotKinematics::Y][i] = ty[i] - depth * dy[i];
+      joints[vtkSlicerPathPlannerRobotKinematics::Depth][i] = depth;
+      }
+    for (i = 0; i < count; i++)
+      {
+      double sine = -dy[i];
+      sine = sine < 1.0 ? (sine > -1.0 ? sine : -1.0) : 1.0;
+      joints[vtkSlicerPathPlannerRobotKinematics::Pitch][i] =
+        vtkMath::DegreesFromRadians(std::asin(sine));
+      joints[vtkSlicerPathPlannerRobotKinematics::Yaw][i] =
+        vtkMath::DegreesFromRadians(std::atan2(dx[i], dz[i]));
+      }
+
+    // Joint limits
+    for (int joint = 0; joint < vtkSlicerPathPlannerRobotKinematics::NumberOfJoints; joint++)
+      {
+      const double minimum = this->Ranges[joint][0];
+      const double maximum = this->Ranges[joint][1];
+      const double* values = joints[joint];
+      for (i = 0; i < count; i++)
+        {
+        violations[i] |= ((values[i] < minimum) | (values[i] > maximum)) << joint;
+        }
+      }
+
+    // Bore clearance of the guide point and of the needle hub. The
+    // segment between them stays inside the convex cylinder if both do.
+    for (i = 0; i < count; i++)
+      {
+      const double* s = segments + 6 * i;
+      double rasDirection[3] = { s[3] - s[0], s[4] - s[1], s[5] - s[2] };
+      double norm = std::sqrt(rasDirection[0] * rasDirection[0] +
+        rasDirection[1] * rasDirection[1] + rasDirection[2] * rasDirection[2]);
+      double inverse = norm > 0.0 ? 1.0 / norm : 0.0;
+      double depth = joints[vtkSlicerPathPlannerRobotKinematics::Depth][i];
+      int outside = 0;
+      for (int end = 0; end < 2; end++)
+        {
+        double back = end ? this->NeedleLength : depth;
+        double offset[3];
+        for (int k = 0; k < 3; k++)
+          {
+          offset[k] = s[3 + k] - back * rasDirection[k] * inverse - this->BoreCenter[k];
+          }
+        double along = offset[0] * this->BoreAxis[0] + offset[1] * this->BoreAxis[1] +
+          offset[2] * this->BoreAxis[2];
+        double radial2 = offset[0] * offset[0] + offset[1] * offset[1] +
+          offset[2] * offset[2] - along * along;
+        outside |= (radial2 > this->BoreRadius2);
+        }
+      collisions[i] = outside;
+      }
+
+    // Interleave the outputs
+    if (this->Joints)
+      {
+      double* output = this->Joints + 5 * first;
+      for (i = 0; i < count; i++)
+        {
+        for (int joint = 0; joint < vtkSlicerPathPlannerRobotKinematics::NumberOfJoints; joint++)
+          {
+          output[5 * i + joint] = joints[joint][i];
+          }
+        }
+      }
+    for (i = 0; i < count; i++)
+      {
+      if (this->Violations)
+        {
+        this->Violations[first + i] = violations[i];
+        }
+      if (this->Collisions)
+        {
+        this->Collisions[first + i] = collisions[i];
+        }
+      }
+  }
+};
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerPathPlannerRobotKinematics);
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerRobotKinematics::vtkSlicerPathPlannerRobotKinematics()
+{
+  this->XRange[0] = -50.0;
+  this->XRange[1] = 50.0;
+  this->YRange[0] = -50.0;
+  this->YRange[1] = 50.0;
+  this->PitchRange[0] = -30.0;
+  this->PitchRange[1] = 30.0;
+  this->YawRange[0] = -30.0;
+  this->YawRange[1] = 30.0;
+  this->DepthRange[0] = 0.0;
+  this->DepthRange[1] = 150.0;
+  for (int i = 0; i < 3; i++)
+    {
+    for (int j = 0; j < 4; j++)
+      {
+      this->RobotToRASMatrix[i][j] = (i == j) ? 1.0 : 0.0;
+      }
+    }
+  this->BoreRadius = 300.0;
+  this->BoreCenter[0] = this->BoreCenter[1] = this->BoreCenter[2] = 0.0;
+  this->BoreAxis[0] = 0.0;
+  this->BoreAxis[1] = 0.0;
+  this->BoreAxis[2] = 1.0;
+  this->NeedleLength = 200.0;
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerRobotKinematics::~vtkSlicerPathPlannerRobotKinematics()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerRobotKinematics::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "XRange: " << this->XRange[0] << " " << this->XRange[1] << "\n";
+  os << indent << "YRange: " << this->YRange[0] << " " << this->YRange[1] << "\n";
+  os << indent << "PitchRange: " << this->PitchRange[0] << " " << this->PitchRange[1] << "\n";
+  os << indent << "YawRange: " << this->YawRange[0] << " " << this->YawRange[1] << "\n";
+  os << indent << "DepthRange: " << this->DepthRange[0] << " " << this->DepthRange[1] << "\n";
+  os << indent << "BoreRadius: " << this->BoreRadius << "\n";
+  os << indent << "BoreCenter: " << this->BoreCenter[0] << " " << this->BoreCenter[1]
+     << " " << this->BoreCenter[2] << "\n";
+  os << indent << "BoreAxis: " << this->BoreAxis[0] << " " << this->BoreAxis[1]
+     << " " << this->BoreAxis[2] << "\n";
+  os << indent << "NeedleLength: " << this->NeedleLength << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerRobotKinematics::GetJointRange(int joint, double range[2])
+{
+  const double* ranges[NumberOfJoints] = {
+    this->XRange, this->YRange, this->PitchRange, this->YawRange, this->DepthRange };
+  if (joint < 0 || joint >= NumberOfJoints)
+    {
+    range[0] = range[1] = 0.0;
+    return;
+    }
+  range[0] = ranges[joint][0];
+  range[1] = ranges[joint][1];
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerRobotKinematics::SetRobotToRASMatrix(vtkMatrix4x4* matrix)
+{
+  if (!matrix)
+    {
+    return;
+    }
+  bool modified = false;
+  for (int i = 0; i < 3; i++)
+    {
+    for (int j = 0; j < 4; j++)
+      {
+      modified |= (this->RobotToRASMatrix[i][j] != matrix->GetElement(i, j));
+      this->RobotToRASMatrix[i][j] = matrix->GetElement(i, j);
+      }
+    }
+  if (modified)
+    {
+    this->Modified();
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerRobotKinematics::GetRobotToRASMatrix(vtkMatrix4x4* matrix)
+{
+  if (!matrix)
+    {
+    return;
+    }
+  matrix->Identity();
+  for (int i = 0; i < 3; i++)
+    {
+    for (int j = 0; j < 4; j++)
+      {
+      matrix->SetElement(i, j, this->RobotToRASMatrix[i][j]);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerRobotKinematics::RASToRobot(const double ras[3], double robot[3]) const
+{
+  // Rigid transform: the inverse rotation is the transpose
+  double offset[3] = { ras[0] - this->RobotToRASMatrix[0][3],
+                       ras[1] - this->RobotToRASMatrix[1][3],
+                       ras[2] - this->RobotToRASMatrix[2][3] };
+  this->RASToRobotDirection(offset, robot);
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerRobotKinematics::RASToRobotDirection(const double ras[3],
+                                                              double robot[3]) const
+{
+  for (int i = 0; i < 3; i++)
+    {
+    robot[i] = this->RobotToRASMatrix[0][i] * ras[0] +
+      this->RobotToRASMatrix[1][i] * ras[1] + this->RobotToRASMatrix[2][i] * ras[2];
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerRobotKinematics::RobotToRAS(const double robot[3], double ras[3]) const
+{
+  for (int i = 0; i < 3; i++)
+    {
+    ras[i] = this->RobotToRASMatrix[i][0] * robot[0] + this->RobotToRASMatrix[i][1] * robot[1] +
+      this->RobotToRASMatrix[i][2] * robot[2] + this->RobotToRASMatrix[i][3];
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerRobotKinematics::GetNeedleDirection(double pitch, double yaw,
+                                                             double direction[3])
+{
+  double a = vtkMath::RadiansFromDegrees(pitch);
+  double b = vtkMath::RadiansFromDegrees(yaw);
+  direction[0] = std::cos(a) * std::sin(b);
+  direction[1] = -std::sin(a);
+  direction[2] = std::cos(a) * std::cos(b);
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerRobotKinematics::ForwardKinematics(const double joints[5],
+                                                            double tip[3]) const
+{
+  double direction[3];
+  this->GetNeedleDirection(joints[Pitch], joints[Yaw], direction);
+  tip[0] = joints[X] + joints[Depth] * direction[0];
+  tip[1] = joints[Y] + joints[Depth] * direction[1];
+  tip[2] = joints[Depth] * direction[2];
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerRobotKinematics::InverseKinematics(const double entry[3],
+                                                           const double target[3],
+                                                           double joints[5])
+{
+  double direction[3] = { target[0] - entry[0], target[1] - entry[1], target[2] - entry[2] };
+  if (vtkMath::Normalize(direction) <= 0.0 || direction[2] <= 1e-9)
+    {
+    return 0;
+    }
+
+  // Guide point: intersection of the needle line with the z = 0 plane
+  double depth = target[2] / direction[2];
+  joints[X] = target[0] - depth * direction[0];
+  joints[Y] = target[1] - depth * direction[1];
+  joints[Pitch] = vtkMath::DegreesFromRadians(std::asin(-direction[1]));
+  joints[Yaw] = vtkMath::DegreesFromRadians(std::atan2(direction[0], direction[2]));
+  joints[Depth] = depth;
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerRobotKinematics::IsWithinLimits(const double joints[5],
+                                                        int* violations) const
+{
+  const double* ranges[NumberOfJoints] = {
+    this->XRange, this->YRange, this->PitchRange, this->YawRange, this->DepthRange };
+  int outside = 0;
+  for (int i = 0; i < NumberOfJoints; i++)
+    {
+    if (joints[i] < ranges[i][0] || joints[i] > ranges[i][1])
+      {
+      outside |= (1 << i);
+      }
+    }
+  if (violations)
+    {
+    *violations = outside;
+    }
+  return outside == 0;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkSlicerPathPlannerRobotKinematics::GetKinematicSignature()
+{
+  std::stringstream signature;
+  signature.precision(17);
+  signature << "XYPitchYawDepth"
+            << " " << this->XRange[0] << " " << this->XRange[1]
+            << " " << this->YRange[0] << " " << this->YRange[1]
+            << " " << this->PitchRange[0] << " " << this->PitchRange[1]
+            << " " << this->YawRange[0] << " " << this->YawRange[1]
+            << " " << this->DepthRange[0] << " " << this->DepthRange[1];
+  return signature.str();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerRobotKinematics::SolveInverseKinematics(vtkDoubleArray* segments,
+                                                                 vtkDoubleArray* joints,
+                                                                 vtkIntArray* violations,
+                                                                 vtkIntArray* collisions)
+{
+  if (!segments || segments->GetNumberOfComponents() != 6)
+    {
+    vtkErrorMacro(<< "SolveInverseKinematics: invalid segments");
+    return;
+    }
+
+  vtkIdType numberOfTrajectories = segments->GetNumberOfTuples();
+  if (joints)
+    {
+    joints->SetNumberOfComponents(NumberOfJoints);
+    joints->SetNumberOfTuples(numberOfTrajectories);
+    }
+  if (violations)
+    {
+    violations->SetNumberOfComponents(1);
+    violations->SetNumberOfTuples(numberOfTrajectories);
+    }
+  if (collisions)
+    {
+    collisions->SetNumberOfComponents(1);
+    collisions->SetNumberOfTuples(numberOfTrajectories);
+    }
+  if (numberOfTrajectories == 0)
+    {
+    return;
+    }
+
+  InverseKinematicsFunctor functor;
+  functor.Segments = segments->GetPointer(0);
+  functor.Joints = joints ? joints->GetPointer(0) : NULL;
+  functor.Violations = violations ? violations->GetPointer(0) : NULL;
+  functor.Collisions = collisions ? collisions->GetPointer(0) : NULL;
+  for (int i = 0; i < 3; i++)
+    {
+    for (int j = 0; j < 3; j++)
+      {
+      functor.Rotation[i][j] = this->RobotToRASMatrix[i][j];
+      }
+    functor.Translation[i] = this->RobotToRASMatrix[i][3];
+    functor.BoreCenter[i] = this->BoreCenter[i];
+    functor.BoreAxis[i] = this->BoreAxis[i];
+    }
+  vtkMath::Normalize(functor.BoreAxis);
+  for (int joint = 0; joint < NumberOfJoints; joint++)
+    {
+    this->GetJointRange(joint, functor.Ranges[joint]);
+    }
+  functor.BoreRadius2 = this->BoreRadius * this->BoreRadius;
+  functor.NeedleLength = this->NeedleLength;
+
+  // Chunks are a whole number of blocks
+  vtkSlicerPathPlannerParallelFor(0, numberOfTrajectories, 16 * BlockSize, functor);
+}
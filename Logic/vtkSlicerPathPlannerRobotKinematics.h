@@ -0,0 +1,167 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// .NAME vtkSlicerPathPlannerRobotKinematics - generic needle guide robot
+// .SECTION Description
+// Kinematic model of a needle guide with five joints: a Cartesian stage
+// moving the guide in the robot z = 0 plane (X, Y, mm), two rotations of
+// the guide (Pitch about x then Yaw about y, degrees) and the insertion
+// Depth (mm) from the guide along the needle. With pitch a and yaw b the
+// needle direction in robot coordinates is
+// (cos a sin b, -sin a, cos a cos b), so needles go toward +z.
+// RobotToRAS is the rigid pose of the robot base.
+//
+// SolveInverseKinematics checks whole trajectory sets at once: joint
+// values, joint limits and clearance of the needle and guide inside the
+// scanner bore, a cylinder of radius BoreRadius around the line through
+// BoreCenter along BoreAxis (RAS).
+
+#ifndef __vtkSlicerPathPlannerRobotKinematics_h
+#define __vtkSlicerPathPlannerRobotKinematics_h
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <string>
+
+#include "vtkSlicerPathPlannerModuleLogicExport.h"
+
+class vtkDoubleArray;
+class vtkIntArray;
+class vtkMatrix4x4;
+
+/// \ingroup Slicer_QtModules_PathPlanner
+class VTK_SLICER_PATHPLANNER_MODULE_LOGIC_EXPORT vtkSlicerPathPlannerRobotKinematics :
+  public vtkObject
+{
+public:
+  static vtkSlicerPathPlannerRobotKinematics *New();
+  vtkTypeMacro(vtkSlicerPathPlannerRobotKinematics, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  //BTX
+  enum
+  {
+    X = 0,
+    Y,
+    Pitch,
+    Yaw,
+    Depth,
+    NumberOfJoints
+  };
+
+  /// Violation bit set when the needle does not point toward +z, in which
+  /// case the joint values are meaningless.
+  enum
+  {
+    InvalidDirection = 1 << NumberOfJoints
+  };
+  //ETX
+
+  /// Joint limits [minimum, maximum]. Defaults are [-50, 50] mm for X and
+  /// Y, [-30, 30] degrees for Pitch and Yaw and [0, 150] mm for Depth.
+  vtkSetVector2Macro(XRange, double);
+  vtkGetVector2Macro(XRange, double);
+  vtkSetVector2Macro(YRange, double);
+  vtkGetVector2Macro(YRange, double);
+  vtkSetVector2Macro(PitchRange, double);
+  vtkGetVector2Macro(PitchRange, double);
+  vtkSetVector2Macro(YawRange, double);
+  vtkGetVector2Macro(YawRange, double);
+  vtkSetVector2Macro(DepthRange, double);
+  vtkGetVector2Macro(DepthRange, double);
+
+  /// Limits of a joint, indexed by the X, Y, Pitch, Yaw, Depth enum.
+  void GetJointRange(int joint, double range[2]);
+
+  /// Pose of the robot base. The matrix is copied and must be rigid.
+  void SetRobotToRASMatrix(vtkMatrix4x4* matrix);
+  void GetRobotToRASMatrix(vtkMatrix4x4* matrix);
+
+  void RASToRobot(const double ras[3], double robot[3]) const;
+  void RASToRobotDirection(const double ras[3], double robot[3]) const;
+  void RobotToRAS(const double robot[3], double ras[3]) const;
+
+  /// Needle tip (robot coordinates) for the given joint values.
+  void ForwardKinematics(const double joints[5], double tip[3]) const;
+
+  /// Needle direction (robot coordinates) for the given pitch and yaw.
+  static void GetNeedleDirection(double pitch, double yaw, double direction[3]);
+
+  /// Joint values placing the needle on the line from entry to target
+  /// (robot coordinates) with the tip on the target. Return 0 if the line
+  /// does not point toward +z; limits are not checked.
+  static int InverseKinematics(const double entry[3], const double target[3],
+                               double joints[5]);
+
+  /// Return 1 if all the joint values are within their limits. If
+  /// "violations" is not NULL, its bit i is set when joint i is outside.
+  int IsWithinLimits(const double joints[5], int* violations = NULL) const;
+
+  /// Text describing the joint limits, used to key cached computations
+  /// (the pose is not part of it).
+  std::string GetKinematicSignature();
+
+  /// Scanner bore. Defaults are a 300 mm radius around the S axis.
+  vtkSetMacro(BoreRadius, double);
+  vtkGetMacro(BoreRadius, double);
+  vtkSetVector3Macro(BoreCenter, double);
+  vtkGetVector3Macro(BoreCenter, double);
+  vtkSetVector3Macro(BoreAxis, double);
+  vtkGetVector3Macro(BoreAxis, double);
+
+  /// Needle length (mm), from the tip to the hub. Default is 200.
+  vtkSetMacro(NeedleLength, double);
+  vtkGetMacro(NeedleLength, double);
+
+  /// Solve the inverse kinematics of every trajectory of "segments" (6
+  /// components: entry RAS, target RAS). "joints" receives the 5 joint
+  /// values, "violations" the bitmask of IsWithinLimits (plus
+  /// InvalidDirection) and "collisions" 1 when the guide or the needle
+  /// hub is outside the bore. Any output may be NULL. Runs in parallel on
+  /// blocks laid out for vectorization.
+  void SolveInverseKinematics(vtkDoubleArray* segments, vtkDoubleArray* joints,
+                              vtkIntArray* violations, vtkIntArray* collisions);
+
+protected:
+  vtkSlicerPathPlannerRobotKinematics();
+  virtual ~vtkSlicerPathPlannerRobotKinematics();
+
+  double XRange[2];
+  double YRange[2];
+  double PitchRange[2];
+  double YawRange[2];
+  double DepthRange[2];
+  double RobotToRASMatrix[3][4];
+  double BoreRadius;
+  double BoreCenter[3];
+  double BoreAxis[3];
+  double NeedleLength;
+
+private:
+  vtkSlicerPathPlannerRobotKinematics(const vtkSlicerPathPlannerRobotKinematics&); // Not implemented
+  void operator=(const vtkSlicerPathPlannerRobotKinematics&);               // Not implemented
+};
+
+#endif
@@ -0,0 +1,391 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerParallel.h"
+#include "vtkSlicerPathPlannerRandom.h"
+#include "vtkSlicerPathPlannerRobustnessAnalyzer.h"
+#include "vtkSlicerPathPlannerVolumeSampler.h"
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkMath.h>
+#include <vtkObjectFactory.h>
+#include <vtkStringArray.h>
+
+// STD includes
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace
+{
+// Samples of a block are generated and tested together
+const int BlockSize = 256;
+
+//----------------------------------------------------------------------------
+struct RobustnessFunctor
+{
+  const double* Segments;
+  const double* PredictedTips;
+  const double* PredictedPaths;
+  int NumberOfPathPoints;
+  const vtkTypeUInt64* Keys;
+  vtkIdType NumberOfBlocksPerTrajectory;
+  int NumberOfSamples;
+  double TargetRadius;
+  double RegistrationSigma;
+  double DeflectionSigma;
+  double MotionSigma;
+  int NumberOfPathSegments;
+  unsigned int Seed;
+  const vtkSlicerPathPlannerVolumeSampler* Structures;
+
+  // One counter per block, summed once all the threads are done
+  std::vector<int> HitCounts;
+  std::vector<int> SafeCounts;
+  std::vector<int> SuccessCounts;
+
+  void operator()(vtkIdType begin, vtkIdType end, int vtkNotUsed(threadId))
+  {
+    double shiftX[BlockSize], shiftY[BlockSize], shiftZ[BlockSize];
+    double bendX[BlockSize], bendY[BlockSize], bendZ[BlockSize];
+    double motionX[BlockSize], motionY[BlockSize], motionZ[BlockSize];
+    int hit[BlockSize];
+
+    for (vtkIdType block = begin; block < end; block++)
+      {
+      vtkIdType trajectory = block / this->NumberOfBlocksPerTrajectory;
+      vtkIdType blockInTrajectory = block % this->NumberOfBlocksPerTrajectory;
+      int firstSample = static_cast<int>(blockInTrajectory) * BlockSize;
+      int numberOfSamples = this->NumberOfSamples - firstSample;
+      numberOfSamples = numberOfSamples < BlockSize ? numberOfSamples : BlockSize;
+
+      const double* entry = this->Segments + 6 * trajectory;
+      const double* target = entry + 3;
+      double axis[3] = { target[0] - entry[0], target[1] - entry[1], target[2] - entry[2] };
+      double depth = vtkMath::Normalize(axis);
+      double lateral1[3] = { 1.0, 0.0, 0.0 };
+      double lateral2[3] = { 0.0, 1.0, 0.0 };
+      if (depth > 0.0)
+        {
+        vtkMath::Perpendiculars(axis, lateral1, lateral2, 0.0);
+        }
+      // else the entry is the target: there is no shaft to deflect and
+      // bendSigma is 0, any lateral directions will do
+      double bendSigma = this->DeflectionSigma * depth;
+
+      // Offset of the nominal tip from the target
+      const double* path = this->PredictedPaths ?
+        this->PredictedPaths + 3 * this->NumberOfPathPoints * trajectory : NULL;
+      double tipX = 0.0, tipY = 0.0, tipZ = 0.0;
+      if (path || this->PredictedTips)
+        {
+        const double* tip = path ? path + 3 * (this->NumberOfPathPoints - 1) :
+          this->PredictedTips + 3 * trajectory;
+        tipX = tip[0] - target[0];
+        tipY = tip[1] - target[1];
+        tipZ = tip[2] - target[2];
+        }
+
+      vtkSlicerPathPlannerRandom random(this->Seed ^ this->Keys[trajectory],
+                                        static_cast<vtkTypeUInt64>(blockInTrajectory));
+      for (int n = 0; n < numberOfSamples; n++)
+        {
+        shiftX[n] = this->RegistrationSigma * random.NextGaussian();
+        shiftY[n] = this->RegistrationSigma * random.NextGaussian();
+        shiftZ[n] = this->RegistrationSigma * random.NextGaussian();
+        double u = bendSigma * random.NextGaussian();
+        double v = bendSigma * random.NextGaussian();
+        bendX[n] = u * lateral1[0] + v * lateral2[0];
+        bendY[n] = u * lateral1[1] + v * lateral2[1];
+        bendZ[n] = u * lateral1[2] + v * lateral2[2];
+        motionX[n] = this->MotionSigma * random.NextGaussian();
+        motionY[n] = this->MotionSigma * random.NextGaussian();
+        motionZ[n] = this->MotionSigma * random.NextGaussian();
+        }
+
+      // Tip to target distance, branch free so the compiler can vectorize it
+      double radius2 = this->TargetRadius * this->TargetRadius;
+      int hitCount = 0;
+      for (int n = 0; n < numberOfSamples; n++)
+        {
+        double dx = shiftX[n] + tipX + bendX[n] - motionX[n];
+        double dy = shiftY[n] + tipY + bendY[n] - motionY[n];
+        double dz = shiftZ[n] + tipZ + bendZ[n] - motionZ[n];
+        hit[n] = (dx * dx + dy * dy + dz * dz <= radius2) ? 1 : 0;
+        hitCount += hit[n];
+        }
+
+      int safeCount = numberOfSamples;
+      int successCount = hitCount;
+      if (this->Structures)
+        {
+        // Nominal shaft: the predicted path, followed point by point, or
+        // the straight trajectory bent quadratically toward the nominal tip
+        int numberOfPieces = this->NumberOfPathSegments;
+        std::vector<double> shaft(3 * (numberOfPieces + 1));
+        if (path)
+          {
+          numberOfPieces = this->NumberOfPathPoints - 1;
+          shaft.assign(path, path + 3 * this->NumberOfPathPoints);
+          }
+        else
+          {
+          for (int piece = 0; piece <= numberOfPieces; piece++)
+            {
+            double s = static_cast<double>(piece) / numberOfPieces;
+            double s2 = s * s;
+            shaft[3 * piece] = entry[0] + s * (target[0] - entry[0]) + s2 * tipX;
+            shaft[3 * piece + 1] = entry[1] + s * (target[1] - entry[1]) + s2 * tipY;
+            shaft[3 * piece + 2] = entry[2] + s * (target[2] - entry[2]) + s2 * tipZ;
+            }
+          }
+
+        safeCount = 0;
+        successCount = 0;
+        for (int n = 0; n < numberOfSamples; n++)
+          {
+          int safe = 1;
+          double previous[3] = { shaft[0] + shiftX[n], shaft[1] + shiftY[n], shaft[2] + shiftZ[n] };
+          for (int piece = 1; piece <= numberOfPieces && safe; piece++)
+            {
+            double s = static_cast<double>(piece) / numberOfPieces;
+            double s2 = s * s;
+            const double* nominal = &shaft[3 * piece];
+            double current[3] = {
+              nominal[0] + shiftX[n] + s2 * bendX[n],
+              nominal[1] + shiftY[n] + s2 * bendY[n],
+              nominal[2] + shiftZ[n] + s2 * bendZ[n] };
+            if (this->Structures->SegmentIntersectsNonZero(previous, current))
+              {
+              safe = 0;
+              }
+            previous[0] = current[0];
+            previous[1] = current[1];
+            previous[2] = current[2];
+            }
+          safeCount += safe;
+          successCount += safe & hit[n];
+          }
+        }
+
+      this->HitCounts[block] = hitCount;
+      this->SafeCounts[block] = safeCount;
+      this->SuccessCounts[block] = successCount;
+      }
+  }
+};
+
+//----------------------------------------------------------------------------
+// FNV-1a hash of a trajectory key
+vtkTypeUInt64 HashKey(const std::string& key)
+{
+  vtkTypeUInt64 hash = 0xCBF29CE484222325ULL;
+  for (size_t i = 0; i < key.size(); i++)
+    {
+    hash = (hash ^ static_cast<unsigned char>(key[i])) * 0x100000001B3ULL;
+    }
+  return hash;
+}
+
+//----------------------------------------------------------------------------
+void InitializeOutput(vtkDoubleArray* array, vtkIdType numberOfTuples)
+{
+  if (array)
+    {
+    array->SetNumberOfComponents(1);
+    array->SetNumberOfTuples(numberOfTuples);
+    }
+}
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerPathPlannerRobustnessAnalyzer);
+
+//----------------------------------------------------------------------------
+vtkCxxSetObjectMacro(vtkSlicerPathPlannerRobustnessAnalyzer, CriticalStructures,
+                     vtkSlicerPathPlannerVolumeSampler);
+
+//----------------------------------------------------------------------------
+vtkCxxSetObjectMacro(vtkSlicerPathPlannerRobustnessAnalyzer, PredictedTips,
+                     vtkDoubleArray);
+
+//----------------------------------------------------------------------------
+vtkCxxSetObjectMacro(vtkSlicerPathPlannerRobustnessAnalyzer, TrajectoryKeys,
+                     vtkStringArray);
+
+//----------------------------------------------------------------------------
+vtkCxxSetObjectMacro(vtkSlicerPathPlannerRobustnessAnalyzer, PredictedPaths,
+                     vtkDoubleArray);
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerRobustnessAnalyzer::vtkSlicerPathPlannerRobustnessAnalyzer()
+{
+  this->NumberOfSamples = 4096;
+  this->TargetRadius = 5.0;
+  this->RegistrationErrorStandardDeviation = 1.0;
+  this->NeedleDeflectionStandardDeviation = 0.02;
+  this->TargetMotionStandardDeviation = 1.5;
+  this->NumberOfPathSegments = 4;
+  this->Seed = 0;
+  this->CriticalStructures = NULL;
+  this->PredictedTips = NULL;
+  this->TrajectoryKeys = NULL;
+  this->PredictedPaths = NULL;
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerRobustnessAnalyzer::~vtkSlicerPathPlannerRobustnessAnalyzer()
+{
+  this->SetCriticalStructures(NULL);
+  this->SetPredictedTips(NULL);
+  this->SetTrajectoryKeys(NULL);
+  this->SetPredictedPaths(NULL);
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerRobustnessAnalyzer::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfSamples: " << this->NumberOfSamples << "\n";
+  os << indent << "TargetRadius: " << this->TargetRadius << "\n";
+  os << indent << "RegistrationErrorStandardDeviation: "
+     << this->RegistrationErrorStandardDeviation << "\n";
+  os << indent << "NeedleDeflectionStandardDeviation: "
+     << this->NeedleDeflectionStandardDeviation << "\n";
+  os << indent << "TargetMotionStandardDeviation: "
+     << this->TargetMotionStandardDeviation << "\n";
+  os << indent << "NumberOfPathSegments: " << this->NumberOfPathSegments << "\n";
+  os << indent << "Seed: " << this->Seed << "\n";
+  os << indent << "CriticalStructures: " << this->CriticalStructures << "\n";
+  os << indent << "PredictedTips: " << this->PredictedTips << "\n";
+  os << indent << "TrajectoryKeys: " << this->TrajectoryKeys << "\n";
+  os << indent << "PredictedPaths: " << this->PredictedPaths << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerRobustnessAnalyzer::Evaluate(vtkDoubleArray* segments,
+                                                      vtkDoubleArray* hitProbabilities,
+                                                      vtkDoubleArray* safeProbabilities,
+                                                      vtkDoubleArray* successProbabilities)
+{
+  if (!segments || segments->GetNumberOfComponents() != 6)
+    {
+    vtkErrorMacro(<< "Evaluate: segments must have 6 components");
+    return;
+    }
+
+  vtkIdType numberOfTrajectories = segments->GetNumberOfTuples();
+  InitializeOutput(hitProbabilities, numberOfTrajectories);
+  InitializeOutput(safeProbabilities, numberOfTrajectories);
+  InitializeOutput(successProbabilities, numberOfTrajectories);
+  if (numberOfTrajectories == 0 || this->NumberOfSamples <= 0)
+    {
+    return;
+    }
+
+  RobustnessFunctor functor;
+  functor.Segments = segments->GetPointer(0);
+  functor.PredictedTips = NULL;
+  if (this->PredictedTips)
+    {
+    if (this->PredictedTips->GetNumberOfComponents() != 3 ||
+        this->PredictedTips->GetNumberOfTuples() != numberOfTrajectories)
+      {
+      vtkErrorMacro(<< "Evaluate: PredictedTips does not match the segments");
+      return;
+      }
+    functor.PredictedTips = this->PredictedTips->GetPointer(0);
+    }
+  functor.PredictedPaths = NULL;
+  functor.NumberOfPathPoints = 0;
+  if (this->PredictedPaths)
+    {
+    if (this->PredictedPaths->GetNumberOfComponents() < 6 ||
+        this->PredictedPaths->GetNumberOfComponents() % 3 != 0 ||
+        this->PredictedPaths->GetNumberOfTuples() != numberOfTrajectories)
+      {
+      vtkErrorMacro(<< "Evaluate: PredictedPaths does not match the segments");
+      return;
+      }
+    functor.PredictedPaths = this->PredictedPaths->GetPointer(0);
+    functor.NumberOfPathPoints = this->PredictedPaths->GetNumberOfComponents() / 3;
+    }
+  if (this->TrajectoryKeys &&
+      this->TrajectoryKeys->GetNumberOfValues() != numberOfTrajectories)
+    {
+    vtkErrorMacro(<< "Evaluate: TrajectoryKeys does not match the segments");
+    return;
+    }
+  std::vector<vtkTypeUInt64> keys(numberOfTrajectories);
+  for (vtkIdType trajectory = 0; trajectory < numberOfTrajectories; trajectory++)
+    {
+    keys[trajectory] = this->TrajectoryKeys ?
+      HashKey(this->TrajectoryKeys->GetValue(trajectory)) :
+      static_cast<vtkTypeUInt64>(trajectory);
+    }
+  functor.Keys = &keys[0];
+  functor.NumberOfBlocksPerTrajectory = (this->NumberOfSamples + BlockSize - 1) / BlockSize;
+  functor.NumberOfSamples = this->NumberOfSamples;
+  functor.TargetRadius = this->TargetRadius;
+  functor.RegistrationSigma = this->RegistrationErrorStandardDeviation;
+  functor.DeflectionSigma = this->NeedleDeflectionStandardDeviation;
+  functor.MotionSigma = this->TargetMotionStandardDeviation;
+  functor.NumberOfPathSegments = this->NumberOfPathSegments > 0 ? this->NumberOfPathSegments : 1;
+  functor.Seed = this->Seed;
+  functor.Structures = (this->CriticalStructures && this->CriticalStructures->IsValid()) ?
+    this->CriticalStructures : NULL;
+
+  vtkIdType numberOfBlocks = numberOfTrajectories * functor.NumberOfBlocksPerTrajectory;
+  functor.HitCounts.resize(numberOfBlocks);
+  functor.SafeCounts.resize(numberOfBlocks);
+  functor.SuccessCounts.resize(numberOfBlocks);
+
+  vtkSlicerPathPlannerParallelFor(0, numberOfBlocks, 1, functor);
+
+  for (vtkIdType trajectory = 0; trajectory < numberOfTrajectories; trajectory++)
+    {
+    int hitCount = 0;
+    int safeCount = 0;
+    int successCount = 0;
+    for (vtkIdType block = trajectory * functor.NumberOfBlocksPerTrajectory;
+         block < (trajectory + 1) * functor.NumberOfBlocksPerTrajectory; block++)
+      {
+      hitCount += functor.HitCounts[block];
+      safeCount += functor.SafeCounts[block];
+      successCount += functor.SuccessCounts[block];
+      }
+    if (hitProbabilities)
+      {
+      hitProbabilities->SetValue(trajectory, static_cast<double>(hitCount) / this->NumberOfSamples);
+      }
+    if (safeProbabilities)
+      {
+      safeProbabilities->SetValue(trajectory, static_cast<double>(safeCount) / this->NumberOfSamples);
+      }
+    if (successProbabilities)
+      {
+      successProbabilities->SetValue(trajectory, static_cast<double>(successCount) / this->NumberOfSamples);
+      }
+    }
+}
@@ -0,0 +1,146 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// .NAME vtkSlicerPathPlannerRobustnessAnalyzer - Monte Carlo trajectory robustness
+// .SECTION Description
+// Simulates perturbed insertions of straight trajectories and estimates the
+// probability that the needle tip lands within TargetRadius of the target
+// while missing the critical structures. Each simulated insertion combines:
+//  - a registration error: rigid shift of the whole insertion,
+//  - a needle deflection: lateral tip offset growing with the insertion
+//    depth, the shaft bending quadratically from the entry point,
+//  - a target motion: shift of the target only.
+// The nominal tip is the target unless PredictedTips or PredictedPaths are
+// given, for instance by vtkSlicerPathPlannerDeflectionPredictor. With
+// PredictedTips the shaft bends quadratically toward the predicted tip,
+// with PredictedPaths it follows the predicted polyline.
+// Samples are evaluated in blocks on all the threads. Every block owns a
+// random stream derived from (Seed, trajectory key, block), so results are
+// reproducible and independent of the number of threads. With
+// TrajectoryKeys, a trajectory gets the same samples whatever the other
+// trajectories evaluated with it.
+
+#ifndef __vtkSlicerPathPlannerRobustnessAnalyzer_h
+#define __vtkSlicerPathPlannerRobustnessAnalyzer_h
+
+// VTK includes
+#include <vtkObject.h>
+
+#include "vtkSlicerPathPlannerModuleLogicExport.h"
+
+class vtkDoubleArray;
+class vtkSlicerPathPlannerVolumeSampler;
+class vtkStringArray;
+
+/// \ingroup Slicer_QtModules_PathPlanner
+class VTK_SLICER_PATHPLANNER_MODULE_LOGIC_EXPORT vtkSlicerPathPlannerRobustnessAnalyzer :
+  public vtkObject
+{
+public:
+  static vtkSlicerPathPlannerRobustnessAnalyzer *New();
+  vtkTypeMacro(vtkSlicerPathPlannerRobustnessAnalyzer, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Number of simulated insertions per trajectory. Default is 4096.
+  vtkSetMacro(NumberOfSamples, int);
+  vtkGetMacro(NumberOfSamples, int);
+
+  /// Maximum distance (mm) between tip and target for a hit. Default is 5.
+  vtkSetMacro(TargetRadius, double);
+  vtkGetMacro(TargetRadius, double);
+
+  /// Standard deviation (mm) of the registration error, per axis.
+  /// Default is 1.
+  vtkSetMacro(RegistrationErrorStandardDeviation, double);
+  vtkGetMacro(RegistrationErrorStandardDeviation, double);
+
+  /// Standard deviation of the lateral tip deflection per mm of insertion
+  /// depth. Default is 0.02 (2 mm at 10 cm).
+  vtkSetMacro(NeedleDeflectionStandardDeviation, double);
+  vtkGetMacro(NeedleDeflectionStandardDeviation, double);
+
+  /// Standard deviation (mm) of the target motion, per axis. Default is 1.5.
+  vtkSetMacro(TargetMotionStandardDeviation, double);
+  vtkGetMacro(TargetMotionStandardDeviation, double);
+
+  /// Number of straight pieces used to follow the bent shaft through the
+  /// critical structures. Default is 4.
+  vtkSetMacro(NumberOfPathSegments, int);
+  vtkGetMacro(NumberOfPathSegments, int);
+
+  /// Seed of the random streams. Default is 0.
+  vtkSetMacro(Seed, unsigned int);
+  vtkGetMacro(Seed, unsigned int);
+
+  /// Label map of the structures the needle must not cross (any non zero
+  /// voxel). When not set, every insertion is considered safe.
+  void SetCriticalStructures(vtkSlicerPathPlannerVolumeSampler* sampler);
+  vtkGetObjectMacro(CriticalStructures, vtkSlicerPathPlannerVolumeSampler);
+
+  /// Nominal tip position (3 components, RAS) of every trajectory given to
+  /// Evaluate. When not set, the nominal tip is the target.
+  void SetPredictedTips(vtkDoubleArray* tips);
+  vtkGetObjectMacro(PredictedTips, vtkDoubleArray);
+
+  /// Nominal needle path of every trajectory given to Evaluate: one tuple
+  /// of 3-component points per trajectory, entry first and tip last,
+  /// evenly spaced along the path. Takes precedence over PredictedTips.
+  void SetPredictedPaths(vtkDoubleArray* paths);
+  vtkGetObjectMacro(PredictedPaths, vtkDoubleArray);
+
+  /// Stable key (e.g. the ruler ID) of every trajectory given to Evaluate,
+  /// from which its random streams are derived. When not set, the index of
+  /// the trajectory in the segments is used.
+  void SetTrajectoryKeys(vtkStringArray* keys);
+  vtkGetObjectMacro(TrajectoryKeys, vtkStringArray);
+
+  /// Evaluate every trajectory of "segments" (6 components: entry RAS,
+  /// target RAS). The output arrays, when not NULL, receive one probability
+  /// per trajectory: tip within TargetRadius, no critical structure crossed,
+  /// and both at once.
+  void Evaluate(vtkDoubleArray* segments,
+                vtkDoubleArray* hitProbabilities,
+                vtkDoubleArray* safeProbabilities,
+                vtkDoubleArray* successProbabilities);
+
+protected:
+  vtkSlicerPathPlannerRobustnessAnalyzer();
+  virtual ~vtkSlicerPathPlannerRobustnessAnalyzer();
+
+  int NumberOfSamples;
+  double TargetRadius;
+  double RegistrationErrorStandardDeviation;
+  double NeedleDeflectionStandardDeviation;
+  double TargetMotionStandardDeviation;
+  int NumberOfPathSegments;
+  unsigned int Seed;
+  vtkSlicerPathPlannerVolumeSampler* CriticalStructures;
+  vtkDoubleArray* PredictedTips;
+  vtkStringArray* TrajectoryKeys;
+  vtkDoubleArray* PredictedPaths;
+
+private:
+  vtkSlicerPathPlannerRobustnessAnalyzer(const vtkSlicerPathPlannerRobustnessAnalyzer&); // Not implemented
+  void operator=(const vtkSlicerPathPlannerRobustnessAnalyzer&);               // Not implemented
+};
+
+#endif
@@ -0,0 +1,516 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerParallel.h"
+#include "vtkSlicerPathPlannerSeedDose.h"
+#include "vtkSlicerPathPlannerVolumeSampler.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMath.h>
+#include <vtkObjectFactory.h>
+#include <vtkPoints.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iterator>
+
+namespace
+{
+// Radial dose function g(r) of the model 6711 seed, r in cm (TG-43U1)
+const int NumberOfRadialDoseValues = 14;
+const double RadialDoseFunction[NumberOfRadialDoseValues][2] = {
+  { 0.10, 1.055 }, { 0.15, 1.078 }, { 0.25, 1.082 }, { 0.50, 1.071 },
+  { 0.75, 1.042 }, { 1.00, 1.000 }, { 1.50, 0.908 }, { 2.00, 0.814 },
+  { 3.00, 0.632 }, { 4.00, 0.496 }, { 5.00, 0.364 }, { 6.00, 0.270 },
+  { 7.00, 0.199 }, { 10.0, 0.0803 } };
+
+// 1D anisotropy function phi_an(r) of the model 6711 seed, r in cm
+const int NumberOfAnisotropyValues = 6;
+const double AnisotropyFunction[NumberOfAnisotropyValues][2] = {
+  { 0.50, 0.973 }, { 1.00, 0.944 }, { 2.00, 0.941 }, { 3.00, 0.942 },
+  { 4.00, 0.943 }, { 5.00, 0.944 } };
+
+//----------------------------------------------------------------------------
+// Piecewise linear interpolation, constant beyond the table
+double Interpolate(const double table[][2], int size, double x)
+{
+  if (x <= table[0][0])
+    {
+    return table[0][1];
+    }
+  for (int i = 1; i < size; i++)
+    {
+    if (x <= table[i][0])
+      {
+      double t = (x - table[i - 1][0]) / (table[i][0] - table[i - 1][0]);
+      return table[i - 1][1] + t * (table[i][1] - table[i - 1][1]);
+      }
+    }
+  return table[size - 1][1];
+}
+
+//----------------------------------------------------------------------------
+// Add weighted seed kernels to the dose, one grid slice per index
+struct AddSeedsFunctor
+{
+  const double* Seeds;
+  const double* Weights;
+  int NumberOfSeeds;
+  const float* Kernel;
+  double InverseKernelStep;
+  double Radius;
+  double Origin[3];
+  double Spacing;
+  int Dimensions[3];
+  double* Dose;
+
+  void operator()(vtkIdType begin, vtkIdType end, int vtkNotUsed(threadId))
+  {
+    const double radius2 = this->Radius * this->Radius;
+    for (vtkIdType k = begin; k < end; k++)
+      {
+      const double z = this->Origin[2] + k * this->Spacing;
+      for (int s = 0; s < this->NumberOfSeeds; s++)
+        {
+        const double* seed = this->Seeds + 3 * s;
+        const double dz2 = (z - seed[2]) * (z - seed[2]);
+        if (dz2 > radius2)
+          {
+          continue;
+          }
+        const double weight = this->Weights[s];
+        const double disk = std::sqrt(radius2 - dz2);
+        int jBegin = std::max(0, static_cast<int>(
+          std::ceil((seed[1] - disk - this->Origin[1]) / this->Spacing)));
+        int jEnd = std::min(this->Dimensions[1] - 1, static_cast<int>(
+          std::floor((seed[1] + disk - this->Origin[1]) / this->Spacing)));
+        for (int j = jBegin; j <= jEnd; j++)
+          {
+          const double dy = this->Origin[1] + j * this->Spacing - seed[1];
+          const double plane2 = dz2 + dy * dy;
+          if (plane2 > radius2)
+            {
+            continue;
+            }
+          const double chord = std::sqrt(radius2 - plane2);
+          int iBegin = std::max(0, static_cast<int>(
+            std::ceil((seed[0] - chord - this->Origin[0]) / this->Spacing)));
+          int iEnd = std::min(this->Dimensions[0] - 1, static_cast<int>(
+            std::floor((seed[0] + chord - this->Origin[0]) / this->Spacing)));
+
+          // Contiguous, branch free row: left to the compiler to vectorize
+          double* row = this->Dose + (k * this->Dimensions[1] + j) * this->Dimensions[0];
+          const double x0 = this->Origin[0] - seed[0];
+          for (int i = iBegin; i <= iEnd; i++)
+            {
+            const double dx = x0 + i * this->Spacing;
+            const double t = std::sqrt(plane2 + dx * dx) * this->InverseKernelStep;
+            const int n = static_cast<int>(t);
+            const double f = t - n;
+            row[i] += weight * ((1.0 - f) * this->Kernel[n] + f * this->Kernel[n + 1]);
+            }
+          }
+        }
+      }
+  }
+};
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerPathPlannerSeedDose);
+
+//----------------------------------------------------------------------------
+vtkCxxSetObjectMacro(vtkSlicerPathPlannerSeedDose, Target,
+                     vtkSlicerPathPlannerVolumeSampler);
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerSeedDose::vtkSlicerPathPlannerSeedDose()
+{
+  this->Target = NULL;
+  this->GridSpacing = 2.0;
+  this->GridMargin = 10.0;
+  this->SeedSpacing = 10.0;
+  this->AirKermaStrength = 0.5;
+  this->DoseRateConstant = 0.965;
+  this->HalfLife = 59.4;
+  this->PrescriptionDose = 145.0;
+  this->MaximumRadius = 100.0;
+  this->NumberOfUpdatedNeedles = 0;
+  this->KernelStep = 0.1;
+  for (int i = 0; i < 3; i++)
+    {
+    this->GridOrigin[i] = 0.0;
+    this->GridDimensions[i] = 0;
+    }
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerSeedDose::~vtkSlicerPathPlannerSeedDose()
+{
+  this->SetTarget(NULL);
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerSeedDose::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Target: " << this->Target << "\n";
+  os << indent << "GridSpacing: " << this->GridSpacing << "\n";
+  os << indent << "GridMargin: " << this->GridMargin << "\n";
+  os << indent << "SeedSpacing: " << this->SeedSpacing << "\n";
+  os << indent << "AirKermaStrength: " << this->AirKermaStrength << "\n";
+  os << indent << "DoseRateConstant: " << this->DoseRateConstant << "\n";
+  os << indent << "HalfLife: " << this->HalfLife << "\n";
+  os << indent << "PrescriptionDose: " << this->PrescriptionDose << "\n";
+  os << indent << "MaximumRadius: " << this->MaximumRadius << "\n";
+  os << indent << "NumberOfNeedles: " << this->Needles.size() << "\n";
+  os << indent << "NumberOfUpdatedNeedles: " << this->NumberOfUpdatedNeedles << "\n";
+  os << indent << "GridDimensions: " << this->GridDimensions[0] << " "
+     << this->GridDimensions[1] << " " << this->GridDimensions[2] << "\n";
+}
+
+//----------------------------------------------------------------------------
+double vtkSlicerPathPlannerSeedDose::GetSeedDose(double radius)
+{
+  // Distances in cm, dose rate in cGy/h, mean life in h
+  double r = std::max(radius, 1.0) / 10.0;
+  double doseRate = this->AirKermaStrength * this->DoseRateConstant / (r * r) *
+    Interpolate(RadialDoseFunction, NumberOfRadialDoseValues, r) *
+    Interpolate(AnisotropyFunction, NumberOfAnisotropyValues, r);
+  double meanLife = 24.0 * this->HalfLife / std::log(2.0);
+  return doseRate * meanLife / 100.0;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerSeedDose::SetNeedle(const char* id, const double entry[3],
+                                             const double tip[3])
+{
+  if (!id)
+    {
+    return;
+    }
+  std::map<std::string, Needle>::iterator it = this->Needles.find(id);
+  bool added = it == this->Needles.end();
+  if (added)
+    {
+    it = this->Needles.insert(std::make_pair(std::string(id), Needle())).first;
+    }
+  else if (std::equal(entry, entry + 3, it->second.Segment) &&
+           std::equal(tip, tip + 3, it->second.Segment + 3))
+    {
+    return;
+    }
+  Needle& needle = it->second;
+  std::copy(entry, entry + 3, needle.Segment);
+  std::copy(tip, tip + 3, needle.Segment + 3);
+
+  // A dirty grid is recomputed from scratch, no need to queue anything
+  if (this->IsGridDirty())
+    {
+    return;
+    }
+  this->PendingSeeds.insert(this->PendingSeeds.end(), needle.Seeds.begin(), needle.Seeds.end());
+  this->PendingWeights.insert(this->PendingWeights.end(), needle.Seeds.size() / 3, -1.0);
+  this->PlaceSeeds(needle.Segment, needle.Seeds);
+  this->PendingSeeds.insert(this->PendingSeeds.end(), needle.Seeds.begin(), needle.Seeds.end());
+  this->PendingWeights.insert(this->PendingWeights.end(), needle.Seeds.size() / 3, 1.0);
+  this->NumberOfUpdatedNeedles++;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerSeedDose::RemoveNeedle(const char* id)
+{
+  std::map<std::string, Needle>::iterator it =
+    id ? this->Needles.find(id) : this->Needles.end();
+  if (it == this->Needles.end())
+    {
+    return;
+    }
+  if (!this->IsGridDirty())
+    {
+    const std::vector<double>& seeds = it->second.Seeds;
+    this->PendingSeeds.insert(this->PendingSeeds.end(), seeds.begin(), seeds.end());
+    this->PendingWeights.insert(this->PendingWeights.end(), seeds.size() / 3, -1.0);
+    }
+  this->Needles.erase(it);
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerSeedDose::RemoveAllNeedles()
+{
+  this->Needles.clear();
+  this->PendingSeeds.clear();
+  this->PendingWeights.clear();
+  std::fill(this->Dose.begin(), this->Dose.end(), 0.0);
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerSeedDose::GetNumberOfNeedles()
+{
+  return static_cast<int>(this->Needles.size());
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerSeedDose::GetNthNeedleID(int n)
+{
+  if (n < 0 || n >= static_cast<int>(this->Needles.size()))
+    {
+    return NULL;
+    }
+  std::map<std::string, Needle>::iterator it = this->Needles.begin();
+  std::advance(it, n);
+  return it->first.c_str();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerSeedDose::GetSeeds(vtkPoints* seeds)
+{
+  if (!seeds)
+    {
+    return;
+    }
+  seeds->Reset();
+  for (std::map<std::string, Needle>::iterator it = this->Needles.begin();
+       it != this->Needles.end(); ++it)
+    {
+    for (size_t s = 0; s < it->second.Seeds.size(); s += 3)
+      {
+      seeds->InsertNextPoint(&it->second.Seeds[s]);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+bool vtkSlicerPathPlannerSeedDose::IsGridDirty()
+{
+  unsigned long gridTime = this->GridTime.GetMTime();
+  return gridTime < this->GetMTime() ||
+    (this->Target && gridTime < this->Target->GetMTime());
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerSeedDose::PlaceSeeds(const double segment[6],
+                                              std::vector<double>& seeds) const
+{
+  seeds.clear();
+  if (!this->Target || !this->Target->IsValid())
+    {
+    return;
+    }
+  double direction[3] = { segment[0] - segment[3], segment[1] - segment[4],
+                          segment[2] - segment[5] };
+  double length = vtkMath::Normalize(direction);
+  for (double s = 0.0; s <= length; s += this->SeedSpacing)
+    {
+    double seed[3] = { segment[3] + s * direction[0], segment[4] + s * direction[1],
+                       segment[5] + s * direction[2] };
+    if (this->Target->GetValueNearest(seed) != 0.0)
+      {
+      seeds.insert(seeds.end(), seed, seed + 3);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerSeedDose::BuildKernel()
+{
+  int size = static_cast<int>(std::ceil(this->MaximumRadius / this->KernelStep)) + 2;
+  this->Kernel.resize(size);
+  for (int n = 0; n < size; n++)
+    {
+    this->Kernel[n] = static_cast<float>(this->GetSeedDose(n * this->KernelStep));
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerSeedDose::BuildGrid()
+{
+  this->Dose.clear();
+  this->TargetPoints.clear();
+  for (int i = 0; i < 3; i++)
+    {
+    this->GridDimensions[i] = 0;
+    }
+  if (!this->Target || !this->Target->IsValid())
+    {
+    return;
+    }
+
+  double bounds[6];
+  this->Target->GetRASBounds(bounds);
+  for (int i = 0; i < 3; i++)
+    {
+    this->GridOrigin[i] = bounds[2 * i] - this->GridMargin;
+    this->GridDimensions[i] = static_cast<int>(std::ceil(
+      (bounds[2 * i + 1] - bounds[2 * i] + 2.0 * this->GridMargin) / this->GridSpacing)) + 1;
+    }
+  vtkIdType numberOfPoints = static_cast<vtkIdType>(this->GridDimensions[0]) *
+    this->GridDimensions[1] * this->GridDimensions[2];
+  this->Dose.assign(numberOfPoints, 0.0);
+
+  vtkIdType index = 0;
+  for (int k = 0; k < this->GridDimensions[2]; k++)
+    {
+    for (int j = 0; j < this->GridDimensions[1]; j++)
+      {
+      for (int i = 0; i < this->GridDimensions[0]; i++, index++)
+        {
+        double point[3] = { this->GridOrigin[0] + i * this->GridSpacing,
+                            this->GridOrigin[1] + j * this->GridSpacing,
+                            this->GridOrigin[2] + k * this->GridSpacing };
+        if (this->Target->GetValueNearest(point) != 0.0)
+          {
+          this->TargetPoints.push_back(index);
+          }
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerSeedDose::AddSeeds(const std::vector<double>& seeds,
+                                            const std::vector<double>& weights)
+{
+  if (seeds.empty() || this->Dose.empty())
+    {
+    return;
+    }
+  AddSeedsFunctor functor;
+  functor.Seeds = &seeds[0];
+  functor.Weights = &weights[0];
+  functor.NumberOfSeeds = static_cast<int>(weights.size());
+  functor.Kernel = &this->Kernel[0];
+  functor.InverseKernelStep = 1.0 / this->KernelStep;
+  functor.Radius = this->MaximumRadius;
+  functor.Spacing = this->GridSpacing;
+  for (int i = 0; i < 3; i++)
+    {
+    functor.Origin[i] = this->GridOrigin[i];
+    functor.Dimensions[i] = this->GridDimensions[i];
+    }
+  functor.Dose = &this->Dose[0];
+  vtkSlicerPathPlannerParallelFor(0, this->GridDimensions[2], 1, functor);
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerSeedDose::Update()
+{
+  if (this->IsGridDirty())
+    {
+    this->BuildGrid();
+    this->BuildKernel();
+    std::vector<double> seeds;
+    for (std::map<std::string, Needle>::iterator it = this->Needles.begin();
+         it != this->Needles.end(); ++it)
+      {
+      this->PlaceSeeds(it->second.Segment, it->second.Seeds);
+      seeds.insert(seeds.end(), it->second.Seeds.begin(), it->second.Seeds.end());
+      }
+    this->NumberOfUpdatedNeedles += static_cast<int>(this->Needles.size());
+    this->PendingSeeds.clear();
+    this->PendingWeights.clear();
+    this->GridTime.Modified();
+    this->AddSeeds(seeds, std::vector<double>(seeds.size() / 3, 1.0));
+    return;
+    }
+
+  this->AddSeeds(this->PendingSeeds, this->PendingWeights);
+  this->PendingSeeds.clear();
+  this->PendingWeights.clear();
+}
+
+//----------------------------------------------------------------------------
+double vtkSlicerPathPlannerSeedDose::GetDose(const double ras[3])
+{
+  if (this->Dose.empty())
+    {
+    return 0.0;
+    }
+  int ijk[3];
+  for (int i = 0; i < 3; i++)
+    {
+    ijk[i] = static_cast<int>(std::floor((ras[i] - this->GridOrigin[i]) / this->GridSpacing + 0.5));
+    if (ijk[i] < 0 || ijk[i] >= this->GridDimensions[i])
+      {
+      return 0.0;
+      }
+    }
+  return this->Dose[(static_cast<vtkIdType>(ijk[2]) * this->GridDimensions[1] + ijk[1]) *
+                    this->GridDimensions[0] + ijk[0]];
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerSeedDose::GetDoseImage(vtkImageData* image)
+{
+  if (!image)
+    {
+    return;
+    }
+  image->SetOrigin(this->GridOrigin);
+  image->SetSpacing(this->GridSpacing, this->GridSpacing, this->GridSpacing);
+  image->SetDimensions(this->GridDimensions);
+  image->SetScalarTypeToDouble();
+  image->SetNumberOfScalarComponents(1);
+  image->AllocateScalars();
+  if (!this->Dose.empty())
+    {
+    std::copy(this->Dose.begin(), this->Dose.end(),
+              static_cast<double*>(image->GetScalarPointer()));
+    }
+}
+
+//----------------------------------------------------------------------------
+double vtkSlicerPathPlannerSeedDose::GetDoseToVolume(double volumeFraction)
+{
+  if (this->TargetPoints.empty() || this->Dose.empty() || volumeFraction <= 0.0)
+    {
+    return 0.0;
+    }
+  std::vector<double> doses(this->TargetPoints.size());
+  for (size_t i = 0; i < doses.size(); i++)
+    {
+    doses[i] = this->Dose[this->TargetPoints[i]];
+    }
+  size_t n = static_cast<size_t>(std::ceil(std::min(volumeFraction, 1.0) * doses.size()));
+  std::nth_element(doses.begin(), doses.begin() + (n - 1), doses.end(), std::greater<double>());
+  return doses[n - 1];
+}
+
+//----------------------------------------------------------------------------
+double vtkSlicerPathPlannerSeedDose::GetVolumeReceivingDose(double dose)
+{
+  if (this->TargetPoints.empty() || this->Dose.empty())
+    {
+    return 0.0;
+    }
+  vtkIdType count = 0;
+  for (size_t i = 0; i < this->TargetPoints.size(); i++)
+    {
+    count += this->Dose[this->TargetPoints[i]] >= dose;
+    }
+  return static_cast<double>(count) / this->TargetPoints.size();
+}
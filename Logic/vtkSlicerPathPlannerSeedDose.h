@@ -0,0 +1,195 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// .NAME vtkSlicerPathPlannerSeedDose - LDR brachytherapy dose of seeds along needles
+// .SECTION Description
+// Seeds are loaded every SeedSpacing mm from the needle tip back toward
+// the entry, where the needle is inside the Target label map. The dose of
+// each seed follows the AAPM TG-43U1 point source formalism for a model
+// 6711 I-125 seed:
+//   D(r) = Sk Lambda (r0 / r)^2 g(r) phi_an(r) 1.44 T1/2
+// (total dose of a permanent implant), with r clamped to 1 mm. The dose
+// is computed on a grid aligned with the RAS axes that covers the target
+// plus GridMargin. D(r) is tabulated once every 0.1 mm and the contribution
+// of every seed is added row by row in parallel over the grid slices.
+//
+// Needles are identified by a string, typically the ruler node ID. Moving
+// or removing a needle only subtracts its previous seeds and adds the new
+// ones on the next Update. Changing the target or any parameter recomputes
+// the whole grid.
+
+#ifndef __vtkSlicerPathPlannerSeedDose_h
+#define __vtkSlicerPathPlannerSeedDose_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkTimeStamp.h>
+
+// STD includes
+#include <map>
+#include <string>
+#include <vector>
+
+#include "vtkSlicerPathPlannerModuleLogicExport.h"
+
+class vtkImageData;
+class vtkPoints;
+class vtkSlicerPathPlannerVolumeSampler;
+
+/// \ingroup Slicer_QtModules_PathPlanner
+class VTK_SLICER_PATHPLANNER_MODULE_LOGIC_EXPORT vtkSlicerPathPlannerSeedDose :
+  public vtkObject
+{
+public:
+  static vtkSlicerPathPlannerSeedDose *New();
+  vtkTypeMacro(vtkSlicerPathPlannerSeedDose, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Label map of the implanted organ. Seeds are only loaded inside it and
+  /// the dose-volume metrics are computed over it.
+  void SetTarget(vtkSlicerPathPlannerVolumeSampler* target);
+  vtkGetObjectMacro(Target, vtkSlicerPathPlannerVolumeSampler);
+
+  /// Dose grid spacing (mm). Default is 2.
+  vtkSetClampMacro(GridSpacing, double, 0.1, VTK_DOUBLE_MAX);
+  vtkGetMacro(GridSpacing, double);
+
+  /// Margin around the target covered by the dose grid (mm). Default is 10.
+  vtkSetClampMacro(GridMargin, double, 0.0, VTK_DOUBLE_MAX);
+  vtkGetMacro(GridMargin, double);
+
+  /// Distance between consecutive seeds along a needle (mm). Default is 10.
+  vtkSetClampMacro(SeedSpacing, double, 0.5, VTK_DOUBLE_MAX);
+  vtkGetMacro(SeedSpacing, double);
+
+  /// Air kerma strength of a seed (U). Default is 0.5.
+  vtkSetMacro(AirKermaStrength, double);
+  vtkGetMacro(AirKermaStrength, double);
+
+  /// Dose rate constant (cGy / h / U). Default is 0.965.
+  vtkSetMacro(DoseRateConstant, double);
+  vtkGetMacro(DoseRateConstant, double);
+
+  /// Half life of the isotope (days). Default is 59.4.
+  vtkSetClampMacro(HalfLife, double, 0.0, VTK_DOUBLE_MAX);
+  vtkGetMacro(HalfLife, double);
+
+  /// Prescribed dose (Gy), used by the logic for the V100 and V150
+  /// metrics. Default is 145.
+  vtkSetMacro(PrescriptionDose, double);
+  vtkGetMacro(PrescriptionDose, double);
+
+  /// Contributions further than this from a seed are ignored (mm).
+  /// Default is 100.
+  vtkSetClampMacro(MaximumRadius, double, 1.0, VTK_DOUBLE_MAX);
+  vtkGetMacro(MaximumRadius, double);
+
+  /// Add or move a needle going from entry to tip. Nothing is recomputed if
+  /// the needle did not move.
+  void SetNeedle(const char* id, const double entry[3], const double tip[3]);
+  void RemoveNeedle(const char* id);
+  void RemoveAllNeedles();
+  int GetNumberOfNeedles();
+  const char* GetNthNeedleID(int n);
+
+  /// Seeds of all the needles, as of the last Update.
+  void GetSeeds(vtkPoints* seeds);
+
+  /// Apply the needle changes, or recompute the whole grid if the target
+  /// or a parameter changed.
+  void Update();
+
+  /// Number of needles whose dose was recomputed since the last call to
+  /// ResetNumberOfUpdatedNeedles.
+  vtkGetMacro(NumberOfUpdatedNeedles, int);
+  void ResetNumberOfUpdatedNeedles() { this->NumberOfUpdatedNeedles = 0; }
+
+  /// Total dose (Gy) at the grid point closest to ras, 0 outside the grid.
+  double GetDose(const double ras[3]);
+
+  /// Copy the dose grid (Gy, double) into "image". Origin and spacing are
+  /// in RAS.
+  void GetDoseImage(vtkImageData* image);
+
+  /// Minimum dose (Gy) received by the hottest "volumeFraction" of the
+  /// target, e.g. D90 for 0.9.
+  double GetDoseToVolume(double volumeFraction);
+
+  /// Fraction of the target receiving at least "dose" (Gy), e.g. V100 for
+  /// the prescription dose.
+  double GetVolumeReceivingDose(double dose);
+
+  /// Total dose (Gy) at distance "radius" (mm) of a single seed.
+  double GetSeedDose(double radius);
+
+protected:
+  vtkSlicerPathPlannerSeedDose();
+  virtual ~vtkSlicerPathPlannerSeedDose();
+
+  //BTX
+  struct Needle
+  {
+    double Segment[6];
+    std::vector<double> Seeds;
+  };
+
+  bool IsGridDirty();
+  void BuildGrid();
+  void BuildKernel();
+  void PlaceSeeds(const double segment[6], std::vector<double>& seeds) const;
+  void AddSeeds(const std::vector<double>& seeds, const std::vector<double>& weights);
+  //ETX
+
+  vtkSlicerPathPlannerVolumeSampler* Target;
+  double GridSpacing;
+  double GridMargin;
+  double SeedSpacing;
+  double AirKermaStrength;
+  double DoseRateConstant;
+  double HalfLife;
+  double PrescriptionDose;
+  double MaximumRadius;
+  int NumberOfUpdatedNeedles;
+
+  //BTX
+  std::map<std::string, Needle> Needles;
+  // Seeds to add (weight 1) or subtract (weight -1) on the next Update
+  std::vector<double> PendingSeeds;
+  std::vector<double> PendingWeights;
+  vtkTimeStamp GridTime;
+  double GridOrigin[3];
+  int GridDimensions[3];
+  std::vector<double> Dose;
+  // Grid points inside the target
+  std::vector<vtkIdType> TargetPoints;
+  // Dose of one seed every KernelStep mm
+  std::vector<float> Kernel;
+  double KernelStep;
+  //ETX
+
+private:
+  vtkSlicerPathPlannerSeedDose(const vtkSlicerPathPlannerSeedDose&); // Not implemented
+  void operator=(const vtkSlicerPathPlannerSeedDose&);               // Not implemented
+};
+
+#endif
@@ -0,0 +1,633 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerSegmentIndex.h"
+
+// VTK includes
+#include <vtkIdList.h>
+#include <vtkMath.h>
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// 21 bits per cell coordinate
+const vtkTypeInt64 CellOffset = 1 << 20;
+const vtkTypeInt64 CellMask = (1 << 21) - 1;
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 MakeCellKey(const int index[3])
+{
+  return (((index[0] + CellOffset) & CellMask) << 42) |
+    (((index[1] + CellOffset) & CellMask) << 21) |
+    ((index[2] + CellOffset) & CellMask);
+}
+
+//----------------------------------------------------------------------------
+void GetCellIndex(vtkTypeInt64 key, int index[3])
+{
+  index[0] = static_cast<int>(((key >> 42) & CellMask) - CellOffset);
+  index[1] = static_cast<int>(((key >> 21) & CellMask) - CellOffset);
+  index[2] = static_cast<int>((key & CellMask) - CellOffset);
+}
+
+//----------------------------------------------------------------------------
+// Cells crossed by the segment, in order (Amanatides and Woo traversal)
+void TraverseCells(const double points[6], double cellSize,
+                   std::vector<vtkTypeInt64>& cells)
+{
+  cells.clear();
+  int index[3];
+  int step[3];
+  double tMax[3];
+  double tDelta[3];
+  int numberOfSteps = 0;
+  for (int axis = 0; axis < 3; axis++)
+    {
+    double start = points[axis] / cellSize;
+    double end = points[3 + axis] / cellSize;
+    index[axis] = static_cast<int>(std::floor(start));
+    int last = static_cast<int>(std::floor(end));
+    numberOfSteps += last > index[axis] ? last - index[axis] : index[axis] - last;
+    double delta = end - start;
+    if (delta > 0.0)
+      {
+      step[axis] = 1;
+      tMax[axis] = (index[axis] + 1 - start) / delta;
+      tDelta[axis] = 1.0 / delta;
+      }
+    else if (delta < 0.0)
+      {
+      step[axis] = -1;
+      tMax[axis] = (index[axis] - start) / delta;
+      tDelta[axis] = -1.0 / delta;
+      }
+    else
+      {
+      step[axis] = 0;
+      tMax[axis] = VTK_DOUBLE_MAX;
+      tDelta[axis] = VTK_DOUBLE_MAX;
+      }
+    }
+
+  cells.push_back(MakeCellKey(index));
+  for (int n = 0; n < numberOfSteps; n++)
+    {
+    int axis = tMax[0] < tMax[1] ? (tMax[0] < tMax[2] ? 0 : 2) : (tMax[1] < tMax[2] ? 1 : 2);
+    index[axis] += step[axis];
+    tMax[axis] += tDelta[axis];
+    cells.push_back(MakeCellKey(index));
+    }
+}
+
+// Maximum number of segments in a leaf of the closest segment tree
+const int TreeLeafSize = 4;
+
+//----------------------------------------------------------------------------
+// Order tree segments by their center along Axis
+template <class T>
+struct CenterLess
+{
+  int Axis;
+  bool operator()(const T& a, const T& b) const
+  {
+    return a.Points[this->Axis] + a.Points[3 + this->Axis] <
+      b.Points[this->Axis] + b.Points[3 + this->Axis];
+  }
+};
+
+//----------------------------------------------------------------------------
+double BoxDistance2(const double bounds[6], const double point[3])
+{
+  double distance2 = 0.0;
+  for (int i = 0; i < 3; i++)
+    {
+    double outside = point[i] < bounds[2 * i] ? bounds[2 * i] - point[i] :
+      (point[i] > bounds[2 * i + 1] ? point[i] - bounds[2 * i + 1] : 0.0);
+    distance2 += outside * outside;
+    }
+  return distance2;
+}
+
+//----------------------------------------------------------------------------
+double PointSegmentDistance2(const double point[3], const double points[6])
+{
+  double direction[3] = { points[3] - points[0], points[4] - points[1], points[5] - points[2] };
+  double offset[3] = { point[0] - points[0], point[1] - points[1], point[2] - points[2] };
+  double length2 = vtkMath::Dot(direction, direction);
+  double t = length2 > 1e-12 ? vtkMath::Dot(offset, direction) / length2 : 0.0;
+  t = t > 0.0 ? (t < 1.0 ? t : 1.0) : 0.0;
+  double difference[3] = { offset[0] - t * direction[0], offset[1] - t * direction[1],
+                           offset[2] - t * direction[2] };
+  return vtkMath::Dot(difference, difference);
+}
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerPathPlannerSegmentIndex);
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerSegmentIndex::vtkSlicerPathPlannerSegmentIndex()
+{
+  this->CellSize = 10.0;
+  this->NumberOfDistanceTests = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerSegmentIndex::~vtkSlicerPathPlannerSegmentIndex()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerSegmentIndex::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "CellSize: " << this->CellSize << "\n";
+  os << indent << "NumberOfSegments: " << this->Segments.size() << "\n";
+  os << indent << "NumberOfCells: " << this->Cells.size() << "\n";
+  os << indent << "NumberOfDistanceTests: " << this->NumberOfDistanceTests << "\n";
+  os << indent << "NumberOfTreeNodes: " << this->Tree.size() << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerSegmentIndex::SetCellSize(double cellSize)
+{
+  if (cellSize <= 0.0 || cellSize == this->CellSize)
+    {
+    return;
+    }
+  this->CellSize = cellSize;
+  this->Cells.clear();
+  for (SegmentMap::iterator it = this->Segments.begin(); it != this->Segments.end(); ++it)
+    {
+    this->InsertCells(it->first, it->second);
+    }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerSegmentIndex::InsertCells(vtkIdType id, Segment& segment)
+{
+  TraverseCells(segment.Points, this->CellSize, segment.Cells);
+  for (std::vector<CellKey>::const_iterator it = segment.Cells.begin();
+       it != segment.Cells.end(); ++it)
+    {
+    this->Cells[*it].push_back(id);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerSegmentIndex::RemoveCells(vtkIdType id, Segment& segment)
+{
+  for (std::vector<CellKey>::const_iterator it = segment.Cells.begin();
+       it != segment.Cells.end(); ++it)
+    {
+    CellMap::iterator cell = this->Cells.find(*it);
+    if (cell == this->Cells.end())
+      {
+      continue;
+      }
+    std::vector<vtkIdType>& ids = cell->second;
+    ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+    if (ids.empty())
+      {
+      this->Cells.erase(cell);
+      }
+    }
+  segment.Cells.clear();
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerSegmentIndex::SetSegment(vtkIdType id, const double point0[3],
+                                                 const double point1[3])
+{
+  SegmentMap::iterator it = this->Segments.find(id);
+  if (it != this->Segments.end())
+    {
+    const double* points = it->second.Points;
+    if (points[0] == point0[0] && points[1] == point0[1] && points[2] == point0[2] &&
+        points[3] == point1[0] && points[4] == point1[1] && points[5] == point1[2])
+      {
+      return 0;
+      }
+    this->RemoveCells(id, it->second);
+    }
+  else
+    {
+    it = this->Segments.insert(std::make_pair(id, Segment())).first;
+    }
+
+  for (int i = 0; i < 3; i++)
+    {
+    it->second.Points[i] = point0[i];
+    it->second.Points[3 + i] = point1[i];
+    }
+  this->InsertCells(id, it->second);
+  this->Modified();
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerSegmentIndex::RemoveSegment(vtkIdType id)
+{
+  SegmentMap::iterator it = this->Segments.find(id);
+  if (it == this->Segments.end())
+    {
+    return;
+    }
+  this->RemoveCells(id, it->second);
+  this->Segments.erase(it);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerSegmentIndex::RemoveAllSegments()
+{
+  this->Segments.clear();
+  this->Cells.clear();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkSlicerPathPlannerSegmentIndex::GetNumberOfSegments()
+{
+  return static_cast<vtkIdType>(this->Segments.size());
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerSegmentIndex::GetSegment(vtkIdType id, double point0[3],
+                                                 double point1[3])
+{
+  SegmentMap::iterator it = this->Segments.find(id);
+  if (it == this->Segments.end())
+    {
+    return 0;
+    }
+  for (int i = 0; i < 3; i++)
+    {
+    point0[i] = it->second.Points[i];
+    point1[i] = it->second.Points[3 + i];
+    }
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerSegmentIndex::FindCandidates(const Segment& segment, double distance,
+                                                     std::vector<vtkIdType>& candidates)
+{
+  candidates.clear();
+  // Points closer than "distance" are at most that many cells apart
+  int range = static_cast<int>(std::floor(distance / this->CellSize)) + 1;
+  for (std::vector<CellKey>::const_iterator it = segment.Cells.begin();
+       it != segment.Cells.end(); ++it)
+    {
+    int center[3];
+    GetCellIndex(*it, center);
+    int index[3];
+    for (index[0] = center[0] - range; index[0] <= center[0] + range; index[0]++)
+      {
+      for (index[1] = center[1] - range; index[1] <= center[1] + range; index[1]++)
+        {
+        for (index[2] = center[2] - range; index[2] <= center[2] + range; index[2]++)
+          {
+          CellMap::const_iterator cell = this->Cells.find(MakeCellKey(index));
+          if (cell != this->Cells.end())
+            {
+            candidates.insert(candidates.end(), cell->second.begin(), cell->second.end());
+            }
+          }
+        }
+      }
+    }
+  std::sort(candidates.begin(), candidates.end());
+  candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerSegmentIndex::FindConflicts(double distance, vtkIdList* pairs)
+{
+  if (!pairs)
+    {
+    return;
+    }
+  pairs->Reset();
+  this->NumberOfDistanceTests = 0;
+
+  std::vector<vtkIdType> candidates;
+  for (SegmentMap::iterator it = this->Segments.begin(); it != this->Segments.end(); ++it)
+    {
+    this->FindCandidates(it->second, distance, candidates);
+    const double* points = it->second.Points;
+    for (std::vector<vtkIdType>::const_iterator candidate =
+           std::upper_bound(candidates.begin(), candidates.end(), it->first);
+         candidate != candidates.end(); ++candidate)
+      {
+      const double* otherPoints = this->Segments[*candidate].Points;
+      ++this->NumberOfDistanceTests;
+      if (this->SegmentDistance(points, points + 3, otherPoints, otherPoints + 3) < distance)
+        {
+        pairs->InsertNextId(it->first);
+        pairs->InsertNextId(*candidate);
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerSegmentIndex::BuildTree()
+{
+  this->Tree.clear();
+  this->TreeSegments.clear();
+  this->TreeSegments.reserve(this->Segments.size());
+  for (SegmentMap::iterator it = this->Segments.begin(); it != this->Segments.end(); ++it)
+    {
+    TreeSegment segment;
+    std::copy(it->second.Points, it->second.Points + 6, segment.Points);
+    for (int i = 0; i < 3; i++)
+      {
+      segment.Direction[i] = segment.Points[3 + i] - segment.Points[i];
+      }
+    vtkMath::Normalize(segment.Direction);
+    segment.Id = it->first;
+    this->TreeSegments.push_back(segment);
+    }
+
+  int numberOfSegments = static_cast<int>(this->TreeSegments.size());
+  if (numberOfSegments > 0)
+    {
+    this->Tree.reserve(2 * (numberOfSegments / TreeLeafSize + 1));
+    this->BuildTreeNode(0, numberOfSegments);
+    }
+  this->TreeBuildTime.Modified();
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerSegmentIndex::BuildTreeNode(int first, int count)
+{
+  TreeNode node;
+  double centerBounds[6];
+  for (int i = 0; i < 3; i++)
+    {
+    node.Bounds[2 * i] = centerBounds[2 * i] = VTK_DOUBLE_MAX;
+    node.Bounds[2 * i + 1] = centerBounds[2 * i + 1] = -VTK_DOUBLE_MAX;
+    }
+  for (int n = first; n < first + count; n++)
+    {
+    const double* points = this->TreeSegments[n].Points;
+    for (int i = 0; i < 3; i++)
+      {
+      node.Bounds[2 * i] = std::min(node.Bounds[2 * i], std::min(points[i], points[3 + i]));
+      node.Bounds[2 * i + 1] = std::max(node.Bounds[2 * i + 1],
+                                        std::max(points[i], points[3 + i]));
+      double center = points[i] + points[3 + i];
+      centerBounds[2 * i] = std::min(centerBounds[2 * i], center);
+      centerBounds[2 * i + 1] = std::max(centerBounds[2 * i + 1], center);
+      }
+    }
+  node.First = first;
+  node.Count = count;
+
+  int index = static_cast<int>(this->Tree.size());
+  this->Tree.push_back(node);
+  if (count <= TreeLeafSize)
+    {
+    return index;
+    }
+
+  // Median split along the largest extent of the segment centers
+  CenterLess<TreeSegment> less;
+  less.Axis = 0;
+  for (int i = 1; i < 3; i++)
+    {
+    if (centerBounds[2 * i + 1] - centerBounds[2 * i] >
+        centerBounds[2 * less.Axis + 1] - centerBounds[2 * less.Axis])
+      {
+      less.Axis = i;
+      }
+    }
+  int half = count / 2;
+  std::nth_element(this->TreeSegments.begin() + first,
+                   this->TreeSegments.begin() + first + half,
+                   this->TreeSegments.begin() + first + count, less);
+
+  this->BuildTreeNode(first, half);
+  int second = this->BuildTreeNode(first + half, count - half);
+  this->Tree[index].First = second;
+  this->Tree[index].Count = 0;
+  return index;
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkSlicerPathPlannerSegmentIndex::FindClosestSegment(const double point[3],
+                                                               double* distance)
+{
+  return this->FindClosestSegment(point, NULL, 180.0, distance);
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkSlicerPathPlannerSegmentIndex::FindClosestSegment(const double point[3],
+                                                               const double direction[3],
+                                                               double maximumAngle,
+                                                               double* distance)
+{
+  this->NumberOfDistanceTests = 0;
+  if (this->TreeBuildTime < this->GetMTime())
+    {
+    this->BuildTree();
+    }
+
+  // Direction filter, disabled by a NULL or null direction
+  double needle[3] = { 0.0, 0.0, 0.0 };
+  double minimumCosine = -2.0;
+  if (direction && maximumAngle < 180.0)
+    {
+    std::copy(direction, direction + 3, needle);
+    if (vtkMath::Normalize(needle) > 0.0)
+      {
+      minimumCosine = std::cos(vtkMath::RadiansFromDegrees(maximumAngle));
+      }
+    }
+
+  vtkIdType closest = -1;
+  double closestDistance2 = VTK_DOUBLE_MAX;
+
+  // Depth first, nearest child first. Median splits keep the depth
+  // logarithmic, one pending node per level.
+  int stack[64];
+  int stackSize = 0;
+  if (!this->Tree.empty())
+    {
+    stack[stackSize++] = 0;
+    }
+  while (stackSize > 0)
+    {
+    int index = stack[--stackSize];
+    const TreeNode& node = this->Tree[index];
+    if (BoxDistance2(node.Bounds, point) > closestDistance2)
+      {
+      continue;
+      }
+
+    if (node.Count > 0)
+      {
+      for (int n = node.First; n < node.First + node.Count; n++)
+        {
+        const TreeSegment& segment = this->TreeSegments[n];
+        if (vtkMath::Dot(segment.Direction, needle) < minimumCosine)
+          {
+          continue;
+          }
+        ++this->NumberOfDistanceTests;
+        double distance2 = PointSegmentDistance2(point, segment.Points);
+        if (distance2 < closestDistance2 ||
+            (distance2 == closestDistance2 && segment.Id < closest))
+          {
+          closest = segment.Id;
+          closestDistance2 = distance2;
+          }
+        }
+      continue;
+      }
+
+    int nearChild = index + 1;
+    int farChild = node.First;
+    double nearDistance2 = BoxDistance2(this->Tree[nearChild].Bounds, point);
+    double farDistance2 = BoxDistance2(this->Tree[farChild].Bounds, point);
+    if (farDistance2 < nearDistance2)
+      {
+      std::swap(nearChild, farChild);
+      std::swap(nearDistance2, farDistance2);
+      }
+    if (farDistance2 <= closestDistance2)
+      {
+      stack[stackSize++] = farChild;
+      }
+    if (nearDistance2 <= closestDistance2)
+      {
+      stack[stackSize++] = nearChild;
+      }
+    }
+
+  if (distance)
+    {
+    *distance = closest >= 0 ? std::sqrt(closestDistance2) : VTK_DOUBLE_MAX;
+    }
+  return closest;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerSegmentIndex::FindConflicts(vtkIdType id, double distance,
+                                                     vtkIdList* ids)
+{
+  if (!ids)
+    {
+    return;
+    }
+  ids->Reset();
+  this->NumberOfDistanceTests = 0;
+  SegmentMap::iterator it = this->Segments.find(id);
+  if (it == this->Segments.end())
+    {
+    return;
+    }
+
+  std::vector<vtkIdType> candidates;
+  this->FindCandidates(it->second, distance, candidates);
+  const double* points = it->second.Points;
+  for (std::vector<vtkIdType>::const_iterator candidate = candidates.begin();
+       candidate != candidates.end(); ++candidate)
+    {
+    if (*candidate == id)
+      {
+      continue;
+      }
+    const double* otherPoints = this->Segments[*candidate].Points;
+    ++this->NumberOfDistanceTests;
+    if (this->SegmentDistance(points, points + 3, otherPoints, otherPoints + 3) < distance)
+      {
+      ids->InsertNextId(*candidate);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+double vtkSlicerPathPlannerSegmentIndex::SegmentDistance(const double p0[3], const double p1[3],
+                                                         const double q0[3], const double q1[3])
+{
+  // Closest points of two segments (Ericson, Real-Time Collision Detection)
+  double d1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+  double d2[3] = { q1[0] - q0[0], q1[1] - q0[1], q1[2] - q0[2] };
+  double r[3] = { p0[0] - q0[0], p0[1] - q0[1], p0[2] - q0[2] };
+  double a = vtkMath::Dot(d1, d1);
+  double e = vtkMath::Dot(d2, d2);
+  double f = vtkMath::Dot(d2, r);
+  double s = 0.0;
+  double t = 0.0;
+  const double epsilon = 1e-12;
+
+  if (a <= epsilon && e <= epsilon)
+    {
+    s = t = 0.0;
+    }
+  else if (a <= epsilon)
+    {
+    t = std::min(std::max(f / e, 0.0), 1.0);
+    }
+  else
+    {
+    double c = vtkMath::Dot(d1, r);
+    if (e <= epsilon)
+      {
+      s = std::min(std::max(-c / a, 0.0), 1.0);
+      }
+    else
+      {
+      double b = vtkMath::Dot(d1, d2);
+      double denominator = a * e - b * b;
+      s = denominator > epsilon * a * e ?
+        std::min(std::max((b * f - c * e) / denominator, 0.0), 1.0) : 0.0;
+      t = (b * s + f) / e;
+      if (t < 0.0)
+        {
+        t = 0.0;
+        s = std::min(std::max(-c / a, 0.0), 1.0);
+        }
+      else if (t > 1.0)
+        {
+        t = 1.0;
+        s = std::min(std::max((b - c) / a, 0.0), 1.0);
+        }
+      }
+    }
+
+  double difference[3];
+  for (int i = 0; i < 3; i++)
+    {
+    difference[i] = (p0[i] + s * d1[i]) - (q0[i] + t * d2[i]);
+    }
+  return std::sqrt(vtkMath::Dot(difference, difference));
+}
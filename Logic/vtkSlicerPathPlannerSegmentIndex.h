@@ -0,0 +1,152 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// .NAME vtkSlicerPathPlannerSegmentIndex - spatial index of straight trajectories
+// .SECTION Description
+// Uniform hash grid of line segments. Each segment is registered in the
+// cells it crosses (3D DDA traversal), so that segments closer than a
+// distance D are found by looking only at the neighbor cells within
+// ceil(D / CellSize) of these cells instead of testing every pair. Moving
+// a segment updates only its own cells.
+//
+// Nearest segment queries, e.g. which trajectory a tracked needle is
+// following, use a bounding volume hierarchy of the segments instead: it
+// is rebuilt on the first query after the segments changed, and subtrees
+// further than the closest segment found so far are skipped, so that a
+// query costs a few microseconds wherever the point is.
+
+#ifndef __vtkSlicerPathPlannerSegmentIndex_h
+#define __vtkSlicerPathPlannerSegmentIndex_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkTimeStamp.h>
+
+// STD includes
+#include <map>
+#include <vector>
+
+#include "vtkSlicerPathPlannerModuleLogicExport.h"
+
+class vtkIdList;
+
+/// \ingroup Slicer_QtModules_PathPlanner
+class VTK_SLICER_PATHPLANNER_MODULE_LOGIC_EXPORT vtkSlicerPathPlannerSegmentIndex :
+  public vtkObject
+{
+public:
+  static vtkSlicerPathPlannerSegmentIndex *New();
+  vtkTypeMacro(vtkSlicerPathPlannerSegmentIndex, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Size of the grid cells (mm). Changing it rebuilds the grid. Default
+  /// is 10, about the conflict distances of interest.
+  void SetCellSize(double cellSize);
+  vtkGetMacro(CellSize, double);
+
+  /// Add the segment "id" or move it. Return 1 if the index changed.
+  int SetSegment(vtkIdType id, const double point0[3], const double point1[3]);
+  void RemoveSegment(vtkIdType id);
+  void RemoveAllSegments();
+  vtkIdType GetNumberOfSegments();
+  int GetSegment(vtkIdType id, double point0[3], double point1[3]);
+
+  /// All the pairs of segments closer than "distance", as consecutive ids
+  /// (first id lower than the second).
+  void FindConflicts(double distance, vtkIdList* pairs);
+
+  /// Segments closer than "distance" to segment "id", sorted.
+  void FindConflicts(vtkIdType id, double distance, vtkIdList* ids);
+
+  /// Segment closest to "point", -1 if the index is empty. "distance"
+  /// receives its distance when not NULL.
+  vtkIdType FindClosestSegment(const double point[3], double* distance = NULL);
+
+  /// Segment closest to a needle pose, only considering the segments whose
+  /// direction (point0 to point1) is within "maximumAngle" degrees of
+  /// "direction". Return -1 if no segment qualifies.
+  vtkIdType FindClosestSegment(const double point[3], const double direction[3],
+                               double maximumAngle, double* distance = NULL);
+
+  /// Number of segment distances computed by the last FindConflicts or
+  /// FindClosestSegment call.
+  vtkGetMacro(NumberOfDistanceTests, vtkIdType);
+
+  /// Shortest distance between segments [p0, p1] and [q0, q1].
+  static double SegmentDistance(const double p0[3], const double p1[3],
+                                const double q0[3], const double q1[3]);
+
+protected:
+  vtkSlicerPathPlannerSegmentIndex();
+  virtual ~vtkSlicerPathPlannerSegmentIndex();
+
+  //BTX
+  typedef vtkTypeInt64 CellKey;
+  struct Segment
+  {
+    double Points[6];
+    std::vector<CellKey> Cells;
+  };
+  typedef std::map<vtkIdType, Segment> SegmentMap;
+  typedef std::map<CellKey, std::vector<vtkIdType> > CellMap;
+
+  void InsertCells(vtkIdType id, Segment& segment);
+  void RemoveCells(vtkIdType id, Segment& segment);
+  void FindCandidates(const Segment& segment, double distance,
+                      std::vector<vtkIdType>& candidates);
+
+  SegmentMap Segments;
+  CellMap Cells;
+
+  // Bounding volume hierarchy for the closest segment queries. Leaves
+  // reference a range of TreeSegments. The first child of an inner node
+  // follows it, First is the index of the second child.
+  struct TreeNode
+  {
+    double Bounds[6];
+    int First;
+    int Count;
+  };
+  struct TreeSegment
+  {
+    double Points[6];
+    double Direction[3];
+    vtkIdType Id;
+  };
+  void BuildTree();
+  int BuildTreeNode(int first, int count);
+
+  std::vector<TreeNode> Tree;
+  std::vector<TreeSegment> TreeSegments;
+  vtkTimeStamp TreeBuildTime;
+  //ETX
+
+  double CellSize;
+  vtkIdType NumberOfDistanceTests;
+
+private:
+  vtkSlicerPathPlannerSegmentIndex(const vtkSlicerPathPlannerSegmentIndex&); // Not implemented
+  void operator=(const vtkSlicerPathPlannerSegmentIndex&);               // Not implemented
+};
+
+#endif
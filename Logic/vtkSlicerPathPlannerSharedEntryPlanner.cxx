@@ -0,0 +1,703 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerParallel.h"
+#include "vtkSlicerPathPlannerSharedEntryPlanner.h"
+#include "vtkSlicerPathPlannerVolumeSampler.h"
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkIdList.h>
+#include <vtkMath.h>
+#include <vtkObjectFactory.h>
+#include <vtkPoints.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+//----------------------------------------------------------------------------
+int CountBits(vtkTypeUInt64 x)
+{
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  return static_cast<int>((x * 0x0101010101010101ULL) >> 56);
+}
+
+//----------------------------------------------------------------------------
+void GetBinDirection(int polarBin, int azimuthBin, double resolution[2], double direction[3])
+{
+  double polar = (polarBin + 0.5) * resolution[0];
+  double azimuth = -vtkMath::Pi() + (azimuthBin + 0.5) * resolution[1];
+  direction[0] = std::sin(polar) * std::cos(azimuth);
+  direction[1] = std::sin(polar) * std::sin(azimuth);
+  direction[2] = std::cos(polar);
+}
+
+//----------------------------------------------------------------------------
+// Free length of the rays cast from every target, one row of azimuth bins
+// per call
+struct DirectionMapFunctor
+{
+  const double* Targets;
+  const vtkSlicerPathPlannerVolumeSampler* Obstacles;
+  int NumberOfPolarBins;
+  int NumberOfAzimuthBins;
+  double Resolution[2];
+  double MaximumDepth;
+  double Step;
+  // Only bins whose direction is within this cone are cast, if set
+  const double* ConeAxis;
+  double ConeCosine;
+  float* Maps;
+
+  void operator()(vtkIdType begin, vtkIdType end, int vtkNotUsed(threadId))
+  {
+    for (vtkIdType row = begin; row < end; row++)
+      {
+      vtkIdType target = row / this->NumberOfPolarBins;
+      int polarBin = static_cast<int>(row % this->NumberOfPolarBins);
+      const double* origin = this->Targets + 3 * target;
+      float* map = this->Maps + row * this->NumberOfAzimuthBins;
+      for (int azimuthBin = 0; azimuthBin < this->NumberOfAzimuthBins; azimuthBin++)
+        {
+        double direction[3];
+        GetBinDirection(polarBin, azimuthBin, this->Resolution, direction);
+        if (this->ConeAxis && vtkMath::Dot(direction, this->ConeAxis) < this->ConeCosine)
+          {
+          map[azimuthBin] = 0.0f;
+          continue;
+          }
+        map[azimuthBin] = static_cast<float>(this->CastRay(origin, direction));
+        }
+      }
+  }
+
+  double CastRay(const double origin[3], const double direction[3]) const
+  {
+    if (!this->Obstacles)
+      {
+      return this->MaximumDepth;
+      }
+    for (double length = 0.0; length < this->MaximumDepth + this->Step; length += this->Step)
+      {
+      double point[3] = { origin[0] + length * direction[0],
+                          origin[1] + length * direction[1],
+                          origin[2] + length * direction[2] };
+      if (this->Obstacles->GetValueNearest(point) != 0.0)
+        {
+        return length - this->Step > 0.0 ? length - this->Step : 0.0;
+        }
+      }
+    return this->MaximumDepth;
+  }
+};
+
+//----------------------------------------------------------------------------
+// Reachable targets of every entry, by direction map lookups
+struct ReachabilityFunctor
+{
+  const double* Entries;
+  const double* Normals;
+  const double* Targets;
+  vtkIdType NumberOfTargets;
+  double ReferenceDirection[3];
+  double MinimumCosine;
+  double MaximumDepth;
+  int NumberOfPolarBins;
+  int NumberOfAzimuthBins;
+  double Resolution[2];
+  const float* Maps;
+  int NumberOfWords;
+  vtkTypeUInt64* Reachable;
+
+  void operator()(vtkIdType begin, vtkIdType end, int vtkNotUsed(threadId))
+  {
+    for (vtkIdType e = begin; e < end; e++)
+      {
+      const double* entry = this->Entries + 3 * e;
+      const double* reference = this->Normals ? this->Normals + 3 * e : this->ReferenceDirection;
+      vtkTypeUInt64* reachable = this->Reachable + e * this->NumberOfWords;
+      for (int w = 0; w < this->NumberOfWords; w++)
+        {
+        reachable[w] = 0;
+        }
+      for (vtkIdType t = 0; t < this->NumberOfTargets; t++)
+        {
+        const double* target = this->Targets + 3 * t;
+        double direction[3] = { entry[0] - target[0], entry[1] - target[1],
+                                entry[2] - target[2] };
+        double depth = vtkMath::Normalize(direction);
+        if (depth <= 0.0 || depth > this->MaximumDepth ||
+            vtkMath::Dot(direction, reference) < this->MinimumCosine)
+          {
+          continue;
+          }
+        double polar = std::acos(direction[2] < 1.0 ? (direction[2] > -1.0 ? direction[2] : -1.0) : 1.0);
+        double azimuth = std::atan2(direction[1], direction[0]) + vtkMath::Pi();
+        int polarBin = std::min(static_cast<int>(polar / this->Resolution[0]),
+                                this->NumberOfPolarBins - 1);
+        int azimuthBin = std::min(static_cast<int>(azimuth / this->Resolution[1]),
+                                  this->NumberOfAzimuthBins - 1);
+        float freeLength = this->Maps[(t * this->NumberOfPolarBins + polarBin) *
+                                      this->NumberOfAzimuthBins + azimuthBin];
+        if (depth <= freeLength)
+          {
+          reachable[t >> 6] |= static_cast<vtkTypeUInt64>(1) << (t & 63);
+          }
+        }
+      }
+  }
+};
+
+//----------------------------------------------------------------------------
+// Exact minimum set cover by branch and bound
+struct CoverSearch
+{
+  const std::vector<vtkTypeUInt64>* Masks;
+  int NumberOfWords;
+  int NumberOfTargets;
+  std::vector<int> Current;
+  std::vector<int> Best;
+  int NodeBudget;
+  int Nodes;
+
+  const vtkTypeUInt64* Mask(int set) const
+  {
+    return &(*this->Masks)[static_cast<size_t>(set) * this->NumberOfWords];
+  }
+
+  int CountNew(int set, const std::vector<vtkTypeUInt64>& uncovered) const
+  {
+    const vtkTypeUInt64* mask = this->Mask(set);
+    int count = 0;
+    for (int w = 0; w < this->NumberOfWords; w++)
+      {
+      count += CountBits(mask[w] & uncovered[w]);
+      }
+    return count;
+  }
+
+  void Search(const std::vector<vtkTypeUInt64>& uncovered)
+  {
+    if (++this->Nodes > this->NodeBudget)
+      {
+      return;
+      }
+    int numberOfSets = static_cast<int>(this->Masks->size() / this->NumberOfWords);
+    int remaining = 0;
+    for (int w = 0; w < this->NumberOfWords; w++)
+      {
+      remaining += CountBits(uncovered[w]);
+      }
+    if (remaining == 0)
+      {
+      this->Best = this->Current;
+      return;
+      }
+
+    // Lower bound: remaining targets over the best single set
+    int largest = 0;
+    for (int set = 0; set < numberOfSets; set++)
+      {
+      largest = std::max(largest, this->CountNew(set, uncovered));
+      }
+    int bound = static_cast<int>(this->Current.size()) + (remaining + largest - 1) / largest;
+    if (bound >= static_cast<int>(this->Best.size()))
+      {
+      return;
+      }
+
+    // Branch on the uncovered target with the fewest covering sets
+    int branchTarget = -1;
+    int fewest = numberOfSets + 1;
+    for (int t = 0; t < this->NumberOfTargets; t++)
+      {
+      if (!(uncovered[t >> 6] & (static_cast<vtkTypeUInt64>(1) << (t & 63))))
+        {
+        continue;
+        }
+      int count = 0;
+      for (int set = 0; set < numberOfSets && count < fewest; set++)
+        {
+        count += (this->Mask(set)[t >> 6] >> (t & 63)) & 1;
+        }
+      if (count < fewest)
+        {
+        fewest = count;
+        branchTarget = t;
+        }
+      }
+
+    std::vector<std::pair<int, int> > branches;
+    for (int set = 0; set < numberOfSets; set++)
+      {
+      if ((this->Mask(set)[branchTarget >> 6] >> (branchTarget & 63)) & 1)
+        {
+        branches.push_back(std::make_pair(-this->CountNew(set, uncovered), set));
+        }
+      }
+    std::sort(branches.begin(), branches.end());
+
+    std::vector<vtkTypeUInt64> next(this->NumberOfWords);
+    for (size_t b = 0; b < branches.size(); b++)
+      {
+      const vtkTypeUInt64* mask = this->Mask(branches[b].second);
+      for (int w = 0; w < this->NumberOfWords; w++)
+        {
+        next[w] = uncovered[w] & ~mask[w];
+        }
+      this->Current.push_back(branches[b].second);
+      this->Search(next);
+      this->Current.pop_back();
+      if (this->Nodes > this->NodeBudget)
+        {
+        return;
+        }
+      }
+  }
+};
+
+//----------------------------------------------------------------------------
+// Lexicographic order of the masks, lower cost first
+struct MaskLess
+{
+  const vtkTypeUInt64* Masks;
+  const double* Costs;
+  int NumberOfWords;
+  bool operator()(vtkIdType a, vtkIdType b) const
+  {
+    const vtkTypeUInt64* maskA = this->Masks + a * this->NumberOfWords;
+    const vtkTypeUInt64* maskB = this->Masks + b * this->NumberOfWords;
+    for (int w = 0; w < this->NumberOfWords; w++)
+      {
+      if (maskA[w] != maskB[w])
+        {
+        return maskA[w] < maskB[w];
+        }
+      }
+    return this->Costs[a] != this->Costs[b] ? this->Costs[a] < this->Costs[b] : a < b;
+  }
+};
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerPathPlannerSharedEntryPlanner);
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerSharedEntryPlanner::vtkSlicerPathPlannerSharedEntryPlanner()
+{
+  this->Targets = NULL;
+  this->Entries = NULL;
+  this->EntryNormals = NULL;
+  this->Obstacles = NULL;
+  this->ReferenceDirection[0] = 0.0;
+  this->ReferenceDirection[1] = 0.0;
+  this->ReferenceDirection[2] = 1.0;
+  this->MaximumAngle = 30.0;
+  this->MaximumDepth = 150.0;
+  this->DirectionResolution = 2.0;
+  this->MaximumNumberOfSearchNodes = 200000;
+  this->Optimal = 0;
+  this->NumberOfUnreachableTargets = 0;
+  this->NumberOfWords = 0;
+  this->NumberOfPolarBins = 0;
+  this->NumberOfAzimuthBins = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerSharedEntryPlanner::~vtkSlicerPathPlannerSharedEntryPlanner()
+{
+  this->SetTargets(NULL);
+  this->SetEntries(NULL);
+  this->SetEntryNormals(NULL);
+  this->SetObstacles(NULL);
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerSharedEntryPlanner::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Targets: " << this->Targets << "\n";
+  os << indent << "Entries: " << this->Entries << "\n";
+  os << indent << "EntryNormals: " << this->EntryNormals << "\n";
+  os << indent << "Obstacles: " << this->Obstacles << "\n";
+  os << indent << "ReferenceDirection: " << this->ReferenceDirection[0] << " "
+     << this->ReferenceDirection[1] << " " << this->ReferenceDirection[2] << "\n";
+  os << indent << "MaximumAngle: " << this->MaximumAngle << "\n";
+  os << indent << "MaximumDepth: " << this->MaximumDepth << "\n";
+  os << indent << "DirectionResolution: " << this->DirectionResolution << "\n";
+  os << indent << "MaximumNumberOfSearchNodes: " << this->MaximumNumberOfSearchNodes << "\n";
+  os << indent << "Optimal: " << this->Optimal << "\n";
+  os << indent << "NumberOfUnreachableTargets: " << this->NumberOfUnreachableTargets << "\n";
+}
+
+//----------------------------------------------------------------------------
+vtkCxxSetObjectMacro(vtkSlicerPathPlannerSharedEntryPlanner, Targets, vtkPoints);
+vtkCxxSetObjectMacro(vtkSlicerPathPlannerSharedEntryPlanner, Entries, vtkPoints);
+vtkCxxSetObjectMacro(vtkSlicerPathPlannerSharedEntryPlanner, EntryNormals, vtkDoubleArray);
+vtkCxxSetObjectMacro(vtkSlicerPathPlannerSharedEntryPlanner, Obstacles,
+                     vtkSlicerPathPlannerVolumeSampler);
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerSharedEntryPlanner::ComputeDirectionMaps()
+{
+  vtkIdType numberOfTargets = this->Targets->GetNumberOfPoints();
+  this->NumberOfPolarBins = static_cast<int>(std::ceil(180.0 / this->DirectionResolution));
+  this->NumberOfAzimuthBins = static_cast<int>(std::ceil(360.0 / this->DirectionResolution));
+
+  std::vector<double> targets(3 * numberOfTargets);
+  for (vtkIdType t = 0; t < numberOfTargets; t++)
+    {
+    this->Targets->GetPoint(t, &targets[3 * t]);
+    }
+
+  double coneAxis[3] = { this->ReferenceDirection[0], this->ReferenceDirection[1],
+                         this->ReferenceDirection[2] };
+  DirectionMapFunctor functor;
+  functor.Targets = &targets[0];
+  functor.Obstacles = this->Obstacles && this->Obstacles->IsValid() ? this->Obstacles : NULL;
+  functor.NumberOfPolarBins = this->NumberOfPolarBins;
+  functor.NumberOfAzimuthBins = this->NumberOfAzimuthBins;
+  functor.Resolution[0] = vtkMath::Pi() / this->NumberOfPolarBins;
+  functor.Resolution[1] = 2.0 * vtkMath::Pi() / this->NumberOfAzimuthBins;
+  functor.MaximumDepth = this->MaximumDepth;
+  functor.Step = functor.Obstacles ? functor.Obstacles->GetMinimumSpacing() : 1.0;
+  // Without entry normals only the directions near the reference matter.
+  // The cone is widened by a bin so that no looked up bin is skipped.
+  functor.ConeAxis = (!this->EntryNormals && vtkMath::Normalize(coneAxis) > 0.0) ? coneAxis : NULL;
+  functor.ConeCosine = std::cos(std::min(vtkMath::Pi(), vtkMath::RadiansFromDegrees(
+    this->MaximumAngle + 2.0 * this->DirectionResolution)));
+  this->DirectionMaps.assign(static_cast<size_t>(numberOfTargets) * this->NumberOfPolarBins *
+                             this->NumberOfAzimuthBins, 0.0f);
+  functor.Maps = &this->DirectionMaps[0];
+  vtkSlicerPathPlannerParallelFor(0, numberOfTargets * this->NumberOfPolarBins, 1, functor);
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerSharedEntryPlanner::ComputeReachability()
+{
+  vtkIdType numberOfTargets = this->Targets->GetNumberOfPoints();
+  vtkIdType numberOfEntries = this->Entries->GetNumberOfPoints();
+  std::vector<double> targets(3 * numberOfTargets);
+  std::vector<double> entries(3 * numberOfEntries);
+  for (vtkIdType t = 0; t < numberOfTargets; t++)
+    {
+    this->Targets->GetPoint(t, &targets[3 * t]);
+    }
+  for (vtkIdType e = 0; e < numberOfEntries; e++)
+    {
+    this->Entries->GetPoint(e, &entries[3 * e]);
+    }
+
+  ReachabilityFunctor functor;
+  functor.Entries = &entries[0];
+  functor.Normals = this->EntryNormals ? this->EntryNormals->GetPointer(0) : NULL;
+  functor.Targets = &targets[0];
+  functor.NumberOfTargets = numberOfTargets;
+  for (int i = 0; i < 3; i++)
+    {
+    functor.ReferenceDirection[i] = this->ReferenceDirection[i];
+    }
+  vtkMath::Normalize(functor.ReferenceDirection);
+  functor.MinimumCosine = std::cos(vtkMath::RadiansFromDegrees(this->MaximumAngle));
+  functor.MaximumDepth = this->MaximumDepth;
+  functor.NumberOfPolarBins = this->NumberOfPolarBins;
+  functor.NumberOfAzimuthBins = this->NumberOfAzimuthBins;
+  functor.Resolution[0] = vtkMath::Pi() / this->NumberOfPolarBins;
+  functor.Resolution[1] = 2.0 * vtkMath::Pi() / this->NumberOfAzimuthBins;
+  functor.Maps = &this->DirectionMaps[0];
+  functor.NumberOfWords = this->NumberOfWords;
+  this->Reachable.assign(static_cast<size_t>(numberOfEntries) * this->NumberOfWords, 0);
+  functor.Reachable = &this->Reachable[0];
+  vtkSlicerPathPlannerParallelFor(0, numberOfEntries, 256, functor);
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerSharedEntryPlanner::SolveCover()
+{
+  const int numberOfWords = this->NumberOfWords;
+  const int numberOfTargets = static_cast<int>(this->Targets->GetNumberOfPoints());
+  vtkIdType numberOfEntries = this->Entries->GetNumberOfPoints();
+  const vtkTypeUInt64* reachable = &this->Reachable[0];
+
+  // Cost of an entry: total depth to its targets
+  std::vector<double> costs(numberOfEntries, 0.0);
+  std::vector<vtkIdType> order;
+  for (vtkIdType e = 0; e < numberOfEntries; e++)
+    {
+    double entry[3];
+    this->Entries->GetPoint(e, entry);
+    bool empty = true;
+    for (int t = 0; t < numberOfTargets; t++)
+      {
+      if ((reachable[e * numberOfWords + (t >> 6)] >> (t & 63)) & 1)
+        {
+        double target[3];
+        this->Targets->GetPoint(t, target);
+        costs[e] += std::sqrt(vtkMath::Distance2BetweenPoints(entry, target));
+        empty = false;
+        }
+      }
+    if (!empty)
+      {
+      order.push_back(e);
+      }
+    }
+
+  // One representative, the cheapest, per distinct mask
+  MaskLess less;
+  less.Masks = reachable;
+  less.Costs = &costs[0];
+  less.NumberOfWords = numberOfWords;
+  std::sort(order.begin(), order.end(), less);
+  std::vector<vtkIdType> representatives;
+  for (size_t i = 0; i < order.size(); i++)
+    {
+    if (representatives.empty() ||
+        !std::equal(reachable + order[i] * numberOfWords,
+                    reachable + (order[i] + 1) * numberOfWords,
+                    reachable + representatives.back() * numberOfWords))
+      {
+      representatives.push_back(order[i]);
+      }
+    }
+
+  // Drop the masks included in another one
+  std::vector<vtkIdType> sets;
+  for (size_t i = 0; i < representatives.size(); i++)
+    {
+    const vtkTypeUInt64* mask = reachable + representatives[i] * numberOfWords;
+    bool dominated = false;
+    for (size_t j = 0; j < representatives.size() && !dominated; j++)
+      {
+      if (i == j)
+        {
+        continue;
+        }
+      const vtkTypeUInt64* other = reachable + representatives[j] * numberOfWords;
+      bool subset = true;
+      for (int w = 0; w < numberOfWords && subset; w++)
+        {
+        subset = (mask[w] & ~other[w]) == 0;
+        }
+      dominated = subset;
+      }
+    if (!dominated)
+      {
+      sets.push_back(representatives[i]);
+      }
+    }
+
+  std::vector<vtkTypeUInt64> masks(sets.size() * numberOfWords);
+  std::vector<vtkTypeUInt64> coverable(numberOfWords, 0);
+  for (size_t s = 0; s < sets.size(); s++)
+    {
+    for (int w = 0; w < numberOfWords; w++)
+      {
+      masks[s * numberOfWords + w] = reachable[sets[s] * numberOfWords + w];
+      coverable[w] |= masks[s * numberOfWords + w];
+      }
+    }
+  this->NumberOfUnreachableTargets = numberOfTargets;
+  for (int w = 0; w < numberOfWords; w++)
+    {
+    this->NumberOfUnreachableTargets -= CountBits(coverable[w]);
+    }
+
+  CoverSearch search;
+  search.Masks = &masks;
+  search.NumberOfWords = numberOfWords;
+  search.NumberOfTargets = numberOfTargets;
+  search.NodeBudget = this->MaximumNumberOfSearchNodes;
+  search.Nodes = 0;
+
+  // Greedy upper bound
+  std::vector<vtkTypeUInt64> uncovered = coverable;
+  int remaining = numberOfTargets - this->NumberOfUnreachableTargets;
+  while (remaining > 0)
+    {
+    int best = -1;
+    int bestCount = 0;
+    for (int s = 0; s < static_cast<int>(sets.size()); s++)
+      {
+      int count = search.CountNew(s, uncovered);
+      if (count > bestCount)
+        {
+        best = s;
+        bestCount = count;
+        }
+      }
+    search.Best.push_back(best);
+    remaining -= bestCount;
+    for (int w = 0; w < numberOfWords; w++)
+      {
+      uncovered[w] &= ~masks[best * numberOfWords + w];
+      }
+    }
+
+  search.Search(coverable);
+  this->Optimal = search.Nodes <= search.NodeBudget;
+
+  this->Selected.clear();
+  for (size_t i = 0; i < search.Best.size(); i++)
+    {
+    this->Selected.push_back(sets[search.Best[i]]);
+    }
+  std::sort(this->Selected.begin(), this->Selected.end());
+
+  // Closest selected entry of every target
+  this->TargetEntries.assign(numberOfTargets, -1);
+  std::vector<double> depths(numberOfTargets, VTK_DOUBLE_MAX);
+  for (size_t i = 0; i < this->Selected.size(); i++)
+    {
+    vtkIdType e = this->Selected[i];
+    double entry[3];
+    this->Entries->GetPoint(e, entry);
+    for (int t = 0; t < numberOfTargets; t++)
+      {
+      if (!((reachable[e * numberOfWords + (t >> 6)] >> (t & 63)) & 1))
+        {
+        continue;
+        }
+      double target[3];
+      this->Targets->GetPoint(t, target);
+      double depth = vtkMath::Distance2BetweenPoints(entry, target);
+      if (depth < depths[t])
+        {
+        depths[t] = depth;
+        this->TargetEntries[t] = e;
+        }
+      }
+    }
+  return static_cast<int>(this->Selected.size());
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerSharedEntryPlanner::Plan()
+{
+  this->Selected.clear();
+  this->TargetEntries.clear();
+  this->Optimal = 0;
+  this->NumberOfUnreachableTargets = 0;
+  if (!this->Targets || !this->Entries)
+    {
+    vtkErrorMacro(<< "Plan: targets and entries are required");
+    return -1;
+    }
+  if (this->EntryNormals &&
+      (this->EntryNormals->GetNumberOfComponents() != 3 ||
+       this->EntryNormals->GetNumberOfTuples() != this->Entries->GetNumberOfPoints()))
+    {
+    vtkErrorMacro(<< "Plan: EntryNormals does not match the entries");
+    return -1;
+    }
+  if (!this->EntryNormals && vtkMath::Norm(this->ReferenceDirection) == 0.0)
+    {
+    vtkErrorMacro(<< "Plan: ReferenceDirection is null");
+    return -1;
+    }
+
+  vtkIdType numberOfTargets = this->Targets->GetNumberOfPoints();
+  this->NumberOfUnreachableTargets = static_cast<int>(numberOfTargets);
+  if (numberOfTargets == 0 || this->Entries->GetNumberOfPoints() == 0)
+    {
+    this->TargetEntries.assign(numberOfTargets, -1);
+    return 0;
+    }
+  this->NumberOfWords = static_cast<int>((numberOfTargets + 63) / 64);
+
+  this->ComputeDirectionMaps();
+  this->ComputeReachability();
+
+  // Direction bins are approximate: check the selected paths exactly and
+  // solve again without the pairs that fail. Every failed pass removes at
+  // least one pair, so this ends with paths that are all free.
+  vtkSlicerPathPlannerVolumeSampler* obstacles =
+    this->Obstacles && this->Obstacles->IsValid() ? this->Obstacles : NULL;
+  int numberOfEntries = 0;
+  for (;;)
+    {
+    numberOfEntries = this->SolveCover();
+    if (!obstacles)
+      {
+      break;
+      }
+    bool valid = true;
+    for (vtkIdType t = 0; t < numberOfTargets; t++)
+      {
+      vtkIdType e = this->TargetEntries[t];
+      if (e < 0)
+        {
+        continue;
+        }
+      double entry[3];
+      double target[3];
+      this->Entries->GetPoint(e, entry);
+      this->Targets->GetPoint(t, target);
+      if (obstacles->SegmentIntersectsNonZero(entry, target))
+        {
+        this->Reachable[e * this->NumberOfWords + (t >> 6)] &=
+          ~(static_cast<vtkTypeUInt64>(1) << (t & 63));
+        valid = false;
+        }
+      }
+    if (valid)
+      {
+      break;
+      }
+    }
+  return numberOfEntries;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerSharedEntryPlanner::GetSelectedEntries(vtkIdList* entries)
+{
+  if (!entries)
+    {
+    return;
+    }
+  entries->SetNumberOfIds(static_cast<vtkIdType>(this->Selected.size()));
+  for (size_t i = 0; i < this->Selected.size(); i++)
+    {
+    entries->SetId(static_cast<vtkIdType>(i), this->Selected[i]);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerSharedEntryPlanner::GetTargetEntries(vtkIdList* entries)
+{
+  if (!entries)
+    {
+    return;
+    }
+  entries->SetNumberOfIds(static_cast<vtkIdType>(this->TargetEntries.size()));
+  for (size_t i = 0; i < this->TargetEntries.size(); i++)
+    {
+    entries->SetId(static_cast<vtkIdType>(i), this->TargetEntries[i]);
+    }
+}
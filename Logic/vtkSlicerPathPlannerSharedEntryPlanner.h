@@ -0,0 +1,154 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// .NAME vtkSlicerPathPlannerSharedEntryPlanner - fewest skin entries for several targets
+// .SECTION Description
+// Chooses the smallest set of entry points, among many candidates, from
+// which every target can be reached. An entry reaches a target when the
+// distance is at most MaximumDepth, the needle makes at most MaximumAngle
+// with the reference direction (the entry normal when EntryNormals is set,
+// ReferenceDirection otherwise) and the path is free of obstacles.
+//
+// Obstacles are looked up in a per-target direction map: the free length
+// of rays cast from the target every DirectionResolution degrees, computed
+// once per target in parallel. The entry x target feasibility bitmaps are
+// then filled in parallel with lookups only. The cover is solved by first
+// merging identical and dominated entries, then taking the greedy solution
+// as an upper bound for an exact branch and bound search limited to
+// MaximumNumberOfSearchNodes. The selected paths are finally checked
+// exactly against the obstacles and the problem is solved again without
+// the pairs that fail.
+
+#ifndef __vtkSlicerPathPlannerSharedEntryPlanner_h
+#define __vtkSlicerPathPlannerSharedEntryPlanner_h
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerPathPlannerModuleLogicExport.h"
+
+class vtkDoubleArray;
+class vtkIdList;
+class vtkPoints;
+class vtkSlicerPathPlannerVolumeSampler;
+
+/// \ingroup Slicer_QtModules_PathPlanner
+class VTK_SLICER_PATHPLANNER_MODULE_LOGIC_EXPORT vtkSlicerPathPlannerSharedEntryPlanner :
+  public vtkObject
+{
+public:
+  static vtkSlicerPathPlannerSharedEntryPlanner *New();
+  vtkTypeMacro(vtkSlicerPathPlannerSharedEntryPlanner, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Targets and candidate entry points (RAS).
+  void SetTargets(vtkPoints* targets);
+  vtkGetObjectMacro(Targets, vtkPoints);
+  void SetEntries(vtkPoints* entries);
+  vtkGetObjectMacro(Entries, vtkPoints);
+
+  /// Optional outward skin normal of every entry (3 components).
+  void SetEntryNormals(vtkDoubleArray* normals);
+  vtkGetObjectMacro(EntryNormals, vtkDoubleArray);
+
+  /// Non zero voxels may not be crossed. May be NULL.
+  void SetObstacles(vtkSlicerPathPlannerVolumeSampler* obstacles);
+  vtkGetObjectMacro(Obstacles, vtkSlicerPathPlannerVolumeSampler);
+
+  /// Direction from the target to the entry used when there are no entry
+  /// normals, must not be null. Default is (0, 0, 1), superior.
+  vtkSetVector3Macro(ReferenceDirection, double);
+  vtkGetVector3Macro(ReferenceDirection, double);
+
+  /// Angulation limit (degrees). Default is 30.
+  vtkSetClampMacro(MaximumAngle, double, 0.0, 180.0);
+  vtkGetMacro(MaximumAngle, double);
+
+  /// Needle length (mm). Default is 150.
+  vtkSetClampMacro(MaximumDepth, double, 0.0, VTK_DOUBLE_MAX);
+  vtkGetMacro(MaximumDepth, double);
+
+  /// Angular step of the direction maps (degrees). Default is 2.
+  vtkSetClampMacro(DirectionResolution, double, 0.25, 30.0);
+  vtkGetMacro(DirectionResolution, double);
+
+  /// Node budget of the exact search. Default is 200000.
+  vtkSetClampMacro(MaximumNumberOfSearchNodes, int, 0, VTK_INT_MAX);
+  vtkGetMacro(MaximumNumberOfSearchNodes, int);
+
+  /// Solve. The selected paths are checked exactly against Obstacles.
+  /// Return the number of selected entries, -1 on error.
+  int Plan();
+
+  /// Selected entries (indices in Entries).
+  void GetSelectedEntries(vtkIdList* entries);
+
+  /// Entry (index in Entries) assigned to every target, -1 when the
+  /// target cannot be reached.
+  void GetTargetEntries(vtkIdList* entries);
+
+  /// 1 if the last Plan proved the number of entries minimal.
+  vtkGetMacro(Optimal, int);
+  vtkGetMacro(NumberOfUnreachableTargets, int);
+
+protected:
+  vtkSlicerPathPlannerSharedEntryPlanner();
+  virtual ~vtkSlicerPathPlannerSharedEntryPlanner();
+
+  void ComputeDirectionMaps();
+  void ComputeReachability();
+  int SolveCover();
+
+  vtkPoints* Targets;
+  vtkPoints* Entries;
+  vtkDoubleArray* EntryNormals;
+  vtkSlicerPathPlannerVolumeSampler* Obstacles;
+  double ReferenceDirection[3];
+  double MaximumAngle;
+  double MaximumDepth;
+  double DirectionResolution;
+  int MaximumNumberOfSearchNodes;
+  int Optimal;
+  int NumberOfUnreachableTargets;
+
+  //BTX
+  int NumberOfWords;
+  int NumberOfPolarBins;
+  int NumberOfAzimuthBins;
+  // Free length of every direction bin, per target
+  std::vector<float> DirectionMaps;
+  // Reachable targets of every entry
+  std::vector<vtkTypeUInt64> Reachable;
+  std::vector<vtkIdType> Selected;
+  std::vector<vtkIdType> TargetEntries;
+  //ETX
+
+private:
+  vtkSlicerPathPlannerSharedEntryPlanner(const vtkSlicerPathPlannerSharedEntryPlanner&); // Not implemented
+  void operator=(const vtkSlicerPathPlannerSharedEntryPlanner&);               // Not implemented
+};
+
+#endif
@@ -0,0 +1,656 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerParallel.h"
+#include "vtkSlicerPathPlannerRandom.h"
+#include "vtkSlicerPathPlannerSteerablePlanner.h"
+#include "vtkSlicerPathPlannerVolumeSampler.h"
+
+// VTK includes
+#include <vtkMath.h>
+#include <vtkObjectFactory.h>
+#include <vtkPoints.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+namespace
+{
+//----------------------------------------------------------------------------
+// Search tree, one entry per node. A null heading marks a root whose
+// direction is free.
+struct Tree
+{
+  std::vector<double> Position;
+  std::vector<double> Heading;
+  std::vector<double> Cost;
+  std::vector<double> GoalLength;
+  std::vector<int> Parent;
+  std::vector<std::vector<int> > Children;
+
+  int GetNumberOfNodes() const
+  {
+    return static_cast<int>(this->Cost.size());
+  }
+
+  int AddNode(const double position[3], const double heading[3], int parent, double cost)
+  {
+    this->Position.insert(this->Position.end(), position, position + 3);
+    this->Heading.insert(this->Heading.end(), heading, heading + 3);
+    this->Cost.push_back(cost);
+    this->GoalLength.push_back(-1.0);
+    this->Parent.push_back(parent);
+    this->Children.push_back(std::vector<int>());
+    int id = this->GetNumberOfNodes() - 1;
+    if (parent >= 0)
+      {
+      this->Children[parent].push_back(id);
+      }
+    return id;
+  }
+};
+
+//----------------------------------------------------------------------------
+// Uniform grid of node ids
+class NodeGrid
+{
+public:
+  void Initialize(const double bounds[6], double cellSize)
+  {
+    this->CellSize = cellSize;
+    for (;;)
+      {
+      vtkIdType numberOfCells = 1;
+      for (int i = 0; i < 3; i++)
+        {
+        this->Origin[i] = bounds[2 * i];
+        this->Dimensions[i] = static_cast<int>(
+          std::floor((bounds[2 * i + 1] - bounds[2 * i]) / this->CellSize)) + 1;
+        numberOfCells *= this->Dimensions[i];
+        }
+      if (numberOfCells <= (1 << 22))
+        {
+        this->Cells.assign(static_cast<size_t>(numberOfCells), std::vector<int>());
+        return;
+        }
+      this->CellSize *= 2.0;
+      }
+  }
+
+  void Insert(int id, const double position[3])
+  {
+    int cell[3];
+    this->Locate(position, cell);
+    this->Cells[this->GetCellId(cell)].push_back(id);
+  }
+
+  int FindNearest(const Tree& tree, const double position[3]) const
+  {
+    int cell[3];
+    this->Locate(position, cell);
+    int maximumRing = std::max(this->Dimensions[0],
+                               std::max(this->Dimensions[1], this->Dimensions[2]));
+    int nearest = -1;
+    double nearestDistance2 = VTK_DOUBLE_MAX;
+    for (int ring = 0; ring <= maximumRing; ring++)
+      {
+      int range[6];
+      for (int i = 0; i < 3; i++)
+        {
+        range[2 * i] = std::max(cell[i] - ring, 0);
+        range[2 * i + 1] = std::min(cell[i] + ring, this->Dimensions[i] - 1);
+        }
+      int ijk[3];
+      for (ijk[2] = range[4]; ijk[2] <= range[5]; ijk[2]++)
+        {
+        for (ijk[1] = range[2]; ijk[1] <= range[3]; ijk[1]++)
+          {
+          for (ijk[0] = range[0]; ijk[0] <= range[1]; ijk[0]++)
+            {
+            // Cells of the previous rings have been visited already
+            if (std::abs(ijk[0] - cell[0]) != ring && std::abs(ijk[1] - cell[1]) != ring &&
+                std::abs(ijk[2] - cell[2]) != ring)
+              {
+              continue;
+              }
+            const std::vector<int>& ids = this->Cells[this->GetCellId(ijk)];
+            for (size_t n = 0; n < ids.size(); n++)
+              {
+              double distance2 = vtkMath::Distance2BetweenPoints(
+                position, &tree.Position[3 * ids[n]]);
+              if (distance2 < nearestDistance2)
+                {
+                nearestDistance2 = distance2;
+                nearest = ids[n];
+                }
+              }
+            }
+          }
+        }
+      // Nodes of the next rings are at least ring * CellSize away
+      if (nearest >= 0 && nearestDistance2 <= (ring * this->CellSize) * (ring * this->CellSize))
+        {
+        break;
+        }
+      }
+    return nearest;
+  }
+
+  void FindWithinRadius(const Tree& tree, const double position[3], double radius,
+                        std::vector<int>& neighbors) const
+  {
+    neighbors.clear();
+    double lower[3] = { position[0] - radius, position[1] - radius, position[2] - radius };
+    double upper[3] = { position[0] + radius, position[1] + radius, position[2] + radius };
+    int lowerCell[3];
+    int upperCell[3];
+    this->Locate(lower, lowerCell);
+    this->Locate(upper, upperCell);
+    double radius2 = radius * radius;
+    int ijk[3];
+    for (ijk[2] = lowerCell[2]; ijk[2] <= upperCell[2]; ijk[2]++)
+      {
+      for (ijk[1] = lowerCell[1]; ijk[1] <= upperCell[1]; ijk[1]++)
+        {
+        for (ijk[0] = lowerCell[0]; ijk[0] <= upperCell[0]; ijk[0]++)
+          {
+          const std::vector<int>& ids = this->Cells[this->GetCellId(ijk)];
+          for (size_t n = 0; n < ids.size(); n++)
+            {
+            if (vtkMath::Distance2BetweenPoints(position, &tree.Position[3 * ids[n]]) <= radius2)
+              {
+              neighbors.push_back(ids[n]);
+              }
+            }
+          }
+        }
+      }
+  }
+
+private:
+  void Locate(const double position[3], int cell[3]) const
+  {
+    for (int i = 0; i < 3; i++)
+      {
+      int index = static_cast<int>(std::floor((position[i] - this->Origin[i]) / this->CellSize));
+      cell[i] = std::min(std::max(index, 0), this->Dimensions[i] - 1);
+      }
+  }
+
+  size_t GetCellId(const int cell[3]) const
+  {
+    return static_cast<size_t>(cell[0]) + static_cast<size_t>(this->Dimensions[0]) *
+      (static_cast<size_t>(cell[1]) + static_cast<size_t>(this->Dimensions[1]) * cell[2]);
+  }
+
+  double Origin[3];
+  double CellSize;
+  int Dimensions[3];
+  std::vector<std::vector<int> > Cells;
+};
+
+//----------------------------------------------------------------------------
+// Arc leaving "start" along "heading" (free if null) and reaching "end".
+// Return 0 if its curvature exceeds maximumCurvature or if it turns back,
+// else the direction at "end" and the arc length.
+int ConnectArc(const double start[3], const double heading[3], const double end[3],
+               double maximumCurvature, double endHeading[3], double& length)
+{
+  double chord[3] = { end[0] - start[0], end[1] - start[1], end[2] - start[2] };
+  double chordLength = vtkMath::Normalize(chord);
+  if (chordLength <= 1e-9)
+    {
+    return 0;
+    }
+  if (heading[0] == 0.0 && heading[1] == 0.0 && heading[2] == 0.0)
+    {
+    endHeading[0] = chord[0];
+    endHeading[1] = chord[1];
+    endHeading[2] = chord[2];
+    length = chordLength;
+    return 1;
+    }
+
+  double cosine = vtkMath::Dot(heading, chord);
+  if (cosine <= 0.0)
+    {
+    return 0;
+    }
+  double sine = std::sqrt(std::max(0.0, 1.0 - cosine * cosine));
+  if (2.0 * sine > maximumCurvature * chordLength * (1.0 + 1e-9))
+    {
+    return 0;
+    }
+
+  // The arc is symmetric about its chord
+  for (int i = 0; i < 3; i++)
+    {
+    endHeading[i] = 2.0 * cosine * chord[i] - heading[i];
+    }
+  vtkMath::Normalize(endHeading);
+  length = sine > 1e-12 ? chordLength * std::asin(sine) / sine : chordLength;
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+// End point of an edge of at most stepLength from "start" toward "sample",
+// turning no more than allowed by maximumCurvature.
+int Steer(const double start[3], const double heading[3], const double sample[3],
+          double stepLength, double maximumCurvature, double end[3])
+{
+  double direction[3] = { sample[0] - start[0], sample[1] - start[1], sample[2] - start[2] };
+  double distance = vtkMath::Normalize(direction);
+  if (distance <= 1e-9)
+    {
+    return 0;
+    }
+  double length = std::min(stepLength, distance);
+
+  double chord[3] = { direction[0], direction[1], direction[2] };
+  if (heading[0] != 0.0 || heading[1] != 0.0 || heading[2] != 0.0)
+    {
+    double maximumAngle = std::asin(std::min(1.0, 0.5 * maximumCurvature * length));
+    double cosine = std::max(-1.0, std::min(1.0, vtkMath::Dot(heading, direction)));
+    if (std::acos(cosine) > maximumAngle)
+      {
+      // Turn as much as possible toward the sample
+      double perpendicular[3];
+      for (int i = 0; i < 3; i++)
+        {
+        perpendicular[i] = direction[i] - cosine * heading[i];
+        }
+      if (vtkMath::Normalize(perpendicular) <= 1e-9)
+        {
+        double other[3];
+        vtkMath::Perpendiculars(heading, perpendicular, other, 0.0);
+        }
+      for (int i = 0; i < 3; i++)
+        {
+        chord[i] = std::cos(maximumAngle) * heading[i] +
+          std::sin(maximumAngle) * perpendicular[i];
+        }
+      }
+    }
+
+  for (int i = 0; i < 3; i++)
+    {
+    end[i] = start[i] + length * chord[i];
+    }
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+struct Rewire
+{
+  int Node;
+  double Heading[3];
+  double Length;
+};
+
+//----------------------------------------------------------------------------
+struct Candidate
+{
+  int Valid;
+  double Position[3];
+  double Heading[3];
+  int Parent;
+  double EdgeLength;
+  double GoalLength;
+  std::vector<Rewire> Rewires;
+};
+
+//----------------------------------------------------------------------------
+// Extension of the tree toward each sample of a batch. The tree is only
+// read, so samples are processed concurrently.
+struct ExtendFunctor
+{
+  const Tree* SearchTree;
+  const NodeGrid* Grid;
+  const vtkSlicerPathPlannerVolumeSampler* Obstacles;
+  const double* Samples;
+  const double* Target;
+  double MaximumCurvature;
+  double StepLength;
+  double RewireRadius;
+  double CosineTolerance;
+  std::vector<Candidate>* Candidates;
+
+  int IsFree(const double p0[3], const double p1[3]) const
+  {
+    return !this->Obstacles || !this->Obstacles->SegmentIntersectsNonZero(p0, p1);
+  }
+
+  void operator()(vtkIdType begin, vtkIdType end, int vtkNotUsed(threadId))
+  {
+    const Tree& tree = *this->SearchTree;
+    std::vector<int> neighbors;
+    std::vector<std::pair<double, int> > parents;
+    for (vtkIdType k = begin; k < end; k++)
+      {
+      Candidate& candidate = (*this->Candidates)[k];
+      candidate.Valid = 0;
+      candidate.GoalLength = -1.0;
+      candidate.Rewires.clear();
+
+      const double* sample = this->Samples + 3 * k;
+      int nearest = this->Grid->FindNearest(tree, sample);
+      if (nearest < 0 ||
+          !Steer(&tree.Position[3 * nearest], &tree.Heading[3 * nearest], sample,
+                 this->StepLength, this->MaximumCurvature, candidate.Position))
+        {
+        continue;
+        }
+
+      // Cheapest feasible parent, collision checks in order of cost
+      this->Grid->FindWithinRadius(tree, candidate.Position, this->RewireRadius, neighbors);
+      if (std::find(neighbors.begin(), neighbors.end(), nearest) == neighbors.end())
+        {
+        neighbors.push_back(nearest);
+        }
+      parents.clear();
+      for (size_t n = 0; n < neighbors.size(); n++)
+        {
+        double heading[3];
+        double length;
+        if (ConnectArc(&tree.Position[3 * neighbors[n]], &tree.Heading[3 * neighbors[n]],
+                       candidate.Position, this->MaximumCurvature, heading, length))
+          {
+          parents.push_back(std::make_pair(tree.Cost[neighbors[n]] + length, neighbors[n]));
+          }
+        }
+      std::sort(parents.begin(), parents.end());
+      for (size_t n = 0; n < parents.size() && !candidate.Valid; n++)
+        {
+        int parent = parents[n].second;
+        if (this->IsFree(&tree.Position[3 * parent], candidate.Position))
+          {
+          ConnectArc(&tree.Position[3 * parent], &tree.Heading[3 * parent],
+                     candidate.Position, this->MaximumCurvature,
+                     candidate.Heading, candidate.EdgeLength);
+          candidate.Parent = parent;
+          candidate.Valid = 1;
+          }
+        }
+      if (!candidate.Valid)
+        {
+        continue;
+        }
+      double cost = tree.Cost[candidate.Parent] + candidate.EdgeLength;
+
+      // Connection to the target
+      double targetDistance2 = vtkMath::Distance2BetweenPoints(candidate.Position, this->Target);
+      if (targetDistance2 <= 1e-12)
+        {
+        candidate.GoalLength = 0.0;
+        }
+      else if (targetDistance2 <= this->RewireRadius * this->RewireRadius)
+        {
+        double heading[3];
+        double length;
+        if (ConnectArc(candidate.Position, candidate.Heading, this->Target,
+                       this->MaximumCurvature, heading, length) &&
+            this->IsFree(candidate.Position, this->Target))
+          {
+          candidate.GoalLength = length;
+          }
+        }
+
+      // Neighbors reached at a lower cost through the new node
+      for (size_t n = 0; n < neighbors.size(); n++)
+        {
+        int node = neighbors[n];
+        Rewire rewire;
+        if (node == candidate.Parent || tree.Parent[node] < 0 ||
+            !ConnectArc(candidate.Position, candidate.Heading, &tree.Position[3 * node],
+                        this->MaximumCurvature, rewire.Heading, rewire.Length) ||
+            cost + rewire.Length >= tree.Cost[node])
+          {
+          continue;
+          }
+        if ((!tree.Children[node].empty() || tree.GoalLength[node] >= 0.0) &&
+            vtkMath::Dot(rewire.Heading, &tree.Heading[3 * node]) < this->CosineTolerance)
+          {
+          continue;
+          }
+        if (this->IsFree(candidate.Position, &tree.Position[3 * node]))
+          {
+          rewire.Node = node;
+          candidate.Rewires.push_back(rewire);
+          }
+        }
+      }
+  }
+};
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerPathPlannerSteerablePlanner);
+
+//----------------------------------------------------------------------------
+vtkCxxSetObjectMacro(vtkSlicerPathPlannerSteerablePlanner, Obstacles,
+                     vtkSlicerPathPlannerVolumeSampler);
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerSteerablePlanner::vtkSlicerPathPlannerSteerablePlanner()
+{
+  this->MaximumCurvature = 0.01;
+  this->StepLength = 2.0;
+  this->RewireRadius = 6.0;
+  this->HeadingTolerance = 5.0;
+  this->NumberOfIterations = 20000;
+  this->BatchSize = 256;
+  this->GoalBias = 0.05;
+  this->SearchMargin = 30.0;
+  this->Seed = 0;
+  this->Obstacles = NULL;
+  this->NumberOfNodes = 0;
+  this->PathLength = 0.0;
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerSteerablePlanner::~vtkSlicerPathPlannerSteerablePlanner()
+{
+  this->SetObstacles(NULL);
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerSteerablePlanner::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "MaximumCurvature: " << this->MaximumCurvature << "\n";
+  os << indent << "StepLength: " << this->StepLength << "\n";
+  os << indent << "RewireRadius: " << this->RewireRadius << "\n";
+  os << indent << "HeadingTolerance: " << this->HeadingTolerance << "\n";
+  os << indent << "NumberOfIterations: " << this->NumberOfIterations << "\n";
+  os << indent << "BatchSize: " << this->BatchSize << "\n";
+  os << indent << "GoalBias: " << this->GoalBias << "\n";
+  os << indent << "SearchMargin: " << this->SearchMargin << "\n";
+  os << indent << "Seed: " << this->Seed << "\n";
+  os << indent << "Obstacles: " << this->Obstacles << "\n";
+  os << indent << "NumberOfNodes: " << this->NumberOfNodes << "\n";
+  os << indent << "PathLength: " << this->PathLength << "\n";
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerSteerablePlanner::Plan(const double entry[3],
+                                               const double entryDirection[3],
+                                               const double target[3],
+                                               vtkPoints* path)
+{
+  this->NumberOfNodes = 0;
+  this->PathLength = 0.0;
+  if (!path)
+    {
+    return 0;
+    }
+  path->Reset();
+  if (this->StepLength <= 0.0 || this->RewireRadius <= 0.0 || this->MaximumCurvature <= 0.0)
+    {
+    vtkErrorMacro(<< "Plan: StepLength, RewireRadius and MaximumCurvature must be positive");
+    return 0;
+    }
+
+  double bounds[6];
+  for (int i = 0; i < 3; i++)
+    {
+    bounds[2 * i] = std::min(entry[i], target[i]) - this->SearchMargin;
+    bounds[2 * i + 1] = std::max(entry[i], target[i]) + this->SearchMargin;
+    }
+
+  Tree tree;
+  NodeGrid grid;
+  grid.Initialize(bounds, this->RewireRadius);
+
+  double rootHeading[3] = { 0.0, 0.0, 0.0 };
+  if (entryDirection)
+    {
+    rootHeading[0] = entryDirection[0];
+    rootHeading[1] = entryDirection[1];
+    rootHeading[2] = entryDirection[2];
+    vtkMath::Normalize(rootHeading);
+    }
+  tree.AddNode(entry, rootHeading, -1, 0.0);
+  grid.Insert(0, entry);
+
+  std::vector<double> samples(3 * this->BatchSize);
+  std::vector<Candidate> candidates(this->BatchSize);
+  std::vector<int> stack;
+
+  ExtendFunctor functor;
+  functor.SearchTree = &tree;
+  functor.Grid = &grid;
+  functor.Obstacles = (this->Obstacles && this->Obstacles->IsValid()) ? this->Obstacles : NULL;
+  functor.Samples = &samples[0];
+  functor.Target = target;
+  functor.MaximumCurvature = this->MaximumCurvature;
+  functor.StepLength = this->StepLength;
+  functor.RewireRadius = this->RewireRadius;
+  functor.CosineTolerance = std::cos(vtkMath::RadiansFromDegrees(this->HeadingTolerance));
+  functor.Candidates = &candidates;
+
+  int numberOfBatches = (this->NumberOfIterations + this->BatchSize - 1) / this->BatchSize;
+  for (int batch = 0; batch < numberOfBatches; batch++)
+    {
+    int batchSize = std::min(this->BatchSize, this->NumberOfIterations - batch * this->BatchSize);
+    vtkSlicerPathPlannerRandom random(this->Seed, static_cast<vtkTypeUInt64>(batch));
+    for (int k = 0; k < batchSize; k++)
+      {
+      double* sample = &samples[3 * k];
+      if (random.NextUniform() < this->GoalBias)
+        {
+        sample[0] = target[0];
+        sample[1] = target[1];
+        sample[2] = target[2];
+        continue;
+        }
+      for (int i = 0; i < 3; i++)
+        {
+        sample[i] = random.NextUniform(bounds[2 * i], bounds[2 * i + 1]);
+        }
+      }
+
+    vtkSlicerPathPlannerParallelFor(0, batchSize, 8, functor);
+
+    // Insert and rewire in sample order, against the up to date costs
+    for (int k = 0; k < batchSize; k++)
+      {
+      const Candidate& candidate = candidates[k];
+      if (!candidate.Valid)
+        {
+        continue;
+        }
+      double cost = tree.Cost[candidate.Parent] + candidate.EdgeLength;
+      int id = tree.AddNode(candidate.Position, candidate.Heading, candidate.Parent, cost);
+      tree.GoalLength[id] = candidate.GoalLength;
+      grid.Insert(id, candidate.Position);
+
+      for (size_t r = 0; r < candidate.Rewires.size(); r++)
+        {
+        const Rewire& rewire = candidate.Rewires[r];
+        int node = rewire.Node;
+        double newCost = cost + rewire.Length;
+        // Costs grow along the tree, so an ancestor of the new node is
+        // never rewired and no cycle can be created.
+        if (newCost >= tree.Cost[node] - 1e-9 ||
+            ((!tree.Children[node].empty() || tree.GoalLength[node] >= 0.0) &&
+             vtkMath::Dot(rewire.Heading, &tree.Heading[3 * node]) < functor.CosineTolerance))
+          {
+          continue;
+          }
+        std::vector<int>& siblings = tree.Children[tree.Parent[node]];
+        siblings.erase(std::find(siblings.begin(), siblings.end(), node));
+        tree.Parent[node] = id;
+        tree.Children[id].push_back(node);
+        std::copy(rewire.Heading, rewire.Heading + 3, &tree.Heading[3 * node]);
+
+        double delta = newCost - tree.Cost[node];
+        stack.assign(1, node);
+        while (!stack.empty())
+          {
+          int current = stack.back();
+          stack.pop_back();
+          tree.Cost[current] += delta;
+          stack.insert(stack.end(), tree.Children[current].begin(), tree.Children[current].end());
+          }
+        }
+      }
+    }
+
+  this->NumberOfNodes = tree.GetNumberOfNodes();
+
+  // Cheapest node connected to the target
+  int goal = -1;
+  double goalCost = VTK_DOUBLE_MAX;
+  for (int n = 0; n < tree.GetNumberOfNodes(); n++)
+    {
+    if (tree.GoalLength[n] >= 0.0 && tree.Cost[n] + tree.GoalLength[n] < goalCost)
+      {
+      goal = n;
+      goalCost = tree.Cost[n] + tree.GoalLength[n];
+      }
+    }
+  if (goal < 0)
+    {
+    return 0;
+    }
+
+  std::vector<int> nodes;
+  for (int n = goal; n >= 0; n = tree.Parent[n])
+    {
+    nodes.push_back(n);
+    }
+  for (int n = static_cast<int>(nodes.size()) - 1; n >= 0; n--)
+    {
+    path->InsertNextPoint(&tree.Position[3 * nodes[n]]);
+    }
+  if (tree.GoalLength[goal] > 0.0)
+    {
+    path->InsertNextPoint(target);
+    }
+  this->PathLength = goalCost;
+  return 1;
+}
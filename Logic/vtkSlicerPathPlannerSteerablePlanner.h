@@ -0,0 +1,140 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// .NAME vtkSlicerPathPlannerSteerablePlanner - RRT* planner for steerable needles
+// .SECTION Description
+// Plans a curvature-constrained path from an entry point to a target
+// around the obstacles of a label map. The tree grows with RRT* (Karaman &
+// Frazzoli, IJRR 2011): each new node is attached to the neighbor giving
+// the shortest path and then used to shorten the paths of its neighbors.
+// Edges are circular arcs tangent to the needle direction at their start,
+// represented by their chord; an edge is feasible when the arc curvature
+// stays below MaximumCurvature. Rewiring a node that has children, or that
+// connects to the target, is only allowed if its direction changes by less
+// than HeadingTolerance, so that the following edges stay (approximately)
+// feasible.
+//
+// Samples are processed in batches of BatchSize: the nearest neighbor
+// search, the choice of parent and the collision checks of a batch run on
+// all the threads against the current tree, then the new nodes are
+// inserted and rewired in sample order. The result only depends on Seed.
+// Nodes are indexed by a uniform grid with RewireRadius cells.
+
+#ifndef __vtkSlicerPathPlannerSteerablePlanner_h
+#define __vtkSlicerPathPlannerSteerablePlanner_h
+
+// VTK includes
+#include <vtkObject.h>
+
+#include "vtkSlicerPathPlannerModuleLogicExport.h"
+
+class vtkPoints;
+class vtkSlicerPathPlannerVolumeSampler;
+
+/// \ingroup Slicer_QtModules_PathPlanner
+class VTK_SLICER_PATHPLANNER_MODULE_LOGIC_EXPORT vtkSlicerPathPlannerSteerablePlanner :
+  public vtkObject
+{
+public:
+  static vtkSlicerPathPlannerSteerablePlanner *New();
+  vtkTypeMacro(vtkSlicerPathPlannerSteerablePlanner, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Maximum curvature (1/mm) of the needle path. Default is 0.01
+  /// (radius of 10 cm).
+  vtkSetMacro(MaximumCurvature, double);
+  vtkGetMacro(MaximumCurvature, double);
+
+  /// Maximum length (mm) of a new edge. Default is 2.
+  vtkSetMacro(StepLength, double);
+  vtkGetMacro(StepLength, double);
+
+  /// Radius (mm) of the neighborhood searched for better parents and
+  /// rewiring, and for connecting to the target. Default is 6.
+  vtkSetMacro(RewireRadius, double);
+  vtkGetMacro(RewireRadius, double);
+
+  /// Maximum direction change (degrees) of a rewired node that has
+  /// children or connects to the target. Default is 5.
+  vtkSetMacro(HeadingTolerance, double);
+  vtkGetMacro(HeadingTolerance, double);
+
+  /// Number of samples. Default is 20000.
+  vtkSetMacro(NumberOfIterations, int);
+  vtkGetMacro(NumberOfIterations, int);
+
+  /// Number of samples processed in parallel. Default is 256.
+  vtkSetClampMacro(BatchSize, int, 1, VTK_INT_MAX);
+  vtkGetMacro(BatchSize, int);
+
+  /// Fraction of the samples drawn at the target. Default is 0.05.
+  vtkSetClampMacro(GoalBias, double, 0.0, 1.0);
+  vtkGetMacro(GoalBias, double);
+
+  /// Samples are drawn in the bounding box of the entry and the target
+  /// enlarged by this margin (mm). Default is 30.
+  vtkSetMacro(SearchMargin, double);
+  vtkGetMacro(SearchMargin, double);
+
+  vtkSetMacro(Seed, unsigned int);
+  vtkGetMacro(Seed, unsigned int);
+
+  /// Label map of the obstacles (any non zero voxel). May be NULL.
+  void SetObstacles(vtkSlicerPathPlannerVolumeSampler* sampler);
+  vtkGetObjectMacro(Obstacles, vtkSlicerPathPlannerVolumeSampler);
+
+  /// Plan a path from entry to target. "entryDirection" is the insertion
+  /// direction at the entry point; when NULL, any direction is allowed.
+  /// On success "path" receives the polyline from entry to target and 1 is
+  /// returned.
+  int Plan(const double entry[3], const double entryDirection[3],
+           const double target[3], vtkPoints* path);
+
+  /// Statistics of the last Plan call.
+  vtkGetMacro(NumberOfNodes, int);
+  vtkGetMacro(PathLength, double);
+
+protected:
+  vtkSlicerPathPlannerSteerablePlanner();
+  virtual ~vtkSlicerPathPlannerSteerablePlanner();
+
+  double MaximumCurvature;
+  double StepLength;
+  double RewireRadius;
+  double HeadingTolerance;
+  int NumberOfIterations;
+  int BatchSize;
+  double GoalBias;
+  double SearchMargin;
+  unsigned int Seed;
+  vtkSlicerPathPlannerVolumeSampler* Obstacles;
+
+  int NumberOfNodes;
+  double PathLength;
+
+private:
+  vtkSlicerPathPlannerSteerablePlanner(const vtkSlicerPathPlannerSteerablePlanner&); // Not implemented
+  void operator=(const vtkSlicerPathPlannerSteerablePlanner&);               // Not implemented
+};
+
+#endif
@@ -0,0 +1,202 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerTemplate.h"
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <sstream>
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerPathPlannerTemplate);
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerTemplate::vtkSlicerPathPlannerTemplate()
+{
+  this->NumberOfRows = 13;
+  this->NumberOfColumns = 13;
+  this->HoleSpacing = 5.0;
+  for (int i = 0; i < 3; i++)
+    {
+    for (int j = 0; j < 4; j++)
+      {
+      this->TemplateToRAS[i][j] = (i == j) ? 1.0 : 0.0;
+      this->RASToTemplateMatrix[i][j] = (i == j) ? 1.0 : 0.0;
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerTemplate::~vtkSlicerPathPlannerTemplate()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTemplate::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfRows: " << this->NumberOfRows << "\n";
+  os << indent << "NumberOfColumns: " << this->NumberOfColumns << "\n";
+  os << indent << "HoleSpacing: " << this->HoleSpacing << "\n";
+  os << indent << "TemplateToRAS:\n";
+  for (int i = 0; i < 3; i++)
+    {
+    os << indent.GetNextIndent() << this->TemplateToRAS[i][0] << " "
+       << this->TemplateToRAS[i][1] << " " << this->TemplateToRAS[i][2] << " "
+       << this->TemplateToRAS[i][3] << "\n";
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTemplate::SetTemplateToRASMatrix(vtkMatrix4x4* matrix)
+{
+  if (!matrix)
+    {
+    return;
+    }
+
+  // Rigid transform: the inverse rotation is the transpose
+  bool modified = false;
+  for (int i = 0; i < 3; i++)
+    {
+    for (int j = 0; j < 4; j++)
+      {
+      modified |= (this->TemplateToRAS[i][j] != matrix->GetElement(i, j));
+      this->TemplateToRAS[i][j] = matrix->GetElement(i, j);
+      }
+    }
+  for (int i = 0; i < 3; i++)
+    {
+    this->RASToTemplateMatrix[i][3] = 0.0;
+    for (int j = 0; j < 3; j++)
+      {
+      this->RASToTemplateMatrix[i][j] = this->TemplateToRAS[j][i];
+      this->RASToTemplateMatrix[i][3] -= this->TemplateToRAS[j][i] * this->TemplateToRAS[j][3];
+      }
+    }
+  if (modified)
+    {
+    this->Modified();
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTemplate::GetTemplateToRASMatrix(vtkMatrix4x4* matrix)
+{
+  if (!matrix)
+    {
+    return;
+    }
+  matrix->Identity();
+  for (int i = 0; i < 3; i++)
+    {
+    for (int j = 0; j < 4; j++)
+      {
+      matrix->SetElement(i, j, this->TemplateToRAS[i][j]);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerTemplate::GetNumberOfHoles()
+{
+  return this->NumberOfRows * this->NumberOfColumns;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerTemplate::GetHoleIndex(int row, int column)
+{
+  if (row < 0 || row >= this->NumberOfRows || column < 0 || column >= this->NumberOfColumns)
+    {
+    return -1;
+    }
+  return row * this->NumberOfColumns + column;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTemplate::GetHoleTemplatePosition(int hole, double position[3])
+{
+  int row = hole / this->NumberOfColumns;
+  int column = hole % this->NumberOfColumns;
+  position[0] = (column - 0.5 * (this->NumberOfColumns - 1)) * this->HoleSpacing;
+  position[1] = (row - 0.5 * (this->NumberOfRows - 1)) * this->HoleSpacing;
+  position[2] = 0.0;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTemplate::GetHolePosition(int hole, double position[3])
+{
+  double templatePosition[3];
+  this->GetHoleTemplatePosition(hole, templatePosition);
+  for (int i = 0; i < 3; i++)
+    {
+    position[i] = this->TemplateToRAS[i][0] * templatePosition[0] +
+      this->TemplateToRAS[i][1] * templatePosition[1] + this->TemplateToRAS[i][3];
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTemplate::GetHoleDirection(int vtkNotUsed(hole), double direction[3])
+{
+  for (int i = 0; i < 3; i++)
+    {
+    direction[i] = this->TemplateToRAS[i][2];
+    }
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerTemplate::GetHoleName(int hole)
+{
+  if (hole < 0 || hole >= this->GetNumberOfHoles())
+    {
+    return NULL;
+    }
+  int row = hole / this->NumberOfColumns;
+  int column = hole % this->NumberOfColumns;
+
+  // Spreadsheet style column letters: A..Z, AA..ZZ, AAA...
+  std::string letters;
+  for (int n = column + 1; n > 0; n = (n - 1) / 26)
+    {
+    letters.insert(letters.begin(), static_cast<char>('A' + (n - 1) % 26));
+    }
+  std::stringstream name;
+  name << letters << row + 1;
+  this->HoleName = name.str();
+  return this->HoleName.c_str();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTemplate::RASToTemplate(const double ras[3], double position[3])
+{
+  for (int i = 0; i < 3; i++)
+    {
+    position[i] = this->RASToTemplateMatrix[i][0] * ras[0] +
+      this->RASToTemplateMatrix[i][1] * ras[1] +
+      this->RASToTemplateMatrix[i][2] * ras[2] + this->RASToTemplateMatrix[i][3];
+    }
+}
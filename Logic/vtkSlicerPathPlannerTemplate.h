@@ -0,0 +1,105 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// .NAME vtkSlicerPathPlannerTemplate - needle guide template model
+// .SECTION Description
+// A rectangular lattice of holes (brachytherapy or biopsy template) and its
+// pose. In template coordinates the holes lie in the z = 0 plane, centered
+// on the origin, and the needles go along +z. Columns are named with
+// letters and rows with numbers, "A1" being the hole of lowest x and y.
+// The TemplateToRAS matrix must be rigid.
+
+#ifndef __vtkSlicerPathPlannerTemplate_h
+#define __vtkSlicerPathPlannerTemplate_h
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <string>
+
+#include "vtkSlicerPathPlannerModuleLogicExport.h"
+
+class vtkMatrix4x4;
+
+/// \ingroup Slicer_QtModules_PathPlanner
+class VTK_SLICER_PATHPLANNER_MODULE_LOGIC_EXPORT vtkSlicerPathPlannerTemplate :
+  public vtkObject
+{
+public:
+  static vtkSlicerPathPlannerTemplate *New();
+  vtkTypeMacro(vtkSlicerPathPlannerTemplate, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Lattice size. Default is 13 x 13.
+  vtkSetClampMacro(NumberOfRows, int, 1, 1000);
+  vtkGetMacro(NumberOfRows, int);
+  vtkSetClampMacro(NumberOfColumns, int, 1, 1000);
+  vtkGetMacro(NumberOfColumns, int);
+
+  /// Distance (mm) between neighbor holes. Default is 5.
+  vtkSetMacro(HoleSpacing, double);
+  vtkGetMacro(HoleSpacing, double);
+
+  /// Pose of the template, typically from its registration. The matrix is
+  /// copied.
+  void SetTemplateToRASMatrix(vtkMatrix4x4* matrix);
+  void GetTemplateToRASMatrix(vtkMatrix4x4* matrix);
+
+  int GetNumberOfHoles();
+  int GetHoleIndex(int row, int column);
+
+  /// Hole position in template coordinates.
+  void GetHoleTemplatePosition(int hole, double position[3]);
+
+  /// Hole position and needle direction in RAS.
+  void GetHolePosition(int hole, double position[3]);
+  void GetHoleDirection(int hole, double direction[3]);
+
+  /// "A1", "B1", ..., "A2", ... Columns after "Z" are "AA", "AB", ...,
+  /// "ZZ", "AAA", ...
+  const char* GetHoleName(int hole);
+
+  /// Transform a RAS point to template coordinates.
+  void RASToTemplate(const double ras[3], double position[3]);
+
+protected:
+  vtkSlicerPathPlannerTemplate();
+  virtual ~vtkSlicerPathPlannerTemplate();
+
+  int NumberOfRows;
+  int NumberOfColumns;
+  double HoleSpacing;
+  double TemplateToRAS[3][4];
+  double RASToTemplateMatrix[3][4];
+
+  //BTX
+  std::string HoleName;
+  //ETX
+
+private:
+  vtkSlicerPathPlannerTemplate(const vtkSlicerPathPlannerTemplate&); // Not implemented
+  void operator=(const vtkSlicerPathPlannerTemplate&);               // Not implemented
+};
+
+#endif
@@ -0,0 +1,300 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerParallel.h"
+#include "vtkSlicerPathPlannerTemplate.h"
+#include "vtkSlicerPathPlannerTemplateReachability.h"
+#include "vtkSlicerPathPlannerVolumeSampler.h"
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkIdList.h>
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+//----------------------------------------------------------------------------
+class vtkSlicerPathPlannerTemplateReachability::BuildRowsFunctor
+{
+public:
+  const vtkSlicerPathPlannerTemplateReachability* Table;
+  std::vector<Row*> Rows;
+
+  void operator()(vtkIdType begin, vtkIdType end, int vtkNotUsed(threadId))
+  {
+    for (vtkIdType i = begin; i < end; i++)
+      {
+      this->Table->BuildRow(*this->Rows[i]);
+      }
+  }
+};
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerPathPlannerTemplateReachability);
+
+//----------------------------------------------------------------------------
+vtkCxxSetObjectMacro(vtkSlicerPathPlannerTemplateReachability, Template,
+                     vtkSlicerPathPlannerTemplate);
+
+//----------------------------------------------------------------------------
+vtkCxxSetObjectMacro(vtkSlicerPathPlannerTemplateReachability, CriticalStructures,
+                     vtkSlicerPathPlannerVolumeSampler);
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerTemplateReachability::vtkSlicerPathPlannerTemplateReachability()
+{
+  this->Template = vtkSlicerPathPlannerTemplate::New();
+  this->CriticalStructures = NULL;
+  this->TargetRadius = 2.5;
+  this->MaximumDepth = 200.0;
+  this->NumberOfUpdatedRows = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerTemplateReachability::~vtkSlicerPathPlannerTemplateReachability()
+{
+  this->SetTemplate(NULL);
+  this->SetCriticalStructures(NULL);
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTemplateReachability::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Template: " << this->Template << "\n";
+  os << indent << "CriticalStructures: " << this->CriticalStructures << "\n";
+  os << indent << "TargetRadius: " << this->TargetRadius << "\n";
+  os << indent << "MaximumDepth: " << this->MaximumDepth << "\n";
+  os << indent << "NumberOfTargets: " << this->Rows.size() << "\n";
+  os << indent << "NumberOfUpdatedRows: " << this->NumberOfUpdatedRows << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTemplateReachability::SetTarget(const char* id,
+                                                         const double position[3])
+{
+  if (!id)
+    {
+    return;
+    }
+  std::map<std::string, Row>::iterator it = this->Rows.find(id);
+  if (it == this->Rows.end())
+    {
+    it = this->Rows.insert(std::make_pair(std::string(id), Row())).first;
+    }
+  else if (it->second.Target[0] == position[0] && it->second.Target[1] == position[1] &&
+           it->second.Target[2] == position[2])
+    {
+    return;
+    }
+  std::copy(position, position + 3, it->second.Target);
+  it->second.TargetTime.Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTemplateReachability::RemoveTarget(const char* id)
+{
+  if (id)
+    {
+    this->Rows.erase(id);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTemplateReachability::RemoveAllTargets()
+{
+  this->Rows.clear();
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerTemplateReachability::GetNumberOfTargets()
+{
+  return static_cast<int>(this->Rows.size());
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerTemplateReachability::GetNthTargetID(int n)
+{
+  if (n < 0 || n >= static_cast<int>(this->Rows.size()))
+    {
+    return NULL;
+    }
+  std::map<std::string, Row>::iterator it = this->Rows.begin();
+  std::advance(it, n);
+  return it->first.c_str();
+}
+
+//----------------------------------------------------------------------------
+bool vtkSlicerPathPlannerTemplateReachability::IsDirty(const Row& row)
+{
+  unsigned long buildTime = row.BuildTime.GetMTime();
+  return buildTime < row.TargetTime.GetMTime() || buildTime < this->GetMTime() ||
+    (this->Template && buildTime < this->Template->GetMTime()) ||
+    (this->CriticalStructures && buildTime < this->CriticalStructures->GetMTime());
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTemplateReachability::BuildRow(Row& row) const
+{
+  row.Entries.clear();
+  vtkSlicerPathPlannerTemplate* needleTemplate = this->Template;
+  if (!needleTemplate)
+    {
+    return;
+    }
+
+  // Target in template coordinates: the needles are parallel to z
+  double target[3];
+  needleTemplate->RASToTemplate(row.Target, target);
+  if (target[2] < 0.0 || target[2] > this->MaximumDepth)
+    {
+    return;
+    }
+
+  // Only the holes around the projection of the target can reach it
+  double spacing = needleTemplate->GetHoleSpacing();
+  int numberOfColumns = needleTemplate->GetNumberOfColumns();
+  int numberOfRows = needleTemplate->GetNumberOfRows();
+  double columnCenter = target[0] / spacing + 0.5 * (numberOfColumns - 1);
+  double rowCenter = target[1] / spacing + 0.5 * (numberOfRows - 1);
+  double halfWidth = this->TargetRadius / spacing;
+  int firstColumn = std::max(0, static_cast<int>(std::ceil(columnCenter - halfWidth)));
+  int lastColumn = std::min(numberOfColumns - 1, static_cast<int>(std::floor(columnCenter + halfWidth)));
+  int firstRow = std::max(0, static_cast<int>(std::ceil(rowCenter - halfWidth)));
+  int lastRow = std::min(numberOfRows - 1, static_cast<int>(std::floor(rowCenter + halfWidth)));
+
+  const vtkSlicerPathPlannerVolumeSampler* structures =
+    (this->CriticalStructures && this->CriticalStructures->IsValid()) ?
+    this->CriticalStructures : NULL;
+  for (int r = firstRow; r <= lastRow; r++)
+    {
+    for (int c = firstColumn; c <= lastColumn; c++)
+      {
+      Entry entry;
+      entry.Hole = needleTemplate->GetHoleIndex(r, c);
+      double hole[3];
+      needleTemplate->GetHoleTemplatePosition(entry.Hole, hole);
+      entry.Distance = std::sqrt((target[0] - hole[0]) * (target[0] - hole[0]) +
+                                 (target[1] - hole[1]) * (target[1] - hole[1]));
+      if (entry.Distance > this->TargetRadius)
+        {
+        continue;
+        }
+      entry.Depth = target[2];
+      entry.Safe = 1;
+      if (structures)
+        {
+        double entryPoint[3];
+        double direction[3];
+        needleTemplate->GetHolePosition(entry.Hole, entryPoint);
+        needleTemplate->GetHoleDirection(entry.Hole, direction);
+        double tip[3] = { entryPoint[0] + entry.Depth * direction[0],
+                          entryPoint[1] + entry.Depth * direction[1],
+                          entryPoint[2] + entry.Depth * direction[2] };
+        entry.Safe = structures->SegmentIntersectsNonZero(entryPoint, tip) ? 0 : 1;
+        }
+      row.Entries.push_back(entry);
+      }
+    }
+  std::sort(row.Entries.begin(), row.Entries.end());
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTemplateReachability::Update()
+{
+  BuildRowsFunctor functor;
+  functor.Table = this;
+  for (std::map<std::string, Row>::iterator it = this->Rows.begin(); it != this->Rows.end(); ++it)
+    {
+    if (this->IsDirty(it->second))
+      {
+      functor.Rows.push_back(&it->second);
+      }
+    }
+  if (functor.Rows.empty())
+    {
+    return;
+    }
+
+  vtkSlicerPathPlannerParallelFor(0, static_cast<vtkIdType>(functor.Rows.size()), 16, functor);
+
+  // Time stamps are not thread safe
+  for (size_t i = 0; i < functor.Rows.size(); i++)
+    {
+    functor.Rows[i]->BuildTime.Modified();
+    }
+  this->NumberOfUpdatedRows += static_cast<int>(functor.Rows.size());
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerTemplateReachability::GetReachableHoles(const char* id,
+                                                                vtkIdList* holes,
+                                                                vtkDoubleArray* depths,
+                                                                int safeOnly)
+{
+  if (holes)
+    {
+    holes->Reset();
+    }
+  if (depths)
+    {
+    depths->SetNumberOfComponents(1);
+    depths->SetNumberOfTuples(0);
+    }
+  std::map<std::string, Row>::iterator it = id ? this->Rows.find(id) : this->Rows.end();
+  if (it == this->Rows.end())
+    {
+    return -1;
+    }
+
+  Row& row = it->second;
+  if (this->IsDirty(row))
+    {
+    this->BuildRow(row);
+    row.BuildTime.Modified();
+    this->NumberOfUpdatedRows++;
+    }
+
+  int numberOfHoles = 0;
+  for (size_t i = 0; i < row.Entries.size(); i++)
+    {
+    if (safeOnly && !row.Entries[i].Safe)
+      {
+      continue;
+      }
+    if (holes)
+      {
+      holes->InsertNextId(row.Entries[i].Hole);
+      }
+    if (depths)
+      {
+      depths->InsertNextValue(row.Entries[i].Depth);
+      }
+    numberOfHoles++;
+    }
+  return numberOfHoles;
+}
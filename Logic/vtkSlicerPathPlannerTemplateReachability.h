@@ -0,0 +1,145 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// .NAME vtkSlicerPathPlannerTemplateReachability - hole to target lookup table
+// .SECTION Description
+// For every target, the table lists the template holes whose needle passes
+// within TargetRadius of the target, with the insertion depth from the
+// template and whether the needle crosses the critical structures. A row
+// only depends on its target, the template and the critical structures,
+// so moving a target recomputes its row only, and changing the template
+// registration marks the rows dirty without recomputing them. Dirty rows
+// are rebuilt in parallel by Update, or one at a time when queried.
+// Targets are identified by a string, typically the fiducial node ID.
+
+#ifndef __vtkSlicerPathPlannerTemplateReachability_h
+#define __vtkSlicerPathPlannerTemplateReachability_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkTimeStamp.h>
+
+// STD includes
+#include <map>
+#include <string>
+#include <vector>
+
+#include "vtkSlicerPathPlannerModuleLogicExport.h"
+
+class vtkDoubleArray;
+class vtkIdList;
+class vtkSlicerPathPlannerTemplate;
+class vtkSlicerPathPlannerVolumeSampler;
+
+/// \ingroup Slicer_QtModules_PathPlanner
+class VTK_SLICER_PATHPLANNER_MODULE_LOGIC_EXPORT vtkSlicerPathPlannerTemplateReachability :
+  public vtkObject
+{
+public:
+  static vtkSlicerPathPlannerTemplateReachability *New();
+  vtkTypeMacro(vtkSlicerPathPlannerTemplateReachability, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Template the table is built for. A default 13 x 13 template is
+  /// created by the constructor.
+  void SetTemplate(vtkSlicerPathPlannerTemplate* needleTemplate);
+  vtkGetObjectMacro(Template, vtkSlicerPathPlannerTemplate);
+
+  /// Label map of the structures the needles must not cross. May be NULL.
+  void SetCriticalStructures(vtkSlicerPathPlannerVolumeSampler* sampler);
+  vtkGetObjectMacro(CriticalStructures, vtkSlicerPathPlannerVolumeSampler);
+
+  /// Maximum distance (mm) between a needle axis and its target.
+  /// Default is 2.5.
+  vtkSetMacro(TargetRadius, double);
+  vtkGetMacro(TargetRadius, double);
+
+  /// Maximum insertion depth (mm) from the template. Default is 200.
+  vtkSetMacro(MaximumDepth, double);
+  vtkGetMacro(MaximumDepth, double);
+
+  /// Add or move a target. Its row is marked dirty only if the position
+  /// changed.
+  void SetTarget(const char* id, const double position[3]);
+  void RemoveTarget(const char* id);
+  void RemoveAllTargets();
+  int GetNumberOfTargets();
+  const char* GetNthTargetID(int n);
+
+  /// Rebuild the dirty rows.
+  void Update();
+
+  /// Number of rows rebuilt since the last call to ResetNumberOfUpdatedRows.
+  vtkGetMacro(NumberOfUpdatedRows, int);
+  void ResetNumberOfUpdatedRows() { this->NumberOfUpdatedRows = 0; }
+
+  /// Holes reaching the target, closest axis first, and the matching
+  /// insertion depths (may be NULL). Holes whose needle crosses the
+  /// critical structures are skipped unless safeOnly is 0. Return the
+  /// number of holes, -1 if the target is unknown.
+  int GetReachableHoles(const char* id, vtkIdList* holes, vtkDoubleArray* depths,
+                        int safeOnly = 1);
+
+protected:
+  vtkSlicerPathPlannerTemplateReachability();
+  virtual ~vtkSlicerPathPlannerTemplateReachability();
+
+  //BTX
+  struct Entry
+  {
+    int Hole;
+    double Depth;
+    double Distance;
+    int Safe;
+    bool operator<(const Entry& other) const { return this->Distance < other.Distance; }
+  };
+  struct Row
+  {
+    double Target[3];
+    vtkTimeStamp TargetTime;
+    vtkTimeStamp BuildTime;
+    std::vector<Entry> Entries;
+  };
+
+  class BuildRowsFunctor;
+
+  bool IsDirty(const Row& row);
+  void BuildRow(Row& row) const;
+  //ETX
+
+  vtkSlicerPathPlannerTemplate* Template;
+  vtkSlicerPathPlannerVolumeSampler* CriticalStructures;
+  double TargetRadius;
+  double MaximumDepth;
+  int NumberOfUpdatedRows;
+
+  //BTX
+  std::map<std::string, Row> Rows;
+  //ETX
+
+private:
+  vtkSlicerPathPlannerTemplateReachability(const vtkSlicerPathPlannerTemplateReachability&); // Not implemented
+  void operator=(const vtkSlicerPathPlannerTemplateReachability&);               // Not implemented
+};
+
+#endif
@@ -0,0 +1,402 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerDeviationMonitor.h"
+#include "vtkSlicerPathPlannerTrackingLog.h"
+
+// MRML includes
+#include "vtkMRMLAnnotationFiducialNode.h"
+#include "vtkMRMLAnnotationHierarchyNode.h"
+#include "vtkMRMLScene.h"
+
+// VTK includes
+#include <vtkByteSwap.h>
+#include <vtkCallbackCommand.h>
+#include <vtkCriticalSection.h>
+#include <vtkDoubleArray.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkTimerLog.h>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+const char Magic[8] = { 'P', 'P', 'T', 'R', 'K', 'L', 'O', 'G' };
+const vtkTypeUInt32 Version = 1;
+
+// Record types
+const unsigned char PoseRecord = 1;
+const unsigned char FiducialRecord = 2;
+
+// Number of doubles after the elapsed time of a record
+const int PoseValues = 7;
+const int FiducialValues = 3;
+
+//----------------------------------------------------------------------------
+// Wait until "due" (universal time), sleeping while more than 2 ms away
+void WaitUntil(double due)
+{
+  double wait;
+  while ((wait = due - vtkTimerLog::GetUniversalTime()) > 0.0)
+    {
+    if (wait > 0.002)
+      {
+      vtksys::SystemTools::Delay(static_cast<unsigned int>(1000.0 * wait) - 1);
+      }
+    }
+}
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerPathPlannerTrackingLog);
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerTrackingLog::vtkSlicerPathPlannerTrackingLog()
+{
+  this->StartTime = 0.0;
+  this->NumberOfRecordedPoses = 0;
+  this->NumberOfRecordedFiducialEvents = 0;
+  this->RecordLock = vtkSimpleCriticalSection::New();
+  this->FiducialCallback = vtkCallbackCommand::New();
+  this->FiducialCallback->SetClientData(this);
+  this->FiducialCallback->SetCallback(
+    &vtkSlicerPathPlannerTrackingLog::FiducialModifiedCallback);
+  this->Monitor = NULL;
+  this->Scene = NULL;
+  this->NumberOfReplayedFiducialEvents = 0;
+  this->ReplayDuration = 0.0;
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerTrackingLog::~vtkSlicerPathPlannerTrackingLog()
+{
+  this->StopRecording();
+  this->SetMonitor(NULL);
+  this->SetScene(NULL);
+  this->FiducialCallback->Delete();
+  this->RecordLock->Delete();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTrackingLog::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Recording: " << this->IsRecording() << "\n";
+  os << indent << "NumberOfRecordedPoses: " << this->GetNumberOfRecordedPoses() << "\n";
+  os << indent << "NumberOfRecordedFiducialEvents: "
+     << this->GetNumberOfRecordedFiducialEvents() << "\n";
+  os << indent << "Monitor: " << this->Monitor << "\n";
+  os << indent << "Scene: " << this->Scene << "\n";
+  os << indent << "NumberOfReplayedPoses: " << this->GetNumberOfReplayedPoses() << "\n";
+  os << indent << "NumberOfReplayedFiducialEvents: "
+     << this->NumberOfReplayedFiducialEvents << "\n";
+  os << indent << "ReplayDuration: " << this->ReplayDuration << "\n";
+}
+
+//----------------------------------------------------------------------------
+vtkCxxSetObjectMacro(vtkSlicerPathPlannerTrackingLog, Monitor,
+                     vtkSlicerPathPlannerDeviationMonitor);
+vtkCxxSetObjectMacro(vtkSlicerPathPlannerTrackingLog, Scene, vtkMRMLScene);
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerTrackingLog::StartRecording(const char* fileName)
+{
+  this->StopRecording();
+  if (!fileName)
+    {
+    return 0;
+    }
+
+  this->RecordLock->Lock();
+  this->Stream.open(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+  int opened = this->Stream.is_open() ? 1 : 0;
+  if (opened)
+    {
+    vtkTypeUInt32 version = Version;
+    vtkByteSwap::SwapLE(&version);
+    this->Stream.write(Magic, sizeof(Magic));
+    this->Stream.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    this->StartTime = vtkTimerLog::GetUniversalTime();
+    this->NumberOfRecordedPoses = 0;
+    this->NumberOfRecordedFiducialEvents = 0;
+    }
+  this->RecordLock->Unlock();
+
+  if (!opened)
+    {
+    vtkErrorMacro(<< "StartRecording: cannot create " << fileName);
+    }
+  return opened;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTrackingLog::StopRecording()
+{
+  for (std::vector<ObservedFiducial>::iterator it = this->ObservedFiducials.begin();
+       it != this->ObservedFiducials.end(); ++it)
+    {
+    it->Node->RemoveObserver(it->Tag);
+    }
+  this->ObservedFiducials.clear();
+
+  this->RecordLock->Lock();
+  if (this->Stream.is_open())
+    {
+    this->Stream.close();
+    }
+  this->RecordLock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerTrackingLog::IsRecording()
+{
+  this->RecordLock->Lock();
+  int recording = this->Stream.is_open() ? 1 : 0;
+  this->RecordLock->Unlock();
+  return recording;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTrackingLog::WriteRecord(unsigned char type, const double* values,
+                                                  int numberOfValues, const char* nodeID)
+{
+  // Elapsed time, then the values, in one buffer
+  double buffer[1 + PoseValues];
+  buffer[0] = vtkTimerLog::GetUniversalTime() - this->StartTime;
+  std::copy(values, values + numberOfValues, buffer + 1);
+  vtkByteSwap::SwapLERange(buffer, 1 + numberOfValues);
+
+  this->Stream.put(static_cast<char>(type));
+  this->Stream.write(reinterpret_cast<const char*>(buffer),
+                     (1 + numberOfValues) * sizeof(double));
+  if (nodeID)
+    {
+    size_t length = std::min(strlen(nodeID), static_cast<size_t>(VTK_UNSIGNED_SHORT_MAX));
+    vtkTypeUInt16 storedLength = static_cast<vtkTypeUInt16>(length);
+    vtkByteSwap::SwapLE(&storedLength);
+    this->Stream.write(reinterpret_cast<const char*>(&storedLength), sizeof(storedLength));
+    this->Stream.write(nodeID, length);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTrackingLog::RecordPose(double time, const double tip[3],
+                                                 const double direction[3])
+{
+  double values[PoseValues] = { time, tip[0], tip[1], tip[2],
+                                direction[0], direction[1], direction[2] };
+  this->RecordLock->Lock();
+  if (this->Stream.is_open())
+    {
+    this->WriteRecord(PoseRecord, values, PoseValues, NULL);
+    ++this->NumberOfRecordedPoses;
+    }
+  this->RecordLock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTrackingLog::RecordFiducialEvent(const char* nodeID,
+                                                          const double position[3])
+{
+  if (!nodeID)
+    {
+    return;
+    }
+  this->RecordLock->Lock();
+  if (this->Stream.is_open())
+    {
+    this->WriteRecord(FiducialRecord, position, FiducialValues, nodeID);
+    ++this->NumberOfRecordedFiducialEvents;
+    }
+  this->RecordLock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTrackingLog::RecordFiducial(vtkMRMLAnnotationFiducialNode* fiducial)
+{
+  double position[3];
+  if (fiducial && fiducial->GetFiducialCoordinates(position))
+    {
+    this->RecordFiducialEvent(fiducial->GetID(), position);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTrackingLog::ObserveFiducials(vtkMRMLAnnotationHierarchyNode* list)
+{
+  for (int i = 0; list && i < list->GetNumberOfChildrenNodes(); i++)
+    {
+    vtkMRMLAnnotationFiducialNode* fiducial =
+      vtkMRMLAnnotationFiducialNode::SafeDownCast(list->GetNthChildNode(i)->GetAssociatedNode());
+    if (!fiducial)
+      {
+      continue;
+      }
+    this->RecordFiducial(fiducial);
+    ObservedFiducial observed;
+    observed.Node = fiducial;
+    observed.Tag = fiducial->AddObserver(vtkCommand::ModifiedEvent, this->FiducialCallback);
+    this->ObservedFiducials.push_back(observed);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTrackingLog::FiducialModifiedCallback(vtkObject* caller,
+                                                               unsigned long vtkNotUsed(eid),
+                                                               void* clientData,
+                                                               void* vtkNotUsed(callData))
+{
+  vtkSlicerPathPlannerTrackingLog* self =
+    reinterpret_cast<vtkSlicerPathPlannerTrackingLog*>(clientData);
+  self->RecordFiducial(vtkMRMLAnnotationFiducialNode::SafeDownCast(caller));
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkSlicerPathPlannerTrackingLog::GetNumberOfRecordedPoses()
+{
+  this->RecordLock->Lock();
+  vtkIdType count = this->NumberOfRecordedPoses;
+  this->RecordLock->Unlock();
+  return count;
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkSlicerPathPlannerTrackingLog::GetNumberOfRecordedFiducialEvents()
+{
+  this->RecordLock->Lock();
+  vtkIdType count = this->NumberOfRecordedFiducialEvents;
+  this->RecordLock->Unlock();
+  return count;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerTrackingLog::Replay(const char* fileName, double rate)
+{
+  this->Latencies.clear();
+  this->NumberOfReplayedFiducialEvents = 0;
+  this->ReplayDuration = 0.0;
+
+  std::ifstream stream(fileName ? fileName : "", std::ios::in | std::ios::binary);
+  char magic[sizeof(Magic)];
+  vtkTypeUInt32 version = 0;
+  stream.read(magic, sizeof(magic));
+  stream.read(reinterpret_cast<char*>(&version), sizeof(version));
+  vtkByteSwap::SwapLE(&version);
+  if (!stream || memcmp(magic, Magic, sizeof(Magic)) != 0 || version > Version)
+    {
+    vtkErrorMacro(<< "Replay: " << (fileName ? fileName : "(null)")
+                  << " is not a tracking log");
+    return -1;
+    }
+
+  vtkNew<vtkDoubleArray> deviations;
+  std::string nodeID;
+  int numberOfRecords = 0;
+  double startTime = vtkTimerLog::GetUniversalTime();
+  char type;
+  while (stream.get(type))
+    {
+    double values[1 + PoseValues];
+    int numberOfValues = type == PoseRecord ? PoseValues : FiducialValues;
+    if (type != PoseRecord && type != FiducialRecord)
+      {
+      vtkErrorMacro(<< "Replay: unknown record type " << static_cast<int>(type));
+      break;
+      }
+    stream.read(reinterpret_cast<char*>(values), (1 + numberOfValues) * sizeof(double));
+    vtkByteSwap::SwapLERange(values, 1 + numberOfValues);
+    if (type == FiducialRecord)
+      {
+      vtkTypeUInt16 length = 0;
+      stream.read(reinterpret_cast<char*>(&length), sizeof(length));
+      vtkByteSwap::SwapLE(&length);
+      nodeID.resize(length);
+      if (length > 0)
+        {
+        stream.read(&nodeID[0], length);
+        }
+      }
+    if (!stream)
+      {
+      vtkWarningMacro(<< "Replay: truncated record, replay stopped");
+      break;
+      }
+
+    // Due time of the record, late records are processed right away
+    double due = rate > 0.0 ? startTime + values[0] / rate : vtkTimerLog::GetUniversalTime();
+    WaitUntil(due);
+
+    if (type == PoseRecord)
+      {
+      if (this->Monitor)
+        {
+        this->Monitor->PushPose(values[1], values + 2, values + 5);
+        this->Monitor->PopDeviations(deviations.GetPointer());
+        }
+      this->InvokeEvent(PoseReplayedEvent, values + 1);
+      this->Latencies.push_back(vtkTimerLog::GetUniversalTime() - due);
+      }
+    else
+      {
+      vtkMRMLAnnotationFiducialNode* fiducial = this->Scene ?
+        vtkMRMLAnnotationFiducialNode::SafeDownCast(this->Scene->GetNodeByID(nodeID.c_str())) :
+        NULL;
+      if (fiducial)
+        {
+        fiducial->SetFiducialCoordinates(values + 1);
+        }
+      this->InvokeEvent(FiducialReplayedEvent, fiducial);
+      ++this->NumberOfReplayedFiducialEvents;
+      }
+    ++numberOfRecords;
+    }
+
+  this->ReplayDuration = vtkTimerLog::GetUniversalTime() - startTime;
+  return numberOfRecords;
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkSlicerPathPlannerTrackingLog::GetNumberOfReplayedPoses()
+{
+  return static_cast<vtkIdType>(this->Latencies.size());
+}
+
+//----------------------------------------------------------------------------
+double vtkSlicerPathPlannerTrackingLog::GetLatencyPercentile(double percent)
+{
+  if (this->Latencies.empty())
+    {
+    return -1.0;
+    }
+  percent = percent > 0.0 ? (percent < 100.0 ? percent : 100.0) : 0.0;
+  std::vector<double> latencies(this->Latencies);
+  size_t rank = static_cast<size_t>(
+    std::floor(percent / 100.0 * (latencies.size() - 1) + 0.5));
+  std::nth_element(latencies.begin(), latencies.begin() + rank, latencies.end());
+  return latencies[rank];
+}
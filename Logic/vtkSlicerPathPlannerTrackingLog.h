@@ -0,0 +1,162 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// .NAME vtkSlicerPathPlannerTrackingLog - record and replay tracking sessions
+// .SECTION Description
+// Records the needle poses of a tracking session and the moves of the
+// fiducials to a compact binary log, and replays it to test the guidance
+// path without a tracker.
+//
+// The log starts with the "PPTRKLOG" magic and a version number, followed
+// by records stamped with the time elapsed since the start of the
+// recording: a pose (tracker time, tip RAS, needle direction) or a
+// fiducial event (local coordinates, node ID). Values are little endian.
+//
+// Replay runs in the calling thread, in the order of the log, paced by
+// the recording times divided by the rate (0 replays as fast as
+// possible), so that a log always drives the same sequence of calls.
+// Poses are pushed to the Monitor, whose deviations are popped right
+// away as the module does, and PoseReplayedEvent is invoked so that other
+// parts of the guidance path (e.g. closest trajectory lookup) can be
+// exercised. Fiducial events move the fiducials of the Scene and invoke
+// FiducialReplayedEvent. The latency of a pose is the time from when it
+// was due to the end of its processing, so that a slow guidance path
+// shows up as growing latencies at 1x.
+
+#ifndef __vtkSlicerPathPlannerTrackingLog_h
+#define __vtkSlicerPathPlannerTrackingLog_h
+
+// VTK includes
+#include <vtkCommand.h>
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "vtkSlicerPathPlannerModuleLogicExport.h"
+
+class vtkCallbackCommand;
+class vtkMRMLAnnotationFiducialNode;
+class vtkMRMLAnnotationHierarchyNode;
+class vtkMRMLScene;
+class vtkSimpleCriticalSection;
+class vtkSlicerPathPlannerDeviationMonitor;
+
+/// \ingroup Slicer_QtModules_PathPlanner
+class VTK_SLICER_PATHPLANNER_MODULE_LOGIC_EXPORT vtkSlicerPathPlannerTrackingLog :
+  public vtkObject
+{
+public:
+  static vtkSlicerPathPlannerTrackingLog *New();
+  vtkTypeMacro(vtkSlicerPathPlannerTrackingLog, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  enum
+    {
+    /// Call data is the pose: time, tip RAS, direction (7 doubles)
+    PoseReplayedEvent = vtkCommand::UserEvent + 1,
+    /// Call data is the moved fiducial node, NULL if not in the Scene
+    FiducialReplayedEvent
+    };
+
+  /// Create the log and start recording. Return 0 if it cannot be created.
+  int StartRecording(const char* fileName);
+  void StopRecording();
+  int IsRecording();
+
+  /// Record a pose. Can be called from any thread, e.g. the reader thread
+  /// of a DeviationMonitor recording to this log.
+  void RecordPose(double time, const double tip[3], const double direction[3]);
+
+  /// Record the local coordinates of a fiducial.
+  void RecordFiducial(vtkMRMLAnnotationFiducialNode* fiducial);
+  void RecordFiducialEvent(const char* nodeID, const double position[3]);
+
+  /// Record the current position of the fiducials of "list", then every
+  /// move, until the recording stops.
+  void ObserveFiducials(vtkMRMLAnnotationHierarchyNode* list);
+
+  vtkIdType GetNumberOfRecordedPoses();
+  vtkIdType GetNumberOfRecordedFiducialEvents();
+
+  /// Receives the replayed poses. The replay consumes its deviations.
+  void SetMonitor(vtkSlicerPathPlannerDeviationMonitor* monitor);
+  vtkGetObjectMacro(Monitor, vtkSlicerPathPlannerDeviationMonitor);
+
+  /// Scene whose fiducials are moved by the fiducial events.
+  void SetScene(vtkMRMLScene* scene);
+  vtkGetObjectMacro(Scene, vtkMRMLScene);
+
+  /// Replay a log at "rate" times the recording speed, 0 for as fast as
+  /// possible. Return the number of records replayed, -1 if the log
+  /// cannot be read.
+  int Replay(const char* fileName, double rate = 1.0);
+
+  /// Statistics of the last replay. Latency percentiles are in seconds,
+  /// "percent" in [0, 100], -1 if no pose was replayed.
+  vtkIdType GetNumberOfReplayedPoses();
+  vtkGetMacro(NumberOfReplayedFiducialEvents, vtkIdType);
+  double GetLatencyPercentile(double percent);
+  vtkGetMacro(ReplayDuration, double);
+
+protected:
+  vtkSlicerPathPlannerTrackingLog();
+  virtual ~vtkSlicerPathPlannerTrackingLog();
+
+  static void FiducialModifiedCallback(vtkObject* caller, unsigned long eid,
+                                       void* clientData, void* callData);
+  void WriteRecord(unsigned char type, const double* values, int numberOfValues,
+                   const char* nodeID);
+
+  //BTX
+  // Recording, guarded by RecordLock
+  std::ofstream Stream;
+  double StartTime;
+  vtkIdType NumberOfRecordedPoses;
+  vtkIdType NumberOfRecordedFiducialEvents;
+
+  struct ObservedFiducial
+  {
+    vtkSmartPointer<vtkMRMLAnnotationFiducialNode> Node;
+    unsigned long Tag;
+  };
+  std::vector<ObservedFiducial> ObservedFiducials;
+
+  std::vector<double> Latencies;
+  //ETX
+
+  vtkSimpleCriticalSection* RecordLock;
+  vtkCallbackCommand* FiducialCallback;
+  vtkSlicerPathPlannerDeviationMonitor* Monitor;
+  vtkMRMLScene* Scene;
+  vtkIdType NumberOfReplayedFiducialEvents;
+  double ReplayDuration;
+
+private:
+  vtkSlicerPathPlannerTrackingLog(const vtkSlicerPathPlannerTrackingLog&); // Not implemented
+  void operator=(const vtkSlicerPathPlannerTrackingLog&);               // Not implemented
+};
+
+#endif
@@ -0,0 +1,251 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerTrajectoryScorer.h"
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkIdList.h>
+#include <vtkMath.h>
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+namespace
+{
+//----------------------------------------------------------------------------
+// Higher score first, lower index first on ties. NaN scores rank last so
+// that the ordering stays strict and weak.
+struct ScoreGreater
+{
+  const double* Scores;
+  bool operator()(vtkIdType a, vtkIdType b) const
+  {
+    bool aIsNan = vtkMath::IsNan(this->Scores[a]) != 0;
+    bool bIsNan = vtkMath::IsNan(this->Scores[b]) != 0;
+    if (aIsNan != bIsNan)
+      {
+      return bIsNan;
+      }
+    if (!aIsNan && this->Scores[a] != this->Scores[b])
+      {
+      return this->Scores[a] > this->Scores[b];
+      }
+    return a < b;
+  }
+};
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerPathPlannerTrajectoryScorer);
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerTrajectoryScorer::vtkSlicerPathPlannerTrajectoryScorer()
+{
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerTrajectoryScorer::~vtkSlicerPathPlannerTrajectoryScorer()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTrajectoryScorer::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  for (TermMap::iterator it = this->Terms.begin(); it != this->Terms.end(); ++it)
+    {
+    os << indent << "Term " << it->first << ": weight " << it->second.Weight
+       << ", " << (it->second.Values ? it->second.Values->GetNumberOfTuples() : 0)
+       << " values\n";
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTrajectoryScorer::SetTerm(const char* name,
+                                                   vtkDoubleArray* values,
+                                                   double weight)
+{
+  if (!name)
+    {
+    return;
+    }
+  Term& term = this->Terms[name];
+  term.Values = values;
+  term.Weight = weight;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTrajectoryScorer::SetTermWeight(const char* name, double weight)
+{
+  if (!name)
+    {
+    return;
+    }
+  this->Terms[name].Weight = weight;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+double vtkSlicerPathPlannerTrajectoryScorer::GetTermWeight(const char* name)
+{
+  TermMap::iterator it = name ? this->Terms.find(name) : this->Terms.end();
+  return it != this->Terms.end() ? it->second.Weight : 0.0;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerTrajectoryScorer::SetTermValues(const char* name,
+                                                        vtkDoubleArray* values)
+{
+  TermMap::iterator it = name ? this->Terms.find(name) : this->Terms.end();
+  if (it == this->Terms.end())
+    {
+    return 0;
+    }
+  it->second.Values = values;
+  this->Modified();
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+vtkDoubleArray* vtkSlicerPathPlannerTrajectoryScorer::GetTermValues(const char* name)
+{
+  TermMap::iterator it = name ? this->Terms.find(name) : this->Terms.end();
+  return it != this->Terms.end() ? it->second.Values.GetPointer() : NULL;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTrajectoryScorer::RemoveTerm(const char* name)
+{
+  if (name && this->Terms.erase(name))
+    {
+    this->Modified();
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTrajectoryScorer::RemoveAllTerms()
+{
+  this->Terms.clear();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerTrajectoryScorer::GetNumberOfTerms()
+{
+  return static_cast<int>(this->Terms.size());
+}
+
+//----------------------------------------------------------------------------
+const char* vtkSlicerPathPlannerTrajectoryScorer::GetNthTermName(int n)
+{
+  if (n < 0 || n >= static_cast<int>(this->Terms.size()))
+    {
+    return NULL;
+    }
+  TermMap::iterator it = this->Terms.begin();
+  std::advance(it, n);
+  return it->first.c_str();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTrajectoryScorer::ComputeScores(vtkIdType numberOfTrajectories,
+                                                         vtkDoubleArray* scores)
+{
+  if (!scores)
+    {
+    return;
+    }
+
+  scores->SetNumberOfComponents(1);
+  scores->SetNumberOfTuples(numberOfTrajectories);
+  double* output = scores->GetPointer(0);
+  for (vtkIdType i = 0; i < numberOfTrajectories; i++)
+    {
+    output[i] = 0.0;
+    }
+
+  for (TermMap::iterator it = this->Terms.begin(); it != this->Terms.end(); ++it)
+    {
+    vtkDoubleArray* values = it->second.Values;
+    if (!values || it->second.Weight == 0.0)
+      {
+      continue;
+      }
+    if (values->GetNumberOfTuples() != numberOfTrajectories ||
+        values->GetNumberOfComponents() != 1)
+      {
+      vtkWarningMacro(<< "ComputeScores: term " << it->first
+                      << " does not match the trajectories, skipped");
+      continue;
+      }
+    const double* input = values->GetPointer(0);
+    const double weight = it->second.Weight;
+    for (vtkIdType i = 0; i < numberOfTrajectories; i++)
+      {
+      output[i] += weight * input[i];
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTrajectoryScorer::SelectBest(vtkDoubleArray* scores,
+                                                      vtkIdType numberOfBest,
+                                                      vtkIdList* order)
+{
+  if (!order)
+    {
+    return;
+    }
+  order->Reset();
+  if (!scores || scores->GetNumberOfTuples() == 0)
+    {
+    return;
+    }
+
+  vtkIdType numberOfScores = scores->GetNumberOfTuples();
+  if (numberOfBest <= 0 || numberOfBest > numberOfScores)
+    {
+    numberOfBest = numberOfScores;
+    }
+
+  std::vector<vtkIdType> indices(numberOfScores);
+  for (vtkIdType i = 0; i < numberOfScores; i++)
+    {
+    indices[i] = i;
+    }
+
+  ScoreGreater greater;
+  greater.Scores = scores->GetPointer(0);
+  std::partial_sort(indices.begin(), indices.begin() + numberOfBest, indices.end(), greater);
+
+  order->SetNumberOfIds(numberOfBest);
+  for (vtkIdType i = 0; i < numberOfBest; i++)
+    {
+    order->SetId(i, indices[i]);
+    }
+}
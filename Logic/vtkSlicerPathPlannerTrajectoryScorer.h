@@ -0,0 +1,100 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// .NAME vtkSlicerPathPlannerTrajectoryScorer - weighted ranking of trajectories
+// .SECTION Description
+// A score is the weighted sum of named terms, each term holding one value
+// per trajectory (higher is better). Use negative weights for costs such as
+// the length. Terms are identified by name so that the logic can refresh
+// their values from the ruler attributes of the same name.
+
+#ifndef __vtkSlicerPathPlannerTrajectoryScorer_h
+#define __vtkSlicerPathPlannerTrajectoryScorer_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <map>
+#include <string>
+
+#include "vtkSlicerPathPlannerModuleLogicExport.h"
+
+class vtkDoubleArray;
+class vtkIdList;
+
+/// \ingroup Slicer_QtModules_PathPlanner
+class VTK_SLICER_PATHPLANNER_MODULE_LOGIC_EXPORT vtkSlicerPathPlannerTrajectoryScorer :
+  public vtkObject
+{
+public:
+  static vtkSlicerPathPlannerTrajectoryScorer *New();
+  vtkTypeMacro(vtkSlicerPathPlannerTrajectoryScorer, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Add or replace a term.
+  void SetTerm(const char* name, vtkDoubleArray* values, double weight);
+
+  /// Set the weight of a term, adding it without values if needed.
+  void SetTermWeight(const char* name, double weight);
+  double GetTermWeight(const char* name);
+
+  /// Set the values of an existing term. Return 0 if there is no such term.
+  int SetTermValues(const char* name, vtkDoubleArray* values);
+  vtkDoubleArray* GetTermValues(const char* name);
+
+  void RemoveTerm(const char* name);
+  void RemoveAllTerms();
+  int GetNumberOfTerms();
+  const char* GetNthTermName(int n);
+
+  /// Weighted sum of the terms for numberOfTrajectories trajectories. Terms
+  /// without values or with a different number of values are skipped.
+  void ComputeScores(vtkIdType numberOfTrajectories, vtkDoubleArray* scores);
+
+  /// Indices of the "numberOfBest" highest scores, best first. All the
+  /// trajectories are sorted if numberOfBest is not positive. Ties keep the
+  /// original order and NaN scores come last. Runs in O(n log k).
+  static void SelectBest(vtkDoubleArray* scores, vtkIdType numberOfBest, vtkIdList* order);
+
+protected:
+  vtkSlicerPathPlannerTrajectoryScorer();
+  virtual ~vtkSlicerPathPlannerTrajectoryScorer();
+
+  //BTX
+  struct Term
+  {
+    Term() : Weight(0.0) {}
+    vtkSmartPointer<vtkDoubleArray> Values;
+    double Weight;
+  };
+  typedef std::map<std::string, Term> TermMap;
+  TermMap Terms;
+  //ETX
+
+private:
+  vtkSlicerPathPlannerTrajectoryScorer(const vtkSlicerPathPlannerTrajectoryScorer&); // Not implemented
+  void operator=(const vtkSlicerPathPlannerTrajectoryScorer&);               // Not implemented
+};
+
+#endif
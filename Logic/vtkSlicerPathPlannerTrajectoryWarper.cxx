@@ -0,0 +1,362 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerParallel.h"
+#include "vtkSlicerPathPlannerTrajectoryWarper.h"
+
+// VTK includes
+#include <vtkAbstractTransform.h>
+#include <vtkDoubleArray.h>
+#include <vtkGeneralTransform.h>
+#include <vtkGridTransform.h>
+#include <vtkIdTypeArray.h>
+#include <vtkImageData.h>
+#include <vtkLinearTransform.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <cmath>
+#include <vector>
+
+namespace
+{
+//----------------------------------------------------------------------------
+// One step of the flattened transform chain
+struct WarpStage
+{
+  enum { Linear, Grid, Generic };
+  int Type;
+
+  // Linear: first three rows of the matrix
+  double Matrix[12];
+
+  // Grid: displacement buffer of 3 component tuples
+  const void* Displacements;
+  int ScalarType;
+  int Size[3];
+  vtkIdType Increments[3];
+  double Origin[3];
+  double InverseSpacing[3];
+  double Scale;
+  double Shift;
+
+  // Generic
+  vtkAbstractTransform* Transform;
+};
+
+//----------------------------------------------------------------------------
+// Flatten "transform" into stages, applied in order. Grid transforms that
+// cannot be evaluated directly (inverted, non linear interpolation, other
+// scalar types) are kept as generic stages.
+void AppendStages(vtkAbstractTransform* transform, std::vector<WarpStage>& stages)
+{
+  if (!transform)
+    {
+    return;
+    }
+  transform->Update();
+
+  WarpStage stage;
+  stage.Type = WarpStage::Generic;
+  stage.Transform = transform;
+
+  vtkGeneralTransform* general = vtkGeneralTransform::SafeDownCast(transform);
+  vtkLinearTransform* linear = vtkLinearTransform::SafeDownCast(transform);
+  vtkGridTransform* grid = vtkGridTransform::SafeDownCast(transform);
+  if (general)
+    {
+    for (int i = 0; i < general->GetNumberOfConcatenatedTransforms(); i++)
+      {
+      AppendStages(general->GetConcatenatedTransform(i), stages);
+      }
+    return;
+    }
+  else if (linear && linear->GetMatrix())
+    {
+    stage.Type = WarpStage::Linear;
+    for (int i = 0; i < 3; i++)
+      {
+      for (int j = 0; j < 4; j++)
+        {
+        stage.Matrix[4 * i + j] = linear->GetMatrix()->GetElement(i, j);
+        }
+      }
+    }
+  else if (grid && grid->GetDisplacementGrid() && !grid->GetInverseFlag() &&
+           grid->GetInterpolationMode() == VTK_GRID_LINEAR &&
+           grid->GetDisplacementGrid()->GetNumberOfScalarComponents() == 3 &&
+           (grid->GetDisplacementGrid()->GetScalarType() == VTK_FLOAT ||
+            grid->GetDisplacementGrid()->GetScalarType() == VTK_DOUBLE))
+    {
+    vtkImageData* displacements = grid->GetDisplacementGrid();
+    int extent[6];
+    displacements->GetExtent(extent);
+    double* origin = displacements->GetOrigin();
+    double* spacing = displacements->GetSpacing();
+    stage.Type = WarpStage::Grid;
+    stage.Displacements = displacements->GetScalarPointer();
+    stage.ScalarType = displacements->GetScalarType();
+    for (int a = 0; a < 3; a++)
+      {
+      stage.Size[a] = extent[2 * a + 1] - extent[2 * a] + 1;
+      // Grid coordinates relative to the first voxel of the extent
+      stage.Origin[a] = origin[a] + extent[2 * a] * spacing[a];
+      stage.InverseSpacing[a] = 1.0 / spacing[a];
+      }
+    stage.Increments[0] = 3;
+    stage.Increments[1] = 3 * static_cast<vtkIdType>(stage.Size[0]);
+    stage.Increments[2] = stage.Increments[1] * stage.Size[1];
+    stage.Scale = grid->GetDisplacementScale();
+    stage.Shift = grid->GetDisplacementShift();
+    if (!stage.Displacements || stage.Size[0] < 1 || stage.Size[1] < 1 || stage.Size[2] < 1)
+      {
+      stage.Type = WarpStage::Generic;
+      }
+    }
+  stages.push_back(stage);
+}
+
+//----------------------------------------------------------------------------
+// Trilinear displacement, clamped to the border of the grid like
+// vtkGridTransform
+template <class T>
+void AddGridDisplacement(const WarpStage& stage, const T* displacements, double point[3])
+{
+  vtkIdType offset0[3];
+  vtkIdType offset1[3];
+  double fraction[3];
+  for (int a = 0; a < 3; a++)
+    {
+    double x = (point[a] - stage.Origin[a]) * stage.InverseSpacing[a];
+    int last = stage.Size[a] - 1;
+    int index0;
+    int index1;
+    if (x < 0.0)
+      {
+      index0 = index1 = 0;
+      fraction[a] = 0.0;
+      }
+    else if (x >= last)
+      {
+      index0 = index1 = last;
+      fraction[a] = 0.0;
+      }
+    else
+      {
+      index0 = static_cast<int>(x);
+      index1 = index0 + 1;
+      fraction[a] = x - index0;
+      }
+    offset0[a] = index0 * stage.Increments[a];
+    offset1[a] = index1 * stage.Increments[a];
+    }
+
+  const double fx = fraction[0];
+  const double fy = fraction[1];
+  const double fz = fraction[2];
+  const double weights[8] = {
+    (1 - fx) * (1 - fy) * (1 - fz), fx * (1 - fy) * (1 - fz),
+    (1 - fx) * fy * (1 - fz), fx * fy * (1 - fz),
+    (1 - fx) * (1 - fy) * fz, fx * (1 - fy) * fz,
+    (1 - fx) * fy * fz, fx * fy * fz };
+  const vtkIdType offsets[8] = {
+    offset0[0] + offset0[1] + offset0[2], offset1[0] + offset0[1] + offset0[2],
+    offset0[0] + offset1[1] + offset0[2], offset1[0] + offset1[1] + offset0[2],
+    offset0[0] + offset0[1] + offset1[2], offset1[0] + offset0[1] + offset1[2],
+    offset0[0] + offset1[1] + offset1[2], offset1[0] + offset1[1] + offset1[2] };
+
+  double displacement[3] = { 0.0, 0.0, 0.0 };
+  for (int n = 0; n < 8; n++)
+    {
+    const T* value = displacements + offsets[n];
+    displacement[0] += weights[n] * value[0];
+    displacement[1] += weights[n] * value[1];
+    displacement[2] += weights[n] * value[2];
+    }
+  point[0] += displacement[0] * stage.Scale + stage.Shift;
+  point[1] += displacement[1] * stage.Scale + stage.Shift;
+  point[2] += displacement[2] * stage.Scale + stage.Shift;
+}
+
+//----------------------------------------------------------------------------
+void ApplyStage(const WarpStage& stage, double point[3])
+{
+  switch (stage.Type)
+    {
+    case WarpStage::Linear:
+      {
+      const double* m = stage.Matrix;
+      double x = point[0];
+      double y = point[1];
+      double z = point[2];
+      point[0] = m[0] * x + m[1] * y + m[2] * z + m[3];
+      point[1] = m[4] * x + m[5] * y + m[6] * z + m[7];
+      point[2] = m[8] * x + m[9] * y + m[10] * z + m[11];
+      break;
+      }
+    case WarpStage::Grid:
+      if (stage.ScalarType == VTK_FLOAT)
+        {
+        AddGridDisplacement(stage, static_cast<const float*>(stage.Displacements), point);
+        }
+      else
+        {
+        AddGridDisplacement(stage, static_cast<const double*>(stage.Displacements), point);
+        }
+      break;
+    default:
+      {
+      // Thread safe once the transform is up to date
+      double input[3] = { point[0], point[1], point[2] };
+      stage.Transform->InternalTransformPoint(input, point);
+      break;
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+struct WarpFunctor
+{
+  const std::vector<WarpStage>* Stages;
+  double* Points;
+
+  void operator()(vtkIdType begin, vtkIdType end, int vtkNotUsed(threadId))
+  {
+    const std::vector<WarpStage>& stages = *this->Stages;
+    for (vtkIdType n = begin; n < end; n++)
+      {
+      double* point = this->Points + 3 * n;
+      for (size_t s = 0; s < stages.size(); s++)
+        {
+        ApplyStage(stages[s], point);
+        }
+      }
+  }
+};
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerPathPlannerTrajectoryWarper);
+vtkCxxSetObjectMacro(vtkSlicerPathPlannerTrajectoryWarper, Transform, vtkAbstractTransform);
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerTrajectoryWarper::vtkSlicerPathPlannerTrajectoryWarper()
+{
+  this->Transform = NULL;
+  this->SampleStep = 1.0;
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerTrajectoryWarper::~vtkSlicerPathPlannerTrajectoryWarper()
+{
+  this->SetTransform(NULL);
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerTrajectoryWarper::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Transform: " << this->Transform << "\n";
+  os << indent << "SampleStep: " << this->SampleStep << "\n";
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerTrajectoryWarper::WarpTrajectories(vtkDoubleArray* segments,
+                                                           vtkDoubleArray* points,
+                                                           vtkIdTypeArray* offsets)
+{
+  if (!segments || !points || !offsets || segments->GetNumberOfComponents() != 6)
+    {
+    vtkErrorMacro(<< "WarpTrajectories: invalid input arrays");
+    return 0;
+    }
+
+  vtkIdType numberOfTrajectories = segments->GetNumberOfTuples();
+  offsets->SetNumberOfComponents(1);
+  offsets->SetNumberOfTuples(numberOfTrajectories + 1);
+  vtkIdType* offset = offsets->GetPointer(0);
+  const double* segment = numberOfTrajectories > 0 ? segments->GetPointer(0) : NULL;
+
+  // Both ends are always sampled
+  offset[0] = 0;
+  for (vtkIdType i = 0; i < numberOfTrajectories; i++)
+    {
+    const double* s = segment + 6 * i;
+    double length = std::sqrt(vtkMath::Distance2BetweenPoints(s, s + 3));
+    vtkIdType numberOfSteps = static_cast<vtkIdType>(std::ceil(length / this->SampleStep));
+    offset[i + 1] = offset[i] + (numberOfSteps > 1 ? numberOfSteps : 1) + 1;
+    }
+
+  points->SetNumberOfComponents(3);
+  points->SetNumberOfTuples(offset[numberOfTrajectories]);
+  if (numberOfTrajectories == 0)
+    {
+    return 1;
+    }
+  double* point = points->GetPointer(0);
+  for (vtkIdType i = 0; i < numberOfTrajectories; i++)
+    {
+    const double* s = segment + 6 * i;
+    vtkIdType numberOfSamples = offset[i + 1] - offset[i];
+    double* p = point + 3 * offset[i];
+    for (vtkIdType n = 0; n < numberOfSamples; n++)
+      {
+      double t = static_cast<double>(n) / (numberOfSamples - 1);
+      p[3 * n] = s[0] + t * (s[3] - s[0]);
+      p[3 * n + 1] = s[1] + t * (s[4] - s[1]);
+      p[3 * n + 2] = s[2] + t * (s[5] - s[2]);
+      }
+    }
+
+  return this->WarpPoints(points);
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerTrajectoryWarper::WarpPoints(vtkDoubleArray* points)
+{
+  if (!points || points->GetNumberOfComponents() != 3)
+    {
+    vtkErrorMacro(<< "WarpPoints: invalid point array");
+    return 0;
+    }
+  vtkIdType numberOfPoints = points->GetNumberOfTuples();
+  std::vector<WarpStage> stages;
+  AppendStages(this->Transform, stages);
+  if (numberOfPoints == 0 || stages.empty())
+    {
+    return 1;
+    }
+  double* point = points->GetPointer(0);
+
+  WarpFunctor functor;
+  functor.Stages = &stages;
+  functor.Points = point;
+  // Samples are visited in trajectory order: consecutive samples fall in
+  // the same or neighbouring grid cells, and stay on the same thread
+  vtkSlicerPathPlannerParallelFor(0, numberOfPoints, 4096, functor);
+
+  points->Modified();
+  return 1;
+}
@@ -0,0 +1,86 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// .NAME vtkSlicerPathPlannerTrajectoryWarper - batch deformation of trajectories
+// .SECTION Description
+// Samples straight trajectories every SampleStep mm and maps all the samples
+// through a transform in one pass, typically the result of the deformable
+// registration of an intra-procedural image. Grid transforms with linear
+// interpolation, alone or concatenated with linear transforms, are
+// evaluated directly on their displacement buffer. Other transforms
+// (B-spline, inverted grids, ...) go through InternalTransformPoint. The
+// samples are stored and warped trajectory by trajectory, so consecutive
+// samples hit the same grid cells while they are in cache, and the
+// traversal is split across threads in contiguous chunks.
+
+#ifndef __vtkSlicerPathPlannerTrajectoryWarper_h
+#define __vtkSlicerPathPlannerTrajectoryWarper_h
+
+// VTK includes
+#include <vtkObject.h>
+
+#include "vtkSlicerPathPlannerModuleLogicExport.h"
+
+class vtkAbstractTransform;
+class vtkDoubleArray;
+class vtkIdTypeArray;
+
+/// \ingroup Slicer_QtModules_PathPlanner
+class VTK_SLICER_PATHPLANNER_MODULE_LOGIC_EXPORT vtkSlicerPathPlannerTrajectoryWarper :
+  public vtkObject
+{
+public:
+  static vtkSlicerPathPlannerTrajectoryWarper *New();
+  vtkTypeMacro(vtkSlicerPathPlannerTrajectoryWarper, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Transform applied to the samples. NULL is the identity.
+  virtual void SetTransform(vtkAbstractTransform* transform);
+  vtkGetObjectMacro(Transform, vtkAbstractTransform);
+
+  /// Distance between the samples of a trajectory (mm). Default is 1.
+  vtkSetClampMacro(SampleStep, double, 0.01, VTK_DOUBLE_MAX);
+  vtkGetMacro(SampleStep, double);
+
+  /// Sample every trajectory of "segments" (6 components: entry RAS,
+  /// target RAS) and warp the samples. The warped points of trajectory i
+  /// are the tuples offsets[i] to offsets[i + 1] - 1 of "points", from the
+  /// entry to the target. Return 0 on error.
+  int WarpTrajectories(vtkDoubleArray* segments, vtkDoubleArray* points,
+                       vtkIdTypeArray* offsets);
+
+  /// Warp "points" (3 components) in place. Return 0 on error.
+  int WarpPoints(vtkDoubleArray* points);
+
+protected:
+  vtkSlicerPathPlannerTrajectoryWarper();
+  virtual ~vtkSlicerPathPlannerTrajectoryWarper();
+
+  vtkAbstractTransform* Transform;
+  double SampleStep;
+
+private:
+  vtkSlicerPathPlannerTrajectoryWarper(const vtkSlicerPathPlannerTrajectoryWarper&); // Not implemented
+  void operator=(const vtkSlicerPathPlannerTrajectoryWarper&);               // Not implemented
+};
+
+#endif
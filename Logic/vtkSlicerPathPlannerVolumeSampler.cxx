@@ -0,0 +1,488 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerLogic.h"
+#include "vtkSlicerPathPlannerVolumeSampler.h"
+
+// MRML includes
+#include "vtkMRMLVolumeNode.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <cmath>
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerPathPlannerVolumeSampler);
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerVolumeSampler::vtkSlicerPathPlannerVolumeSampler()
+{
+  for (int i = 0; i < 3; i++)
+    {
+    for (int j = 0; j < 4; j++)
+      {
+      this->RASToIJKMatrix[i][j] = (i == j) ? 1.0 : 0.0;
+      this->IJKToRASMatrix[i][j] = (i == j) ? 1.0 : 0.0;
+      }
+    this->Dimensions[i] = 0;
+    this->Increments[i] = 0;
+    }
+  this->MinimumSpacing = 1.0;
+  this->Scalars = NULL;
+  this->ScalarType = VTK_DOUBLE;
+  this->OutsideValue = 0.0;
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerVolumeSampler::~vtkSlicerPathPlannerVolumeSampler()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerVolumeSampler::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Dimensions: " << this->Dimensions[0] << " "
+     << this->Dimensions[1] << " " << this->Dimensions[2] << "\n";
+  os << indent << "MinimumSpacing: " << this->MinimumSpacing << "\n";
+  os << indent << "OutsideValue: " << this->OutsideValue << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerVolumeSampler::SetVolumeNode(vtkMRMLVolumeNode* volumeNode)
+{
+  if (!volumeNode || !volumeNode->GetImageData())
+    {
+    this->SetImageData(NULL, NULL);
+    return;
+    }
+
+  // Positions are in world coordinates: go through the parent transforms
+  vtkNew<vtkMatrix4x4> worldToIJK;
+  if (!vtkSlicerPathPlannerLogic::GetWorldToIJKMatrix(volumeNode, worldToIJK.GetPointer()))
+    {
+    vtkWarningMacro(<< "SetVolumeNode: volume " << (volumeNode->GetID() ? volumeNode->GetID() : "")
+                    << " is under a non linear transform, not sampled");
+    this->SetImageData(NULL, NULL);
+    return;
+    }
+  this->SetImageData(volumeNode->GetImageData(), worldToIJK.GetPointer());
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerVolumeSampler::SetImageData(vtkImageData* imageData,
+                                                     vtkMatrix4x4* rasToIJK)
+{
+  this->ImageData = imageData;
+  this->Scalars = NULL;
+  this->Dimensions[0] = this->Dimensions[1] = this->Dimensions[2] = 0;
+
+  if (!imageData || !rasToIJK || !imageData->GetScalarPointer())
+    {
+    this->Modified();
+    return;
+    }
+
+  for (int i = 0; i < 3; i++)
+    {
+    for (int j = 0; j < 4; j++)
+      {
+      this->RASToIJKMatrix[i][j] = rasToIJK->GetElement(i, j);
+      }
+    }
+
+  // Voxel size is the norm of the columns of the IJK to RAS matrix
+  vtkNew<vtkMatrix4x4> ijkToRAS;
+  vtkMatrix4x4::Invert(rasToIJK, ijkToRAS.GetPointer());
+  for (int i = 0; i < 3; i++)
+    {
+    for (int j = 0; j < 4; j++)
+      {
+      this->IJKToRASMatrix[i][j] = ijkToRAS->GetElement(i, j);
+      }
+    }
+  this->MinimumSpacing = VTK_DOUBLE_MAX;
+  for (int j = 0; j < 3; j++)
+    {
+    double spacing = 0.0;
+    for (int i = 0; i < 3; i++)
+      {
+      spacing += ijkToRAS->GetElement(i, j) * ijkToRAS->GetElement(i, j);
+      }
+    spacing = std::sqrt(spacing);
+    if (spacing < this->MinimumSpacing)
+      {
+      this->MinimumSpacing = spacing;
+      }
+    }
+
+  imageData->GetDimensions(this->Dimensions);
+  int numberOfComponents = imageData->GetNumberOfScalarComponents();
+  this->Increments[0] = numberOfComponents;
+  this->Increments[1] = this->Increments[0] * this->Dimensions[0];
+  this->Increments[2] = this->Increments[1] * this->Dimensions[1];
+  this->Scalars = imageData->GetScalarPointer();
+  this->ScalarType = imageData->GetScalarType();
+
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+vtkImageData* vtkSlicerPathPlannerVolumeSampler::GetImageData()
+{
+  return this->ImageData;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerVolumeSampler::IsValid() const
+{
+  return this->Scalars != NULL;
+}
+
+//----------------------------------------------------------------------------
+double vtkSlicerPathPlannerVolumeSampler::GetMinimumSpacing() const
+{
+  return this->MinimumSpacing;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerVolumeSampler::RASToIJK(const double ras[3], double ijk[3]) const
+{
+  for (int i = 0; i < 3; i++)
+    {
+    ijk[i] = this->RASToIJKMatrix[i][0] * ras[0]
+      + this->RASToIJKMatrix[i][1] * ras[1]
+      + this->RASToIJKMatrix[i][2] * ras[2]
+      + this->RASToIJKMatrix[i][3];
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerVolumeSampler::IJKToRAS(const double ijk[3], double ras[3]) const
+{
+  for (int i = 0; i < 3; i++)
+    {
+    ras[i] = this->IJKToRASMatrix[i][0] * ijk[0]
+      + this->IJKToRASMatrix[i][1] * ijk[1]
+      + this->IJKToRASMatrix[i][2] * ijk[2]
+      + this->IJKToRASMatrix[i][3];
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerVolumeSampler::GetRASBounds(double bounds[6]) const
+{
+  bounds[0] = bounds[2] = bounds[4] = VTK_DOUBLE_MAX;
+  bounds[1] = bounds[3] = bounds[5] = -VTK_DOUBLE_MAX;
+  if (!this->IsValid())
+    {
+    bounds[0] = bounds[2] = bounds[4] = 0.0;
+    bounds[1] = bounds[3] = bounds[5] = 0.0;
+    return;
+    }
+  for (int corner = 0; corner < 8; corner++)
+    {
+    double ijk[3] = { (corner & 1) ? this->Dimensions[0] - 0.5 : -0.5,
+                      (corner & 2) ? this->Dimensions[1] - 0.5 : -0.5,
+                      (corner & 4) ? this->Dimensions[2] - 0.5 : -0.5 };
+    double ras[3];
+    this->IJKToRAS(ijk, ras);
+    for (int i = 0; i < 3; i++)
+      {
+      bounds[2 * i] = ras[i] < bounds[2 * i] ? ras[i] : bounds[2 * i];
+      bounds[2 * i + 1] = ras[i] > bounds[2 * i + 1] ? ras[i] : bounds[2 * i + 1];
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+double vtkSlicerPathPlannerVolumeSampler::GetScalar(vtkIdType index) const
+{
+  switch (this->ScalarType)
+    {
+    vtkTemplateMacro(return static_cast<double>(static_cast<VTK_TT*>(this->Scalars)[index]));
+    }
+  return this->OutsideValue;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerVolumeSampler::GetDimensions(int dimensions[3]) const
+{
+  for (int i = 0; i < 3; i++)
+    {
+    dimensions[i] = this->Scalars ? this->Dimensions[i] : 0;
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerVolumeSampler::GetSpacing(double spacing[3]) const
+{
+  for (int j = 0; j < 3; j++)
+    {
+    spacing[j] = std::sqrt(this->IJKToRASMatrix[0][j] * this->IJKToRASMatrix[0][j] +
+                           this->IJKToRASMatrix[1][j] * this->IJKToRASMatrix[1][j] +
+                           this->IJKToRASMatrix[2][j] * this->IJKToRASMatrix[2][j]);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerVolumeSampler::GetRASToIJKMatrix(vtkMatrix4x4* rasToIJK) const
+{
+  if (!rasToIJK)
+    {
+    return;
+    }
+  rasToIJK->Identity();
+  for (int i = 0; i < 3; i++)
+    {
+    for (int j = 0; j < 4; j++)
+      {
+      rasToIJK->SetElement(i, j, this->RASToIJKMatrix[i][j]);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+double vtkSlicerPathPlannerVolumeSampler::GetScalar(int i, int j, int k) const
+{
+  return this->GetScalar(i * this->Increments[0] +
+                         j * this->Increments[1] +
+                         k * this->Increments[2]);
+}
+
+//----------------------------------------------------------------------------
+double vtkSlicerPathPlannerVolumeSampler::GetValueNearest(const double ras[3]) const
+{
+  if (!this->Scalars)
+    {
+    return this->OutsideValue;
+    }
+
+  double ijk[3];
+  this->RASToIJK(ras, ijk);
+
+  int index[3];
+  for (int i = 0; i < 3; i++)
+    {
+    index[i] = static_cast<int>(std::floor(ijk[i] + 0.5));
+    if (index[i] < 0 || index[i] >= this->Dimensions[i])
+      {
+      return this->OutsideValue;
+      }
+    }
+  return this->GetScalar(index[0], index[1], index[2]);
+}
+
+//----------------------------------------------------------------------------
+double vtkSlicerPathPlannerVolumeSampler::GetValueLinear(const double ras[3]) const
+{
+  if (!this->Scalars)
+    {
+    return this->OutsideValue;
+    }
+
+  double ijk[3];
+  this->RASToIJK(ras, ijk);
+
+  int index[3];
+  double fraction[3];
+  for (int i = 0; i < 3; i++)
+    {
+    if (ijk[i] < 0.0 || ijk[i] > this->Dimensions[i] - 1)
+      {
+      return this->OutsideValue;
+      }
+    index[i] = static_cast<int>(ijk[i]);
+    if (index[i] >= this->Dimensions[i] - 1)
+      {
+      // On the last slice: interpolate with itself
+      index[i] = this->Dimensions[i] > 1 ? this->Dimensions[i] - 2 : 0;
+      }
+    fraction[i] = ijk[i] - index[i];
+    }
+
+  vtkIdType base = index[0] * this->Increments[0] +
+    index[1] * this->Increments[1] + index[2] * this->Increments[2];
+  vtkIdType di = this->Dimensions[0] > 1 ? this->Increments[0] : 0;
+  vtkIdType dj = this->Dimensions[1] > 1 ? this->Increments[1] : 0;
+  vtkIdType dk = this->Dimensions[2] > 1 ? this->Increments[2] : 0;
+
+  double c00 = this->GetScalar(base) * (1.0 - fraction[0])
+    + this->GetScalar(base + di) * fraction[0];
+  double c10 = this->GetScalar(base + dj) * (1.0 - fraction[0])
+    + this->GetScalar(base + dj + di) * fraction[0];
+  double c01 = this->GetScalar(base + dk) * (1.0 - fraction[0])
+    + this->GetScalar(base + dk + di) * fraction[0];
+  double c11 = this->GetScalar(base + dk + dj) * (1.0 - fraction[0])
+    + this->GetScalar(base + dk + dj + di) * fraction[0];
+
+  double c0 = c00 * (1.0 - fraction[1]) + c10 * fraction[1];
+  double c1 = c01 * (1.0 - fraction[1]) + c11 * fraction[1];
+  return c0 * (1.0 - fraction[2]) + c1 * fraction[2];
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerVolumeSampler::SegmentIntersectsNonZero(const double p0[3],
+                                                                const double p1[3]) const
+{
+  if (!this->Scalars)
+    {
+    return 0;
+    }
+
+  // Work in voxel units where voxel v covers [v, v+1)
+  double start[3];
+  double direction[3];
+  double end[3];
+  this->RASToIJK(p0, start);
+  this->RASToIJK(p1, end);
+  for (int i = 0; i < 3; i++)
+    {
+    start[i] += 0.5;
+    end[i] += 0.5;
+    direction[i] = end[i] - start[i];
+    }
+
+  // Clip the segment against the image bounds
+  double tEnter = 0.0;
+  double tExit = 1.0;
+  for (int i = 0; i < 3; i++)
+    {
+    if (std::fabs(direction[i]) < 1e-12)
+      {
+      if (start[i] < 0.0 || start[i] >= this->Dimensions[i])
+        {
+        return 0;
+        }
+      continue;
+      }
+    double t0 = -start[i] / direction[i];
+    double t1 = (this->Dimensions[i] - start[i]) / direction[i];
+    if (t0 > t1)
+      {
+      double tmp = t0;
+      t0 = t1;
+      t1 = tmp;
+      }
+    tEnter = t0 > tEnter ? t0 : tEnter;
+    tExit = t1 < tExit ? t1 : tExit;
+    if (tEnter > tExit)
+      {
+      return 0;
+      }
+    }
+
+  int voxel[3];
+  int step[3];
+  double tMax[3];
+  double tDelta[3];
+  for (int i = 0; i < 3; i++)
+    {
+    double position = start[i] + tEnter * direction[i];
+    voxel[i] = static_cast<int>(std::floor(position));
+    voxel[i] = voxel[i] < 0 ? 0 :
+      (voxel[i] >= this->Dimensions[i] ? this->Dimensions[i] - 1 : voxel[i]);
+    if (direction[i] > 1e-12)
+      {
+      step[i] = 1;
+      tMax[i] = (voxel[i] + 1 - start[i]) / direction[i];
+      tDelta[i] = 1.0 / direction[i];
+      }
+    else if (direction[i] < -1e-12)
+      {
+      step[i] = -1;
+      tMax[i] = (voxel[i] - start[i]) / direction[i];
+      tDelta[i] = -1.0 / direction[i];
+      }
+    else
+      {
+      step[i] = 0;
+      tMax[i] = VTK_DOUBLE_MAX;
+      tDelta[i] = VTK_DOUBLE_MAX;
+      }
+    }
+
+  for (;;)
+    {
+    if (this->GetScalar(voxel[0], voxel[1], voxel[2]) != 0.0)
+      {
+      return 1;
+      }
+
+    int axis = 0;
+    if (tMax[1] < tMax[axis])
+      {
+      axis = 1;
+      }
+    if (tMax[2] < tMax[axis])
+      {
+      axis = 2;
+      }
+    if (tMax[axis] > tExit)
+      {
+      break;
+      }
+    voxel[axis] += step[axis];
+    if (voxel[axis] < 0 || voxel[axis] >= this->Dimensions[axis])
+      {
+      break;
+      }
+    tMax[axis] += tDelta[axis];
+    }
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+double vtkSlicerPathPlannerVolumeSampler::GetMinimumAlongSegment(const double p0[3],
+                                                                 const double p1[3],
+                                                                 double step) const
+{
+  double delta[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+  double length = std::sqrt(delta[0] * delta[0] + delta[1] * delta[1] + delta[2] * delta[2]);
+  if (step <= 0.0)
+    {
+    step = this->MinimumSpacing;
+    }
+
+  int numberOfSteps = static_cast<int>(std::ceil(length / step));
+  numberOfSteps = numberOfSteps > 0 ? numberOfSteps : 1;
+
+  double minimum = VTK_DOUBLE_MAX;
+  for (int n = 0; n <= numberOfSteps; n++)
+    {
+    double t = static_cast<double>(n) / numberOfSteps;
+    double point[3] = { p0[0] + t * delta[0], p0[1] + t * delta[1], p0[2] + t * delta[2] };
+    double value = this->GetValueLinear(point);
+    if (value < minimum)
+      {
+      minimum = value;
+      }
+    }
+  return minimum;
+}
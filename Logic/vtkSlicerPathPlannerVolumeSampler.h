@@ -0,0 +1,128 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+// .NAME vtkSlicerPathPlannerVolumeSampler - RAS sampling of a volume
+// .SECTION Description
+// Caches the scalar pointer and the RAS to IJK matrix of an image so that
+// worker threads can sample it concurrently. All the sampling methods are
+// const and do not touch the VTK pipeline. The image must not be modified
+// while a sampler built on it is in use.
+
+#ifndef __vtkSlicerPathPlannerVolumeSampler_h
+#define __vtkSlicerPathPlannerVolumeSampler_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+#include "vtkSlicerPathPlannerModuleLogicExport.h"
+
+class vtkImageData;
+class vtkMatrix4x4;
+class vtkMRMLVolumeNode;
+
+/// \ingroup Slicer_QtModules_PathPlanner
+class VTK_SLICER_PATHPLANNER_MODULE_LOGIC_EXPORT vtkSlicerPathPlannerVolumeSampler :
+  public vtkObject
+{
+public:
+  static vtkSlicerPathPlannerVolumeSampler *New();
+  vtkTypeMacro(vtkSlicerPathPlannerVolumeSampler, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Sample the image data of a volume node in world coordinates, through
+  /// the transforms of its parent chain (see
+  /// vtkSlicerPathPlannerLogic::GetWorldToIJKMatrix). A volume under a non
+  /// linear transform is not sampled: a warning is emitted and no image is
+  /// set.
+  void SetVolumeNode(vtkMRMLVolumeNode* volumeNode);
+
+  /// Sample an image whose voxel indices are given by rasToIJK.
+  /// The extent of the image must start at 0.
+  void SetImageData(vtkImageData* imageData, vtkMatrix4x4* rasToIJK);
+  vtkImageData* GetImageData();
+
+  /// Value returned when sampling outside of the image. Default is 0.
+  vtkSetMacro(OutsideValue, double);
+  vtkGetMacro(OutsideValue, double);
+
+  /// Return 1 if an image is set.
+  int IsValid() const;
+
+  /// Smallest voxel size in mm.
+  double GetMinimumSpacing() const;
+
+  void RASToIJK(const double ras[3], double ijk[3]) const;
+  void IJKToRAS(const double ijk[3], double ras[3]) const;
+
+  /// RAS bounding box of the image, voxels included.
+  void GetRASBounds(double bounds[6]) const;
+
+  /// Geometry of the sampled image. Dimensions are 0 when invalid.
+  void GetDimensions(int dimensions[3]) const;
+  void GetSpacing(double spacing[3]) const;
+  void GetRASToIJKMatrix(vtkMatrix4x4* rasToIJK) const;
+
+  /// Value of the voxel (i, j, k), which must be inside the image.
+  double GetVoxelValue(int i, int j, int k) const { return this->GetScalar(i, j, k); }
+
+  /// Value of the voxel containing ras.
+  double GetValueNearest(const double ras[3]) const;
+
+  /// Trilinear interpolation at ras.
+  double GetValueLinear(const double ras[3]) const;
+
+  /// Return 1 if the segment p0-p1 crosses at least one voxel with a non
+  /// zero value. Every voxel crossed by the segment is visited exactly once
+  /// (Amanatides & Woo traversal).
+  int SegmentIntersectsNonZero(const double p0[3], const double p1[3]) const;
+
+  /// Minimum of the interpolated value sampled every "step" mm along the
+  /// segment p0-p1, end points included.
+  double GetMinimumAlongSegment(const double p0[3], const double p1[3],
+                                double step) const;
+
+protected:
+  vtkSlicerPathPlannerVolumeSampler();
+  virtual ~vtkSlicerPathPlannerVolumeSampler();
+
+  double GetScalar(vtkIdType index) const;
+  double GetScalar(int i, int j, int k) const;
+
+  //BTX
+  vtkSmartPointer<vtkImageData> ImageData;
+  //ETX
+  double RASToIJKMatrix[3][4];
+  double IJKToRASMatrix[3][4];
+  double MinimumSpacing;
+  int Dimensions[3];
+  vtkIdType Increments[3];
+  void* Scalars;
+  int ScalarType;
+  double OutsideValue;
+
+private:
+  vtkSlicerPathPlannerVolumeSampler(const vtkSlicerPathPlannerVolumeSampler&); // Not implemented
+  void operator=(const vtkSlicerPathPlannerVolumeSampler&);               // Not implemented
+};
+
+#endif
@@ -0,0 +1,590 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerParallel.h"
+#include "vtkSlicerPathPlannerRobotKinematics.h"
+#include "vtkSlicerPathPlannerWorkspace.h"
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkIntArray.h>
+#include <vtkMath.h>
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+const char CacheMagic[4] = { 'P', 'P', 'W', 'S' };
+const int CacheVersion = 1;
+const int NumberOfBins = vtkSlicerPathPlannerWorkspace::NumberOfPitchBins *
+  vtkSlicerPathPlannerWorkspace::NumberOfYawBins;
+
+//----------------------------------------------------------------------------
+// 64-bit FNV-1a
+vtkTypeUInt64 HashString(const std::string& text)
+{
+  vtkTypeUInt64 hash = 14695981039346656037ULL;
+  for (std::string::size_type i = 0; i < text.size(); i++)
+    {
+    hash ^= static_cast<unsigned char>(text[i]);
+    hash *= 1099511628211ULL;
+    }
+  return hash;
+}
+
+//----------------------------------------------------------------------------
+// Bin of a direction given in robot coordinates, -1 if outside the limits
+int FindBin(const double direction[3], const double pitchRange[2],
+            const double yawRange[2])
+{
+  if (direction[2] <= 0.0)
+    {
+    return -1;
+    }
+  double pitch = vtkMath::DegreesFromRadians(std::asin(-direction[1]));
+  double yaw = vtkMath::DegreesFromRadians(std::atan2(direction[0], direction[2]));
+  if (pitch < pitchRange[0] || pitch > pitchRange[1] ||
+      yaw < yawRange[0] || yaw > yawRange[1])
+    {
+    return -1;
+    }
+  double pitchWidth = pitchRange[1] - pitchRange[0];
+  double yawWidth = yawRange[1] - yawRange[0];
+  int pitchBin = pitchWidth > 0.0 ? static_cast<int>(
+    (pitch - pitchRange[0]) / pitchWidth * vtkSlicerPathPlannerWorkspace::NumberOfPitchBins) : 0;
+  int yawBin = yawWidth > 0.0 ? static_cast<int>(
+    (yaw - yawRange[0]) / yawWidth * vtkSlicerPathPlannerWorkspace::NumberOfYawBins) : 0;
+  pitchBin = pitchBin < vtkSlicerPathPlannerWorkspace::NumberOfPitchBins ?
+    pitchBin : vtkSlicerPathPlannerWorkspace::NumberOfPitchBins - 1;
+  yawBin = yawBin < vtkSlicerPathPlannerWorkspace::NumberOfYawBins ?
+    yawBin : vtkSlicerPathPlannerWorkspace::NumberOfYawBins - 1;
+  return pitchBin * vtkSlicerPathPlannerWorkspace::NumberOfYawBins + yawBin;
+}
+
+//----------------------------------------------------------------------------
+struct ComputeFunctor
+{
+  double Origin[3];
+  int Dimensions[3];
+  double Spacing;
+  double XRange[2];
+  double YRange[2];
+  double DepthRange[2];
+  double Directions[NumberOfBins][3];
+  double BinRadius;
+  vtkTypeUInt64* Masks;
+  float* Cones;
+
+  // One call per row of voxels along x
+  void operator()(vtkIdType begin, vtkIdType end, int vtkNotUsed(threadId))
+  {
+    for (vtkIdType row = begin; row < end; row++)
+      {
+      int j = static_cast<int>(row % this->Dimensions[1]);
+      int k = static_cast<int>(row / this->Dimensions[1]);
+      double point[3];
+      point[1] = this->Origin[1] + j * this->Spacing;
+      point[2] = this->Origin[2] + k * this->Spacing;
+      vtkIdType voxel = row * this->Dimensions[0];
+      for (int i = 0; i < this->Dimensions[0]; i++, voxel++)
+        {
+        point[0] = this->Origin[0] + i * this->Spacing;
+        this->ComputeVoxel(point, this->Masks[voxel], this->Cones + 4 * voxel);
+        }
+      }
+  }
+
+  void ComputeVoxel(const double point[3], vtkTypeUInt64& mask, float* cone) const
+  {
+    mask = 0;
+    double axis[3] = { 0.0, 0.0, 0.0 };
+    for (int bin = 0; bin < NumberOfBins; bin++)
+      {
+      const double* direction = this->Directions[bin];
+      // Guide point on z = 0, tip on the point
+      double depth = point[2] / direction[2];
+      double x = point[0] - depth * direction[0];
+      double y = point[1] - depth * direction[1];
+      if (depth < this->DepthRange[0] || depth > this->DepthRange[1] ||
+          x < this->XRange[0] || x > this->XRange[1] ||
+          y < this->YRange[0] || y > this->YRange[1])
+        {
+        continue;
+        }
+      mask |= (static_cast<vtkTypeUInt64>(1) << bin);
+      axis[0] += direction[0];
+      axis[1] += direction[1];
+      axis[2] += direction[2];
+      }
+
+    cone[0] = cone[1] = cone[2] = cone[3] = 0.0f;
+    if (!mask)
+      {
+      return;
+      }
+    vtkMath::Normalize(axis);
+    double minimumCosine = 1.0;
+    for (int bin = 0; bin < NumberOfBins; bin++)
+      {
+      if (mask & (static_cast<vtkTypeUInt64>(1) << bin))
+        {
+        double cosine = vtkMath::Dot(axis, this->Directions[bin]);
+        minimumCosine = cosine < minimumCosine ? cosine : minimumCosine;
+        }
+      }
+    minimumCosine = minimumCosine > -1.0 ? minimumCosine : -1.0;
+    cone[0] = static_cast<float>(axis[0]);
+    cone[1] = static_cast<float>(axis[1]);
+    cone[2] = static_cast<float>(axis[2]);
+    cone[3] = static_cast<float>(
+      vtkMath::DegreesFromRadians(std::acos(minimumCosine)) + this->BinRadius);
+  }
+};
+
+//----------------------------------------------------------------------------
+struct FeasibilityFunctor
+{
+  const vtkSlicerPathPlannerWorkspace* Workspace;
+  const double* Segments;
+  int* Feasible;
+
+  void operator()(vtkIdType begin, vtkIdType end, int vtkNotUsed(threadId))
+  {
+    for (vtkIdType i = begin; i < end; i++)
+      {
+      this->Feasible[i] = this->Workspace->IsTrajectoryFeasible(
+        this->Segments + 6 * i, this->Segments + 6 * i + 3);
+      }
+  }
+};
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerPathPlannerWorkspace);
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerWorkspace::vtkSlicerPathPlannerWorkspace()
+{
+  this->Kinematics = vtkSlicerPathPlannerRobotKinematics::New();
+  this->Spacing = 2.5;
+  this->CacheDirectory = NULL;
+  this->LoadedFromCache = 0;
+  this->Origin[0] = this->Origin[1] = this->Origin[2] = 0.0;
+  this->Dimensions[0] = this->Dimensions[1] = this->Dimensions[2] = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerPathPlannerWorkspace::~vtkSlicerPathPlannerWorkspace()
+{
+  this->SetKinematics(NULL);
+  this->SetCacheDirectory(NULL);
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerWorkspace::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Kinematics: " << this->Kinematics << "\n";
+  os << indent << "Spacing: " << this->Spacing << "\n";
+  os << indent << "CacheDirectory: "
+     << (this->CacheDirectory ? this->CacheDirectory : "(none)") << "\n";
+  os << indent << "LoadedFromCache: " << this->LoadedFromCache << "\n";
+  os << indent << "Dimensions: " << this->Dimensions[0] << " " << this->Dimensions[1]
+     << " " << this->Dimensions[2] << "\n";
+}
+
+//----------------------------------------------------------------------------
+vtkCxxSetObjectMacro(vtkSlicerPathPlannerWorkspace, Kinematics,
+                     vtkSlicerPathPlannerRobotKinematics);
+
+//----------------------------------------------------------------------------
+std::string vtkSlicerPathPlannerWorkspace::GetSignature()
+{
+  std::stringstream signature;
+  signature.precision(17);
+  signature << "PathPlannerWorkspace " << CacheVersion
+            << " " << NumberOfPitchBins << "x" << NumberOfYawBins
+            << " " << this->Spacing << " "
+            << (this->Kinematics ? this->Kinematics->GetKinematicSignature() : "");
+  return signature.str();
+}
+
+//----------------------------------------------------------------------------
+std::string vtkSlicerPathPlannerWorkspace::GetParameterHash()
+{
+  std::stringstream hash;
+  hash << std::hex;
+  hash.width(16);
+  hash.fill('0');
+  hash << HashString(this->GetSignature());
+  return hash.str();
+}
+
+//----------------------------------------------------------------------------
+std::string vtkSlicerPathPlannerWorkspace::GetCacheFileName()
+{
+  if (!this->CacheDirectory || !*this->CacheDirectory)
+    {
+    return std::string();
+    }
+  return std::string(this->CacheDirectory) + "/PathPlannerWorkspace-" +
+    this->GetParameterHash() + ".bin";
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerWorkspace::Update()
+{
+  if (!this->Kinematics)
+    {
+    vtkErrorMacro(<< "Update: no kinematics");
+    return 0;
+    }
+
+  std::string signature = this->GetSignature();
+  if (signature == this->ComputedSignature)
+    {
+    return 1;
+    }
+
+  this->ComputeGrid();
+  vtkIdType numberOfVoxels = static_cast<vtkIdType>(this->Dimensions[0]) *
+    this->Dimensions[1] * this->Dimensions[2];
+  if (numberOfVoxels <= 0 || numberOfVoxels > 64 * 1024 * 1024)
+    {
+    vtkErrorMacro(<< "Update: invalid workspace grid of " << this->Dimensions[0] << "x"
+                  << this->Dimensions[1] << "x" << this->Dimensions[2]
+                  << " voxels, check the joint limits and the spacing");
+    this->Masks.clear();
+    this->Cones.clear();
+    this->ComputedSignature.clear();
+    return 0;
+    }
+
+  std::string fileName = this->GetCacheFileName();
+  this->LoadedFromCache = !fileName.empty() && this->ReadCache(fileName, signature);
+  if (!this->LoadedFromCache)
+    {
+    this->Compute();
+    if (!fileName.empty() && !this->WriteCache(fileName, signature))
+      {
+      vtkWarningMacro(<< "Update: could not write the workspace cache " << fileName);
+      }
+    }
+  this->ComputedSignature = signature;
+  this->Modified();
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerWorkspace::ComputeGrid()
+{
+  double xRange[2];
+  double yRange[2];
+  double pitchRange[2];
+  double yawRange[2];
+  double depthRange[2];
+  this->Kinematics->GetXRange(xRange);
+  this->Kinematics->GetYRange(yRange);
+  this->Kinematics->GetPitchRange(pitchRange);
+  this->Kinematics->GetYawRange(yawRange);
+  this->Kinematics->GetDepthRange(depthRange);
+
+  // Lateral reach of the needle from the guide: |sin| of the largest angle
+  double maximumPitch = std::fabs(pitchRange[0]) > std::fabs(pitchRange[1]) ?
+    std::fabs(pitchRange[0]) : std::fabs(pitchRange[1]);
+  double maximumYaw = std::fabs(yawRange[0]) > std::fabs(yawRange[1]) ?
+    std::fabs(yawRange[0]) : std::fabs(yawRange[1]);
+  double xReach = depthRange[1] *
+    (maximumYaw < 90.0 ? std::sin(vtkMath::RadiansFromDegrees(maximumYaw)) : 1.0);
+  double yReach = depthRange[1] *
+    (maximumPitch < 90.0 ? std::sin(vtkMath::RadiansFromDegrees(maximumPitch)) : 1.0);
+
+  double bounds[6] = { xRange[0] - xReach, xRange[1] + xReach,
+                       yRange[0] - yReach, yRange[1] + yReach,
+                       0.0, depthRange[1] };
+  for (int axis = 0; axis < 3; axis++)
+    {
+    this->Origin[axis] = bounds[2 * axis];
+    double extent = bounds[2 * axis + 1] - bounds[2 * axis];
+    this->Dimensions[axis] = extent >= 0.0 ?
+      static_cast<int>(std::ceil(extent / this->Spacing)) + 1 : 0;
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerWorkspace::Compute()
+{
+  ComputeFunctor functor;
+  for (int axis = 0; axis < 3; axis++)
+    {
+    functor.Origin[axis] = this->Origin[axis];
+    functor.Dimensions[axis] = this->Dimensions[axis];
+    }
+  functor.Spacing = this->Spacing;
+  this->Kinematics->GetXRange(functor.XRange);
+  this->Kinematics->GetYRange(functor.YRange);
+  this->Kinematics->GetDepthRange(functor.DepthRange);
+
+  double pitchRange[2];
+  double yawRange[2];
+  this->Kinematics->GetPitchRange(pitchRange);
+  this->Kinematics->GetYawRange(yawRange);
+  double pitchWidth = (pitchRange[1] - pitchRange[0]) / NumberOfPitchBins;
+  double yawWidth = (yawRange[1] - yawRange[0]) / NumberOfYawBins;
+  for (int pitchBin = 0; pitchBin < NumberOfPitchBins; pitchBin++)
+    {
+    for (int yawBin = 0; yawBin < NumberOfYawBins; yawBin++)
+      {
+      vtkSlicerPathPlannerRobotKinematics::GetNeedleDirection(
+        pitchRange[0] + (pitchBin + 0.5) * pitchWidth,
+        yawRange[0] + (yawBin + 0.5) * yawWidth,
+        functor.Directions[pitchBin * NumberOfYawBins + yawBin]);
+      }
+    }
+  // The cone must contain the whole bins, not only their centers
+  functor.BinRadius = 0.5 * std::sqrt(pitchWidth * pitchWidth + yawWidth * yawWidth);
+
+  vtkIdType numberOfVoxels = static_cast<vtkIdType>(this->Dimensions[0]) *
+    this->Dimensions[1] * this->Dimensions[2];
+  this->Masks.assign(numberOfVoxels, 0);
+  this->Cones.assign(4 * numberOfVoxels, 0.0f);
+  functor.Masks = &this->Masks[0];
+  functor.Cones = &this->Cones[0];
+
+  vtkIdType numberOfRows = static_cast<vtkIdType>(this->Dimensions[1]) * this->Dimensions[2];
+  vtkSlicerPathPlannerParallelFor(0, numberOfRows, 16, functor);
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerWorkspace::ReadCache(const std::string& fileName,
+                                             const std::string& signature)
+{
+  std::ifstream file(fileName.c_str(), std::ios::in | std::ios::binary);
+  if (!file)
+    {
+    return 0;
+    }
+
+  char magic[4];
+  int version = 0;
+  vtkTypeUInt64 signatureLength = 0;
+  file.read(magic, 4);
+  file.read(reinterpret_cast<char*>(&version), sizeof(version));
+  file.read(reinterpret_cast<char*>(&signatureLength), sizeof(signatureLength));
+  if (!file || std::string(magic, 4) != std::string(CacheMagic, 4) ||
+      version != CacheVersion || signatureLength != signature.size())
+    {
+    return 0;
+    }
+  // The signature guards against hash collisions
+  std::string storedSignature(signature.size(), '\0');
+  if (!signature.empty())
+    {
+    file.read(&storedSignature[0], signature.size());
+    }
+  int dimensions[3];
+  file.read(reinterpret_cast<char*>(dimensions), sizeof(dimensions));
+  if (!file || storedSignature != signature ||
+      dimensions[0] != this->Dimensions[0] || dimensions[1] != this->Dimensions[1] ||
+      dimensions[2] != this->Dimensions[2])
+    {
+    return 0;
+    }
+
+  vtkIdType numberOfVoxels = static_cast<vtkIdType>(this->Dimensions[0]) *
+    this->Dimensions[1] * this->Dimensions[2];
+  std::vector<vtkTypeUInt64> masks(numberOfVoxels);
+  std::vector<float> cones(4 * numberOfVoxels);
+  file.read(reinterpret_cast<char*>(&masks[0]), numberOfVoxels * sizeof(vtkTypeUInt64));
+  file.read(reinterpret_cast<char*>(&cones[0]), 4 * numberOfVoxels * sizeof(float));
+  if (!file)
+    {
+    return 0;
+    }
+  this->Masks.swap(masks);
+  this->Cones.swap(cones);
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerWorkspace::WriteCache(const std::string& fileName,
+                                              const std::string& signature)
+{
+  // Write to a temporary file first so that an interrupted write never
+  // leaves a truncated cache behind
+  std::string temporaryFileName = fileName + ".tmp";
+  std::ofstream file(temporaryFileName.c_str(),
+                     std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file)
+    {
+    return 0;
+    }
+  vtkTypeUInt64 signatureLength = signature.size();
+  file.write(CacheMagic, 4);
+  file.write(reinterpret_cast<const char*>(&CacheVersion), sizeof(CacheVersion));
+  file.write(reinterpret_cast<const char*>(&signatureLength), sizeof(signatureLength));
+  file.write(signature.c_str(), signature.size());
+  file.write(reinterpret_cast<const char*>(this->Dimensions), sizeof(this->Dimensions));
+  file.write(reinterpret_cast<const char*>(&this->Masks[0]),
+             this->Masks.size() * sizeof(vtkTypeUInt64));
+  file.write(reinterpret_cast<const char*>(&this->Cones[0]),
+             this->Cones.size() * sizeof(float));
+  file.close();
+  if (!file)
+    {
+    std::remove(temporaryFileName.c_str());
+    return 0;
+    }
+  std::remove(fileName.c_str());
+  return std::rename(temporaryFileName.c_str(), fileName.c_str()) == 0;
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkSlicerPathPlannerWorkspace::GetNumberOfReachableVoxels()
+{
+  vtkIdType count = 0;
+  for (std::vector<vtkTypeUInt64>::const_iterator it = this->Masks.begin();
+       it != this->Masks.end(); ++it)
+    {
+    count += (*it != 0);
+    }
+  return count;
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkSlicerPathPlannerWorkspace::FindVoxel(const double robot[3]) const
+{
+  if (this->Masks.empty())
+    {
+    return -1;
+    }
+  int index[3];
+  for (int axis = 0; axis < 3; axis++)
+    {
+    double position = (robot[axis] - this->Origin[axis]) / this->Spacing + 0.5;
+    if (position < 0.0 || position >= this->Dimensions[axis])
+      {
+      return -1;
+      }
+    index[axis] = static_cast<int>(position);
+    }
+  return (static_cast<vtkIdType>(index[2]) * this->Dimensions[1] + index[1]) *
+    this->Dimensions[0] + index[0];
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerWorkspace::IsTrajectoryFeasible(const double entry[3],
+                                                        const double target[3]) const
+{
+  if (!this->Kinematics)
+    {
+    return 0;
+    }
+  double robotTarget[3];
+  this->Kinematics->RASToRobot(target, robotTarget);
+  vtkIdType voxel = this->FindVoxel(robotTarget);
+  if (voxel < 0 || !this->Masks[voxel])
+    {
+    return 0;
+    }
+
+  double direction[3] = { target[0] - entry[0], target[1] - entry[1], target[2] - entry[2] };
+  double robotDirection[3];
+  this->Kinematics->RASToRobotDirection(direction, robotDirection);
+  if (vtkMath::Normalize(robotDirection) <= 0.0)
+    {
+    return 0;
+    }
+  int bin = FindBin(robotDirection, this->Kinematics->GetPitchRange(),
+                    this->Kinematics->GetYawRange());
+  return bin >= 0 && (this->Masks[voxel] & (static_cast<vtkTypeUInt64>(1) << bin)) != 0;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerPathPlannerWorkspace::EvaluateFeasibility(vtkDoubleArray* segments,
+                                                        vtkIntArray* feasible)
+{
+  if (!segments || !feasible || segments->GetNumberOfComponents() != 6)
+    {
+    vtkErrorMacro(<< "EvaluateFeasibility: invalid input arrays");
+    return;
+    }
+
+  vtkIdType numberOfTrajectories = segments->GetNumberOfTuples();
+  feasible->SetNumberOfComponents(1);
+  feasible->SetNumberOfTuples(numberOfTrajectories);
+  if (numberOfTrajectories == 0)
+    {
+    return;
+    }
+
+  FeasibilityFunctor functor;
+  functor.Workspace = this;
+  functor.Segments = segments->GetPointer(0);
+  functor.Feasible = feasible->GetPointer(0);
+  vtkSlicerPathPlannerParallelFor(0, numberOfTrajectories, 1024, functor);
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerWorkspace::GetOrientationCone(const double ras[3], double axis[3],
+                                                      double* halfAngle) const
+{
+  axis[0] = axis[1] = axis[2] = 0.0;
+  if (halfAngle)
+    {
+    *halfAngle = 0.0;
+    }
+  if (!this->Kinematics)
+    {
+    return 0;
+    }
+  double robot[3];
+  this->Kinematics->RASToRobot(ras, robot);
+  vtkIdType voxel = this->FindVoxel(robot);
+  if (voxel < 0 || !this->Masks[voxel])
+    {
+    return 0;
+    }
+
+  const float* cone = &this->Cones[4 * voxel];
+  double robotAxis[3] = { cone[0], cone[1], cone[2] };
+  double origin[3] = { 0.0, 0.0, 0.0 };
+  double rasOrigin[3];
+  this->Kinematics->RobotToRAS(origin, rasOrigin);
+  this->Kinematics->RobotToRAS(robotAxis, axis);
+  for (int i = 0; i < 3; i++)
+    {
+    axis[i] -= rasOrigin[i];
+    }
+  if (halfAngle)
+    {
+    *halfAngle = cone[3];
+    }
+  return 1;
+}
@@ -0,0 +1,154 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// .NAME vtkSlicerPathPlannerWorkspace - precomputed reachability of a needle guide robot
+// .SECTION Description
+// Samples, for every voxel of a grid in robot coordinates, the needle
+// directions with which the robot can put the tip on the voxel center.
+// Directions are binned on a NumberOfPitchBins x NumberOfYawBins grid
+// spanning the pitch and yaw limits; a direction is reachable when the
+// guide point and insertion depth of its bin center are within the
+// limits. Each voxel keeps the bitmask of its reachable bins and the
+// orientation cone (axis, half angle) enclosing them.
+//
+// The grid is in robot coordinates so that moving the robot base does not
+// invalidate it: feasibility of a trajectory is a change of frame and a
+// voxel lookup instead of an inverse kinematics solve. The result depends
+// only on the joint limits and the Spacing and is cached in CacheDirectory,
+// in a file named after a hash of these parameters.
+//
+// Lookups are accurate to a bin and a voxel; confirm the selected
+// trajectory with vtkSlicerPathPlannerRobotKinematics::InverseKinematics.
+
+#ifndef __vtkSlicerPathPlannerWorkspace_h
+#define __vtkSlicerPathPlannerWorkspace_h
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <string>
+#include <vector>
+
+#include "vtkSlicerPathPlannerModuleLogicExport.h"
+
+class vtkDoubleArray;
+class vtkIntArray;
+class vtkSlicerPathPlannerRobotKinematics;
+
+/// \ingroup Slicer_QtModules_PathPlanner
+class VTK_SLICER_PATHPLANNER_MODULE_LOGIC_EXPORT vtkSlicerPathPlannerWorkspace :
+  public vtkObject
+{
+public:
+  static vtkSlicerPathPlannerWorkspace *New();
+  vtkTypeMacro(vtkSlicerPathPlannerWorkspace, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  //BTX
+  enum
+  {
+    NumberOfPitchBins = 8,
+    NumberOfYawBins = 8
+  };
+  //ETX
+
+  /// Robot model. A default one is created.
+  void SetKinematics(vtkSlicerPathPlannerRobotKinematics* kinematics);
+  vtkGetObjectMacro(Kinematics, vtkSlicerPathPlannerRobotKinematics);
+
+  /// Voxel size (mm). Default is 2.5.
+  vtkSetClampMacro(Spacing, double, 0.1, 100.0);
+  vtkGetMacro(Spacing, double);
+
+  /// Directory of the cached workspaces. Caching is disabled when NULL or
+  /// empty (default).
+  vtkSetStringMacro(CacheDirectory);
+  vtkGetStringMacro(CacheDirectory);
+
+  /// Load or compute the workspace if the joint limits or the spacing
+  /// changed. Return 0 on failure.
+  int Update();
+
+  /// 1 if the last Update loaded the workspace from the cache.
+  vtkGetMacro(LoadedFromCache, int);
+
+  /// Hash of the joint limits and spacing, in hexadecimal.
+  std::string GetParameterHash();
+
+  /// File caching the workspace for the current parameters, empty if
+  /// there is no CacheDirectory.
+  std::string GetCacheFileName();
+
+  /// Grid in robot coordinates.
+  vtkGetVector3Macro(Origin, double);
+  vtkGetVector3Macro(Dimensions, int);
+  vtkIdType GetNumberOfReachableVoxels();
+
+  /// Return 1 if the robot can put the needle tip on "target" along the
+  /// line coming from "entry" (RAS). Update must have been called.
+  int IsTrajectoryFeasible(const double entry[3], const double target[3]) const;
+
+  /// Feasibility (0 or 1) of every trajectory of "segments" (6
+  /// components: entry RAS, target RAS). Runs in parallel.
+  void EvaluateFeasibility(vtkDoubleArray* segments, vtkIntArray* feasible);
+
+  /// Orientation cone of the voxel containing "ras": axis (RAS, unit) and
+  /// half angle (degrees). Return 0 if the point is not reachable.
+  int GetOrientationCone(const double ras[3], double axis[3], double* halfAngle) const;
+
+protected:
+  vtkSlicerPathPlannerWorkspace();
+  virtual ~vtkSlicerPathPlannerWorkspace();
+
+  std::string GetSignature();
+  void ComputeGrid();
+  void Compute();
+  int ReadCache(const std::string& fileName, const std::string& signature);
+  int WriteCache(const std::string& fileName, const std::string& signature);
+
+  /// Index of the voxel containing the robot point, -1 if outside.
+  vtkIdType FindVoxel(const double robot[3]) const;
+
+  vtkSlicerPathPlannerRobotKinematics* Kinematics;
+  double Spacing;
+  char* CacheDirectory;
+  int LoadedFromCache;
+
+  double Origin[3];
+  int Dimensions[3];
+
+  //BTX
+  std::string ComputedSignature;
+  // Reachable direction bins, bit (pitchBin * NumberOfYawBins + yawBin)
+  std::vector<vtkTypeUInt64> Masks;
+  // Cone axis (robot coordinates) and half angle (degrees) per voxel
+  std::vector<float> Cones;
+  //ETX
+
+private:
+  vtkSlicerPathPlannerWorkspace(const vtkSlicerPathPlannerWorkspace&); // Not implemented
+  void operator=(const vtkSlicerPathPlannerWorkspace&);               // Not implemented
+};
+
+#endif
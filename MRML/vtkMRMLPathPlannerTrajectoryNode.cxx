@@ -26,6 +26,59 @@
 #include "vtkMRMLAnnotationRulerNode.h"
 
 #include <vtkObjectFactory.h>
+#include <vtkPoints.h>
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+namespace
+{
+//----------------------------------------------------------------------------
+// Percent-encode the characters that cannot appear in an XML attribute,
+// as MRML does for node names, plus '&'.
+std::string EncodeAttributeValue(const std::string& value)
+{
+  std::string encoded;
+  for (size_t i = 0; i < value.size(); i++)
+    {
+    char c = value[i];
+    if (c != '\0' && strchr("%\"'<>& \t\n\r", c))
+      {
+      char code[4];
+      sprintf(code, "%%%02X", static_cast<unsigned char>(c));
+      encoded += code;
+      }
+    else
+      {
+      encoded += c;
+      }
+    }
+  return encoded;
+}
+
+//----------------------------------------------------------------------------
+std::string DecodeAttributeValue(const char* value)
+{
+  std::string decoded;
+  for (const char* c = value; *c; c++)
+    {
+    if (c[0] == '%' && isxdigit(c[1]) && isxdigit(c[2]))
+      {
+      char code[3] = { c[1], c[2], '\0' };
+      decoded += static_cast<char>(strtol(code, NULL, 16));
+      c += 2;
+      }
+    else
+      {
+      decoded += *c;
+      }
+    }
+  return decoded;
+}
+}
 
 //----------------------------------------------------------------------------
 vtkMRMLNodeNewMacro(vtkMRMLPathPlannerTrajectoryNode);
@@ -46,6 +99,22 @@ vtkMRMLPathPlannerTrajectoryNode::~vtkMRMLPathPlannerTrajectoryNode()
 void vtkMRMLPathPlannerTrajectoryNode::WriteXML(ostream& of, int nIndent)
 {
   Superclass::WriteXML(of, nIndent);
+
+  // Enough digits to read back the same doubles
+  std::streamsize precision = of.precision(17);
+  for (size_t i = 0; i < this->CurvedPaths.size(); i++)
+    {
+    of << " curvedPath" << i << "Name=\""
+       << EncodeAttributeValue(this->CurvedPaths[i].Name) << "\"";
+    of << " curvedPath" << i << "Points=\"";
+    const std::vector<double>& points = this->CurvedPaths[i].Points;
+    for (size_t j = 0; j < points.size(); j++)
+      {
+      of << (j ? " " : "") << points[j];
+      }
+    of << "\"";
+    }
+  of.precision(precision);
 }
 
 
@@ -53,12 +122,65 @@ void vtkMRMLPathPlannerTrajectoryNode::WriteXML(ostream& of, int nIndent)
 void vtkMRMLPathPlannerTrajectoryNode::ReadXMLAttributes(const char** atts)
 {
   Superclass::ReadXMLAttributes(atts);
+
+  this->CurvedPaths.clear();
+
+  // Every curved path has at least one attribute, which bounds the index
+  long numberOfAttributes = 0;
+  while (atts[2 * numberOfAttributes] != NULL)
+    {
+    ++numberOfAttributes;
+    }
+
+  const char* attName;
+  const char* attValue;
+  while (*atts != NULL)
+    {
+    attName = *(atts++);
+    attValue = *(atts++);
+    if (strncmp(attName, "curvedPath", 10) != 0)
+      {
+      continue;
+      }
+    char* suffix = NULL;
+    long index = strtol(attName + 10, &suffix, 10);
+    if (suffix == attName + 10 || index < 0 || index >= numberOfAttributes)
+      {
+      vtkWarningMacro(<< "ReadXMLAttributes: ignoring " << attName);
+      continue;
+      }
+    if (this->CurvedPaths.size() <= static_cast<size_t>(index))
+      {
+      this->CurvedPaths.resize(index + 1);
+      }
+    if (!strcmp(suffix, "Name"))
+      {
+      this->CurvedPaths[index].Name = DecodeAttributeValue(attValue);
+      }
+    else if (!strcmp(suffix, "Points"))
+      {
+      std::stringstream ss(attValue);
+      double value;
+      this->CurvedPaths[index].Points.clear();
+      while (ss >> value)
+        {
+        this->CurvedPaths[index].Points.push_back(value);
+        }
+      }
+    }
 }
 
 //----------------------------------------------------------------------------
 void vtkMRMLPathPlannerTrajectoryNode::Copy(vtkMRMLNode *anode)
 {
   Superclass::Copy(anode);
+
+  vtkMRMLPathPlannerTrajectoryNode* node =
+    vtkMRMLPathPlannerTrajectoryNode::SafeDownCast(anode);
+  if (node)
+    {
+    this->CurvedPaths = node->CurvedPaths;
+    }
 }
 
 //-----------------------------------------------------------
@@ -74,3 +196,77 @@ void vtkMRMLPathPlannerTrajectoryNode::ProcessMRMLEvents ( vtkObject *caller,
 {
   Superclass::ProcessMRMLEvents(caller, event, callData);
 }
+
+//----------------------------------------------------------------------------
+int vtkMRMLPathPlannerTrajectoryNode::AddCurvedPath(const char* name, vtkPoints* points)
+{
+  CurvedPath path;
+  path.Name = name ? name : "";
+  if (points)
+    {
+    path.Points.resize(3 * points->GetNumberOfPoints());
+    for (vtkIdType i = 0; i < points->GetNumberOfPoints(); i++)
+      {
+      points->GetPoint(i, &path.Points[3 * i]);
+      }
+    }
+  this->CurvedPaths.push_back(path);
+  this->Modified();
+  return static_cast<int>(this->CurvedPaths.size()) - 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLPathPlannerTrajectoryNode::GetNumberOfCurvedPaths()
+{
+  return static_cast<int>(this->CurvedPaths.size());
+}
+
+//----------------------------------------------------------------------------
+const char* vtkMRMLPathPlannerTrajectoryNode::GetNthCurvedPathName(int n)
+{
+  if (n < 0 || n >= static_cast<int>(this->CurvedPaths.size()))
+    {
+    return NULL;
+    }
+  return this->CurvedPaths[n].Name.c_str();
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLPathPlannerTrajectoryNode::GetNthCurvedPathPoints(int n, vtkPoints* points)
+{
+  if (!points)
+    {
+    return;
+    }
+  points->Reset();
+  if (n < 0 || n >= static_cast<int>(this->CurvedPaths.size()))
+    {
+    return;
+    }
+  const std::vector<double>& pathPoints = this->CurvedPaths[n].Points;
+  for (size_t i = 0; i + 2 < pathPoints.size(); i += 3)
+    {
+    points->InsertNextPoint(&pathPoints[i]);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLPathPlannerTrajectoryNode::RemoveNthCurvedPath(int n)
+{
+  if (n < 0 || n >= static_cast<int>(this->CurvedPaths.size()))
+    {
+    return;
+    }
+  this->CurvedPaths.erase(this->CurvedPaths.begin() + n);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLPathPlannerTrajectoryNode::RemoveAllCurvedPaths()
+{
+  if (!this->CurvedPaths.empty())
+    {
+    this->CurvedPaths.clear();
+    this->Modified();
+    }
+}
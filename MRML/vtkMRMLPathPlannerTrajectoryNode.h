@@ -26,10 +26,15 @@
 #include "vtkSlicerPathPlannerModuleMRMLExport.h"
 #include "vtkMRMLAnnotationHierarchyNode.h" 
 
+// STD includes
+#include <string>
+#include <vector>
+
 class vtkMRMLNode;
 class vtkMRMLScene;
 class vtkMRMLAnnotationFiducialNode;
 class vtkMRMLAnnotationRulerNode;
+class vtkPoints;
 
 class  VTK_SLICER_PATHPLANNER_MODULE_MRML_EXPORT vtkMRMLPathPlannerTrajectoryNode : public vtkMRMLAnnotationHierarchyNode
 {
@@ -68,6 +73,21 @@ public:
                                    unsigned long /*event*/, 
                                    void * /*callData*/ );
 
+  //--------------------------------------------------------------------------
+  // Curved trajectories
+  //--------------------------------------------------------------------------
+
+  // Description:
+  // Polyline trajectories (steerable needles), stored alongside the
+  // straight rulers and saved with the scene. Points go from the entry to
+  // the target. AddCurvedPath returns the index of the new path.
+  int AddCurvedPath(const char* name, vtkPoints* points);
+  int GetNumberOfCurvedPaths();
+  const char* GetNthCurvedPathName(int n);
+  void GetNthCurvedPathPoints(int n, vtkPoints* points);
+  void RemoveNthCurvedPath(int n);
+  void RemoveAllCurvedPaths();
+
 protected:
   vtkMRMLPathPlannerTrajectoryNode();
   ~vtkMRMLPathPlannerTrajectoryNode();
@@ -78,6 +98,15 @@ protected:
   typedef std::map<FiducialPair, vtkMRMLAnnotationRulerNode*> FiducialRuler;
 
   FiducialRuler RulerList;
+
+  //BTX
+  struct CurvedPath
+  {
+    std::string Name;
+    std::vector<double> Points;
+  };
+  std::vector<CurvedPath> CurvedPaths;
+  //ETX
 };
 
 #endif
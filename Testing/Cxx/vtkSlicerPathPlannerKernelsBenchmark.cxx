@@ -0,0 +1,651 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Laurent Chauvin, Brigham and Women's
+  Hospital. The project was supported by grants 5P01CA067165,
+  5R01CA124377, 5R01CA138586, 2R44DE019322, 7R01CA124377,
+  5R42CA137886, 8P41EB015898
+
+==============================================================================*/
+
+
+// Micro-benchmark of the planner kernels on fixed synthetic inputs: segment
+// length and angle metrics, voxel traversal, distance map sampling, closest
+// segment queries in the bounding volume hierarchy and top-k selection.
+// Throughput is reported in trajectories (queries for the hierarchy, scores
+// for the selection) per second, with the number of heap allocations made
+// through operator new by one run. Inputs are seeded so that the numbers of
+// two builds can be compared.
+//
+// Only operator new is counted. VTK data arrays allocate and grow with
+// malloc and realloc, and on Windows the allocations made inside the VTK
+// and module DLLs use their own operator new, not the one of this driver:
+// those allocations are not in the numbers.
+//
+// Usage: vtkSlicerPathPlannerKernelsBenchmark [numberOfThreads [numberOfRuns]]
+// Defaults to 1 thread, for reproducible numbers, and 5 runs of which the
+// fastest is reported.
+
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerDistanceMapCache.h"
+#include "vtkSlicerPathPlannerParallel.h"
+#include "vtkSlicerPathPlannerRandom.h"
+#include "vtkSlicerPathPlannerSegmentIndex.h"
+#include "vtkSlicerPathPlannerTrajectoryScorer.h"
+#include "vtkSlicerPathPlannerVolumeSampler.h"
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkIdList.h>
+#include <vtkImageData.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkMultiThreader.h>
+#include <vtkNew.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#if __cplusplus >= 201103L
+# define PATHPLANNER_THROW_BAD_ALLOC
+# define PATHPLANNER_THROW_NOTHING noexcept
+#else
+# define PATHPLANNER_THROW_BAD_ALLOC throw(std::bad_alloc)
+# define PATHPLANNER_THROW_NOTHING throw()
+#endif
+
+namespace
+{
+// Allocations are only counted during the single threaded counting run,
+// and only those made through the operators below
+bool CountAllocations = false;
+vtkTypeInt64 NumberOfAllocations = 0;
+
+//----------------------------------------------------------------------------
+void* Allocate(std::size_t size)
+{
+  if (CountAllocations)
+    {
+    ++NumberOfAllocations;
+    }
+  void* pointer = std::malloc(size > 0 ? size : 1);
+  if (!pointer)
+    {
+    throw std::bad_alloc();
+    }
+  return pointer;
+}
+}
+
+//----------------------------------------------------------------------------
+void* operator new(std::size_t size) PATHPLANNER_THROW_BAD_ALLOC
+{
+  return Allocate(size);
+}
+
+//----------------------------------------------------------------------------
+void* operator new[](std::size_t size) PATHPLANNER_THROW_BAD_ALLOC
+{
+  return Allocate(size);
+}
+
+//----------------------------------------------------------------------------
+void operator delete(void* pointer) PATHPLANNER_THROW_NOTHING
+{
+  std::free(pointer);
+}
+
+//----------------------------------------------------------------------------
+void operator delete[](void* pointer) PATHPLANNER_THROW_NOTHING
+{
+  std::free(pointer);
+}
+
+namespace
+{
+// Synthetic scene: a 160 mm cube of 1 mm voxels holding spherical critical
+// structures, entries on a 75 mm sphere around the center and targets
+// within 15 mm of it.
+const int VolumeSize = 160;
+const int NumberOfStructures = 24;
+const vtkIdType NumberOfTrajectories = 20000;
+const vtkIdType NumberOfQueries = 10000;
+const vtkIdType NumberOfScores = 1000000;
+const vtkIdType NumberOfBest = 100;
+const double SampleStep = 1.0;
+
+//----------------------------------------------------------------------------
+class Kernel
+{
+public:
+  Kernel(const char* name, vtkIdType size) : Name(name), Size(size) {}
+  virtual ~Kernel() {}
+
+  /// Run the kernel once and return a checksum of its output, which must
+  /// not depend on the number of threads.
+  virtual double Run() = 0;
+
+  /// Check the output of the last run. Return false on failure.
+  virtual bool Check() { return true; }
+
+  std::string Name;
+  vtkIdType Size;
+};
+
+//----------------------------------------------------------------------------
+struct LengthAngleFunctor
+{
+  const double* Segments;
+  double Axis[3];
+  double* Lengths;
+  double* Angles;
+
+  void operator()(vtkIdType begin, vtkIdType end, int vtkNotUsed(threadId))
+  {
+    for (vtkIdType i = begin; i < end; i++)
+      {
+      const double* segment = this->Segments + 6 * i;
+      double direction[3] = { segment[3] - segment[0],
+                              segment[4] - segment[1],
+                              segment[5] - segment[2] };
+      double length = vtkMath::Norm(direction);
+      this->Lengths[i] = length;
+      this->Angles[i] = length > 0.0 ?
+        vtkMath::DegreesFromRadians(std::acos(vtkMath::Dot(direction, this->Axis) / length)) : 0.0;
+      }
+  }
+};
+
+//----------------------------------------------------------------------------
+class LengthAngleKernel : public Kernel
+{
+public:
+  LengthAngleKernel(vtkDoubleArray* segments)
+    : Kernel("Length and angle", segments->GetNumberOfTuples()), Segments(segments)
+  {
+    this->Lengths.resize(this->Size);
+    this->Angles.resize(this->Size);
+  }
+
+  virtual double Run()
+  {
+    LengthAngleFunctor functor;
+    functor.Segments = this->Segments->GetPointer(0);
+    functor.Axis[0] = 0.0;
+    functor.Axis[1] = 0.0;
+    functor.Axis[2] = -1.0;
+    functor.Lengths = &this->Lengths[0];
+    functor.Angles = &this->Angles[0];
+    vtkSlicerPathPlannerParallelFor(0, this->Size, 4096, functor);
+
+    double checksum = 0.0;
+    for (vtkIdType i = 0; i < this->Size; i++)
+      {
+      checksum += this->Lengths[i] + this->Angles[i];
+      }
+    return checksum;
+  }
+
+  vtkDoubleArray* Segments;
+  std::vector<double> Lengths;
+  std::vector<double> Angles;
+};
+
+//----------------------------------------------------------------------------
+struct VoxelTraversalFunctor
+{
+  const double* Segments;
+  const vtkSlicerPathPlannerVolumeSampler* Structures;
+  int* Hits;
+
+  void operator()(vtkIdType begin, vtkIdType end, int vtkNotUsed(threadId))
+  {
+    for (vtkIdType i = begin; i < end; i++)
+      {
+      const double* segment = this->Segments + 6 * i;
+      this->Hits[i] = this->Structures->SegmentIntersectsNonZero(segment, segment + 3);
+      }
+  }
+};
+
+//----------------------------------------------------------------------------
+class VoxelTraversalKernel : public Kernel
+{
+public:
+  VoxelTraversalKernel(vtkDoubleArray* segments, vtkSlicerPathPlannerVolumeSampler* structures)
+    : Kernel("Voxel traversal", segments->GetNumberOfTuples()),
+      Segments(segments), Structures(structures)
+  {
+    this->Hits.resize(this->Size);
+  }
+
+  virtual double Run()
+  {
+    VoxelTraversalFunctor functor;
+    functor.Segments = this->Segments->GetPointer(0);
+    functor.Structures = this->Structures;
+    functor.Hits = &this->Hits[0];
+    vtkSlicerPathPlannerParallelFor(0, this->Size, 256, functor);
+
+    double checksum = 0.0;
+    for (vtkIdType i = 0; i < this->Size; i++)
+      {
+      checksum += this->Hits[i];
+      }
+    return checksum;
+  }
+
+  // Both outcomes must occur, or the inputs do not exercise the traversal
+  virtual bool Check()
+  {
+    vtkIdType numberOfHits = 0;
+    for (vtkIdType i = 0; i < this->Size; i++)
+      {
+      numberOfHits += this->Hits[i] ? 1 : 0;
+      }
+    return numberOfHits > 0 && numberOfHits < this->Size;
+  }
+
+  vtkDoubleArray* Segments;
+  vtkSlicerPathPlannerVolumeSampler* Structures;
+  std::vector<int> Hits;
+};
+
+//----------------------------------------------------------------------------
+struct DistanceSamplingFunctor
+{
+  const double* Segments;
+  const vtkSlicerPathPlannerVolumeSampler* Distances;
+  double* Clearances;
+
+  void operator()(vtkIdType begin, vtkIdType end, int vtkNotUsed(threadId))
+  {
+    for (vtkIdType i = begin; i < end; i++)
+      {
+      const double* segment = this->Segments + 6 * i;
+      this->Clearances[i] = this->Distances->GetMinimumAlongSegment(segment, segment + 3,
+                                                                    SampleStep);
+      }
+  }
+};
+
+//----------------------------------------------------------------------------
+class DistanceSamplingKernel : public Kernel
+{
+public:
+  DistanceSamplingKernel(vtkDoubleArray* segments, vtkSlicerPathPlannerVolumeSampler* distances)
+    : Kernel("Distance map sampling", segments->GetNumberOfTuples()),
+      Segments(segments), Distances(distances)
+  {
+    this->Clearances.resize(this->Size);
+  }
+
+  virtual double Run()
+  {
+    DistanceSamplingFunctor functor;
+    functor.Segments = this->Segments->GetPointer(0);
+    functor.Distances = this->Distances;
+    functor.Clearances = &this->Clearances[0];
+    vtkSlicerPathPlannerParallelFor(0, this->Size, 256, functor);
+
+    double checksum = 0.0;
+    for (vtkIdType i = 0; i < this->Size; i++)
+      {
+      checksum += this->Clearances[i];
+      }
+    return checksum;
+  }
+
+  vtkDoubleArray* Segments;
+  vtkSlicerPathPlannerVolumeSampler* Distances;
+  std::vector<double> Clearances;
+};
+
+//----------------------------------------------------------------------------
+class HierarchyKernel : public Kernel
+{
+public:
+  HierarchyKernel(vtkDoubleArray* segments, vtkDoubleArray* queries)
+    : Kernel("Hierarchy closest segment", queries->GetNumberOfTuples()),
+      Segments(segments), Queries(queries)
+  {
+    const double* points = segments->GetPointer(0);
+    for (vtkIdType i = 0; i < segments->GetNumberOfTuples(); i++)
+      {
+      this->Index->SetSegment(i, points + 6 * i, points + 6 * i + 3);
+      }
+    this->Closest.resize(this->Size);
+    this->Distances.resize(this->Size);
+  }
+
+  // The index is not thread safe: queries run one after the other
+  virtual double Run()
+  {
+    const double* points = this->Queries->GetPointer(0);
+    double checksum = 0.0;
+    for (vtkIdType i = 0; i < this->Size; i++)
+      {
+      this->Closest[i] = this->Index->FindClosestSegment(points + 3 * i, &this->Distances[i]);
+      checksum += this->Distances[i];
+      }
+    return checksum;
+  }
+
+  // Compare the first queries with an exhaustive search
+  virtual bool Check()
+  {
+    const double* points = this->Queries->GetPointer(0);
+    const double* segments = this->Segments->GetPointer(0);
+    for (vtkIdType i = 0; i < 100 && i < this->Size; i++)
+      {
+      double minimum = VTK_DOUBLE_MAX;
+      for (vtkIdType j = 0; j < this->Segments->GetNumberOfTuples(); j++)
+        {
+        double distance = vtkSlicerPathPlannerSegmentIndex::SegmentDistance(
+          points + 3 * i, points + 3 * i, segments + 6 * j, segments + 6 * j + 3);
+        minimum = distance < minimum ? distance : minimum;
+        }
+      if (this->Closest[i] < 0 || std::fabs(this->Distances[i] - minimum) > 1e-9)
+        {
+        std::cerr << "Query " << i << ": closest segment at " << this->Distances[i]
+                  << " instead of " << minimum << std::endl;
+        return false;
+        }
+      }
+    return true;
+  }
+
+  vtkDoubleArray* Segments;
+  vtkDoubleArray* Queries;
+  vtkNew<vtkSlicerPathPlannerSegmentIndex> Index;
+  std::vector<vtkIdType> Closest;
+  std::vector<double> Distances;
+};
+
+//----------------------------------------------------------------------------
+class TopKKernel : public Kernel
+{
+public:
+  TopKKernel(vtkDoubleArray* scores)
+    : Kernel("Top-k selection", scores->GetNumberOfTuples()), Scores(scores)
+  {
+  }
+
+  virtual double Run()
+  {
+    vtkSlicerPathPlannerTrajectoryScorer::SelectBest(this->Scores, NumberOfBest,
+                                                     this->Order.GetPointer());
+    double checksum = 0.0;
+    for (vtkIdType i = 0; i < this->Order->GetNumberOfIds(); i++)
+      {
+      checksum += this->Order->GetId(i);
+      }
+    return checksum;
+  }
+
+  // Best first, no NaN, and no score left out is above the last one kept
+  virtual bool Check()
+  {
+    if (this->Order->GetNumberOfIds() != NumberOfBest)
+      {
+      return false;
+      }
+    const double* scores = this->Scores->GetPointer(0);
+    std::vector<bool> selected(this->Size, false);
+    for (vtkIdType i = 0; i < NumberOfBest; i++)
+      {
+      vtkIdType id = this->Order->GetId(i);
+      selected[id] = true;
+      if (vtkMath::IsNan(scores[id]) ||
+          (i > 0 && scores[id] > scores[this->Order->GetId(i - 1)]))
+        {
+        return false;
+        }
+      }
+    double last = scores[this->Order->GetId(NumberOfBest - 1)];
+    for (vtkIdType i = 0; i < this->Size; i++)
+      {
+      if (!selected[i] && scores[i] > last)
+        {
+        return false;
+        }
+      }
+    return true;
+  }
+
+  vtkDoubleArray* Scores;
+  vtkNew<vtkIdList> Order;
+};
+
+//----------------------------------------------------------------------------
+void CreateStructures(vtkImageData* image, vtkMatrix4x4* rasToIJK)
+{
+  image->SetDimensions(VolumeSize, VolumeSize, VolumeSize);
+  image->SetScalarTypeToUnsignedChar();
+  image->SetNumberOfScalarComponents(1);
+  image->AllocateScalars();
+  unsigned char* voxels = static_cast<unsigned char*>(image->GetScalarPointer());
+  const vtkIdType numberOfVoxels =
+    static_cast<vtkIdType>(VolumeSize) * VolumeSize * VolumeSize;
+  for (vtkIdType n = 0; n < numberOfVoxels; n++)
+    {
+    voxels[n] = 0;
+    }
+
+  // RAS origin at the center of the volume
+  rasToIJK->Identity();
+  for (int i = 0; i < 3; i++)
+    {
+    rasToIJK->SetElement(i, 3, 0.5 * (VolumeSize - 1));
+    }
+
+  vtkSlicerPathPlannerRandom random(1);
+  for (int s = 0; s < NumberOfStructures; s++)
+    {
+    double center[3];
+    for (int i = 0; i < 3; i++)
+      {
+      center[i] = random.NextUniform(20.0, VolumeSize - 20.0);
+      }
+    double radius = random.NextUniform(3.0, 10.0);
+    int bounds[6];
+    for (int i = 0; i < 3; i++)
+      {
+      bounds[2 * i] = vtkMath::Floor(center[i] - radius);
+      bounds[2 * i + 1] = vtkMath::Floor(center[i] + radius) + 1;
+      }
+    for (int k = bounds[4]; k <= bounds[5]; k++)
+      {
+      for (int j = bounds[2]; j <= bounds[3]; j++)
+        {
+        for (int i = bounds[0]; i <= bounds[1]; i++)
+          {
+          double ijk[3] = { static_cast<double>(i), static_cast<double>(j),
+                            static_cast<double>(k) };
+          if (vtkMath::Distance2BetweenPoints(ijk, center) <= radius * radius)
+            {
+            voxels[i + VolumeSize * (j + static_cast<vtkIdType>(VolumeSize) * k)] =
+              static_cast<unsigned char>(s + 1);
+            }
+          }
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void CreateSegments(vtkDoubleArray* segments)
+{
+  vtkSlicerPathPlannerRandom random(2);
+  segments->SetNumberOfComponents(6);
+  segments->SetNumberOfTuples(NumberOfTrajectories);
+  double* points = segments->GetPointer(0);
+  for (vtkIdType n = 0; n < NumberOfTrajectories; n++)
+    {
+    double direction[3] = { random.NextGaussian(), random.NextGaussian(),
+                            random.NextGaussian() };
+    if (vtkMath::Normalize(direction) == 0.0)
+      {
+      direction[2] = 1.0;
+      }
+    for (int i = 0; i < 3; i++)
+      {
+      points[6 * n + i] = 75.0 * direction[i];
+      points[6 * n + 3 + i] = random.NextUniform(-15.0, 15.0);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void CreateQueries(vtkDoubleArray* queries)
+{
+  vtkSlicerPathPlannerRandom random(3);
+  queries->SetNumberOfComponents(3);
+  queries->SetNumberOfTuples(NumberOfQueries);
+  double* points = queries->GetPointer(0);
+  for (vtkIdType n = 0; n < 3 * NumberOfQueries; n++)
+    {
+    points[n] = random.NextUniform(-80.0, 80.0);
+    }
+}
+
+//----------------------------------------------------------------------------
+void CreateScores(vtkDoubleArray* scores)
+{
+  vtkSlicerPathPlannerRandom random(4);
+  scores->SetNumberOfComponents(1);
+  scores->SetNumberOfTuples(NumberOfScores);
+  double* values = scores->GetPointer(0);
+  for (vtkIdType n = 0; n < NumberOfScores; n++)
+    {
+    values[n] = random.NextUniform();
+    }
+  // Degenerate terms give NaN scores, which must never be selected first
+  for (vtkIdType n = 0; n < NumberOfScores; n += 997)
+    {
+    values[n] = vtkMath::Nan();
+    }
+}
+
+//----------------------------------------------------------------------------
+bool RunKernel(Kernel& kernel, int numberOfThreads, int numberOfRuns)
+{
+  vtkMultiThreader::SetGlobalDefaultNumberOfThreads(numberOfThreads);
+  double checksum = kernel.Run();
+  double bestTime = VTK_DOUBLE_MAX;
+  bool stable = true;
+  for (int run = 0; run < numberOfRuns; run++)
+    {
+    double start = vtkTimerLog::GetUniversalTime();
+    double runChecksum = kernel.Run();
+    double time = vtkTimerLog::GetUniversalTime() - start;
+    bestTime = time < bestTime ? time : bestTime;
+    stable = stable && runChecksum == checksum;
+    }
+
+  // Allocations of one single threaded run, the thread pool excluded
+  vtkMultiThreader::SetGlobalDefaultNumberOfThreads(1);
+  NumberOfAllocations = 0;
+  CountAllocations = true;
+  double countedChecksum = kernel.Run();
+  CountAllocations = false;
+  stable = stable && countedChecksum == checksum;
+
+  double throughput = bestTime > 0.0 ? kernel.Size / bestTime : 0.0;
+  std::cout << std::left << std::setw(28) << kernel.Name << std::right
+            << std::setw(10) << kernel.Size
+            << std::setw(14) << std::fixed << std::setprecision(6) << bestTime
+            << std::setw(16) << std::setprecision(0) << throughput
+            << std::setw(14) << NumberOfAllocations << std::endl;
+
+  if (!stable)
+    {
+    std::cerr << kernel.Name << ": output depends on the run or the number of threads"
+              << std::endl;
+    return false;
+    }
+  if (!kernel.Check())
+    {
+    std::cerr << kernel.Name << ": invalid output" << std::endl;
+    return false;
+    }
+  return true;
+}
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerPathPlannerKernelsBenchmark(int argc, char* argv[])
+{
+  int numberOfThreads = argc > 1 ? atoi(argv[1]) : 1;
+  int numberOfRuns = argc > 2 ? atoi(argv[2]) : 5;
+  if (numberOfThreads <= 0)
+    {
+    numberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+    }
+  numberOfRuns = numberOfRuns > 0 ? numberOfRuns : 1;
+
+  vtkNew<vtkImageData> image;
+  vtkNew<vtkMatrix4x4> rasToIJK;
+  CreateStructures(image.GetPointer(), rasToIJK.GetPointer());
+  vtkNew<vtkSlicerPathPlannerVolumeSampler> structures;
+  structures->SetImageData(image.GetPointer(), rasToIJK.GetPointer());
+  vtkNew<vtkSlicerPathPlannerDistanceMapCache> distanceMaps;
+  vtkSlicerPathPlannerVolumeSampler* distances =
+    distanceMaps->GetDistanceMap(structures.GetPointer());
+  if (!distances)
+    {
+    std::cerr << "Failed to compute the distance map" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  vtkNew<vtkDoubleArray> segments;
+  CreateSegments(segments.GetPointer());
+  vtkNew<vtkDoubleArray> queries;
+  CreateQueries(queries.GetPointer());
+  vtkNew<vtkDoubleArray> scores;
+  CreateScores(scores.GetPointer());
+
+  std::cout << "Threads: " << numberOfThreads << ", runs: " << numberOfRuns << std::endl;
+  std::cout << std::left << std::setw(28) << "Kernel" << std::right
+            << std::setw(10) << "Items"
+            << std::setw(14) << "Best time (s)"
+            << std::setw(16) << "Items/s"
+            << std::setw(14) << "Allocations" << std::endl;
+
+  LengthAngleKernel lengthAngle(segments.GetPointer());
+  VoxelTraversalKernel voxelTraversal(segments.GetPointer(), structures.GetPointer());
+  DistanceSamplingKernel distanceSampling(segments.GetPointer(), distances);
+  HierarchyKernel hierarchy(segments.GetPointer(), queries.GetPointer());
+  TopKKernel topK(scores.GetPointer());
+  Kernel* kernels[] = { &lengthAngle, &voxelTraversal, &distanceSampling,
+                        &hierarchy, &topK };
+
+  bool success = true;
+  for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++)
+    {
+    success = RunKernel(*kernels[k], numberOfThreads, numberOfRuns) && success;
+    }
+
+  // Back to the default number of threads of the test driver
+  vtkMultiThreader::SetGlobalDefaultNumberOfThreads(0);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
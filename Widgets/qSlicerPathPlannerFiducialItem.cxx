@@ -23,6 +23,12 @@
 // SlicerQt includes
 #include "qSlicerPathPlannerFiducialItem.h"
 
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerLogic.h"
+
+// MRML includes
+#include "vtkMRMLTransformableNode.h"
+
 // --------------------------------------------------------------------------
 qSlicerPathPlannerFiducialItem
 ::qSlicerPathPlannerFiducialItem() : QTableWidgetItem()
@@ -43,7 +49,10 @@ setFiducialNode(vtkMRMLAnnotationFiducialNode* fiducialNode)
   if (fiducialNode)
     {
     qvtkReconnect(this->FiducialNode, fiducialNode, vtkCommand::ModifiedEvent,
-		  this, SLOT(updateItem()));
+		  this, SLOT(onFiducialModified()));
+    qvtkReconnect(this->FiducialNode, fiducialNode,
+                  vtkMRMLTransformableNode::TransformModifiedEvent,
+                  this, SLOT(onFiducialModified()));
     this->FiducialNode = fiducialNode;
     this->updateItem();
     }
@@ -56,6 +65,14 @@ getFiducialNode()
   return this->FiducialNode;
 }
 
+// --------------------------------------------------------------------------
+void qSlicerPathPlannerFiducialItem::
+onFiducialModified()
+{
+  this->updateItem();
+  emit fiducialModified();
+}
+
 // --------------------------------------------------------------------------
 void qSlicerPathPlannerFiducialItem::
 updateItem()
@@ -65,8 +82,9 @@ updateItem()
     return;
     }
 
-  double* targetPosition;
-  targetPosition = this->FiducialNode->GetFiducialCoordinates();
+  // World coordinates, as the trajectories and the plan
+  double targetPosition[3];
+  vtkSlicerPathPlannerLogic::GetFiducialWorldCoordinates(this->FiducialNode, targetPosition);
 
   double itemRow = this->row();
   QTableWidget* tableWidget = this->tableWidget();
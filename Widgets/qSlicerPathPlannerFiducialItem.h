@@ -55,6 +55,14 @@ class Q_SLICER_MODULE_PATHPLANNER_WIDGETS_EXPORT qSlicerPathPlannerFiducialItem
  public slots:
    void updateItem();
 
+ signals:
+   /// Emitted when the fiducial node is modified or moved by a transform,
+   /// after the item is updated
+   void fiducialModified();
+
+ protected slots:
+   void onFiducialModified();
+
  private:
   vtkMRMLAnnotationFiducialNode* FiducialNode;
 };
@@ -27,6 +27,9 @@
 // Annotation logic
 #include "vtkSlicerAnnotationModuleLogic.h"
 
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerLogic.h"
+
 // VTK includes
 #include "vtkMRMLAnnotationHierarchyNode.h"
 #include "vtkMRMLAnnotationPointDisplayNode.h"
@@ -209,6 +212,7 @@ void qSlicerPathPlannerTableWidget
 
   // Remove row from widget
   d->TableWidget->removeRow(selectedRow);
+  emit fiducialsEdited();
 }
 
 //-----------------------------------------------------------------------------
@@ -225,6 +229,7 @@ void qSlicerPathPlannerTableWidget
   d->TableWidget->clearContents();
   d->TableWidget->setRowCount(0);
   d->selectedHierarchyNode->RemoveAllChildrenNodes();
+  emit fiducialsEdited();
 }
 
 //-----------------------------------------------------------------------------
@@ -325,7 +330,9 @@ void qSlicerPathPlannerTableWidget
     return;
     }
 
-  currentFiducial->SetFiducialCoordinates(newFiducialCoordinates);
+  // The table shows world coordinates
+  vtkSlicerPathPlannerLogic::SetFiducialWorldCoordinates(currentFiducial, newFiducialCoordinates);
   // Update item
   //currentItem->updateItem();
+  emit fiducialsEdited();
 }
@@ -62,6 +62,11 @@ public slots:
   void onSelectionChanged();
   void onCellChanged(int row, int column);
 
+signals:
+  /// Emitted at the end of an edit of the list from the table: deletion,
+  /// clear or move of a point
+  void fiducialsEdited();
+
 protected:
   QScopedPointer<qSlicerPathPlannerTableWidgetPrivate> d_ptr;
   
@@ -24,10 +24,19 @@
 #include "qSlicerCoreApplication.h"
 #include "qSlicerPathPlannerTrajectoryItem.h"
 
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerLogic.h"
+
 // MRML includes
 #include "vtkMRMLAnnotationFiducialNode.h"
 #include "vtkMRMLAnnotationRulerNode.h"
 #include "vtkMRMLScene.h"
+#include "vtkMRMLTransformableNode.h"
+
+// STD includes
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
 
 // --------------------------------------------------------------------------
 qSlicerPathPlannerTrajectoryItem
@@ -36,6 +45,12 @@ qSlicerPathPlannerTrajectoryItem
   this->EntryPoint  = NULL;
   this->TargetPoint = NULL;
   this->Trajectory  = NULL;
+  for (int i = 0; i < 3; i++)
+    {
+    this->EntryLocal[i]  = this->TargetLocal[i] = 0.0;
+    this->EntryWorld[i]  = this->TargetWorld[i] = 0.0;
+    }
+  this->WorldPositionsValid = false;
 }
 
 // --------------------------------------------------------------------------
@@ -56,7 +71,11 @@ setEntryPoint(vtkMRMLAnnotationFiducialNode* entryPoint)
     {
     qvtkReconnect(this->EntryPoint, entryPoint, vtkCommand::ModifiedEvent,
                   this, SLOT(updateItem()));
+    qvtkReconnect(this->EntryPoint, entryPoint,
+                  vtkMRMLTransformableNode::TransformModifiedEvent,
+                  this, SLOT(onTransformModified()));
     this->EntryPoint = entryPoint;
+    this->WorldPositionsValid = false;
     this->updateItem();
     }
 }
@@ -76,7 +95,11 @@ setTargetPoint(vtkMRMLAnnotationFiducialNode* targetPoint)
     {
     qvtkReconnect(this->TargetPoint, targetPoint, vtkCommand::ModifiedEvent,
                   this, SLOT(updateItem()));
+    qvtkReconnect(this->TargetPoint, targetPoint,
+                  vtkMRMLTransformableNode::TransformModifiedEvent,
+                  this, SLOT(onTransformModified()));
     this->TargetPoint = targetPoint;
+    this->WorldPositionsValid = false;
     this->updateItem();
     }
 }
@@ -97,6 +120,7 @@ setTrajectory(vtkMRMLAnnotationRulerNode* trajectory)
     qvtkReconnect(this->Trajectory, trajectory, vtkCommand::ModifiedEvent,
                   this, SLOT(updateItem()));
     this->Trajectory = trajectory;
+    this->WorldPositionsValid = false;
     this->updateItem();
     }
 }
@@ -108,6 +132,43 @@ trajectoryNode()
   return this->Trajectory;
 }
 
+// --------------------------------------------------------------------------
+void qSlicerPathPlannerTrajectoryItem::
+onTransformModified()
+{
+  // Parent transform changed (or was replaced): world positions are stale
+  this->WorldPositionsValid = false;
+  this->updateItem();
+}
+
+// --------------------------------------------------------------------------
+void qSlicerPathPlannerTrajectoryItem::
+updateWorldPositions()
+{
+  double entryLocal[3];
+  double targetLocal[3];
+  this->EntryPoint->GetFiducialCoordinates(entryLocal);
+  this->TargetPoint->GetFiducialCoordinates(targetLocal);
+
+  if (this->WorldPositionsValid &&
+      entryLocal[0] == this->EntryLocal[0] && entryLocal[1] == this->EntryLocal[1] &&
+      entryLocal[2] == this->EntryLocal[2] && targetLocal[0] == this->TargetLocal[0] &&
+      targetLocal[1] == this->TargetLocal[1] && targetLocal[2] == this->TargetLocal[2])
+    {
+    // Name or display changes only
+    return;
+    }
+
+  vtkSlicerPathPlannerLogic::GetFiducialWorldCoordinates(this->EntryPoint, this->EntryWorld);
+  vtkSlicerPathPlannerLogic::GetFiducialWorldCoordinates(this->TargetPoint, this->TargetWorld);
+  for (int i = 0; i < 3; i++)
+    {
+    this->EntryLocal[i] = entryLocal[i];
+    this->TargetLocal[i] = targetLocal[i];
+    }
+  this->WorldPositionsValid = true;
+}
+
 
 // --------------------------------------------------------------------------
 void qSlicerPathPlannerTrajectoryItem::
@@ -125,16 +186,75 @@ updateItem()
     this->Trajectory = vtkMRMLAnnotationRulerNode::New();
     }
 
-  // Set ruler points
+  // Set ruler points from the world positions of the fiducials
   // Convention: Point1 -> Entry Point
   //             Point2 -> Target Point
-  double targetPosition[3];
-  double entryPosition[3];
-  this->TargetPoint->GetFiducialCoordinates(targetPosition);
-  this->EntryPoint->GetFiducialCoordinates(entryPosition);
+  this->updateWorldPositions();
+  double* entryPosition = this->EntryWorld;
+  double* targetPosition = this->TargetWorld;
+
+  // Probabilities and predictions no longer hold once the trajectory moved
+  double* rulerEntry = this->Trajectory->GetPosition1();
+  double* rulerTarget = this->Trajectory->GetPosition2();
+  bool moved = !rulerEntry || !rulerTarget ||
+    rulerEntry[0] != entryPosition[0] || rulerEntry[1] != entryPosition[1] ||
+    rulerEntry[2] != entryPosition[2] || rulerTarget[0] != targetPosition[0] ||
+    rulerTarget[1] != targetPosition[1] || rulerTarget[2] != targetPosition[2];
+  if (moved && rulerEntry && rulerTarget)
+    {
+    this->Trajectory->RemoveAttribute(
+      vtkSlicerPathPlannerLogic::GetSuccessProbabilityAttributeName());
+    this->Trajectory->RemoveAttribute(
+      vtkSlicerPathPlannerLogic::GetHitProbabilityAttributeName());
+    this->Trajectory->RemoveAttribute(
+      vtkSlicerPathPlannerLogic::GetPredictedTipSegmentAttributeName());
+    this->Trajectory->RemoveAttribute(
+      vtkSlicerPathPlannerLogic::GetPredictedDeviationAttributeName());
+    this->Trajectory->RemoveAttribute(
+      vtkSlicerPathPlannerLogic::GetPredictedPathAttributeName());
+    this->Trajectory->RemoveAttribute(
+      vtkSlicerPathPlannerLogic::GetPredictionStiffnessAttributeName());
+    this->Trajectory->RemoveAttribute(
+      vtkSlicerPathPlannerLogic::GetRobotWorkspaceReachableAttributeName());
+    this->Trajectory->RemoveAttribute(
+      vtkSlicerPathPlannerLogic::GetRobotIKReachableAttributeName());
+    this->Trajectory->RemoveAttribute(
+      vtkSlicerPathPlannerLogic::GetRobotJointsAttributeName());
+    this->Trajectory->RemoveAttribute(
+      vtkSlicerPathPlannerLogic::GetWorstCaseClearanceAttributeName());
+    this->Trajectory->RemoveAttribute(
+      vtkSlicerPathPlannerLogic::GetWorstCaseRiskAttributeName());
+    this->Trajectory->RemoveAttribute(
+      vtkSlicerPathPlannerLogic::GetWorstCasePhaseAttributeName());
+    this->Trajectory->RemoveAttribute(
+      vtkSlicerPathPlannerLogic::GetClearanceAttributeName());
+    this->Trajectory->RemoveAttribute(
+      vtkSlicerPathPlannerLogic::GetClearanceRiskAttributeName());
+    }
 
-  this->Trajectory->SetPosition1(entryPosition);
-  this->Trajectory->SetPosition2(targetPosition);
+  if (moved)
+    {
+    this->Trajectory->SetPosition1(entryPosition);
+    this->Trajectory->SetPosition2(targetPosition);
+    }
+
+  // Keep track of the fiducials the ruler is built from
+  const char* entryID = this->Trajectory->GetAttribute(
+    vtkSlicerPathPlannerLogic::GetEntryPointIDAttributeName());
+  if (this->EntryPoint->GetID() &&
+      (!entryID || strcmp(entryID, this->EntryPoint->GetID()) != 0))
+    {
+    this->Trajectory->SetAttribute(
+      vtkSlicerPathPlannerLogic::GetEntryPointIDAttributeName(), this->EntryPoint->GetID());
+    }
+  const char* targetID = this->Trajectory->GetAttribute(
+    vtkSlicerPathPlannerLogic::GetTargetPointIDAttributeName());
+  if (this->TargetPoint->GetID() &&
+      (!targetID || strcmp(targetID, this->TargetPoint->GetID()) != 0))
+    {
+    this->Trajectory->SetAttribute(
+      vtkSlicerPathPlannerLogic::GetTargetPointIDAttributeName(), this->TargetPoint->GetID());
+    }
 
   // Update table widget
   double itemRow = this->row();
@@ -167,4 +287,24 @@ updateItem()
   
   // -- Update target cell
   tableWidget->item(itemRow,2)->setText(this->EntryPoint->GetName()); 
+
+  // -- Update success cell
+  QTableWidgetItem* successItem = tableWidget->item(itemRow,3);
+  if (successItem)
+    {
+    const char* successProbability = this->Trajectory->GetAttribute(
+      vtkSlicerPathPlannerLogic::GetSuccessProbabilityAttributeName());
+    if (successProbability)
+      {
+      std::stringstream successText;
+      successText.precision(1);
+      successText.setf(std::ios::fixed);
+      successText << 100.0 * atof(successProbability) << " %";
+      successItem->setText(successText.str().c_str());
+      }
+    else
+      {
+      successItem->setText("");
+      }
+    }
 }
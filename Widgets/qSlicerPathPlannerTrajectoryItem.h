@@ -58,11 +58,24 @@ class Q_SLICER_MODULE_PATHPLANNER_WIDGETS_EXPORT qSlicerPathPlannerTrajectoryIte
 
  public slots:
    void updateItem();
+   void onTransformModified();
 
  private:
+  // Refresh the cached world positions if the transforms or the local
+  // coordinates changed since the last call.
+  void updateWorldPositions();
+
   vtkMRMLAnnotationFiducialNode* EntryPoint;
   vtkMRMLAnnotationFiducialNode* TargetPoint;
   vtkMRMLAnnotationRulerNode* Trajectory;
+
+  // World positions are only recomputed when a parent transform or the
+  // fiducial coordinates change
+  double EntryLocal[3];
+  double TargetLocal[3];
+  double EntryWorld[3];
+  double TargetWorld[3];
+  bool WorldPositionsValid;
 };
 
 #endif
@@ -21,7 +21,11 @@
 ==============================================================================*/
 
 // Qt includes
+#include <QApplication>
+#include <QCursor>
 #include <QDebug>
+#include <QFileInfo>
+#include <QTimer>
 
 // SlicerQt includes
 #include "qSlicerPathPlannerModuleWidget.h"
@@ -37,12 +41,28 @@
 #include "qSlicerPathPlannerFiducialItem.h"
 #include "qSlicerPathPlannerTrajectoryItem.h"
 
+// PathPlanner Logic includes
+#include "vtkSlicerPathPlannerDeviationMonitor.h"
+#include "vtkSlicerPathPlannerLogic.h"
+#include "vtkSlicerPathPlannerPlanDescription.h"
+#include "vtkSlicerPathPlannerPlanHistory.h"
+#include "vtkSlicerPathPlannerPlanJournal.h"
+#include "vtkSlicerPathPlannerPlanSync.h"
+#include "vtkSlicerPathPlannerTrackingLog.h"
+
 // MRML
 #include "vtkMRMLAnnotationFiducialNode.h"
 #include "vtkMRMLAnnotationHierarchyNode.h"
 #include "vtkMRMLAnnotationPointDisplayNode.h"
 #include "vtkMRMLAnnotationRulerNode.h"
 #include "vtkMRMLPathPlannerTrajectoryNode.h"
+#include "vtkMRMLScalarVolumeNode.h"
+
+// VTK includes
+#include "vtkCollection.h"
+#include "vtkDoubleArray.h"
+#include "vtkNew.h"
+#include "vtkSmartPointer.h"
 
 //-----------------------------------------------------------------------------
 /// \ingroup Slicer_QtModules_ExtensionTemplate
@@ -52,6 +72,24 @@ public:
   qSlicerPathPlannerModuleWidgetPrivate();
 
   vtkMRMLPathPlannerTrajectoryNode *selectedTrajectoryNode;
+
+  // Drains the deviation monitor while tracking
+  QTimer trackingTimer;
+  vtkSmartPointer<vtkDoubleArray> deviations;
+
+  // Sends or receives the plan changes
+  QTimer planSyncTimer;
+  bool planSyncSender;
+
+  // Queues the plan edits to the journal
+  QTimer planJournalTimer;
+
+  // Records the plan edits for undo: an operation is recorded when it
+  // ends. Fiducial edits made outside of the tables (placement, drag in
+  // the views) are recorded once they stop for a timer period, so that a
+  // drag is one step
+  QTimer planHistoryTimer;
+  int planEditDepth;
 };
 
 //-----------------------------------------------------------------------------
@@ -62,6 +100,37 @@ qSlicerPathPlannerModuleWidgetPrivate::
 qSlicerPathPlannerModuleWidgetPrivate()
 {
   this->selectedTrajectoryNode = NULL;
+  this->deviations = vtkSmartPointer<vtkDoubleArray>::New();
+  this->planSyncSender = false;
+  this->planEditDepth = 0;
+}
+
+//-----------------------------------------------------------------------------
+namespace
+{
+// Scope of an operation editing the plan. Nested operations, e.g. the MRML
+// and table events the operation triggers, are part of it: the edits are
+// recorded as one undo step when the outermost operation ends.
+class PlanEditOperation
+{
+public:
+  PlanEditOperation(qSlicerPathPlannerModuleWidget* widget, int& depth)
+    : Widget(widget), Depth(depth)
+  {
+    ++this->Depth;
+  }
+  ~PlanEditOperation()
+  {
+    if (--this->Depth == 0)
+      {
+      this->Widget->recordPlanEdits();
+      }
+  }
+
+private:
+  qSlicerPathPlannerModuleWidget* Widget;
+  int& Depth;
+};
 }
 
 //-----------------------------------------------------------------------------
@@ -79,6 +148,12 @@ qSlicerPathPlannerModuleWidget(QWidget* _parent)
 qSlicerPathPlannerModuleWidget::
 ~qSlicerPathPlannerModuleWidget()
 {
+  vtkSlicerPathPlannerLogic* pathPlannerLogic =
+    vtkSlicerPathPlannerLogic::SafeDownCast(this->logic());
+  if (pathPlannerLogic)
+    {
+    pathPlannerLogic->GetDeviationMonitor()->Stop();
+    }
 }
 
 //-----------------------------------------------------------------------------
@@ -96,6 +171,9 @@ setup()
   connect(d->EntryPointWidget->getTableWidget(), SIGNAL(itemSelectionChanged()),
 	  this, SLOT(onEntrySelectionChanged()));
 
+  connect(d->EntryPointWidget, SIGNAL(fiducialsEdited()),
+	  this, SLOT(recordPlanEdits()));
+
   // Target table widget
   connect(d->TargetPointListNodeSelector, SIGNAL(nodeActivated(vtkMRMLNode*)),
 	  this, SLOT(onTargetListNodeChanged(vtkMRMLNode*)));
@@ -103,6 +181,9 @@ setup()
   connect(d->TargetPointWidget->getTableWidget(), SIGNAL(itemSelectionChanged()),
 	  this, SLOT(onTargetSelectionChanged()));
 
+  connect(d->TargetPointWidget, SIGNAL(fiducialsEdited()),
+	  this, SLOT(recordPlanEdits()));
+
   // Trajectory table widget
   connect(d->TrajectoryListNodeSelector, SIGNAL(nodeActivated(vtkMRMLNode*)),
 	  this, SLOT(onTrajectoryListNodeChanged(vtkMRMLNode*)));
@@ -119,12 +200,51 @@ setup()
   connect(d->ClearButton, SIGNAL(clicked()),
 	  this, SLOT(onClearButtonClicked()));
 
+  connect(d->AnalyzeButton, SIGNAL(clicked()),
+	  this, SLOT(onAnalyzeButtonClicked()));
+
   connect(d->TrajectoryTableWidget, SIGNAL(cellClicked(int,int)),
 	  this, SLOT(onTrajectoryCellClicked(int,int)));
 
   connect(d->TrajectoryTableWidget, SIGNAL(cellChanged(int,int)),
 	  this, SLOT(onTrajectoryCellChanged(int,int)));
 
+  // Needle tracking, refreshed at 50 Hz whatever the tracker rate
+  connect(d->TrackingButton, SIGNAL(toggled(bool)),
+	  this, SLOT(onTrackingToggled(bool)));
+
+  d->trackingTimer.setInterval(20);
+  connect(&d->trackingTimer, SIGNAL(timeout()),
+	  this, SLOT(onTrackingTimeout()));
+
+  // Plan sync, edits are sent within a timer period
+  connect(d->PlanSyncButton, SIGNAL(toggled(bool)),
+	  this, SLOT(onPlanSyncToggled(bool)));
+
+  d->planSyncTimer.setInterval(20);
+  connect(&d->planSyncTimer, SIGNAL(timeout()),
+	  this, SLOT(onPlanSyncTimeout()));
+
+  // Plan journal, written by a background thread
+  connect(d->PlanJournalLineEdit, SIGNAL(editingFinished()),
+	  this, SLOT(onPlanJournalChanged()));
+
+  d->planJournalTimer.setInterval(100);
+  connect(&d->planJournalTimer, SIGNAL(timeout()),
+	  this, SLOT(onPlanJournalTimeout()));
+
+  // Undo and redo, one step per operation
+  connect(d->UndoButton, SIGNAL(clicked()),
+	  this, SLOT(onUndoButtonClicked()));
+
+  connect(d->RedoButton, SIGNAL(clicked()),
+	  this, SLOT(onRedoButtonClicked()));
+
+  d->planHistoryTimer.setInterval(500);
+  d->planHistoryTimer.setSingleShot(true);
+  connect(&d->planHistoryTimer, SIGNAL(timeout()),
+	  this, SLOT(recordPlanEdits()));
+
   // mrmlScene
   connect(this, SIGNAL(mrmlSceneChanged(vtkMRMLScene*)),
 	  this, SLOT(onMRMLSceneChanged(vtkMRMLScene*)));
@@ -167,6 +287,9 @@ onEntryListNodeChanged(vtkMRMLNode* newList)
 
   // Refresh view
   this->refreshEntryView();
+
+  // Edits of the previous list cannot be undone anymore
+  this->resetPlanHistory();
 }
 
 //-----------------------------------------------------------------------------
@@ -204,6 +327,9 @@ onTargetListNodeChanged(vtkMRMLNode* newList)
 
   // Refresh view
   this->refreshTargetView();
+
+  // Edits of the previous list cannot be undone anymore
+  this->resetPlanHistory();
 }
 
 //-----------------------------------------------------------------------------
@@ -247,6 +373,8 @@ addNewFiducialItem(QTableWidget* tableWidget, vtkMRMLAnnotationFiducialNode* fid
   tableWidget->setItem(numberOfItems, 3, new QTableWidgetItem());
   tableWidget->setItem(numberOfItems, 4, new QTableWidgetItem());
   newItem->setFiducialNode(fiducialNode);
+  connect(newItem, SIGNAL(fiducialModified()),
+          this, SLOT(onPlanEdited()));
 
   // Automatic scroll and select last item added
   tableWidget->scrollToItem(tableWidget->item(numberOfItems,1));
@@ -309,6 +437,9 @@ refreshEntryView()
       this->addNewFiducialItem(d->EntryPointWidget->getTableWidget(), fiducialPoint);
       }
     }
+
+  // Points added or removed, one by one when a list is cleared
+  this->onPlanEdited();
 }
 
 //-----------------------------------------------------------------------------
@@ -343,6 +474,9 @@ refreshTargetView()
       this->addNewFiducialItem(d->TargetPointWidget->getTableWidget(), fiducialPoint);
       }
     }
+
+  // Points added or removed, one by one when a list is cleared
+  this->onPlanEdited();
 }
 
 //-----------------------------------------------------------------------------
@@ -378,6 +512,9 @@ onTrajectoryListNodeChanged(vtkMRMLNode* newList)
 
   // TODO: Populate table with trajectory in new node
   // How to know which fiducials have been used to create ruler ?
+
+  // Edits of the previous list cannot be undone anymore
+  this->resetPlanHistory();
 }
 
 //-----------------------------------------------------------------------------
@@ -386,6 +523,9 @@ onAddButtonClicked()
 {
   Q_D(qSlicerPathPlannerModuleWidget);
 
+  // One undo step for the whole operation
+  PlanEditOperation operation(this, d->planEditDepth);
+
   if (!d->EntryPointWidget | !d->TargetPointWidget)
     {
     return;
@@ -455,6 +595,9 @@ onDeleteButtonClicked()
     return;
     }
 
+  // One undo step for the whole operation
+  PlanEditOperation operation(this, d->planEditDepth);
+
   // Remove ruler from scene
   qSlicerPathPlannerTrajectoryItem* itemToRemove =
     dynamic_cast<qSlicerPathPlannerTrajectoryItem*>(d->TrajectoryTableWidget->item(selectedRow,0));
@@ -485,6 +628,9 @@ onUpdateButtonClicked()
 {
   Q_D(qSlicerPathPlannerModuleWidget);
 
+  // One undo step for the whole operation
+  PlanEditOperation operation(this, d->planEditDepth);
+
   if (!d->TrajectoryTableWidget)
     {
     return;
@@ -557,6 +703,9 @@ onClearButtonClicked()
     return;
     }
 
+  // One undo step for the whole operation
+  PlanEditOperation operation(this, d->planEditDepth);
+
   // Clear hierarchy node and widget
   d->TrajectoryTableWidget->clearContents();
   d->TrajectoryTableWidget->setRowCount(0);
@@ -578,7 +727,66 @@ onClearButtonClicked()
 
 //-----------------------------------------------------------------------------
 void qSlicerPathPlannerModuleWidget::
-addNewRulerItem(vtkMRMLAnnotationFiducialNode* entryPoint, vtkMRMLAnnotationFiducialNode* targetPoint)
+onAnalyzeButtonClicked()
+{
+  Q_D(qSlicerPathPlannerModuleWidget);
+
+  vtkSlicerPathPlannerLogic* pathPlannerLogic =
+    vtkSlicerPathPlannerLogic::SafeDownCast(this->logic());
+  if (!pathPlannerLogic || !d->selectedTrajectoryNode)
+    {
+    return;
+    }
+
+  vtkMRMLScalarVolumeNode* criticalStructures =
+    vtkMRMLScalarVolumeNode::SafeDownCast(d->CriticalStructuresNodeSelector->currentNode());
+
+  QApplication::setOverrideCursor(QCursor(Qt::BusyCursor));
+  pathPlannerLogic->SetUsePredictedPaths(d->UsePredictedPathsCheckBox->isChecked());
+  if (pathPlannerLogic->GetUsePredictedPaths())
+    {
+    vtkMRMLScalarVolumeNode* tissueStiffness =
+      vtkMRMLScalarVolumeNode::SafeDownCast(d->TissueStiffnessNodeSelector->currentNode());
+    pathPlannerLogic->PredictNeedlePaths(d->selectedTrajectoryNode, tissueStiffness, NULL);
+    }
+  pathPlannerLogic->ComputeSuccessProbabilities(d->selectedTrajectoryNode, criticalStructures);
+  pathPlannerLogic->ComputeHitProbabilities(d->selectedTrajectoryNode);
+
+  // Seed dose, only the moved needles are recomputed
+  vtkMRMLScalarVolumeNode* implantTarget =
+    vtkMRMLScalarVolumeNode::SafeDownCast(d->ImplantTargetNodeSelector->currentNode());
+  double doseMetrics[3];
+  if (implantTarget &&
+      pathPlannerLogic->ComputeSeedDose(d->selectedTrajectoryNode, implantTarget, doseMetrics))
+    {
+    d->DoseMetricsLabel->setText(
+      QString("D90: %1 Gy   V100: %2 %   V150: %3 %")
+      .arg(doseMetrics[0], 0, 'f', 1)
+      .arg(100.0 * doseMetrics[1], 0, 'f', 1)
+      .arg(100.0 * doseMetrics[2], 0, 'f', 1));
+    }
+  else
+    {
+    d->DoseMetricsLabel->setText("");
+    }
+  QApplication::restoreOverrideCursor();
+
+  // Refresh success column
+  for (int i = 0; i < d->TrajectoryTableWidget->rowCount(); i++)
+    {
+    qSlicerPathPlannerTrajectoryItem* currentItem =
+      dynamic_cast<qSlicerPathPlannerTrajectoryItem*>(d->TrajectoryTableWidget->item(i,0));
+    if (currentItem)
+      {
+      currentItem->updateItem();
+      }
+    }
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerPathPlannerModuleWidget::
+addNewRulerItem(vtkMRMLAnnotationFiducialNode* entryPoint, vtkMRMLAnnotationFiducialNode* targetPoint,
+                const char* nodeID)
 {
   Q_D(qSlicerPathPlannerModuleWidget);
 
@@ -635,12 +843,18 @@ addNewRulerItem(vtkMRMLAnnotationFiducialNode* entryPoint, vtkMRMLAnnotationFidu
   d->TrajectoryTableWidget->setItem(rowCount, 0, newTrajectory);
   d->TrajectoryTableWidget->setItem(rowCount, 1, new QTableWidgetItem());
   d->TrajectoryTableWidget->setItem(rowCount, 2, new QTableWidgetItem());
+  d->TrajectoryTableWidget->setItem(rowCount, 3, new QTableWidgetItem());
 
   newTrajectory->setEntryPoint(entryPoint);
   newTrajectory->setTargetPoint(targetPoint);
 
   if (newTrajectory->trajectoryNode())
     {
+    // The scene keeps a requested ID if it is not in use
+    if (nodeID)
+      {
+      newTrajectory->trajectoryNode()->SetID(nodeID);
+      }
     newTrajectory->trajectoryNode()->Initialize(this->mrmlScene());
     newTrajectory->updateItem();
     }
@@ -648,6 +862,7 @@ addNewRulerItem(vtkMRMLAnnotationFiducialNode* entryPoint, vtkMRMLAnnotationFidu
   // Set only name editable
   d->TrajectoryTableWidget->item(rowCount,1)->setFlags(d->TrajectoryTableWidget->item(rowCount,1)->flags() & ~Qt::ItemIsEditable);
   d->TrajectoryTableWidget->item(rowCount,2)->setFlags(d->TrajectoryTableWidget->item(rowCount,2)->flags() & ~Qt::ItemIsEditable);
+  d->TrajectoryTableWidget->item(rowCount,3)->setFlags(d->TrajectoryTableWidget->item(rowCount,3)->flags() & ~Qt::ItemIsEditable);
 
   // Automatic scroll to last item added
   d->TrajectoryTableWidget->scrollToItem(d->TrajectoryTableWidget->item(rowCount,0));  
@@ -769,6 +984,8 @@ onMRMLSceneChanged(vtkMRMLScene* newScene)
   // Create new PathPlannerTrajectory Node
   vtkMRMLNode* newTrajectoryNode =
     d->TrajectoryListNodeSelector->addNode();
+
+  this->resetPlanHistory();
 }
 
 
@@ -863,6 +1080,9 @@ onTrajectoryCellChanged(int row, int column)
     return;
     }
 
+  // One undo step for the whole operation
+  PlanEditOperation operation(this, d->planEditDepth);
+
   // Get item
   qSlicerPathPlannerTrajectoryItem* currentItem =
     dynamic_cast<qSlicerPathPlannerTrajectoryItem*>(d->TrajectoryTableWidget->item(row,0));
@@ -885,3 +1105,610 @@ onTrajectoryCellChanged(int row, int column)
   // Update hierarchy node
   d->selectedTrajectoryNode->Modified();
 }
+
+//-----------------------------------------------------------------------------
+void qSlicerPathPlannerModuleWidget::
+onTrackingToggled(bool checked)
+{
+  Q_D(qSlicerPathPlannerModuleWidget);
+
+  vtkSlicerPathPlannerLogic* pathPlannerLogic =
+    vtkSlicerPathPlannerLogic::SafeDownCast(this->logic());
+  if (!pathPlannerLogic)
+    {
+    return;
+    }
+  vtkSlicerPathPlannerDeviationMonitor* monitor = pathPlannerLogic->GetDeviationMonitor();
+
+  vtkSlicerPathPlannerTrackingLog* trackingLog = pathPlannerLogic->GetTrackingLog();
+
+  if (!checked)
+    {
+    d->trackingTimer.stop();
+    monitor->Stop();
+    monitor->SetRecorder(NULL);
+    trackingLog->StopRecording();
+    return;
+    }
+
+  // Record the session along with the moves of the entry and target points
+  QString logFileName = d->TrackingLogLineEdit->text().trimmed();
+  if (!logFileName.isEmpty() &&
+      trackingLog->StartRecording(logFileName.toStdString().c_str()))
+    {
+    trackingLog->ObserveFiducials(vtkMRMLAnnotationHierarchyNode::SafeDownCast(
+      d->EntryPointListNodeSelector->currentNode()));
+    trackingLog->ObserveFiducials(vtkMRMLAnnotationHierarchyNode::SafeDownCast(
+      d->TargetPointListNodeSelector->currentNode()));
+    monitor->SetRecorder(trackingLog);
+    }
+
+  // A file is replayed in real time, anything else is host:port
+  QString source = d->TrackerSourceLineEdit->text().trimmed();
+  int started = 0;
+  if (QFileInfo(source).isFile())
+    {
+    started = monitor->ReplayFile(source.toStdString().c_str(), 1.0);
+    }
+  else
+    {
+    int separator = source.lastIndexOf(':');
+    bool validPort = false;
+    int port = source.mid(separator + 1).toInt(&validPort);
+    if (separator > 0 && validPort)
+      {
+      started = monitor->ConnectToServer(source.left(separator).toStdString().c_str(), port);
+      }
+    }
+
+  if (!started)
+    {
+    d->DeviationLabel->setText("Cannot open tracker source");
+    d->TrackingButton->setChecked(false);
+    return;
+    }
+  d->DeviationLabel->setText("Waiting for poses...");
+  this->onTrackingTimeout();
+  d->trackingTimer.start();
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerPathPlannerModuleWidget::
+onTrackingTimeout()
+{
+  Q_D(qSlicerPathPlannerModuleWidget);
+
+  vtkSlicerPathPlannerLogic* pathPlannerLogic =
+    vtkSlicerPathPlannerLogic::SafeDownCast(this->logic());
+  if (!pathPlannerLogic)
+    {
+    return;
+    }
+  vtkSlicerPathPlannerDeviationMonitor* monitor = pathPlannerLogic->GetDeviationMonitor();
+
+  // Select the trajectory the needle is following, if any
+  double tip[3];
+  double direction[3];
+  if (d->selectedTrajectoryNode && monitor->GetLastPose(tip, direction))
+    {
+    // Needles more than 30 degrees off are not following the trajectory
+    vtkMRMLAnnotationRulerNode* closestRuler =
+      pathPlannerLogic->FindClosestTrajectory(d->selectedTrajectoryNode, tip, direction, 30.0);
+    for (int i = 0; closestRuler && i < d->TrajectoryTableWidget->rowCount(); i++)
+      {
+      qSlicerPathPlannerTrajectoryItem* rowItem =
+        dynamic_cast<qSlicerPathPlannerTrajectoryItem*>(d->TrajectoryTableWidget->item(i,0));
+      if (rowItem && rowItem->trajectoryNode() == closestRuler)
+        {
+        if (i != d->TrajectoryTableWidget->currentRow())
+          {
+          d->TrajectoryTableWidget->setCurrentCell(i, 0);
+          }
+        break;
+        }
+      }
+    }
+
+  // Follow the selected trajectory, rulers hold world positions
+  int trajectoryRow = d->TrajectoryTableWidget->currentRow();
+  qSlicerPathPlannerTrajectoryItem* currentItem =
+    dynamic_cast<qSlicerPathPlannerTrajectoryItem*>(d->TrajectoryTableWidget->item(trajectoryRow,0));
+  vtkMRMLAnnotationRulerNode* currentRuler =
+    currentItem ? currentItem->trajectoryNode() : NULL;
+  if (currentRuler)
+    {
+    monitor->SetTrajectory(currentRuler->GetPosition1(), currentRuler->GetPosition2());
+    }
+
+  // Only the most recent deviation is shown
+  int numberOfDeviations = monitor->PopDeviations(d->deviations);
+  if (numberOfDeviations > 0)
+    {
+    const double* deviation = d->deviations->GetTuple(numberOfDeviations - 1);
+    d->DeviationLabel->setText(
+      QString("Lateral: %1 mm   Angle: %2 deg   Depth: %3 mm   Latency: %4 / %5 ms")
+      .arg(deviation[vtkSlicerPathPlannerDeviationMonitor::LateralComponent], 0, 'f', 1)
+      .arg(deviation[vtkSlicerPathPlannerDeviationMonitor::AngularComponent], 0, 'f', 1)
+      .arg(deviation[vtkSlicerPathPlannerDeviationMonitor::DepthComponent], 0, 'f', 1)
+      .arg(1000.0 * monitor->GetLatencyPercentile(50.0), 0, 'f', 1)
+      .arg(1000.0 * monitor->GetLatencyPercentile(99.0), 0, 'f', 1));
+    }
+  else if (!monitor->IsRunning())
+    {
+    // End of the replay or connection closed
+    d->TrackingButton->setChecked(false);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerPathPlannerModuleWidget::
+onPlanSyncToggled(bool checked)
+{
+  Q_D(qSlicerPathPlannerModuleWidget);
+
+  vtkSlicerPathPlannerLogic* pathPlannerLogic =
+    vtkSlicerPathPlannerLogic::SafeDownCast(this->logic());
+  if (!pathPlannerLogic)
+    {
+    return;
+    }
+  vtkSlicerPathPlannerPlanSync* planSync = pathPlannerLogic->GetPlanSync();
+
+  if (!checked)
+    {
+    d->planSyncTimer.stop();
+    planSync->Disconnect();
+    return;
+    }
+
+  // A port alone receives, host:port sends
+  QString address = d->PlanSyncLineEdit->text().trimmed();
+  int separator = address.lastIndexOf(':');
+  bool validPort = false;
+  int port = address.mid(separator + 1).toInt(&validPort);
+  d->planSyncSender = separator > 0;
+  int started = 0;
+  if (validPort && d->planSyncSender)
+    {
+    started = planSync->Connect(address.left(separator).toStdString().c_str(), port);
+    }
+  else if (validPort)
+    {
+    started = planSync->Listen(port);
+    }
+
+  if (!started)
+    {
+    d->PlanSyncButton->setChecked(false);
+    return;
+    }
+  this->onPlanSyncTimeout();
+  d->planSyncTimer.start();
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerPathPlannerModuleWidget::
+onPlanSyncTimeout()
+{
+  Q_D(qSlicerPathPlannerModuleWidget);
+
+  vtkSlicerPathPlannerLogic* pathPlannerLogic =
+    vtkSlicerPathPlannerLogic::SafeDownCast(this->logic());
+  if (!pathPlannerLogic)
+    {
+    return;
+    }
+  vtkSlicerPathPlannerPlanSync* planSync = pathPlannerLogic->GetPlanSync();
+
+  if (d->planSyncSender && this->describePlan(planSync) > 0)
+    {
+    planSync->SendDelta();
+    }
+  if (planSync->Poll() > 0)
+    {
+    this->applyPlanChanges(planSync);
+    }
+
+  // The receiver waits for a new sender, the sender stops
+  if (d->planSyncSender && !planSync->IsConnected())
+    {
+    d->PlanSyncButton->setChecked(false);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerPathPlannerModuleWidget::
+onPlanJournalChanged()
+{
+  Q_D(qSlicerPathPlannerModuleWidget);
+
+  vtkSlicerPathPlannerLogic* pathPlannerLogic =
+    vtkSlicerPathPlannerLogic::SafeDownCast(this->logic());
+  if (!pathPlannerLogic)
+    {
+    return;
+    }
+  vtkSlicerPathPlannerPlanJournal* planJournal = pathPlannerLogic->GetPlanJournal();
+
+  d->planJournalTimer.stop();
+  planJournal->Close();
+  QString fileName = d->PlanJournalLineEdit->text().trimmed();
+  if (fileName.isEmpty())
+    {
+    return;
+    }
+
+  // Recover the plan of a previous session, unless there is one already
+  vtkSlicerPathPlannerPlanSync* plan = planJournal->GetPlan();
+  this->describePlan(plan);
+  if (plan->GetNumberOfItems() == 0 && QFileInfo(fileName).size() > 0)
+    {
+    vtkSmartPointer<vtkSlicerPathPlannerPlanSync> recoveredPlan =
+      vtkSmartPointer<vtkSlicerPathPlannerPlanSync>::New();
+    if (vtkSlicerPathPlannerPlanJournal::Recover(fileName.toStdString().c_str(), recoveredPlan) > 0)
+      {
+      this->applyPlanChanges(recoveredPlan);
+      this->describePlan(plan);
+      }
+    }
+
+  if (planJournal->Open(fileName.toStdString().c_str()))
+    {
+    d->planJournalTimer.start();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerPathPlannerModuleWidget::
+onPlanJournalTimeout()
+{
+  vtkSlicerPathPlannerLogic* pathPlannerLogic =
+    vtkSlicerPathPlannerLogic::SafeDownCast(this->logic());
+  if (!pathPlannerLogic)
+    {
+    return;
+    }
+  vtkSlicerPathPlannerPlanJournal* planJournal = pathPlannerLogic->GetPlanJournal();
+
+  // The edits are only queued here
+  if (this->describePlan(planJournal->GetPlan()) > 0)
+    {
+    planJournal->Save();
+    }
+}
+
+//-----------------------------------------------------------------------------
+int qSlicerPathPlannerModuleWidget::
+describePlan(vtkSlicerPathPlannerPlanDescription* plan)
+{
+  Q_D(qSlicerPathPlannerModuleWidget);
+
+  plan->BeginUpdate();
+
+  // Entry and target points
+  QTableWidget* fiducialTables[2] =
+    { d->EntryPointWidget->getTableWidget(), d->TargetPointWidget->getTableWidget() };
+  int fiducialTypes[2] =
+    { vtkSlicerPathPlannerPlanDescription::EntryFiducial,
+      vtkSlicerPathPlannerPlanDescription::TargetFiducial };
+  for (int list = 0; list < 2; list++)
+    {
+    for (int i = 0; i < fiducialTables[list]->rowCount(); i++)
+      {
+      qSlicerPathPlannerFiducialItem* fiducialItem =
+        dynamic_cast<qSlicerPathPlannerFiducialItem*>(fiducialTables[list]->item(i,0));
+      vtkMRMLAnnotationFiducialNode* fiducialNode =
+        fiducialItem ? fiducialItem->getFiducialNode() : NULL;
+      if (fiducialNode)
+        {
+        double position[3];
+        vtkSlicerPathPlannerLogic::GetFiducialWorldCoordinates(fiducialNode, position);
+        plan->SetFiducial(fiducialNode->GetID(), fiducialTypes[list],
+                          fiducialNode->GetName(), position);
+        }
+      }
+    }
+
+  // Trajectories
+  for (int i = 0; i < d->TrajectoryTableWidget->rowCount(); i++)
+    {
+    qSlicerPathPlannerTrajectoryItem* rowItem =
+      dynamic_cast<qSlicerPathPlannerTrajectoryItem*>(d->TrajectoryTableWidget->item(i,0));
+    if (rowItem && rowItem->trajectoryNode() && rowItem->entryPoint() && rowItem->targetPoint())
+      {
+      plan->SetTrajectory(rowItem->trajectoryNode()->GetID(),
+                          rowItem->trajectoryNode()->GetName(),
+                          rowItem->entryPoint()->GetID(),
+                          rowItem->targetPoint()->GetID());
+      }
+    }
+
+  return plan->EndUpdate();
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerPathPlannerModuleWidget::
+applyPlanChanges(vtkSlicerPathPlannerPlanDescription* plan)
+{
+  Q_D(qSlicerPathPlannerModuleWidget);
+
+  vtkMRMLScene* scene = this->mrmlScene();
+  if (!scene)
+    {
+    return;
+    }
+
+  qSlicerAbstractCoreModule* annotationModule =
+    qSlicerCoreApplication::application()->moduleManager()->module("Annotations");
+  vtkSlicerAnnotationModuleLogic* annotationLogic = NULL;
+  if (annotationModule)
+    {
+    annotationLogic = 
+      vtkSlicerAnnotationModuleLogic::SafeDownCast(annotationModule->logic());
+    }
+
+  // One undo step for the whole operation
+  PlanEditOperation operation(this, d->planEditDepth);
+
+  // Remote items of a plan sync are mapped to the local nodes created for
+  // them. The items of the plan history are local nodes, restored with the
+  // same ID.
+  vtkSlicerPathPlannerPlanSync* remotePlan = vtkSlicerPathPlannerPlanSync::SafeDownCast(plan);
+  bool keepNodeIDs = remotePlan == NULL;
+  for (int n = 0; n < plan->GetNumberOfChanges(); n++)
+    {
+    const char* remoteID = plan->GetNthChangeID(n);
+    const char* localID = keepNodeIDs ? remoteID : remotePlan->GetLocalNodeID(remoteID);
+    vtkMRMLNode* localNode = localID ? scene->GetNodeByID(localID) : NULL;
+    int type = plan->GetNthChangeType(n);
+
+    if (type == vtkSlicerPathPlannerPlanDescription::Removed)
+      {
+      if (!localNode)
+        {
+        continue;
+        }
+      for (int i = 0; i < d->TrajectoryTableWidget->rowCount(); i++)
+        {
+        qSlicerPathPlannerTrajectoryItem* rowItem =
+          dynamic_cast<qSlicerPathPlannerTrajectoryItem*>(d->TrajectoryTableWidget->item(i,0));
+        if (rowItem && rowItem->trajectoryNode() == localNode)
+          {
+          d->TrajectoryTableWidget->removeRow(i);
+          break;
+          }
+        }
+      scene->RemoveNode(localNode);
+      if (remotePlan)
+        {
+        remotePlan->SetLocalNodeID(remoteID, NULL);
+        }
+      }
+    else if (type == vtkSlicerPathPlannerPlanDescription::Trajectory)
+      {
+      // The fiducials were applied first
+      const char* entryID = keepNodeIDs ? plan->GetNthChangeEntryID(n) :
+        remotePlan->GetLocalNodeID(plan->GetNthChangeEntryID(n));
+      const char* targetID = keepNodeIDs ? plan->GetNthChangeTargetID(n) :
+        remotePlan->GetLocalNodeID(plan->GetNthChangeTargetID(n));
+      vtkMRMLAnnotationFiducialNode* entryPoint = vtkMRMLAnnotationFiducialNode::SafeDownCast(
+        entryID ? scene->GetNodeByID(entryID) : NULL);
+      vtkMRMLAnnotationFiducialNode* targetPoint = vtkMRMLAnnotationFiducialNode::SafeDownCast(
+        targetID ? scene->GetNodeByID(targetID) : NULL);
+
+      vtkMRMLAnnotationRulerNode* rulerNode = vtkMRMLAnnotationRulerNode::SafeDownCast(localNode);
+      if (!rulerNode)
+        {
+        int rowCount = d->TrajectoryTableWidget->rowCount();
+        this->addNewRulerItem(entryPoint, targetPoint, keepNodeIDs ? remoteID : NULL);
+        if (d->TrajectoryTableWidget->rowCount() == rowCount)
+          {
+          continue;
+          }
+        qSlicerPathPlannerTrajectoryItem* newItem =
+          dynamic_cast<qSlicerPathPlannerTrajectoryItem*>(d->TrajectoryTableWidget->item(rowCount,0));
+        rulerNode = newItem ? newItem->trajectoryNode() : NULL;
+        if (!rulerNode)
+          {
+          continue;
+          }
+        if (remotePlan)
+          {
+          remotePlan->SetLocalNodeID(remoteID, rulerNode->GetID());
+          }
+        }
+      else if (entryPoint && targetPoint)
+        {
+        // Trajectory updated with other fiducials
+        for (int i = 0; i < d->TrajectoryTableWidget->rowCount(); i++)
+          {
+          qSlicerPathPlannerTrajectoryItem* rowItem =
+            dynamic_cast<qSlicerPathPlannerTrajectoryItem*>(d->TrajectoryTableWidget->item(i,0));
+          if (rowItem && rowItem->trajectoryNode() == rulerNode)
+            {
+            if (rowItem->entryPoint() != entryPoint)
+              {
+              rowItem->setEntryPoint(entryPoint);
+              }
+            if (rowItem->targetPoint() != targetPoint)
+              {
+              rowItem->setTargetPoint(targetPoint);
+              }
+            break;
+            }
+          }
+        }
+      rulerNode->SetName(plan->GetNthChangeName(n));
+      }
+    else
+      {
+      double position[3];
+      plan->GetNthChangePosition(n, position);
+      vtkMRMLAnnotationFiducialNode* fiducialNode =
+        vtkMRMLAnnotationFiducialNode::SafeDownCast(localNode);
+      if (!fiducialNode)
+        {
+        vtkMRMLNode* fiducialList = type == vtkSlicerPathPlannerPlanDescription::EntryFiducial ?
+          d->EntryPointListNodeSelector->currentNode() : d->TargetPointListNodeSelector->currentNode();
+        if (!fiducialList || !annotationLogic)
+          {
+          continue;
+          }
+        annotationLogic->SetActiveHierarchyNodeID(fiducialList->GetID());
+        vtkSmartPointer<vtkMRMLAnnotationFiducialNode> newFiducial =
+          vtkSmartPointer<vtkMRMLAnnotationFiducialNode>::New();
+        newFiducial->SetFiducialCoordinates(position);
+        if (keepNodeIDs)
+          {
+          newFiducial->SetID(remoteID);
+          }
+        newFiducial->Initialize(scene);
+        fiducialNode = newFiducial;
+        if (remotePlan)
+          {
+          remotePlan->SetLocalNodeID(remoteID, fiducialNode->GetID());
+          }
+        }
+      else
+        {
+        vtkSlicerPathPlannerLogic::SetFiducialWorldCoordinates(fiducialNode, position);
+        }
+      fiducialNode->SetName(plan->GetNthChangeName(n));
+      }
+    }
+  plan->ClearChanges();
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerPathPlannerModuleWidget::
+onUndoButtonClicked()
+{
+  this->stepPlanHistory(true);
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerPathPlannerModuleWidget::
+onRedoButtonClicked()
+{
+  this->stepPlanHistory(false);
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerPathPlannerModuleWidget::
+onPlanEdited()
+{
+  Q_D(qSlicerPathPlannerModuleWidget);
+
+  // Recorded by the operation in progress, if any, otherwise once the
+  // edits stop for a timer period
+  if (d->planEditDepth == 0)
+    {
+    d->planHistoryTimer.start();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerPathPlannerModuleWidget::
+recordPlanEdits()
+{
+  Q_D(qSlicerPathPlannerModuleWidget);
+
+  // The table is only complete once the outermost operation ends
+  if (d->planEditDepth > 0)
+    {
+    return;
+    }
+  d->planHistoryTimer.stop();
+
+  vtkSlicerPathPlannerLogic* pathPlannerLogic =
+    vtkSlicerPathPlannerLogic::SafeDownCast(this->logic());
+  if (!pathPlannerLogic)
+    {
+    return;
+    }
+  vtkSlicerPathPlannerPlanHistory* planHistory = pathPlannerLogic->GetPlanHistory();
+
+  if (this->describePlan(planHistory) > 0)
+    {
+    planHistory->Record();
+    this->publishPlanSnapshot();
+    }
+  d->UndoButton->setEnabled(planHistory->GetNumberOfUndoSteps() > 0);
+  d->RedoButton->setEnabled(planHistory->GetNumberOfRedoSteps() > 0);
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerPathPlannerModuleWidget::
+stepPlanHistory(bool undo)
+{
+  Q_D(qSlicerPathPlannerModuleWidget);
+
+  vtkSlicerPathPlannerLogic* pathPlannerLogic =
+    vtkSlicerPathPlannerLogic::SafeDownCast(this->logic());
+  if (!pathPlannerLogic)
+    {
+    return;
+    }
+  vtkSlicerPathPlannerPlanHistory* planHistory = pathPlannerLogic->GetPlanHistory();
+
+  // Fiducial edits not recorded yet form their own step
+  this->recordPlanEdits();
+  if ((undo ? planHistory->Undo() : planHistory->Redo()) > 0)
+    {
+    // The scene then matches the plan of the history: nothing is recorded
+    this->applyPlanChanges(planHistory);
+    this->publishPlanSnapshot();
+    }
+  d->UndoButton->setEnabled(planHistory->GetNumberOfUndoSteps() > 0);
+  d->RedoButton->setEnabled(planHistory->GetNumberOfRedoSteps() > 0);
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerPathPlannerModuleWidget::
+resetPlanHistory()
+{
+  Q_D(qSlicerPathPlannerModuleWidget);
+
+  vtkSlicerPathPlannerLogic* pathPlannerLogic =
+    vtkSlicerPathPlannerLogic::SafeDownCast(this->logic());
+  if (!pathPlannerLogic)
+    {
+    return;
+    }
+  vtkSlicerPathPlannerPlanHistory* planHistory = pathPlannerLogic->GetPlanHistory();
+
+  // The plan displayed now is the base of the next steps
+  d->planHistoryTimer.stop();
+  this->describePlan(planHistory);
+  planHistory->Record();
+  planHistory->ClearSteps();
+  d->UndoButton->setEnabled(false);
+  d->RedoButton->setEnabled(false);
+  this->publishPlanSnapshot();
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerPathPlannerModuleWidget::
+publishPlanSnapshot()
+{
+  Q_D(qSlicerPathPlannerModuleWidget);
+
+  vtkSlicerPathPlannerLogic* pathPlannerLogic =
+    vtkSlicerPathPlannerLogic::SafeDownCast(this->logic());
+  if (!pathPlannerLogic)
+    {
+    return;
+    }
+
+  // Published when the plan edits are recorded, so background workers see
+  // a new snapshot at the end of each operation
+  vtkNew<vtkCollection> volumeNodes;
+  if (d->CriticalStructuresNodeSelector->currentNode())
+    {
+    volumeNodes->AddItem(d->CriticalStructuresNodeSelector->currentNode());
+    }
+  pathPlannerLogic->PublishPlanSnapshot(d->selectedTrajectoryNode,
+                                        d->EntryPointWidget->selectedHierarchyNode(),
+                                        d->TargetPointWidget->selectedHierarchyNode(),
+                                        volumeNodes.GetPointer());
+}
@@ -36,6 +36,7 @@
 class qSlicerPathPlannerModuleWidgetPrivate;
 class vtkMRMLNode;
 class vtkMRMLAnnotationFiducialNode;
+class vtkSlicerPathPlannerPlanDescription;
 
 /// \ingroup Slicer_QtModules_ExtensionTemplate
 class Q_SLICER_QTMODULES_PATHPLANNER_EXPORT qSlicerPathPlannerModuleWidget :
@@ -60,19 +61,36 @@ public slots:
   void onDeleteButtonClicked();
   void onUpdateButtonClicked();
   void onClearButtonClicked();
+  void onAnalyzeButtonClicked();
   void onTrajectoryListNodeChanged(vtkMRMLNode* newList);
   void onTrajectoryCellClicked(int row, int column);
   void onMRMLSceneChanged(vtkMRMLScene* newScene);
   void onTargetSelectionChanged();
   void onEntrySelectionChanged();
   void onTrajectoryCellChanged(int row, int column);
+  void onTrackingToggled(bool checked);
+  void onTrackingTimeout();
+  void onPlanSyncToggled(bool checked);
+  void onPlanSyncTimeout();
+  void onPlanJournalChanged();
+  void onPlanJournalTimeout();
+  void onUndoButtonClicked();
+  void onRedoButtonClicked();
+  void onPlanEdited();
+  void recordPlanEdits();
 
 protected:
   QScopedPointer<qSlicerPathPlannerModuleWidgetPrivate> d_ptr;
   
   virtual void setup();
   void addNewFiducialItem(QTableWidget* tableWidget, vtkMRMLAnnotationFiducialNode* fiducialNode);
-  void addNewRulerItem(vtkMRMLAnnotationFiducialNode* entryPoint, vtkMRMLAnnotationFiducialNode* targetPoint);
+  void addNewRulerItem(vtkMRMLAnnotationFiducialNode* entryPoint, vtkMRMLAnnotationFiducialNode* targetPoint,
+                       const char* nodeID = NULL);
+  int describePlan(vtkSlicerPathPlannerPlanDescription* plan);
+  void applyPlanChanges(vtkSlicerPathPlannerPlanDescription* plan);
+  void stepPlanHistory(bool undo);
+  void resetPlanHistory();
+  void publishPlanSnapshot();
 
 private:
   Q_DECLARE_PRIVATE(qSlicerPathPlannerModuleWidget);